@@ -5,6 +5,7 @@ rm -rf edk2-edk2-stable201911
 unzip edk2-edk2-stable201911.zip
 
 /bin/cp -a ./edk2_mod/edk2-edk2-stable201911  ./
+/bin/cp -a ../vtoychain/vtoychain.h ../vtoychain/vtoychain.c ./edk2-edk2-stable201911/MdeModulePkg/Application/Ventoy/
 
 cd edk2-edk2-stable201911
 
@@ -699,6 +699,11 @@ STATIC EFI_STATUS EFIAPI ventoy_parse_cmdline(IN EFI_HANDLE ImageHandle)
         g_virt_chunk = (ventoy_virt_chunk *)((char *)g_chain + g_chain->virt_chunk_offset);
         g_virt_chunk_num = g_chain->virt_chunk_num;
 
+        if (vtoy_chain_init_head(&g_vtoy_chain, g_chain, size))
+        {
+            debug("invalid chunk table in chain head");
+        }
+
         g_os_param_reserved = (UINT8 *)(g_chain->os_param.vtoy_reserved);
 
         /* Workaround for Windows & ISO9660 */
@@ -751,9 +756,6 @@ STATIC EFI_STATUS EFIAPI ventoy_parse_cmdline(IN EFI_HANDLE ImageHandle)
 
 EFI_STATUS EFIAPI ventoy_clean_env(VOID)
 {
-    FreePool(g_sector_flag);
-    g_sector_flag_num = 0;
-
     if (gLoadIsoEfi && gBlockData.IsoDriverImage)
     {
         gBS->UnloadImage(gBlockData.IsoDriverImage);
@@ -946,14 +948,6 @@ EFI_STATUS EFIAPI VentoyEfiMain
     EFI_STATUS Status = EFI_SUCCESS;
     EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL *Protocol;
     
-    g_sector_flag_num = 512; /* initial value */
-
-    g_sector_flag = AllocatePool(g_sector_flag_num * sizeof(ventoy_sector_flag));
-    if (NULL == g_sector_flag)
-    {
-        return EFI_OUT_OF_RESOURCES;
-    }
-
     Status = gBS->HandleProtocol(gST->ConsoleInHandle, &gEfiSimpleTextInputExProtocolGuid, (VOID **)&Protocol);
     if (EFI_SUCCESS == Status)
     {
@@ -21,6 +21,8 @@
 #ifndef __VENTOY_H__
 #define __VENTOY_H__
 
+#include <vtoychain.h>
+
 #define COMPILE_ASSERT(expr)  extern char __compile_assert[(expr) ? 1 : -1]
 
 #define VENTOY_GUID { 0x77772020, 0x2e77, 0x6576, { 0x6e, 0x74, 0x6f, 0x79, 0x2e, 0x6e, 0x65, 0x74 }}
@@ -133,35 +135,6 @@ typedef struct ventoy_chain_head
     UINT32 virt_chunk_num;
 }ventoy_chain_head;
 
-
-typedef struct ventoy_img_chunk
-{
-    UINT32 img_start_sector; //2KB
-    UINT32 img_end_sector;
-
-    UINT64 disk_start_sector; // in disk_sector_size
-    UINT64 disk_end_sector;
-}ventoy_img_chunk;
-
-
-typedef struct ventoy_override_chunk
-{
-    UINT64 img_offset;
-    UINT32 override_size;
-    UINT8  override_data[512];
-}ventoy_override_chunk;
-
-typedef struct ventoy_virt_chunk
-{
-    UINT32 mem_sector_start;
-    UINT32 mem_sector_end;
-    UINT32 mem_sector_offset;
-    UINT32 remap_sector_start;
-    UINT32 remap_sector_end;
-    UINT32 org_sector_start;
-}ventoy_virt_chunk;
-
-
 #pragma pack()
 
 
@@ -185,12 +158,6 @@ typedef struct ventoy_virt_chunk
   #error Unknown Processor Type
 #endif
 
-typedef struct ventoy_sector_flag
-{
-    UINT8 flag; // 0:init   1:mem  2:remap
-    UINT64 remap_lba;    
-}ventoy_sector_flag;
-
 
 typedef struct vtoy_block_data 
 {
@@ -235,6 +202,8 @@ typedef int (*grub_env_printf_pf)(const char *fmt, ...);
 
 #define GRUB_FILE_REPLACE_MAGIC  0x1258BEEF
 
+#define VTOY_FILE_REPLACE_MAX   4
+
 typedef struct ventoy_efi_file_replace
 {
     UINT64 BlockIoSectorStart;
@@ -242,13 +211,22 @@ typedef struct ventoy_efi_file_replace
     UINT64 CurPos;
     UINT64 FileSizeBytes;
 
+    /* the memory part of the new file, read with CopyMem directly */
+    UINT8 *MemData;
+    UINT64 MemBytes;
+
+    /* old file names, converted and hashed once when the hook is installed */
+    UINT32 OldNameCnt;
+    UINT32 OldNameHash[VTOY_FILE_REPLACE_MAX];
+    CHAR16 OldName[VTOY_FILE_REPLACE_MAX][256];
+
     EFI_FILE_PROTOCOL  WrapperHandle;
 }ventoy_efi_file_replace;
 
 typedef struct ventoy_grub_param_file_replace
 {
     UINT32 magic;
-    char   old_file_name[4][256];
+    char   old_file_name[VTOY_FILE_REPLACE_MAX][256];
     UINT32 old_file_cnt;
     UINT32 new_file_virtual_id;
 }ventoy_grub_param_file_replace;
@@ -337,8 +315,7 @@ extern ventoy_virt_chunk *g_virt_chunk;
 extern UINT32 g_virt_chunk_num;
 extern vtoy_block_data gBlockData;
 extern ventoy_efi_file_replace g_efi_file_replace;
-extern ventoy_sector_flag *g_sector_flag;
-extern UINT32 g_sector_flag_num;
+extern vtoy_chain g_vtoy_chain;
 extern BOOLEAN gMemdiskMode;
 extern BOOLEAN gSector512Mode;
 extern UINTN g_iso_buf_size;
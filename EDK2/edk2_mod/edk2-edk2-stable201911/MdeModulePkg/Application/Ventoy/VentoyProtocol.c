@@ -41,8 +41,7 @@ UINTN g_iso_buf_size = 0;
 BOOLEAN gMemdiskMode = FALSE;
 BOOLEAN gSector512Mode = FALSE;
 
-ventoy_sector_flag *g_sector_flag = NULL;
-UINT32 g_sector_flag_num = 0;
+vtoy_chain g_vtoy_chain;
 
 EFI_FILE_OPEN g_original_fopen = NULL;
 EFI_FILE_CLOSE g_original_fclose = NULL;
@@ -126,6 +125,24 @@ EFI_STATUS EFIAPI ventoy_block_io_reset
 	return EFI_SUCCESS;
 }
 
+STATIC VOID ventoy_override_hook(VOID *Ctx, CONST ventoy_override_chunk *pOverride)
+{
+    ventoy_iso9660_override *dirent;
+
+    (VOID)Ctx;
+
+    if (g_fixup_iso9660_secover_enable && (!g_fixup_iso9660_secover_start) && 
+        pOverride->override_size == sizeof(ventoy_iso9660_override))
+    {
+        dirent = (ventoy_iso9660_override *)pOverride->override_data;
+        if (dirent->first_sector >= VENTOY_ISO9660_SECTOR_OVERFLOW)
+        {
+            g_fixup_iso9660_secover_start = TRUE;
+            g_fixup_iso9660_secover_cur_secs = 0;
+        }
+    }
+}
+
 STATIC EFI_STATUS EFIAPI ventoy_read_iso_sector
 (
     IN UINT64                 Sector,
@@ -135,39 +152,19 @@ STATIC EFI_STATUS EFIAPI ventoy_read_iso_sector
 {
     EFI_STATUS Status = EFI_SUCCESS;
     EFI_LBA MapLba = 0;
-    UINT32 i = 0;
-    UINTN secLeft = 0;
-    UINTN secRead = 0;
-    UINT64 ReadStart = 0;
-    UINT64 ReadEnd = 0;
-    UINT64 OverrideStart = 0;
-    UINT64 OverrideEnd= 0;
+    UINT32 secRead = 0;
+    UINT64 CurSector = Sector;
+    UINTN secLeft = Count;
     UINT8 *pCurBuf = (UINT8 *)Buffer;
-    ventoy_img_chunk *pchunk = g_chunk;
-    ventoy_override_chunk *pOverride = g_override_chunk;
     EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
     
     debug("read iso sector %lu  count %u", Sector, Count);
 
-    ReadStart = Sector * 2048;
-    ReadEnd = (Sector + Count) * 2048;
-
-    for (i = 0; Count > 0 && i < g_img_chunk_num; i++, pchunk++)
+    while (secLeft > 0)
     {
-        if (Sector >= pchunk->img_start_sector && Sector <= pchunk->img_end_sector)
+        secRead = (UINT32)secLeft;
+        if (vtoy_chain_map(&g_vtoy_chain, CurSector, &secRead, &MapLba) == 0)
         {
-            if (g_chain->disk_sector_size == 512)
-            {
-                MapLba = (Sector - pchunk->img_start_sector) * 4 + pchunk->disk_start_sector;
-            }
-            else
-            {
-                MapLba = (Sector - pchunk->img_start_sector) * 2048 / g_chain->disk_sector_size + pchunk->disk_start_sector;
-            }
-
-            secLeft = pchunk->img_end_sector + 1 - Sector;
-            secRead = (Count < secLeft) ? Count : secLeft;
-
             Status = pRawBlockIo->ReadBlocks(pRawBlockIo, pRawBlockIo->Media->MediaId,
                                      MapLba, secRead * 2048, pCurBuf);
             if (EFI_ERROR(Status))
@@ -175,64 +172,15 @@ STATIC EFI_STATUS EFIAPI ventoy_read_iso_sector
                 debug("Raw disk read block failed %r LBA:%lu Count:%u", Status, MapLba, secRead);
                 return Status;
             }
-
-            Count -= secRead;
-            Sector += secRead;
-            pCurBuf += secRead * 2048;
         }
-    }
 
-    if (ReadStart > g_chain->real_img_size_in_bytes)
-    {
-        return EFI_SUCCESS;
+        secLeft -= secRead;
+        CurSector += secRead;
+        pCurBuf += secRead * 2048;
     }
 
     /* override data */
-    pCurBuf = (UINT8 *)Buffer;
-    for (i = 0; i < g_override_chunk_num; i++, pOverride++)
-    {
-        OverrideStart = pOverride->img_offset;
-        OverrideEnd = pOverride->img_offset + pOverride->override_size;
-    
-        if (OverrideStart >= ReadEnd || ReadStart >= OverrideEnd)
-        {
-            continue;
-        }
-
-        if (ReadStart <= OverrideStart)
-        {
-            if (ReadEnd <= OverrideEnd)
-            {
-                CopyMem(pCurBuf + OverrideStart - ReadStart, pOverride->override_data, ReadEnd - OverrideStart);  
-            }
-            else
-            {
-                CopyMem(pCurBuf + OverrideStart - ReadStart, pOverride->override_data, pOverride->override_size);
-            }
-        }
-        else
-        {
-            if (ReadEnd <= OverrideEnd)
-            {
-                CopyMem(pCurBuf, pOverride->override_data + ReadStart - OverrideStart, ReadEnd - ReadStart); 
-            }
-            else
-            {
-                CopyMem(pCurBuf, pOverride->override_data + ReadStart - OverrideStart, OverrideEnd - ReadStart);
-            }
-        }
-
-        if (g_fixup_iso9660_secover_enable && (!g_fixup_iso9660_secover_start) && 
-            pOverride->override_size == sizeof(ventoy_iso9660_override))
-        {
-            ventoy_iso9660_override *dirent = (ventoy_iso9660_override *)pOverride->override_data;
-            if (dirent->first_sector >= VENTOY_ISO9660_SECTOR_OVERFLOW)
-            {
-                g_fixup_iso9660_secover_start = TRUE;
-                g_fixup_iso9660_secover_cur_secs = 0;
-            }
-        }
-    }
+    vtoy_chain_override(&g_vtoy_chain, Sector, (UINT32)Count, Buffer, ventoy_override_hook, NULL);
 
     if (g_blockio_start_record_bcd && FALSE == g_blockio_bcd_read_done)
     {
@@ -245,6 +193,12 @@ STATIC EFI_STATUS EFIAPI ventoy_read_iso_sector
     return EFI_SUCCESS;    
 }
 
+STATIC int ventoy_read_remap_sector(void *Ctx, UINT64 Sector, UINT32 Count, UINT8 *Buffer)
+{
+    (VOID)Ctx;
+    return EFI_ERROR(ventoy_read_iso_sector(Sector, Count, Buffer)) ? 1 : 0;
+}
+
 EFI_STATUS EFIAPI ventoy_block_io_ramdisk_read 
 (
     IN EFI_BLOCK_IO_PROTOCOL          *This,
@@ -272,6 +226,31 @@ EFI_STATUS EFIAPI ventoy_block_io_ramdisk_read
 	return EFI_SUCCESS;
 }
 
+EFI_STATUS EFIAPI ventoy_block_io_ramdisk_read_512
+(
+    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN UINT32                          MediaId,
+    IN EFI_LBA                         Lba,
+    IN UINTN                           BufferSize,
+    OUT VOID                          *Buffer
+)
+{
+    (VOID)This;
+    (VOID)MediaId;
+
+    CopyMem(Buffer, g_iso_data_buf + (Lba * 512), BufferSize);
+
+    if (g_blockio_start_record_bcd && FALSE == g_blockio_bcd_read_done)
+    {
+        if (*(UINT32 *)Buffer == 0x66676572)
+        {
+            g_blockio_bcd_read_done = TRUE;
+        }
+    }
+
+	return EFI_SUCCESS;
+}
+
 EFI_LBA EFIAPI ventoy_fixup_iso9660_sector(IN EFI_LBA Lba, UINT32 secNum)
 {
     UINT32 i = 0;
@@ -334,16 +313,8 @@ EFI_STATUS EFIAPI ventoy_block_io_read
     OUT VOID                          *Buffer
 ) 
 {
-    UINT32 i = 0;
-    UINT32 j = 0;
-    UINT32 lbacount = 0;
     UINT32 secNum = 0;
     UINT64 offset = 0;
-    EFI_LBA curlba = 0;
-    EFI_LBA lastlba = 0;
-    UINT8 *lastbuffer;
-    ventoy_sector_flag *cur_flag;
-    ventoy_virt_chunk *node;
     
     //debug("### ventoy_block_io_read sector:%u count:%u", (UINT32)Lba, (UINT32)BufferSize / 2048);
 
@@ -362,68 +333,9 @@ EFI_STATUS EFIAPI ventoy_block_io_read
         return ventoy_read_iso_sector(Lba, secNum, Buffer);
     }
 
-    if (secNum > g_sector_flag_num)
-    {
-        cur_flag = AllocatePool(secNum * sizeof(ventoy_sector_flag));
-        if (NULL == cur_flag)
-        {
-            return EFI_OUT_OF_RESOURCES;
-        }
-
-        FreePool(g_sector_flag);
-        g_sector_flag = cur_flag;
-        g_sector_flag_num = secNum;
-    }
-
-    for (curlba = Lba, cur_flag = g_sector_flag, j = 0; j < secNum; j++, curlba++, cur_flag++)
-    {
-        cur_flag->flag = 0;
-        for (node = g_virt_chunk, i = 0; i < g_virt_chunk_num; i++, node++)
-        {
-            if (curlba >= node->mem_sector_start && curlba < node->mem_sector_end)
-            {
-                CopyMem((UINT8 *)Buffer + j * 2048, 
-                       (char *)g_virt_chunk + node->mem_sector_offset + (curlba - node->mem_sector_start) * 2048,
-                       2048);
-                cur_flag->flag = 1;
-                break;
-            }
-            else if (curlba >= node->remap_sector_start && curlba < node->remap_sector_end)
-            {
-                cur_flag->remap_lba = node->org_sector_start + curlba - node->remap_sector_start;
-                cur_flag->flag = 2;
-                break;
-            }
-        }
-    }
-
-    for (curlba = Lba, cur_flag = g_sector_flag, j = 0; j < secNum; j++, curlba++, cur_flag++)
-    {
-        if (cur_flag->flag == 2)
-        {
-            if (lastlba == 0)
-            {
-                lastbuffer = (UINT8 *)Buffer + j * 2048;
-                lastlba = cur_flag->remap_lba;
-                lbacount = 1;
-            }
-            else if (lastlba + lbacount == cur_flag->remap_lba)
-            {
-                lbacount++;
-            }
-            else
-            {
-                ventoy_read_iso_sector(lastlba, lbacount, lastbuffer);
-                lastbuffer = (UINT8 *)Buffer + j * 2048;
-                lastlba = cur_flag->remap_lba;
-                lbacount = 1;
-            }
-        }
-    }
-
-    if (lbacount > 0)
+    if (vtoy_chain_virt_read(&g_vtoy_chain, Lba, secNum, Buffer, ventoy_read_remap_sector, NULL))
     {
-        ventoy_read_iso_sector(lastlba, lbacount, lastbuffer);
+        return EFI_DEVICE_ERROR;
     }
 
 	return EFI_SUCCESS;
@@ -575,6 +487,57 @@ end:
     return Status;
 }
 
+/*
+ * 512 bytes sector read inside the real image, map at 512 bytes granularity and read
+ * directly into the caller's buffer, so a small read is not turned into full 2048 bytes reads.
+ */
+STATIC EFI_STATUS EFIAPI ventoy_read_iso_sector_512
+(
+    IN UINT64                 Sector,
+    IN UINTN                  Count,
+    OUT VOID                 *Buffer
+)
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_LBA MapLba = 0;
+    UINT32 secRead = 0;
+    UINT64 CurSector = Sector;
+    UINTN secLeft = Count;
+    UINT8 *pCurBuf = (UINT8 *)Buffer;
+    EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
+
+    while (secLeft > 0)
+    {
+        secRead = (UINT32)secLeft;
+        if (vtoy_chain_map_512(&g_vtoy_chain, CurSector, &secRead, &MapLba) == 0)
+        {
+            Status = pRawBlockIo->ReadBlocks(pRawBlockIo, pRawBlockIo->Media->MediaId,
+                                     MapLba, secRead * 512, pCurBuf);
+            if (EFI_ERROR(Status))
+            {
+                debug("Raw disk read block failed %r LBA:%lu Count:%u", Status, MapLba, secRead);
+                return Status;
+            }
+        }
+
+        secLeft -= secRead;
+        CurSector += secRead;
+        pCurBuf += secRead * 512;
+    }
+
+    vtoy_chain_override_bytes(&g_vtoy_chain, Sector * 512, Count * 512, Buffer, ventoy_override_hook, NULL);
+
+    if (g_blockio_start_record_bcd && FALSE == g_blockio_bcd_read_done)
+    {
+        if (*(UINT32 *)Buffer == 0x66676572)
+        {
+            g_blockio_bcd_read_done = TRUE;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
 EFI_STATUS EFIAPI ventoy_block_io_read_512
 (
     IN EFI_BLOCK_IO_PROTOCOL          *This,
@@ -591,6 +554,21 @@ EFI_STATUS EFIAPI ventoy_block_io_read_512
 
     debug("ventoy_block_io_read_512 %lu %lu\n", Lba, BufferSize / 512);
 
+    if (gMemdiskMode)
+    {
+        return ventoy_block_io_ramdisk_read_512(This, MediaId, Lba, BufferSize, Buffer);
+    }
+
+    /*
+     * The virt chunks and the iso9660 fixup work on 2048 bytes sectors,
+     * only the reads inside the real image can go the direct way.
+     */
+    if (g_vtoy_chain.disk_sector_size == 512 && (!g_fixup_iso9660_secover_start) &&
+        Lba * 512 + BufferSize <= g_chain->real_img_size_in_bytes)
+    {
+        return ventoy_read_iso_sector_512(Lba, BufferSize / 512, Buffer);
+    }
+
     CurBuf = (UINT8 *)Buffer;
 
     Mod = Lba % 4;
@@ -840,7 +818,12 @@ STATIC EFI_STATUS EFIAPI
 ventoy_wrapper_file_read(EFI_FILE_HANDLE This, UINTN *Len, VOID *Data)
 {
     EFI_LBA Lba;
+    UINTN Mod = 0;
+    UINTN CopyLen = 0;
     UINTN ReadLen = *Len;
+    UINTN LeftLen = 0;
+    UINT64 Pos = g_efi_file_replace.CurPos;
+    UINT8 *CurBuf = (UINT8 *)Data;
     
     (VOID)This;
 
@@ -851,9 +834,41 @@ ventoy_wrapper_file_read(EFI_FILE_HANDLE This, UINTN *Len, VOID *Data)
         ReadLen = g_efi_file_replace.FileSizeBytes - g_efi_file_replace.CurPos;
     }
 
-    Lba = g_efi_file_replace.CurPos / 2048 + g_efi_file_replace.BlockIoSectorStart;
+    LeftLen = ReadLen;
+
+    /* the memory part, the loaders read the new file in small pieces, one CopyMem for each */
+    if (Pos < g_efi_file_replace.MemBytes)
+    {
+        CopyLen = (LeftLen < g_efi_file_replace.MemBytes - Pos) ? LeftLen : (UINTN)(g_efi_file_replace.MemBytes - Pos);
+        CopyMem(CurBuf, g_efi_file_replace.MemData + Pos, CopyLen);
 
-    ventoy_block_io_read(NULL, 0, Lba, ReadLen, Data);
+        CurBuf += CopyLen;
+        Pos += CopyLen;
+        LeftLen -= CopyLen;
+    }
+
+    /* the remap part, through the block io */
+    while (LeftLen > 0)
+    {
+        Lba = Pos / 2048 + g_efi_file_replace.BlockIoSectorStart;
+        Mod = (UINTN)(Pos % 2048);
+
+        if (Mod == 0 && LeftLen >= 2048)
+        {
+            CopyLen = LeftLen / 2048 * 2048;
+            ventoy_block_io_read(NULL, 0, Lba, CopyLen, CurBuf);
+        }
+        else
+        {
+            CopyLen = (LeftLen < 2048 - Mod) ? LeftLen : (2048 - Mod);
+            ventoy_block_io_read(NULL, 0, Lba, 2048, g_sector_buf);
+            CopyMem(CurBuf, g_sector_buf + Mod, CopyLen);
+        }
+
+        CurBuf += CopyLen;
+        Pos += CopyLen;
+        LeftLen -= CopyLen;
+    }
 
     *Len = ReadLen;
 
@@ -889,6 +904,18 @@ STATIC EFI_STATUS EFIAPI ventoy_wrapper_file_procotol(EFI_FILE_PROTOCOL *File)
     return EFI_SUCCESS;
 }
 
+STATIC UINT32 ventoy_file_name_hash(CONST CHAR16 *Name)
+{
+    UINT32 Hash = 2166136261U;
+
+    while (*Name)
+    {
+        Hash = (Hash ^ (UINT32)(*Name++)) * 16777619U;
+    }
+
+    return Hash;
+}
+
 STATIC EFI_STATUS EFIAPI ventoy_wrapper_file_open
 (
     EFI_FILE_HANDLE This, 
@@ -898,11 +925,10 @@ STATIC EFI_STATUS EFIAPI ventoy_wrapper_file_open
     UINT64 Attributes
 )
 {
-    UINT32 i = 0;
     UINT32 j = 0;
+    UINT32 Hash = 0;
     UINT64 Sectors = 0;
     EFI_STATUS Status = EFI_SUCCESS;
-    CHAR8 TmpName[256];
     ventoy_virt_chunk *virt = NULL;
 
     debug("## ventoy_wrapper_file_open <%s> ", Name);
@@ -916,10 +942,10 @@ STATIC EFI_STATUS EFIAPI ventoy_wrapper_file_open
     if (g_file_replace_list && g_file_replace_list->magic == GRUB_FILE_REPLACE_MAGIC &&
         g_file_replace_list->new_file_virtual_id < g_virt_chunk_num)
     {
-        AsciiSPrint(TmpName, sizeof(TmpName), "%s", Name);
-        for (j = 0; j < 4; j++)
+        Hash = ventoy_file_name_hash(Name);
+        for (j = 0; j < g_efi_file_replace.OldNameCnt; j++)
         {
-            if (0 == AsciiStrCmp(g_file_replace_list[i].old_file_name[j], TmpName))
+            if (Hash == g_efi_file_replace.OldNameHash[j] && 0 == StrCmp(g_efi_file_replace.OldName[j], Name))
             {
                 g_original_fclose(*New);
                 *New = &g_efi_file_replace.WrapperHandle;
@@ -931,6 +957,8 @@ STATIC EFI_STATUS EFIAPI ventoy_wrapper_file_open
                 
                 g_efi_file_replace.BlockIoSectorStart = virt->mem_sector_start;
                 g_efi_file_replace.FileSizeBytes = Sectors * 2048;
+                g_efi_file_replace.MemData = (UINT8 *)g_virt_chunk + virt->mem_sector_offset;
+                g_efi_file_replace.MemBytes = (UINT64)(virt->mem_sector_end - virt->mem_sector_start) * 2048;
 
                 if (gDebugPrint)
                 {
@@ -973,7 +1001,26 @@ EFI_STATUS EFIAPI ventoy_wrapper_open_volume
 
 EFI_STATUS EFIAPI ventoy_wrapper_push_openvolume(IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_OPEN_VOLUME OpenVolume)
 {
+    UINT32 j = 0;
+    UINT32 Cnt = 0;
+
     g_original_open_volume = OpenVolume;
+
+    /* the loaders open many files, build the name table once here instead of converting for each open */
+    Cnt = g_file_replace_list->old_file_cnt;
+    if (Cnt > VTOY_FILE_REPLACE_MAX)
+    {
+        Cnt = VTOY_FILE_REPLACE_MAX;
+    }
+
+    for (j = 0; j < Cnt; j++)
+    {
+        UnicodeSPrint(g_efi_file_replace.OldName[j], sizeof(g_efi_file_replace.OldName[j]), L"%a",
+                      g_file_replace_list->old_file_name[j]);
+        g_efi_file_replace.OldNameHash[j] = ventoy_file_name_hash(g_efi_file_replace.OldName[j]);
+    }
+    g_efi_file_replace.OldNameCnt = Cnt;
+
     return EFI_SUCCESS;
 }
 
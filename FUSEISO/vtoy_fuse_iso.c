@@ -28,16 +28,9 @@
 #include <errno.h>
 #include <fcntl.h>
 
-typedef unsigned int uint32_t;
+#include "vtoychain.h"
 
-typedef struct dmtable_entry
-{
-    uint32_t isoSector;
-    uint32_t sectorNum;
-    unsigned long long diskSector;
-}dmtable_entry;
-
-#define MAX_ENTRY_NUM  (1024 * 1024 / sizeof(dmtable_entry))
+#define DEFAULT_ENTRY_NUM  (1024 * 1024 / sizeof(ventoy_img_chunk))
 
 static int verbose = 0;
 #define debug(fmt, ...) if(verbose) printf(fmt, ##__VA_ARGS__)
@@ -46,8 +39,10 @@ static int g_disk_fd = -1;
 static uint64_t g_iso_file_size;
 static char g_mnt_point[512];
 static char g_iso_file_name[512];
-static dmtable_entry *g_disk_entry_list = NULL;
+static ventoy_img_chunk *g_disk_entry_list = NULL;
 static int g_disk_entry_num = 0;
+static int g_disk_entry_max = 0;
+static vtoy_chain g_img_chain;
 
 static int ventoy_iso_getattr(const char *path, struct stat *statinfo)
 {
@@ -114,36 +109,6 @@ static int ventoy_iso_open(const char *path, struct fuse_file_info *file)
     return 0;
 }
 
-static int ventoy_read_iso_sector(uint32_t sector, uint32_t num, char *buf)
-{
-    uint32_t i = 0;
-    uint32_t leftSec = 0;
-    uint32_t readSec = 0;
-    off_t offset = 0;
-    dmtable_entry *entry = NULL;
-    
-    for (i = 0; i < g_disk_entry_num && num > 0; i++)
-    {
-        entry = g_disk_entry_list + i;
-
-        if (sector >= entry->isoSector && sector < entry->isoSector + entry->sectorNum)
-        {
-            offset = (entry->diskSector + (sector - entry->isoSector)) * 512;
-
-            leftSec = entry->sectorNum - (sector - entry->isoSector);
-            readSec = (leftSec > num) ? num : leftSec;
-
-            pread(g_disk_fd, buf, readSec * 512, offset);
-
-            sector += readSec;
-            buf += readSec * 512;
-            num -= readSec;
-        }
-    }
-
-    return 0;
-}
-
 static int ventoy_iso_read
 (
     const char *path, char *buf, 
@@ -151,12 +116,13 @@ static int ventoy_iso_read
     struct fuse_file_info *file
 )
 {
+    int rc = 0;
     uint32_t mod = 0;
-    uint32_t align = 0;
-    uint32_t sector = 0;
-    uint32_t number = 0;
+    uint32_t count = 0;
+    uint64_t disk_sector = 0;
     size_t leftsize = 0;
-    char secbuf[512];
+    size_t len = 0;
+    ssize_t ret = 0;
     
     (void)file;
     
@@ -175,39 +141,39 @@ static int ventoy_iso_read
         size = g_iso_file_size - offset;
     }
     
+    /* read directly from the disk, one pread for each part continuous on the disk */
     leftsize = size;
-    sector = offset / 512;
-
-    mod = offset % 512;
-    if (mod > 0)
+    while (leftsize > 0)
     {
-        align = 512 - mod;
-        ventoy_read_iso_sector(sector, 1, secbuf);
+        mod = (uint32_t)(offset % 2048);
+        count = (uint32_t)((mod + leftsize + 2047) / 2048);
+
+        rc = vtoy_chain_map(&g_img_chain, offset / 2048, &count, &disk_sector);
 
-        if (leftsize > align)
+        len = (size_t)count * 2048 - mod;
+        if (len > leftsize)
         {
-            memcpy(buf, secbuf + mod, align);
-            buf += align;
-            offset += align;
-            sector++;
-            leftsize -= align;
+            len = leftsize;
+        }
+
+        if (rc)
+        {
+            memset(buf, 0, len);
         }
         else
         {
-            memcpy(buf, secbuf + mod, leftsize);
-            return size;
+            ret = pread(g_disk_fd, buf, len, (off_t)(disk_sector * 512 + mod));
+            if (ret <= 0)
+            {
+                debug("Failed to read %u at %llu err:%d\n", (unsigned int)len, (unsigned long long)disk_sector, errno);
+                return -EIO;
+            }
+            len = (size_t)ret;
         }
-    }
-
-    number = leftsize / 512;
-    ventoy_read_iso_sector(sector, number, buf);
-    buf += number * 512;
 
-    mod = leftsize % 512;
-    if (mod > 0)
-    {
-        ventoy_read_iso_sector(sector + number, 1, secbuf);
-        memcpy(buf, secbuf, mod);
+        buf += len;
+        offset += len;
+        leftsize -= len;
     }
 
     return size;
@@ -221,12 +187,98 @@ static struct fuse_operations ventoy_op =
     .read       = ventoy_iso_read,
 };
 
+static int ventoy_add_entry(uint32_t isoSector, uint32_t sectorNum, uint64_t diskSector)
+{
+    int newmax;
+    ventoy_img_chunk *entry = NULL;
+
+    if (g_disk_entry_num >= g_disk_entry_max)
+    {
+        newmax = g_disk_entry_max ? g_disk_entry_max * 2 : (int)DEFAULT_ENTRY_NUM;
+        entry = realloc(g_disk_entry_list, newmax * sizeof(ventoy_img_chunk));
+        if (NULL == entry)
+        {
+            fprintf(stderr, "Failed to alloc memory for %d entries\n", newmax);
+            return 1;
+        }
+
+        g_disk_entry_list = entry;
+        g_disk_entry_max = newmax;
+    }
+
+    entry = g_disk_entry_list + g_disk_entry_num;
+    entry->img_start_sector = isoSector / 4;
+    entry->img_end_sector = (isoSector + sectorNum) / 4 - 1;
+    entry->disk_start_sector = diskSector;
+    entry->disk_end_sector = diskSector + sectorNum - 1;
+    g_disk_entry_num++;
+
+    return 0;
+}
+
+static int ventoy_entry_cmp(const void *a, const void *b)
+{
+    const ventoy_img_chunk *entry1 = (const ventoy_img_chunk *)a;
+    const ventoy_img_chunk *entry2 = (const ventoy_img_chunk *)b;
+
+    if (entry1->img_start_sector < entry2->img_start_sector)
+    {
+        return -1;
+    }
+    
+    return (entry1->img_start_sector > entry2->img_start_sector) ? 1 : 0;
+}
+
+/*
+ * Sort the entries by the iso offset and merge the ones continuous both in the iso and 
+ * on the disk, so a read is mapped with a binary search over as few entries as possible.
+ */
+static int ventoy_merge_entry(void)
+{
+    int i;
+    int num = 0;
+    ventoy_img_chunk *last = NULL;
+    ventoy_img_chunk *cur = NULL;
+
+    qsort(g_disk_entry_list, g_disk_entry_num, sizeof(ventoy_img_chunk), ventoy_entry_cmp);
+
+    for (i = 0; i < g_disk_entry_num; i++)
+    {
+        cur = g_disk_entry_list + i;
+        if (last && last->img_end_sector >= cur->img_start_sector)
+        {
+            fprintf(stderr, "Overlapped dmsetup table entry at iso sector %u\n", cur->img_start_sector);
+            return 1;
+        }
+
+        if (last && last->img_end_sector + 1 == cur->img_start_sector && 
+            last->disk_end_sector + 1 == cur->disk_start_sector)
+        {
+            last->img_end_sector = cur->img_end_sector;
+            last->disk_end_sector = cur->disk_end_sector;
+            continue;
+        }
+
+        last = g_disk_entry_list + num++;
+        if (last != cur)
+        {
+            *last = *cur;
+        }
+    }
+
+    debug("dmsetup table entry %d merged to %d\n", g_disk_entry_num, num);
+    g_disk_entry_num = num;
+    return 0;
+}
+
 static int ventoy_parse_dmtable(const char *filename)
 {
     FILE *fp = NULL;
+    uint32_t isoSector = 0;
+    uint32_t sectorNum = 0;
+    unsigned long long diskSector = 0;
     char diskname[128] = {0};
     char line[256] = {0};
-    dmtable_entry *entry= g_disk_entry_list;
 
     fp = fopen(filename, "r");
     if (NULL == fp)
@@ -236,26 +288,48 @@ static int ventoy_parse_dmtable(const char *filename)
     }
 
     /* read untill the last line */
-    while (fgets(line, sizeof(line), fp) && g_disk_entry_num < MAX_ENTRY_NUM)
+    while (fgets(line, sizeof(line), fp))
     {
-        sscanf(line, "%u %u linear %s %llu", 
-               &entry->isoSector, &entry->sectorNum, 
-               diskname, &entry->diskSector);
+        if (sscanf(line, "%u %u linear %127s %llu", 
+                   &isoSector, &sectorNum, 
+                   diskname, &diskSector) != 4)
+        {
+            continue;
+        }
+
+        /* the table is made from the 2048 bytes image sectors by vtoydm -p */
+        if ((isoSector % 4) || (sectorNum % 4) || sectorNum == 0)
+        {
+            fprintf(stderr, "Invalid dmsetup table line: %s", line);
+            fclose(fp);
+            return 1;
+        }
+
+        if (ventoy_add_entry(isoSector, sectorNum, diskSector))
+        {
+            fclose(fp);
+            return 1;
+        }
 
-        g_iso_file_size += (uint64_t)entry->sectorNum * 512ULL;
-        g_disk_entry_num++;
-        entry++;
+        g_iso_file_size += (uint64_t)sectorNum * 512ULL;
     }
     fclose(fp);
 
-    if (g_disk_entry_num >= MAX_ENTRY_NUM)
+    if (g_disk_entry_num == 0)
+    {
+        fprintf(stderr, "No valid line in dmsetup table %s\n", filename);
+        return 1;
+    }
+
+    if (ventoy_merge_entry())
     {
-        fprintf(stderr, "ISO file has too many fragments ( more than %u )\n", MAX_ENTRY_NUM);
         return 1;
     }
 
     debug("iso file size: %llu disk name %s\n", g_iso_file_size, diskname);
 
+    vtoy_chain_init(&g_img_chain, g_disk_entry_list, 0, 0, g_disk_entry_num, 0, 0, 0, 0, g_iso_file_size, 512);
+
     g_disk_fd = open(diskname, O_RDONLY);
     if (g_disk_fd < 0)
     {
@@ -323,12 +397,6 @@ int main(int argc, char **argv)
 
     debug("ventoy fuse iso: %s %s %s\n", filename, g_iso_file_name, g_mnt_point);
 
-    g_disk_entry_list = malloc(MAX_ENTRY_NUM * sizeof(dmtable_entry));
-    if (NULL == g_disk_entry_list)
-    {
-        return 1;
-    }
-
     rc = ventoy_parse_dmtable(filename);
     if (rc)
     {
@@ -28,6 +28,8 @@
 #include <grub/fshelp.h>
 #include <grub/charset.h>
 #include <grub/datetime.h>
+#include <grub/i18n.h>
+#include <grub/partition.h>
 #include <grub/ventoy.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
@@ -40,6 +42,47 @@ static grub_uint64_t g_ventoy_last_read_dirent_offset = 0;
 static grub_uint64_t g_ventoy_last_file_dirent_pos = 0;
 static grub_uint64_t g_ventoy_last_file_dirent_offset = 0;
 
+extern int g_ventoy_case_insensitive;
+
+/*
+ * Ventoy opens the same few paths (/boot/..., /casper/..., /isolinux/...) in
+ * the mounted ISO many times while probing the distro. Remember the result of
+ * each path lookup (the found node or "not found") so that a repeated lookup
+ * does not walk the directory records again.
+ * The cache belongs to one mount. A different disk/partition/volume (e.g. after
+ * "loopback -d loop" and a new "loopback loop xxx.iso", which always gets a new
+ * disk id) flushes the whole cache.
+ */
+#define VTOY_DIRENT_CACHE_NUM     128
+#define VTOY_DIRENT_CACHE_PATH    256
+
+typedef struct ventoy_dirent_cache
+{
+    int valid;
+    int expecttype;
+    grub_uint32_t lru;
+    grub_uint64_t dirent_pos;
+    grub_uint64_t dirent_offset;
+    struct grub_fshelp_node *node; /* NULL means the path does not exist */
+    char path[VTOY_DIRENT_CACHE_PATH];
+}ventoy_dirent_cache;
+
+typedef struct ventoy_dirent_cache_key
+{
+    unsigned long dev_id;
+    unsigned long disk_id;
+    grub_disk_addr_t part_start;
+    grub_uint32_t root_sector;
+    int joliet;
+    int rockridge;
+}ventoy_dirent_cache_key;
+
+static int g_ventoy_dirent_cache_enable = 1;
+static grub_uint32_t g_ventoy_dirent_cache_lru = 0;
+static ventoy_dirent_cache_key g_ventoy_dirent_cache_key;
+static ventoy_dirent_cache g_ventoy_dirent_cache[VTOY_DIRENT_CACHE_NUM];
+static grub_iso9660_cache_stat g_ventoy_dirent_cache_stat;
+
 #define GRUB_ISO9660_FSTYPE_DIR		0040000
 #define GRUB_ISO9660_FSTYPE_REG		0100000
 #define GRUB_ISO9660_FSTYPE_SYMLINK	0120000
@@ -856,6 +899,219 @@ grub_iso9660_iterate_dir (grub_fshelp_node_t dir,
 
 
 
+static grub_size_t ventoy_dirent_node_size(struct grub_fshelp_node *node)
+{
+    grub_size_t size;
+
+    size = sizeof (struct grub_fshelp_node)
+           + (node->alloc_dirents - ARRAY_SIZE (node->dirents)) * sizeof (node->dirents[0]);
+
+    if (node->have_symlink)
+    {
+        size += grub_strlen (node->symlink + node->have_dirents * sizeof (node->dirents[0])
+                             - sizeof (node->dirents)) + 1;
+    }
+
+    return size;
+}
+
+static struct grub_fshelp_node *ventoy_dirent_node_dup(struct grub_fshelp_node *node)
+{
+    grub_size_t size;
+    struct grub_fshelp_node *dup;
+
+    size = ventoy_dirent_node_size(node);
+    dup = grub_malloc (size);
+    if (dup)
+    {
+        grub_memcpy (dup, node, size);
+    }
+
+    return dup;
+}
+
+void grub_iso9660_flush_cache(void)
+{
+    int i;
+
+    for (i = 0; i < VTOY_DIRENT_CACHE_NUM; i++)
+    {
+        if (g_ventoy_dirent_cache[i].valid)
+        {
+            grub_free (g_ventoy_dirent_cache[i].node);
+            grub_memset (g_ventoy_dirent_cache + i, 0, sizeof (ventoy_dirent_cache));
+        }
+    }
+
+    grub_memset (&g_ventoy_dirent_cache_key, 0, sizeof (g_ventoy_dirent_cache_key));
+    g_ventoy_dirent_cache_stat.flush++;
+}
+
+static void ventoy_dirent_cache_check_key(struct grub_iso9660_data *data)
+{
+    ventoy_dirent_cache_key key;
+
+    grub_memset (&key, 0, sizeof (key));
+    key.dev_id = data->disk->dev->id;
+    key.disk_id = data->disk->id;
+    key.part_start = grub_partition_get_start (data->disk->partition);
+    key.root_sector = grub_le_to_cpu32 (data->voldesc.rootdir.first_sector);
+    key.joliet = data->joliet;
+    key.rockridge = data->rockridge;
+
+    if (grub_memcmp (&key, &g_ventoy_dirent_cache_key, sizeof (key)) != 0)
+    {
+        grub_iso9660_flush_cache();
+        grub_memcpy (&g_ventoy_dirent_cache_key, &key, sizeof (key));
+    }
+}
+
+static ventoy_dirent_cache *ventoy_dirent_cache_find(const char *path, int expecttype)
+{
+    int i;
+
+    for (i = 0; i < VTOY_DIRENT_CACHE_NUM; i++)
+    {
+        if (g_ventoy_dirent_cache[i].valid && g_ventoy_dirent_cache[i].expecttype == expecttype &&
+            grub_strcmp (g_ventoy_dirent_cache[i].path, path) == 0)
+        {
+            return g_ventoy_dirent_cache + i;
+        }
+    }
+
+    return NULL;
+}
+
+static void ventoy_dirent_cache_add(const char *path, int expecttype, struct grub_fshelp_node *node)
+{
+    int i;
+    ventoy_dirent_cache *cache = g_ventoy_dirent_cache;
+
+    for (i = 0; i < VTOY_DIRENT_CACHE_NUM; i++)
+    {
+        if (!g_ventoy_dirent_cache[i].valid)
+        {
+            cache = g_ventoy_dirent_cache + i;
+            break;
+        }
+
+        if (g_ventoy_dirent_cache[i].lru < cache->lru)
+        {
+            cache = g_ventoy_dirent_cache + i;
+        }
+    }
+
+    if (cache->valid)
+    {
+        grub_free (cache->node);
+        g_ventoy_dirent_cache_stat.evict++;
+    }
+
+    cache->node = NULL;
+    if (node)
+    {
+        cache->node = ventoy_dirent_node_dup(node);
+        if (!cache->node)
+        {
+            grub_errno = GRUB_ERR_NONE;
+            cache->valid = 0;
+            return;
+        }
+    }
+
+    cache->valid = 1;
+    cache->expecttype = expecttype;
+    cache->lru = ++g_ventoy_dirent_cache_lru;
+    cache->dirent_pos = g_ventoy_last_file_dirent_pos;
+    cache->dirent_offset = g_ventoy_last_file_dirent_offset;
+    grub_strncpy (cache->path, path, sizeof (cache->path) - 1);
+    cache->path[sizeof (cache->path) - 1] = 0;
+}
+
+/* grub_fshelp_find_file with the dirent cache in front of it.  */
+static grub_err_t
+ventoy_iso9660_find_file (const char *path, struct grub_fshelp_node *rootnode,
+			  struct grub_fshelp_node **foundnode,
+			  enum grub_fshelp_filetype expecttype)
+{
+  grub_err_t err;
+  ventoy_dirent_cache *cache;
+
+  if (!g_ventoy_dirent_cache_enable || g_ventoy_case_insensitive
+      || !path || grub_strlen (path) >= VTOY_DIRENT_CACHE_PATH)
+    return grub_fshelp_find_file (path, rootnode, foundnode,
+				  grub_iso9660_iterate_dir,
+				  grub_iso9660_read_symlink, expecttype);
+
+  ventoy_dirent_cache_check_key (rootnode->data);
+  g_ventoy_dirent_cache_stat.lookup++;
+
+  cache = ventoy_dirent_cache_find (path, expecttype);
+  if (cache)
+    {
+      cache->lru = ++g_ventoy_dirent_cache_lru;
+      if (!cache->node)
+	{
+	  g_ventoy_dirent_cache_stat.negative_hit++;
+	  return grub_error (GRUB_ERR_FILE_NOT_FOUND, N_("file `%s' not found"), path);
+	}
+
+      *foundnode = ventoy_dirent_node_dup (cache->node);
+      if (!*foundnode)
+	return grub_errno;
+
+      (*foundnode)->data = rootnode->data;
+      g_ventoy_last_file_dirent_pos = cache->dirent_pos;
+      g_ventoy_last_file_dirent_offset = cache->dirent_offset;
+      g_ventoy_dirent_cache_stat.hit++;
+      return GRUB_ERR_NONE;
+    }
+
+  g_ventoy_dirent_cache_stat.miss++;
+
+  err = grub_fshelp_find_file (path, rootnode, foundnode,
+			       grub_iso9660_iterate_dir,
+			       grub_iso9660_read_symlink, expecttype);
+  if (err == GRUB_ERR_NONE && *foundnode != rootnode)
+    ventoy_dirent_cache_add (path, expecttype, *foundnode);
+  else if (err == GRUB_ERR_FILE_NOT_FOUND)
+    ventoy_dirent_cache_add (path, expecttype, NULL);
+
+  return err;
+}
+
+void grub_iso9660_get_cache_stat(grub_iso9660_cache_stat *stat)
+{
+    int i;
+
+    grub_memcpy (stat, &g_ventoy_dirent_cache_stat, sizeof (grub_iso9660_cache_stat));
+
+    stat->entry = 0;
+    for (i = 0; i < VTOY_DIRENT_CACHE_NUM; i++)
+    {
+        if (g_ventoy_dirent_cache[i].valid)
+        {
+            stat->entry++;
+        }
+    }
+    stat->enable = g_ventoy_dirent_cache_enable;
+}
+
+void grub_iso9660_set_cache(int enable, int clear_stat)
+{
+    if (!enable)
+    {
+        grub_iso9660_flush_cache();
+    }
+
+    g_ventoy_dirent_cache_enable = enable;
+
+    if (clear_stat)
+    {
+        grub_memset (&g_ventoy_dirent_cache_stat, 0, sizeof (g_ventoy_dirent_cache_stat));
+    }
+}
+
 /* Context for grub_iso9660_dir.  */
 struct grub_iso9660_dir_ctx
 {
@@ -874,6 +1130,7 @@ grub_iso9660_dir_iter (const char *filename,
 
   grub_memset (&info, 0, sizeof (info));
   info.dir = ((filetype & GRUB_FSHELP_TYPE_MASK) == GRUB_FSHELP_DIR);
+  info.case_insensitive = !!(filetype & GRUB_FSHELP_CASE_INSENSITIVE);
   info.mtimeset = !!iso9660_to_unixtime2 (&node->dirents[0].mtime, &info.mtime);
 
   grub_free (node);
@@ -902,11 +1159,7 @@ grub_iso9660_dir (grub_device_t device, const char *path,
   rootnode.dirents[0] = data->voldesc.rootdir;
 
   /* Use the fshelp function to traverse the path.  */
-  if (grub_fshelp_find_file (path, &rootnode,
-			     &foundnode,
-			     grub_iso9660_iterate_dir,
-			     grub_iso9660_read_symlink,
-			     GRUB_FSHELP_DIR))
+  if (ventoy_iso9660_find_file (path, &rootnode, &foundnode, GRUB_FSHELP_DIR))
     goto fail;
 
   /* List the files in the directory.  */
@@ -945,11 +1198,7 @@ grub_iso9660_open (struct grub_file *file, const char *name)
   rootnode.dirents[0] = data->voldesc.rootdir;
 
   /* Use the fshelp function to traverse the path.  */
-  if (grub_fshelp_find_file (name, &rootnode,
-			     &foundnode,
-			     grub_iso9660_iterate_dir,
-			     grub_iso9660_read_symlink,
-			     GRUB_FSHELP_REG))
+  if (ventoy_iso9660_find_file (name, &rootnode, &foundnode, GRUB_FSHELP_REG))
     goto fail;
 
   data->node = foundnode;
@@ -45,6 +45,186 @@ extern int g_ventoy_menu_refresh;
 
 static grub_gfxmenu_view_t cached_view;
 
+/* Decoded theme images are kept across view rebuilds, so a new view does
+   not read and decode every PNG from the disk again.  */
+#define VTOY_BITMAP_CACHE_MAX  (16 * 1024 * 1024)
+
+struct ventoy_bitmap_cache
+{
+  struct ventoy_bitmap_cache *next;
+  char *filename;
+  struct grub_video_bitmap *bitmap;
+  grub_size_t size;
+};
+
+static struct ventoy_bitmap_cache *bitmap_cache;
+static grub_size_t bitmap_cache_size;
+static int ventoy_bitmap_hooked;
+
+static grub_err_t
+ventoy_bitmap_cache_reader (struct grub_video_bitmap **bitmap,
+			    const char *filename);
+
+static struct grub_video_bitmap_reader ventoy_bitmap_readers[] =
+  {
+    { .extension = ".png", .reader = ventoy_bitmap_cache_reader },
+    { .extension = ".jpg", .reader = ventoy_bitmap_cache_reader },
+    { .extension = ".jpeg", .reader = ventoy_bitmap_cache_reader },
+    { .extension = ".tga", .reader = ventoy_bitmap_cache_reader },
+  };
+
+static grub_err_t
+ventoy_bitmap_copy (struct grub_video_bitmap **dst,
+		    struct grub_video_bitmap *src)
+{
+  grub_err_t err;
+
+  err = grub_video_bitmap_create (dst, src->mode_info.width,
+				  src->mode_info.height,
+				  src->mode_info.blit_format);
+  if (err)
+    return err;
+
+  grub_memcpy ((*dst)->data, src->data,
+	       src->mode_info.pitch * src->mode_info.height);
+  return GRUB_ERR_NONE;
+}
+
+static void
+ventoy_bitmap_cache_clear (void)
+{
+  struct ventoy_bitmap_cache *node, *next;
+
+  for (node = bitmap_cache; node; node = next)
+    {
+      next = node->next;
+      grub_video_bitmap_destroy (node->bitmap);
+      grub_free (node->filename);
+      grub_free (node);
+    }
+
+  bitmap_cache = NULL;
+  bitmap_cache_size = 0;
+}
+
+static void
+ventoy_bitmap_cache_add (const char *filename, struct grub_video_bitmap *bitmap)
+{
+  grub_size_t size;
+  struct ventoy_bitmap_cache *node, **last;
+
+  size = bitmap->mode_info.pitch * bitmap->mode_info.height;
+  if (size > VTOY_BITMAP_CACHE_MAX)
+    return;
+
+  node = grub_zalloc (sizeof (*node));
+  if (! node)
+    return;
+
+  node->filename = grub_strdup (filename);
+  if (! node->filename || ventoy_bitmap_copy (&node->bitmap, bitmap))
+    {
+      grub_free (node->filename);
+      grub_free (node);
+      grub_errno = GRUB_ERR_NONE;
+      return;
+    }
+  node->size = size;
+
+  /* Drop the oldest ones from the tail of the list.  */
+  while (bitmap_cache && bitmap_cache_size + size > VTOY_BITMAP_CACHE_MAX)
+    {
+      for (last = &bitmap_cache; (*last)->next; last = &(*last)->next);
+      bitmap_cache_size -= (*last)->size;
+      grub_video_bitmap_destroy ((*last)->bitmap);
+      grub_free ((*last)->filename);
+      grub_free (*last);
+      *last = NULL;
+    }
+
+  node->next = bitmap_cache;
+  bitmap_cache = node;
+  bitmap_cache_size += size;
+}
+
+static void
+ventoy_bitmap_cache_hook (int enable)
+{
+  unsigned i;
+
+  if (ventoy_bitmap_hooked == enable)
+    return;
+
+  for (i = 0; i < ARRAY_SIZE (ventoy_bitmap_readers); i++)
+    if (enable)
+      grub_video_bitmap_reader_register (&ventoy_bitmap_readers[i]);
+    else
+      grub_video_bitmap_reader_unregister (&ventoy_bitmap_readers[i]);
+
+  ventoy_bitmap_hooked = enable;
+}
+
+static grub_err_t
+ventoy_bitmap_cache_reader (struct grub_video_bitmap **bitmap,
+			    const char *filename)
+{
+  grub_err_t err;
+  struct ventoy_bitmap_cache *node;
+
+  for (node = bitmap_cache; node; node = node->next)
+    if (grub_strcmp (node->filename, filename) == 0)
+      return ventoy_bitmap_copy (bitmap, node->bitmap);
+
+  /* Not cached, let the real decoder load it.  The cache readers are out
+     of the list meanwhile, so the load does not come back here.  */
+  ventoy_bitmap_cache_hook (0);
+  err = grub_video_bitmap_load (bitmap, filename);
+  ventoy_bitmap_cache_hook (1);
+
+  if (err == GRUB_ERR_NONE && *bitmap)
+    ventoy_bitmap_cache_add (filename, *bitmap);
+
+  return err;
+}
+
+static void
+ventoy_component_abs_bounds (grub_gui_component_t comp, grub_video_rect_t *r)
+{
+  grub_video_rect_t bounds;
+  grub_gui_container_t parent;
+
+  comp->ops->get_bounds (comp, r);
+  for (parent = comp->ops->get_parent (comp); parent;
+       parent = parent->component.ops->get_parent (parent))
+    {
+      parent->component.ops->get_bounds (parent, &bounds);
+      r->x += bounds.x;
+      r->y += bounds.y;
+    }
+}
+
+static void
+ventoy_refresh_status_label_text (grub_gui_component_t comp,
+				  void *userdata __attribute__ ((unused)))
+{
+  if (comp->ops->is_instance (comp, "ventoy_status"))
+    comp->ops->set_property (comp, "ventoy_refresh", NULL);
+}
+
+static void
+ventoy_refresh_status_label (grub_gui_component_t comp, void *userdata)
+{
+  grub_video_rect_t bounds;
+  grub_gfxmenu_view_t view = userdata;
+
+  if (! comp->ops->is_instance (comp, "ventoy_status"))
+    return;
+
+  comp->ops->set_property (comp, "ventoy_refresh", NULL);
+  ventoy_component_abs_bounds (comp, &bounds);
+  grub_gfxmenu_redraw_ext (view, &bounds);
+}
+
 static void 
 grub_gfxmenu_viewer_fini (void *data __attribute__ ((unused)))
 {
@@ -55,6 +235,7 @@ static grub_err_t
 grub_gfxmenu_try (int entry, grub_menu_t menu, int nested)
 {
   int force_refresh = 0;
+  int label_refresh = 0;
   grub_gfxmenu_view_t view = NULL;
   const char *theme_path;
   char *full_theme_path = 0;
@@ -84,14 +265,18 @@ grub_gfxmenu_try (int entry, grub_menu_t menu, int nested)
 					theme_path);
     }
 
+  /* Readers registered later come first, so register again to stay in
+     front of the decoders loaded meanwhile.  */
+  ventoy_bitmap_cache_hook (0);
+  ventoy_bitmap_cache_hook (1);
+
   if (g_ventoy_menu_refresh)
   {
       g_ventoy_menu_refresh = 0;
       force_refresh = 1;
   }
 
-  if (force_refresh ||
-      !cached_view || grub_strcmp (cached_view->theme_path,
+  if (!cached_view || grub_strcmp (cached_view->theme_path,
 				   full_theme_path ? : theme_path) != 0
       || cached_view->screen.width != mode_info.width
       || cached_view->screen.height != mode_info.height)
@@ -102,6 +287,14 @@ grub_gfxmenu_try (int entry, grub_menu_t menu, int nested)
 					   mode_info.width,
 					   mode_info.height);
     }
+  else if (force_refresh && cached_view->menu == menu
+	   && cached_view->selected == entry
+	   && cached_view->nested == nested)
+    {
+      /* Only the memdisk/ISO raw/UEFI driver status labels changed, the
+	 rest of the screen is still there.  */
+      label_refresh = 1;
+    }
   grub_free (full_theme_path);
 
   if (! cached_view)
@@ -127,7 +320,16 @@ grub_gfxmenu_try (int entry, grub_menu_t menu, int nested)
       grub_video_set_viewport (0, 0, mode_info.width, mode_info.height);
     }
 
-  grub_gfxmenu_view_draw (view);
+  if (label_refresh)
+    grub_gui_iterate_recursively ((grub_gui_component_t) view->canvas,
+				  ventoy_refresh_status_label, view);
+  else
+    {
+      if (force_refresh)
+	grub_gui_iterate_recursively ((grub_gui_component_t) view->canvas,
+				      ventoy_refresh_status_label_text, NULL);
+      grub_gfxmenu_view_draw (view);
+    }
 
   instance->data = view;
   instance->set_chosen_entry = grub_gfxmenu_set_chosen_entry;
@@ -157,5 +359,7 @@ GRUB_MOD_INIT (gfxmenu)
 GRUB_MOD_FINI (gfxmenu)
 {
   grub_gfxmenu_view_destroy (cached_view);
+  ventoy_bitmap_cache_hook (0);
+  ventoy_bitmap_cache_clear ();
   grub_gfxmenu_try_hook = NULL;
 }
@@ -44,6 +44,14 @@ enum align_mode {
   align_right
 };
 
+/* Ventoy status labels, their text follows the F-key toggles.  */
+enum vtoy_status {
+  vtoy_status_none,
+  vtoy_status_mem_disk,
+  vtoy_status_iso_raw,
+  vtoy_status_iso_uefi_drv
+};
+
 struct grub_gui_label
 {
   struct grub_gui_component comp;
@@ -58,6 +66,7 @@ struct grub_gui_label
   grub_video_rgba_color_t color;
   int value;
   enum align_mode align;
+  enum vtoy_status status;
 };
 
 typedef struct grub_gui_label *grub_gui_label_t;
@@ -80,11 +89,32 @@ label_get_id (void *vself)
 }
 
 static int
-label_is_instance (void *vself __attribute__((unused)), const char *type)
+label_is_instance (void *vself, const char *type)
 {
+  grub_gui_label_t self = vself;
+
+  if (self->status != vtoy_status_none
+      && grub_strcmp (type, "ventoy_status") == 0)
+    return 1;
+
   return grub_strcmp (type, "component") == 0;
 }
 
+static const char *
+label_get_status_text (enum vtoy_status status)
+{
+  const char *value = NULL;
+
+  if (status == vtoy_status_mem_disk && g_ventoy_memdisk_mode)
+    value = grub_env_get("VTOY_MEM_DISK_STR");
+  else if (status == vtoy_status_iso_raw && g_ventoy_iso_raw)
+    value = grub_env_get("VTOY_ISO_RAW_STR");
+  else if (status == vtoy_status_iso_uefi_drv && g_ventoy_iso_uefi_drv)
+    value = grub_env_get("VTOY_ISO_UEFI_DRV_STR");
+
+  return value ? : " ";
+}
+
 static void
 label_paint (void *vself, const grub_video_rect_t *region)
 {
@@ -180,6 +210,7 @@ label_set_property (void *vself, const char *name, const char *value)
     {
       grub_free (self->text);
       grub_free (self->template);
+      self->status = vtoy_status_none;
       if (! value)
 	{
 	  self->template = NULL;
@@ -200,13 +231,16 @@ label_set_property (void *vself, const char *name, const char *value)
 	   /* FIXME: Add more templates here if needed.  */
        
        else if (grub_strcmp (value, "@VTOY_MEM_DISK@") == 0) {
-            value = g_ventoy_memdisk_mode ? grub_env_get("VTOY_MEM_DISK_STR") : " ";
+            self->status = vtoy_status_mem_disk;
+            value = label_get_status_text (self->status);
        }
        else if (grub_strcmp (value, "@VTOY_ISO_RAW@") == 0) {
-            value = g_ventoy_iso_raw ? grub_env_get("VTOY_ISO_RAW_STR") : " ";
+            self->status = vtoy_status_iso_raw;
+            value = label_get_status_text (self->status);
        }
        else if (grub_strcmp (value, "@VTOY_ISO_UEFI_DRV@") == 0) {
-            value = g_ventoy_iso_uefi_drv ? grub_env_get("VTOY_ISO_UEFI_DRV_STR") : " ";
+            self->status = vtoy_status_iso_uefi_drv;
+            value = label_get_status_text (self->status);
        }
        else if (grub_strcmp (value, "@VTOY_HOTKEY_TIP@") == 0) {
             value = grub_env_get("VTOY_HOTKEY_TIP");
@@ -219,6 +253,17 @@ label_set_property (void *vself, const char *name, const char *value)
 	  self->text = grub_xasprintf (value, self->value);
 	}
     }
+  else if (grub_strcmp (name, "ventoy_refresh") == 0)
+    {
+      /* Re-evaluate the status text after an F-key toggle.  */
+      if (self->status != vtoy_status_none)
+	{
+	  grub_free (self->text);
+	  grub_free (self->template);
+	  self->template = grub_strdup (label_get_status_text (self->status));
+	  self->text = grub_xasprintf (self->template ? : "", self->value);
+	}
+    }
   else if (grub_strcmp (name, "font") == 0)
     {
       self->font = grub_font_get (value);
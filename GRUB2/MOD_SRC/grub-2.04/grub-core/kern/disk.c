@@ -34,6 +34,68 @@ static grub_uint64_t grub_last_time = 0;
 
 struct grub_disk_cache grub_disk_cache_table[GRUB_DISK_CACHE_NUM];
 
+struct grub_disk_io_stat grub_disk_io_total;
+struct grub_disk_io_stat grub_disk_io_stat[GRUB_DISK_IO_STAT_MAX];
+int grub_disk_io_stat_num;
+
+static struct grub_disk_io_stat *
+grub_disk_io_get_stat (grub_disk_t disk)
+{
+  int i;
+  static int last = 0;
+
+  if (last < grub_disk_io_stat_num
+      && grub_disk_io_stat[last].dev_id == disk->dev->id
+      && grub_disk_io_stat[last].disk_id == disk->id)
+    return grub_disk_io_stat + last;
+
+  for (i = 0; i < grub_disk_io_stat_num; i++)
+    if (grub_disk_io_stat[i].dev_id == disk->dev->id
+	&& grub_disk_io_stat[i].disk_id == disk->id)
+      {
+	last = i;
+	return grub_disk_io_stat + i;
+      }
+
+  if (grub_disk_io_stat_num >= GRUB_DISK_IO_STAT_MAX)
+    return NULL;
+
+  last = grub_disk_io_stat_num++;
+  grub_disk_io_stat[last].dev_id = disk->dev->id;
+  grub_disk_io_stat[last].disk_id = disk->id;
+  grub_snprintf (grub_disk_io_stat[last].name,
+		 sizeof (grub_disk_io_stat[last].name), "%s", disk->name);
+  return grub_disk_io_stat + last;
+}
+
+static void
+grub_disk_io_account (grub_disk_t disk, int dev, grub_uint64_t bytes)
+{
+  struct grub_disk_io_stat *stat;
+
+  stat = grub_disk_io_get_stat (disk);
+  if (dev)
+    {
+      grub_disk_io_total.dev_count++;
+      grub_disk_io_total.dev_bytes += bytes;
+      if (stat)
+	{
+	  stat->dev_count++;
+	  stat->dev_bytes += bytes;
+	}
+    }
+  else
+    {
+      grub_disk_io_total.read_count++;
+      grub_disk_io_total.read_bytes += bytes;
+      if (stat)
+	{
+	  stat->read_count++;
+	  stat->read_bytes += bytes;
+	}
+    }
+}
+
 void (*grub_disk_firmware_fini) (void);
 int grub_disk_firmware_is_tainted;
 
@@ -342,6 +404,7 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
       < (disk->total_sectors << (disk->log_sector_size - GRUB_DISK_SECTOR_BITS)))
     {
       grub_err_t err;
+      grub_disk_io_account (disk, 1, GRUB_DISK_SECTOR_SIZE << GRUB_DISK_CACHE_BITS);
       err = (disk->dev->disk_read) (disk, transform_sector (disk, sector),
 				    1U << (GRUB_DISK_CACHE_BITS
 					   + GRUB_DISK_SECTOR_BITS
@@ -378,6 +441,7 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
     if (!tmp_buf)
       return grub_errno;
     
+    grub_disk_io_account (disk, 1, (grub_uint64_t) num << disk->log_sector_size);
     if ((disk->dev->disk_read) (disk, transform_sector (disk, aligned_sector),
 				num, tmp_buf))
       {
@@ -486,6 +550,8 @@ grub_disk_read (grub_disk_t disk, grub_disk_addr_t sector,
       return grub_errno;
     }
 
+  grub_disk_io_account (disk, 0, size);
+
   /* First read until first cache boundary.   */
   if (offset || (sector & (GRUB_DISK_CACHE_SIZE - 1)))
     {
@@ -546,6 +612,8 @@ grub_disk_read (grub_disk_t disk, grub_disk_addr_t sector,
 	{
 	  grub_disk_addr_t i;
 
+	  grub_disk_io_account (disk, 1, agglomerate << (GRUB_DISK_CACHE_BITS
+							 + GRUB_DISK_SECTOR_BITS));
 	  err = (disk->dev->disk_read) (disk, transform_sector (disk, sector),
 					agglomerate << (GRUB_DISK_CACHE_BITS
 							+ GRUB_DISK_SECTOR_BITS
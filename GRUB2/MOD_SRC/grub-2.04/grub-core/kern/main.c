@@ -322,6 +322,18 @@ static int ventoy_legacy_limit_workaround(void)
     pos = grub_strchr(root, ',');
     if (pos) *pos = 0;
 
+    /* multi-block image: decode only the blocks that are read */
+    grub_snprintf(buf, sizeof(buf), "vt_xz_disk ventoydisk (%s,1)/ventoy/ventoy.disk.img.xz", root);
+    grub_parser_execute(buf);
+    grub_errno = GRUB_ERR_NONE;
+
+    if (ventoy_check_file_exist("(ventoydisk)/grub/grub.cfg"))
+    {
+        grub_env_set("prefix", "(ventoydisk)/grub");
+        grub_free(root);
+        return 0;
+    }
+
     grub_snprintf(buf, sizeof(buf), "(%s,1)/ventoy/ventoy.disk.img.xz", root);
     file = grub_file_open(buf, GRUB_FILE_TYPE_NONE);
     if (file)
@@ -29,6 +29,7 @@
 #include <grub/partition.h>
 #include <grub/file.h>
 #include <grub/normal.h>
+#include <grub/env.h>
 #include <grub/extcmd.h>
 #include <grub/datetime.h>
 #include <grub/i18n.h>
@@ -72,6 +73,8 @@ grub_uint8_t g_ventoy_break_level = 0;
 grub_uint8_t g_ventoy_debug_level = 0;
 grub_uint8_t g_ventoy_chain_type = 0;
 
+grub_uint8_t *g_ventoy_cpio_base = NULL;
+grub_uint32_t g_ventoy_cpio_base_size = 0;
 grub_uint8_t *g_ventoy_cpio_buf = NULL;
 grub_uint32_t g_ventoy_cpio_size = 0;
 cpio_newc_header *g_ventoy_initrd_head = NULL;
@@ -87,11 +90,9 @@ int g_wimboot_enable = 0;
 ventoy_img_chunk_list g_wimiso_chunk_list;
 char *g_wimiso_path = NULL;
 
-static char *g_tree_script_buf = NULL;
-static int g_tree_script_pos = 0;
-
-static char *g_list_script_buf = NULL;
-static int g_list_script_pos = 0;
+static img_info **g_ventoy_img_array = NULL;
+static grub_uint64_t g_ventoy_trace_start = 0;
+static int g_list_default_id = -1;
 
 static char *g_part_list_buf = NULL;
 static int g_part_list_pos = 0;
@@ -115,6 +116,62 @@ void ventoy_debug(const char *fmt, ...)
     va_end (args);
 }
 
+void ventoy_arena_init(ventoy_arena *arena, grub_size_t block_size)
+{
+    arena->block_size = block_size;
+    arena->block = NULL;
+}
+
+void * ventoy_arena_zalloc(ventoy_arena *arena, grub_size_t size)
+{
+    grub_size_t blksize;
+    grub_uint8_t *data = NULL;
+    ventoy_arena_block *block = arena->block;
+
+    size = ventoy_align(size, 8);
+
+    if (!block || block->used + size > block->size)
+    {
+        blksize = (arena->block_size > 0) ? arena->block_size : VTOY_ARENA_DEF_BLOCK;
+        if (blksize < size)
+        {
+            blksize = size;
+        }
+
+        block = grub_malloc(VTOY_ARENA_HEAD_SIZE + blksize);
+        if (!block)
+        {
+            return NULL;
+        }
+
+        block->size = blksize;
+        block->used = 0;
+        block->next = arena->block;
+        arena->block = block;
+    }
+
+    data = (grub_uint8_t *)block + VTOY_ARENA_HEAD_SIZE + block->used;
+    block->used += size;
+    grub_memset(data, 0, size);
+
+    return data;
+}
+
+void ventoy_arena_free(ventoy_arena *arena)
+{
+    ventoy_arena_block *next = NULL;
+    ventoy_arena_block *block = arena->block;
+
+    while (block)
+    {
+        next = block->next;
+        grub_free(block);
+        block = next;
+    }
+
+    arena->block = NULL;
+}
+
 int ventoy_is_efi_os(void)
 {
     if (g_efi_os > 1)
@@ -680,6 +737,51 @@ static grub_err_t ventoy_cmd_iso9660_nojoliet(grub_extcmd_context_t ctxt, int ar
     return 0;
 }
 
+static grub_err_t ventoy_cmd_iso9660_cache(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    grub_iso9660_cache_stat stat;
+
+    (void)ctxt;
+
+    if (argc == 1)
+    {
+        if (grub_strcmp(args[0], "on") == 0)
+        {
+            grub_iso9660_set_cache(1, 0);
+        }
+        else if (grub_strcmp(args[0], "off") == 0)
+        {
+            grub_iso9660_set_cache(0, 0);
+        }
+        else if (grub_strcmp(args[0], "flush") == 0)
+        {
+            grub_iso9660_flush_cache();
+        }
+        else if (grub_strcmp(args[0], "clear") == 0)
+        {
+            grub_iso9660_set_cache(1, 1);
+        }
+        else
+        {
+            return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s [on|off|flush|clear]", cmd_raw_name);
+        }
+
+        VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+    }
+
+    grub_iso9660_get_cache_stat(&stat);
+
+    grub_printf("iso9660 dirent cache: %s  entry: %d\n", stat.enable ? "on" : "off", stat.entry);
+    grub_printf("lookup:%u hit:%u negative_hit:%u miss:%u evict:%u flush:%u\n",
+                stat.lookup, stat.hit, stat.negative_hit, stat.miss, stat.evict, stat.flush);
+    if (stat.lookup > 0)
+    {
+        grub_printf("hit rate: %u%%\n", (stat.hit + stat.negative_hit) * 100 / stat.lookup);
+    }
+
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+}
+
 static grub_err_t ventoy_cmd_is_udf(grub_extcmd_context_t ctxt, int argc, char **args)
 {
     int i;
@@ -1249,88 +1351,312 @@ static img_iterator_node * ventoy_get_min_child(img_iterator_node *node)
     return Minchild;
 }
 
-static int ventoy_dynamic_tree_menu(img_iterator_node *node)
+static int ventoy_build_tree_menu(img_iterator_node *node)
 {
-    int offset = 1;
+    int num = 0;
     img_info *img = NULL;
-    const char *dir_class = NULL;
-    const char *dir_alias = NULL;
     img_iterator_node *child = NULL;
+    img_iterator_node **last = NULL;
 
     if (node->isocnt == 0 || node->done == 1)
     {
         return 0;
     }
 
+    if (node != &g_img_iterator_head)
+    {
+        node->dir[node->dirlen - 1] = 0;
+    }
+
+    /* record the menu order once, the menu entries are built from it on demand */
+    last = &node->menu_child;
+    while ((child = ventoy_get_min_child(node)) != NULL)
+    {
+        ventoy_build_tree_menu(child);
+        if (child->isocnt > 0)
+        {
+            *last = child;
+            last = &child->menu_next;
+        }
+    }
+
+    img = (img_info *)(node->firstiso);
+    while (img && (img_iterator_node *)(img->parent) == node)
+    {
+        num++;
+        img = img->next;
+    }
+
+    if (num > 0)
+    {
+        node->menu_isoid = grub_malloc(num * sizeof(int));
+    }
+
+    while (node->menu_isoid && node->menu_isonum < num && (img = ventoy_get_min_iso(node)) != NULL)
+    {
+        node->menu_isoid[node->menu_isonum++] = img->id;
+    }
+
+    node->done = 1;
+    return 0;    
+}
+
+static const char * ventoy_menu_dir_title(img_iterator_node *node, char *title, int len)
+{
+    int offset = 1;
+    const char *dir_class = NULL;
+    const char *dir_alias = NULL;
+
     if (node->parent && node->parent->dirlen < node->dirlen)
     {
         offset = node->parent->dirlen;
     }
 
+    dir_class = ventoy_plugin_get_menu_class(vtoy_class_directory, node->dir);
+    if (!dir_class)
+    {
+        dir_class = "vtoydir";
+    }
+
+    dir_alias = ventoy_plugin_get_menu_alias(vtoy_alias_directory, node->dir);
+    if (dir_alias)
+    {
+        grub_snprintf(title, len, "%-10s %s", "DIR", dir_alias);
+    }
+    else
+    {
+        grub_snprintf(title, len, "%-10s [%s]", "DIR", node->dir + offset);
+    }
+
+    return dir_class;
+}
+
+static void ventoy_menu_img_title(img_info *img, int tree, char *title, int len)
+{
+    if (tree)
+    {
+        grub_snprintf(title, len, "%-10s %s%s", 
+                      grub_get_human_size(img->size, GRUB_HUMAN_SIZE_SHORT), 
+                      img->unsupport ? "[***********] " : "", 
+                      img->alias ? img->alias : img->name);
+    }
+    else
+    {
+        grub_snprintf(title, len, "%s%s", 
+                      img->unsupport ? "[***********] " : "", 
+                      img->alias ? img->alias : img->name);
+    }
+}
+
+static img_info * ventoy_get_img_by_id(int id)
+{
+    if (g_ventoy_img_array && id >= 0 && id < g_ventoy_img_count)
+    {
+        return g_ventoy_img_array[id];
+    }
+    return NULL;
+}
+
+static void ventoy_menu_add_return(const char *title)
+{
+    const char *args[2] = { title, "VTOY_RET" };
+    char *classes[2] = { (char *)"vtoyret", NULL };
+
+    grub_normal_add_menu_entry(2, args, classes, NULL, "", NULL, NULL, 
+                               "    echo 'return ...' \n", 0, NULL, NULL);
+}
+
+static void ventoy_menu_add_img(img_info *img, int tree)
+{
+    char id[32];
+    char title[1024];
+    char source[128];
+    const char *args[1] = { title };
+    char *classes[2] = { (char *)img->class, NULL };
+
+    ventoy_menu_img_title(img, tree, title, sizeof(title));
+    grub_snprintf(id, sizeof(id), "VID_%d", img->id);
+    grub_snprintf(source, sizeof(source), "  %s_%s \n", img->menu_prefix,
+                  img->unsupport ? "unsupport_menuentry" : "common_menuentry");
+
+    grub_normal_add_menu_entry(1, args, classes, id, "", NULL, NULL, source, 0, NULL, NULL);
+}
+
+static void ventoy_menu_add_tree_dir(img_iterator_node *node)
+{
+    int i;
+    char title[1024];
+    char source[64];
+    const char *args[1] = { title };
+    char *classes[2] = { NULL, NULL };
+    img_info *img = NULL;
+    img_iterator_node *child = NULL;
+
     if (node == &g_img_iterator_head)
     {
         if (g_default_menu_mode == 0)
         {
-            vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, 
-                          "menuentry \"%-10s [Return to ListView]\" --class=\"vtoyret\" VTOY_RET {\n  "
-                          "  echo 'return ...' \n"
-                          "}\n", "<--");
+            grub_snprintf(title, sizeof(title), "%-10s [Return to ListView]", "<--");
+            ventoy_menu_add_return(title);
         }
     }
     else
     {
-        node->dir[node->dirlen - 1] = 0;
-        dir_class = ventoy_plugin_get_menu_class(vtoy_class_directory, node->dir);
-        if (!dir_class)
-        {
-            dir_class = "vtoydir";
-        }
+        grub_snprintf(title, sizeof(title), "%-10s [../]", "<--");
+        ventoy_menu_add_return(title);
+    }
+
+    /* the submenu body is expanded only when the user enters the directory */
+    for (child = node->menu_child; child; child = child->menu_next)
+    {
+        classes[0] = (char *)ventoy_menu_dir_title(child, title, sizeof(title));
+        grub_snprintf(source, sizeof(source), "vt_dynamic_menu_dir 0x%llx\n", (ulonglong)(ulong)child);
+        grub_normal_add_menu_entry(1, args, classes, NULL, "", NULL, NULL, source, 1, NULL, NULL);
+    }
 
-        dir_alias = ventoy_plugin_get_menu_alias(vtoy_alias_directory, node->dir);
-        if (dir_alias)
+    for (i = 0; i < node->menu_isonum; i++)
+    {
+        img = ventoy_get_img_by_id(node->menu_isoid[i]);
+        if (img)
         {
-            vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, 
-                          "submenu \"%-10s %s\" --class=\"%s\" {\n", 
-                          "DIR", dir_alias, dir_class);
+            ventoy_menu_add_img(img, 1);
         }
-        else
+    }
+}
+
+static void ventoy_menu_add_list(void)
+{
+    char title[64];
+    img_info *cur = NULL;
+
+    if (g_default_menu_mode == 1)
+    {
+        grub_snprintf(title, sizeof(title), "%s [Return to TreeView]", "<--");
+        ventoy_menu_add_return(title);
+    }
+
+    for (cur = g_ventoy_img_list; cur; cur = cur->next)
+    {
+        ventoy_menu_add_img(cur, 0);
+    }
+
+    if (g_list_default_id >= 0)
+    {
+        grub_snprintf(title, sizeof(title), "VID_%d", g_list_default_id);
+        grub_env_set("default", title);
+    }
+}
+
+static int ventoy_dump_tree_menu(img_iterator_node *node, char *buf, int pos)
+{
+    int i;
+    img_info *img = NULL;
+    const char *dir_class = NULL;
+    img_iterator_node *child = NULL;
+    char title[1024];
+
+    if (node == &g_img_iterator_head)
+    {
+        if (g_default_menu_mode == 0)
         {
-            vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, 
-                          "submenu \"%-10s [%s]\" --class=\"%s\" {\n", 
-                          "DIR", node->dir + offset, dir_class);
+            vtoy_ssprintf(buf, pos, 
+                          "menuentry \"%-10s [Return to ListView]\" --class=\"vtoyret\" VTOY_RET {\n  "
+                          "  echo 'return ...' \n"
+                          "}\n", "<--");
         }
-
-        vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, 
+    }
+    else
+    {
+        dir_class = ventoy_menu_dir_title(node, title, sizeof(title));
+        vtoy_ssprintf(buf, pos, "submenu \"%s\" --class=\"%s\" {\n", title, dir_class);
+        vtoy_ssprintf(buf, pos, 
                       "menuentry \"%-10s [../]\" --class=\"vtoyret\" VTOY_RET {\n  "
                       "  echo 'return ...' \n"
                       "}\n", "<--");
     }
 
-    while ((child = ventoy_get_min_child(node)) != NULL)
+    for (child = node->menu_child; child; child = child->menu_next)
     {
-        ventoy_dynamic_tree_menu(child);
+        pos = ventoy_dump_tree_menu(child, buf, pos);
     }
 
-    while ((img = ventoy_get_min_iso(node)) != NULL)
+    for (i = 0; i < node->menu_isonum; i++)
     {
-        vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, 
-                      "menuentry \"%-10s %s%s\" --class=\"%s\" --id=\"VID_%d\" {\n"
+        img = ventoy_get_img_by_id(node->menu_isoid[i]);
+        if (!img)
+        {
+            continue;
+        }
+
+        ventoy_menu_img_title(img, 1, title, sizeof(title));
+        vtoy_ssprintf(buf, pos, 
+                      "menuentry \"%s\" --class=\"%s\" --id=\"VID_%d\" {\n"
                       "  %s_%s \n" 
                       "}\n", 
-                      grub_get_human_size(img->size, GRUB_HUMAN_SIZE_SHORT), 
-                      img->unsupport ? "[***********] " : "", 
-                      img->alias ? img->alias : img->name, img->class, img->id,
-                      img->menu_prefix,
+                      title, img->class, img->id, img->menu_prefix,
                       img->unsupport ? "unsupport_menuentry" : "common_menuentry");
     }
 
     if (node != &g_img_iterator_head)
     {
-        vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, "%s", "}\n");
+        vtoy_ssprintf(buf, pos, "%s", "}\n");
     }
 
-    node->done = 1;
-    return 0;    
+    return pos;
+}
+
+static int ventoy_dump_list_menu(char *buf, int pos)
+{
+    char title[1024];
+    img_info *cur = NULL;
+
+    if (g_default_menu_mode == 1)
+    {
+        vtoy_ssprintf(buf, pos, 
+                      "menuentry \"%s [Return to TreeView]\" --class=\"vtoyret\" VTOY_RET {\n  "
+                      "  echo 'return ...' \n"
+                      "}\n", "<--");
+    }
+
+    for (cur = g_ventoy_img_list; cur; cur = cur->next)
+    {
+        ventoy_menu_img_title(cur, 0, title, sizeof(title));
+        vtoy_ssprintf(buf, pos,
+                  "menuentry \"%s\" --class=\"%s\" --id=\"VID_%d\" {\n"
+                  "  %s_%s \n" 
+                  "}\n", 
+                  title, cur->class, cur->id, cur->menu_prefix,
+                  cur->unsupport ? "unsupport_menuentry" : "common_menuentry");
+    }
+
+    if (g_list_default_id >= 0)
+    {
+        vtoy_ssprintf(buf, pos, "set default='VID_%d'\n", g_list_default_id);
+    }
+
+    return pos;
+}
+
+static void ventoy_free_img_iterator(void)
+{
+    img_iterator_node *node = NULL;
+    img_iterator_node *tmp = NULL;
+
+    check_free(g_ventoy_img_array, grub_free);
+    g_list_default_id = -1;
+
+    /* the tree menu keeps the nodes until the image list is cleared */
+    check_free(g_img_iterator_head.menu_isoid, grub_free);
+    node = g_img_iterator_head.next;
+    while (node)
+    {
+        tmp = node->next;
+        check_free(node->menu_isoid, grub_free);
+        grub_free(node);
+        node = tmp;
+    }
+
+    grub_memset(&g_img_iterator_head, 0, sizeof(g_img_iterator_head));
 }
 
 static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char **args)
@@ -1340,14 +1666,12 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
     grub_device_t dev = NULL;
     img_info *cur = NULL;
     img_info *tail = NULL;
-    img_info *default_node = NULL;
     const char *strdata = NULL;
     char *device_name = NULL;
     const char *default_image = NULL;
     int img_len = 0;
     char buf[32];
     img_iterator_node *node = NULL;
-    img_iterator_node *tmp = NULL;
     
     (void)ctxt;
 
@@ -1398,7 +1722,7 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
         g_default_menu_mode = 1;
     }
 
-    grub_memset(&g_img_iterator_head, 0, sizeof(g_img_iterator_head));
+    ventoy_free_img_iterator();
 
     grub_snprintf(g_iso_path, sizeof(g_iso_path), "%s", args[0]);
 
@@ -1427,18 +1751,9 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
 
     for (node = &g_img_iterator_head; node; node = node->next)
     {
-        ventoy_dynamic_tree_menu(node);
+        ventoy_build_tree_menu(node);
     }
 
-    /* free node */
-    node = g_img_iterator_head.next;    
-    while (node)
-    {
-        tmp = node->next;
-        grub_free(node);
-        node = tmp;
-    }
-    
     /* sort image list by image name */
     for (cur = g_ventoy_img_list; cur; cur = cur->next)
     {
@@ -1451,12 +1766,20 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
         }
     }
 
-    if (g_default_menu_mode == 1)
+    /* the tree menu refers to the images by id, the sort above moved them around */
+    if (g_ventoy_img_count > 0)
     {
-        vtoy_ssprintf(g_list_script_buf, g_list_script_pos, 
-                      "menuentry \"%s [Return to TreeView]\" --class=\"vtoyret\" VTOY_RET {\n  "
-                      "  echo 'return ...' \n"
-                      "}\n", "<--");
+        g_ventoy_img_array = grub_zalloc(g_ventoy_img_count * sizeof(img_info *));
+        if (g_ventoy_img_array)
+        {
+            for (cur = g_ventoy_img_list; cur; cur = cur->next)
+            {
+                if (cur->id >= 0 && cur->id < g_ventoy_img_count)
+                {
+                    g_ventoy_img_array[cur->id] = cur;
+                }
+            }
+        }
     }
 
     if (g_default_menu_mode == 0)
@@ -1465,36 +1788,17 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
         if (default_image)
         {
             img_len = grub_strlen(default_image);
-        }
-    }
-
-    for (cur = g_ventoy_img_list; cur; cur = cur->next)
-    {
-        vtoy_ssprintf(g_list_script_buf, g_list_script_pos,
-                  "menuentry \"%s%s\" --class=\"%s\" --id=\"VID_%d\" {\n"
-                  "  %s_%s \n" 
-                  "}\n", 
-                  cur->unsupport ? "[***********] " : "", 
-                  cur->alias ? cur->alias : cur->name, cur->class, cur->id,
-                  cur->menu_prefix,
-                  cur->unsupport ? "unsupport_menuentry" : "common_menuentry");
-
-        if (g_default_menu_mode == 0 && default_image && default_node == NULL)
-        {
-            if (img_len == cur->pathlen && grub_strcmp(default_image, cur->path) == 0)
+            for (cur = g_ventoy_img_list; cur; cur = cur->next)
             {
-                default_node = cur;
+                if (img_len == cur->pathlen && grub_strcmp(default_image, cur->path) == 0)
+                {
+                    g_list_default_id = cur->id;
+                    break;
+                }
             }
         }
     }
 
-    if (default_node)
-    {
-        vtoy_ssprintf(g_list_script_buf, g_list_script_pos, "set default='VID_%d'\n", default_node->id);
-    }
-    
-    g_list_script_buf[g_list_script_pos] = 0;
-
     grub_snprintf(buf, sizeof(buf), "%d", g_ventoy_img_count);
     grub_env_set(args[1], buf);
 
@@ -1525,6 +1829,8 @@ static grub_err_t ventoy_cmd_clear_img(grub_extcmd_context_t ctxt, int argc, cha
     
     g_ventoy_img_list = NULL;
     g_ventoy_img_count = 0;
+
+    ventoy_free_img_iterator();
     
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
@@ -2237,17 +2543,36 @@ static grub_err_t ventoy_cmd_dump_menu(grub_extcmd_context_t ctxt, int argc, cha
     (void)argc;
     (void)args;
 
+    int pos = 0;
+    char *buf = NULL;
+
+    /* the menus are built natively, the script text is only generated here for debug */
+    buf = grub_malloc(VTOY_MAX_SCRIPT_BUF);
+    if (!buf)
+    {
+        return 1;
+    }
+
     if (argc == 0)
     {
-        grub_printf("List Mode: CurLen:%d  MaxLen:%u\n", g_list_script_pos, VTOY_MAX_SCRIPT_BUF);
-        grub_printf("%s", g_list_script_buf);
+        pos = ventoy_dump_list_menu(buf, 0);
+        grub_printf("List Mode: CurLen:%d  MaxLen:%u\n", pos, VTOY_MAX_SCRIPT_BUF);
     }
     else
     {
-        grub_printf("Tree Mode: CurLen:%d  MaxLen:%u\n", g_tree_script_pos, VTOY_MAX_SCRIPT_BUF);
-        grub_printf("%s", g_tree_script_buf);        
+        pos = (g_img_iterator_head.done) ? ventoy_dump_tree_menu(&g_img_iterator_head, buf, 0) : 0;
+        grub_printf("Tree Mode: CurLen:%d  MaxLen:%u\n", pos, VTOY_MAX_SCRIPT_BUF);
     }
 
+    if (pos >= VTOY_MAX_SCRIPT_BUF)
+    {
+        pos = VTOY_MAX_SCRIPT_BUF - 1;
+    }
+
+    buf[pos] = 0;
+    grub_printf("%s", buf);
+    grub_free(buf);
+
     return 0;
 }
 
@@ -2332,7 +2657,7 @@ static grub_err_t ventoy_cmd_check_mode(grub_extcmd_context_t ctxt, int argc, ch
 static grub_err_t ventoy_cmd_dynamic_menu(grub_extcmd_context_t ctxt, int argc, char **args)
 {
     static int configfile_mode = 0;
-    char memfile[128] = {0};
+    grub_menu_t menu = NULL;
     
     (void)ctxt;
     (void)argc;
@@ -2340,7 +2665,7 @@ static grub_err_t ventoy_cmd_dynamic_menu(grub_extcmd_context_t ctxt, int argc,
 
     /* 
      * args[0]:  0:normal     1:configfile
-     * args[1]:  0:list_buf   1:tree_buf
+     * args[1]:  0:list_menu  1:tree_menu
      */
 
     if (argc != 2)
@@ -2353,11 +2678,11 @@ static grub_err_t ventoy_cmd_dynamic_menu(grub_extcmd_context_t ctxt, int argc,
     {
         if (args[1][0] == '0')
         {
-            grub_script_execute_sourcecode(g_list_script_buf);            
+            ventoy_menu_add_list();
         }
         else
         {
-            grub_script_execute_sourcecode(g_tree_script_buf); 
+            ventoy_menu_add_tree_dir(&g_img_iterator_head);
         }
     }
     else
@@ -2368,23 +2693,95 @@ static grub_err_t ventoy_cmd_dynamic_menu(grub_extcmd_context_t ctxt, int argc,
             return 0;
         }
 
-        if (args[1][0] == '0')
+        if (args[1][0] == '1')
         {
-            grub_snprintf(memfile, sizeof(memfile), "configfile mem:0x%llx:size:%d", 
-                (ulonglong)(ulong)g_list_script_buf, g_list_script_pos);
+            g_ventoy_last_entry = -1;
         }
-        else
+
+        configfile_mode = 1;
+
+        /* same as configfile, but the entries are added to the new menu directly */
+        grub_cls();
+        grub_env_context_open();
+
+        menu = grub_zalloc(sizeof(*menu));
+        if (menu)
         {
-             g_ventoy_last_entry = -1;
-            grub_snprintf(memfile, sizeof(memfile), "configfile mem:0x%llx:size:%d", 
-                (ulonglong)(ulong)g_tree_script_buf, g_tree_script_pos); 
+            grub_env_set_menu(menu);
+            
+            if (args[1][0] == '0')
+            {
+                ventoy_menu_add_list();
+            }
+            else
+            {
+                ventoy_menu_add_tree_dir(&g_img_iterator_head);
+            }
+
+            if (menu->size)
+            {
+                grub_show_menu(menu, 1, 0);
+            }
+            grub_normal_free_menu(menu);
         }
 
-        configfile_mode = 1;
-        grub_script_execute_sourcecode(memfile);
+        grub_env_context_close();
         configfile_mode = 0;
     }
-    
+
+    grub_errno = GRUB_ERR_NONE;
+    return 0;
+}
+
+static grub_err_t ventoy_cmd_dynamic_menu_dir(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    img_iterator_node *node = NULL;
+    img_iterator_node *target = NULL;
+
+    (void)ctxt;
+
+    if (argc != 1)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s {node}", cmd_raw_name);
+    }
+
+    target = (img_iterator_node *)(ulong)grub_strtoull(args[0], NULL, 16);
+    for (node = &g_img_iterator_head; node; node = node->next)
+    {
+        if (node == target)
+        {
+            break;
+        }
+    }
+
+    if (!node)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "No such directory");
+    }
+
+    ventoy_menu_add_tree_dir(node);
+
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+}
+
+static grub_err_t ventoy_cmd_dump_trace(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    char *buf = NULL;
+
+    (void)ctxt;
+    (void)argc;
+    (void)args;
+
+    buf = grub_malloc(VTOY_TRACE_BUF_SIZE * 2);
+    if (!buf)
+    {
+        return 1;
+    }
+
+    ventoy_trace_dump(buf, VTOY_TRACE_BUF_SIZE * 2);
+    grub_printf("%s", buf);
+    grub_free(buf);
+
     return 0;
 }
 
@@ -3086,11 +3483,11 @@ static int ventoy_env_init(void)
 {
     char buf[64];
 
+    g_ventoy_trace_start = grub_get_time_ms();
+
     grub_env_set("vtdebug_flag", "");
 
     g_part_list_buf = grub_malloc(VTOY_PART_BUF_LEN);
-    g_tree_script_buf = grub_malloc(VTOY_MAX_SCRIPT_BUF);
-    g_list_script_buf = grub_malloc(VTOY_MAX_SCRIPT_BUF);
 
     ventoy_filt_register(0, ventoy_wrapper_open);
 
@@ -3142,6 +3539,9 @@ static cmd_para ventoy_cmds[] =
     { "vt_find_first_bootable_hd", ventoy_cmd_find_bootable_hdd, 0, NULL, "", "", NULL },
     { "vt_dump_menu", ventoy_cmd_dump_menu, 0, NULL, "", "", NULL },
     { "vt_dynamic_menu", ventoy_cmd_dynamic_menu, 0, NULL, "", "", NULL },
+    { "vt_dynamic_menu_dir", ventoy_cmd_dynamic_menu_dir, 0, NULL, "{node}", "", NULL },
+    { "vt_xz_disk", ventoy_cmd_xz_disk, 0, NULL, "{name} {xzfile}", "", NULL },
+    { "vt_dump_trace", ventoy_cmd_dump_trace, 0, NULL, "", "dump boot trace", NULL },
     { "vt_check_mode", ventoy_cmd_check_mode, 0, NULL, "", "", NULL },
     { "vt_dump_img_list", ventoy_cmd_dump_img_list, 0, NULL, "", "", NULL },
     { "vt_dump_injection", ventoy_cmd_dump_injection, 0, NULL, "", "", NULL },
@@ -3151,6 +3551,7 @@ static cmd_para ventoy_cmds[] =
     { "vt_select_persistence", ventoy_cmd_sel_persistence, 0, NULL, "", "", NULL },
 
     { "vt_iso9660_nojoliet", ventoy_cmd_iso9660_nojoliet, 0, NULL, "", "", NULL },
+    { "vt_iso9660_cache", ventoy_cmd_iso9660_cache, 0, NULL, "[on|off|flush|clear]", "", NULL },
     { "vt_is_udf", ventoy_cmd_is_udf, 0, NULL, "", "", NULL },
     { "vt_file_size", ventoy_cmd_file_size, 0, NULL, "", "", NULL },
     { "vt_load_file_to_mem", ventoy_cmd_load_file_to_mem, 0, NULL, "", "", NULL },
@@ -3160,6 +3561,7 @@ static cmd_para ventoy_cmds[] =
     { "vt_linux_parse_initrd_isolinux", ventoy_cmd_isolinux_initrd_collect, 0, NULL, "{cfgfile}", "", NULL },
     { "vt_linux_parse_initrd_grub", ventoy_cmd_grub_initrd_collect, 0, NULL, "{cfgfile}", "", NULL },
     { "vt_linux_specify_initrd_file", ventoy_cmd_specify_initrd_file, 0, NULL, "", "", NULL },
+    { "vt_linux_probe_initrd", ventoy_cmd_linux_probe_initrd, 0, NULL, "(loop) {phase}", "", NULL },
     { "vt_linux_clear_initrd", ventoy_cmd_clear_initrd_list, 0, NULL, "", "", NULL },
     { "vt_linux_dump_initrd", ventoy_cmd_dump_initrd_list, 0, NULL, "", "", NULL },
     { "vt_linux_initrd_count", ventoy_cmd_initrd_count, 0, NULL, "", "", NULL },
@@ -3179,6 +3581,7 @@ static cmd_para ventoy_cmds[] =
     { "vt_add_replace_file", ventoy_cmd_add_replace_file, 0, NULL, "", "", NULL },
     { "vt_relocator_chaindata", ventoy_cmd_relocator_chaindata, 0, NULL, "", "", NULL },
     { "vt_test_block_list", ventoy_cmd_test_block_list, 0, NULL, "", "", NULL },
+    { "vt_img_hash", ventoy_cmd_img_hash, 0, NULL, "{file} [md5] [sha1] [sha256] [sha512]", "hash image file", NULL },
     { "vt_file_exist_nocase", ventoy_cmd_file_exist_nocase, 0, NULL, "", "", NULL },
 
     
@@ -3206,6 +3609,86 @@ static cmd_para ventoy_cmds[] =
 
 
 
+/* 
+ * Every vt_xxx command goes through here, so the time and disk reads of each
+ * boot phase (list_img, load_plugin, img_sector, load_cpio, chain_data ...)
+ * are known without touching the commands themselves.
+ */
+static grub_err_t ventoy_cmd_trace_wrapper(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    grub_err_t ret;
+    grub_uint64_t start;
+    struct grub_disk_io_stat io;
+    cmd_para *para = (cmd_para *)(ctxt->extcmd->data);
+
+    grub_memcpy(&io, &grub_disk_io_total, sizeof(io));
+    start = grub_get_time_ms();
+
+    ret = para->func(ctxt, argc, args);
+
+    para->trace_call++;
+    para->trace_ms += grub_get_time_ms() - start;
+    para->trace_read += grub_disk_io_total.read_count - io.read_count;
+    para->trace_read_bytes += grub_disk_io_total.read_bytes - io.read_bytes;
+    para->trace_dev += grub_disk_io_total.dev_count - io.dev_count;
+    para->trace_dev_bytes += grub_disk_io_total.dev_bytes - io.dev_bytes;
+
+    return ret;
+}
+
+#define vtoy_trace_printf(buf, len, pos, fmt, ...) \
+    if (pos < len) pos += grub_snprintf(buf + pos, len - pos, fmt, __VA_ARGS__)
+
+int ventoy_trace_dump(char *buf, int len)
+{
+    int i;
+    int pos = 0;
+    cmd_para *cur = NULL;
+    struct grub_disk_io_stat *stat = NULL;
+
+    vtoy_trace_printf(buf, len, pos, "Ventoy boot trace, %llu ms since ventoy module init\n\n",
+                      (ulonglong)(grub_get_time_ms() - g_ventoy_trace_start));
+
+    vtoy_trace_printf(buf, len, pos, "%-24s %6s %10s %8s %10s %8s %10s\n",
+                      "command", "call", "time(ms)", "read", "read(KB)", "devreq", "dev(KB)");
+
+    for (i = 0; i < (int)ARRAY_SIZE(ventoy_cmds); i++)
+    {
+        cur = ventoy_cmds + i;
+        if (cur->trace_call == 0)
+        {
+            continue;
+        }
+
+        vtoy_trace_printf(buf, len, pos, "%-24s %6u %10llu %8llu %10llu %8llu %10llu\n", cur->name, cur->trace_call, 
+                          (ulonglong)cur->trace_ms, (ulonglong)cur->trace_read, (ulonglong)(cur->trace_read_bytes >> 10),
+                          (ulonglong)cur->trace_dev, (ulonglong)(cur->trace_dev_bytes >> 10));
+    }
+
+    vtoy_trace_printf(buf, len, pos, "\n%-24s %8s %10s %8s %10s\n", "disk", "read", "read(KB)", "devreq", "dev(KB)");
+
+    for (i = 0; i < grub_disk_io_stat_num; i++)
+    {
+        stat = grub_disk_io_stat + i;
+        vtoy_trace_printf(buf, len, pos, "%-24s %8llu %10llu %8llu %10llu\n", stat->name, 
+                          (ulonglong)stat->read_count, (ulonglong)(stat->read_bytes >> 10),
+                          (ulonglong)stat->dev_count, (ulonglong)(stat->dev_bytes >> 10));
+    }
+
+    stat = &grub_disk_io_total;
+    vtoy_trace_printf(buf, len, pos, "%-24s %8llu %10llu %8llu %10llu\n", "total", 
+                      (ulonglong)stat->read_count, (ulonglong)(stat->read_bytes >> 10),
+                      (ulonglong)stat->dev_count, (ulonglong)(stat->dev_bytes >> 10));
+
+    if (pos >= len)
+    {
+        pos = len - 1;
+    }
+    buf[pos] = 0;
+
+    return pos;
+}
+
 GRUB_MOD_INIT(ventoy)
 {
     grub_uint32_t i;
@@ -3216,8 +3699,12 @@ GRUB_MOD_INIT(ventoy)
     for (i = 0; i < ARRAY_SIZE(ventoy_cmds); i++)
     {
         cur = ventoy_cmds + i;
-        cur->cmd = grub_register_extcmd(cur->name, cur->func, cur->flags, 
+        cur->cmd = grub_register_extcmd(cur->name, ventoy_cmd_trace_wrapper, cur->flags, 
                                         cur->summary, cur->description, cur->parser);
+        if (cur->cmd)
+        {
+            cur->cmd->data = cur;
+        }
     }
 }
 
@@ -3229,5 +3716,6 @@ GRUB_MOD_FINI(ventoy)
     {
         grub_unregister_extcmd(ventoy_cmds[i].cmd);
     }
-}
 
+    ventoy_xzdisk_fini();
+}
@@ -65,8 +65,18 @@ typedef struct cmd_para
     const char *description;
 
     grub_extcmd_t cmd;
+
+    /* boot trace, time and disk io spent in this command (nested calls included) */
+    grub_uint32_t trace_call;
+    grub_uint64_t trace_ms;
+    grub_uint64_t trace_read;
+    grub_uint64_t trace_read_bytes;
+    grub_uint64_t trace_dev;
+    grub_uint64_t trace_dev_bytes;
 }cmd_para;
 
+#define VTOY_TRACE_BUF_SIZE   8192
+
 #define ventoy_align_2k(value)  ((value + 2047) / 2048 * 2048)
 #define ventoy_align(value, align)  (((value) + ((align) - 1)) & (~((align) - 1)))
 
@@ -98,6 +108,31 @@ typedef struct cpio_newc_header
 typedef int (*grub_char_check_func)(int c);
 #define ventoy_is_decimal(str)  ventoy_string_check(str, grub_isdigit)
 
+/*
+ * Simple bump allocator. Memory is taken from big blocks and is only
+ * released all together by ventoy_arena_free, so a lot of small objects
+ * with the same lifetime don't fragment the grub heap.
+ */
+#define VTOY_ARENA_DEF_BLOCK    (16 * 1024)
+#define VTOY_ARENA_HEAD_SIZE    ventoy_align(sizeof(ventoy_arena_block), 16)
+
+typedef struct ventoy_arena_block
+{
+    struct ventoy_arena_block *next;
+    grub_size_t size;
+    grub_size_t used;
+}ventoy_arena_block;
+
+typedef struct ventoy_arena
+{
+    grub_size_t block_size;
+    ventoy_arena_block *block;
+}ventoy_arena;
+
+void ventoy_arena_init(ventoy_arena *arena, grub_size_t block_size);
+void * ventoy_arena_zalloc(ventoy_arena *arena, grub_size_t size);
+void ventoy_arena_free(ventoy_arena *arena);
+
 
 // El Torito Boot Record Volume Descriptor
 #pragma pack(1)
@@ -178,6 +213,12 @@ typedef struct img_iterator_node
     struct img_iterator_node *firstchild;
     
     void *firstiso;    
+
+    /* menu order, recorded once at list time */
+    struct img_iterator_node *menu_child;
+    struct img_iterator_node *menu_next;
+    int menu_isonum;
+    int *menu_isoid;
 }img_iterator_node;
 
 
@@ -200,6 +241,42 @@ typedef struct initrd_info
     struct initrd_info *prev;
 }initrd_info;
 
+#define VTOY_PROBE_ANY   0  /* [ -e ] */
+#define VTOY_PROBE_FILE  1  /* [ -f ] */
+#define VTOY_PROBE_DIR   2  /* [ -d ] */
+
+#define VTOY_PROBE_INITRD_NUM  3
+#define VTOY_MAX_PROBE_NODE    128
+
+typedef struct initrd_probe_rule
+{
+    int chain;          /* 1: part of an elif chain  0: always checked */
+    int type;           /* VTOY_PROBE_XXX for cond */
+    const char *cond;   /* rule matches when this path exists */
+    const char *initrd[VTOY_PROBE_INITRD_NUM]; /* added if exist */
+    const char *replace; /* UEFI file replace name, optional */
+}initrd_probe_rule;
+
+typedef struct initrd_probe_node
+{
+    char path[256];
+    const char *name;
+    int parent;
+    int haschild;
+    int exist;
+    int isdir;
+}initrd_probe_node;
+
+typedef struct initrd_probe_ctx
+{
+    grub_device_t dev;
+    grub_fs_t fs;
+    int curdir;
+    int dircnt;
+    int nodenum;
+    initrd_probe_node nodes[VTOY_MAX_PROBE_NODE];
+}initrd_probe_ctx;
+
 extern initrd_info *g_initrd_img_list;
 extern initrd_info *g_initrd_img_tail;
 extern int g_initrd_img_count;
@@ -208,6 +285,13 @@ extern int g_valid_initrd_count;
 extern img_info *g_ventoy_img_list;
 extern int g_ventoy_img_count;
 
+/*
+ * The cpio passed to the Linux initrd is g_ventoy_cpio_base (ventoy.cpio up to its
+ * TRAILER!!!, loaded once per grub session) followed by g_ventoy_cpio_buf (the per
+ * image members). g_ventoy_cpio_size is the total size of both parts.
+ */
+extern grub_uint8_t *g_ventoy_cpio_base;
+extern grub_uint32_t g_ventoy_cpio_base_size;
 extern grub_uint8_t *g_ventoy_cpio_buf;
 extern grub_uint32_t g_ventoy_cpio_size;
 extern cpio_newc_header *g_ventoy_initrd_head;
@@ -435,9 +519,12 @@ typedef struct _JSON_PARSE
     grub_uint32_t  uiBufSize;
 }JSON_PARSE;
 
+/* the root node created by vtoy_json_create is followed by the arena of all the other nodes */
+#define JSON_ROOT_ARENA(pstJson) ((ventoy_arena *)((pstJson) + 1))
+
 #define JSON_NEW_ITEM(pstJson, ret) \
 { \
-    (pstJson) = (VTOY_JSON *)grub_zalloc(sizeof(VTOY_JSON)); \
+    (pstJson) = (VTOY_JSON *)ventoy_arena_zalloc(g_json_arena, sizeof(VTOY_JSON)); \
     if (NULL == (pstJson)) \
     { \
         json_debug("Failed to alloc memory for json.\n"); \
@@ -460,6 +547,11 @@ void ventoy_fill_os_param(grub_file_t file, ventoy_os_param *param);
 grub_err_t ventoy_cmd_isolinux_initrd_collect(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_grub_initrd_collect(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_specify_initrd_file(grub_extcmd_context_t ctxt, int argc, char **args);
+grub_err_t ventoy_cmd_linux_probe_initrd(grub_extcmd_context_t ctxt, int argc, char **args);
+grub_err_t ventoy_cmd_xz_disk(grub_extcmd_context_t ctxt, int argc, char **args);
+int ventoy_trace_dump(char *buf, int len);
+void ventoy_xzdisk_fini(void);
+grub_err_t ventoy_cmd_img_hash(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_dump_initrd_list(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_clear_initrd_list(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_uint32_t ventoy_get_iso_boot_catlog(grub_file_t file);
@@ -672,6 +764,13 @@ typedef struct injection_config
     struct injection_config *next;
 }injection_config;
 
+typedef struct initrd_probe_config
+{
+    char initrd[256];
+
+    struct initrd_probe_config *next;
+}initrd_probe_config;
+
 extern int g_ventoy_menu_esc;
 extern int g_ventoy_suppress_esc;
 extern int g_ventoy_last_entry;
@@ -711,6 +810,7 @@ int ventoy_plugin_get_persistent_chunklist(const char *isopath, int index, vento
 const char * ventoy_plugin_get_injection(const char *isopath);
 const char * ventoy_plugin_get_menu_alias(int type, const char *isopath);
 const char * ventoy_plugin_get_menu_class(int type, const char *name);
+initrd_probe_config * ventoy_plugin_get_initrd_probe(void);
 int ventoy_get_block_list(grub_file_t file, ventoy_img_chunk_list *chunklist, grub_disk_addr_t start);
 int ventoy_check_block_list(grub_file_t file, ventoy_img_chunk_list *chunklist, grub_disk_addr_t start);
 void ventoy_plugin_dump_persistence(void);
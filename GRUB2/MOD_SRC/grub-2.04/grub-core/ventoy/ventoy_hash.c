@@ -0,0 +1,417 @@
+/******************************************************************************
+ * ventoy_hash.c
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/disk.h>
+#include <grub/device.h>
+#include <grub/term.h>
+#include <grub/partition.h>
+#include <grub/file.h>
+#include <grub/normal.h>
+#include <grub/env.h>
+#include <grub/extcmd.h>
+#include <grub/time.h>
+#include <grub/crypto.h>
+#include <grub/i18n.h>
+#include <grub/ventoy.h>
+#include "ventoy_def.h"
+
+/*
+ * vt_img_hash computes the checksums of an image file in one pass.
+ * The file is read with large disk reads following its chunk list, instead of the small
+ * reads of the filesystem driver that hashsum does, and every buffer is fed to all the
+ * requested digests. The results are kept for this boot, so a second check is instant.
+ */
+
+#define VTOY_HASH_NUM        4
+#define VTOY_HASH_MAX_LEN    64
+#define VTOY_HASH_BUF_SIZE   (4 * 1024 * 1024)
+#define VTOY_HASH_CACHE_NUM  16
+
+typedef struct ventoy_hash_cache
+{
+    char disk[64];
+    grub_uint64_t part_start;
+    grub_uint64_t size;
+    grub_uint64_t first_sector;
+    grub_uint32_t mask;   /* digests in hex[] */
+    char hex[VTOY_HASH_NUM][VTOY_HASH_MAX_LEN * 2 + 1];
+}ventoy_hash_cache;
+
+typedef struct ventoy_hash_ctx
+{
+    grub_uint32_t mask;
+    const gcry_md_spec_t *md[VTOY_HASH_NUM];
+    void *ctx[VTOY_HASH_NUM];
+
+    grub_uint64_t total;
+    grub_uint64_t done;
+    grub_uint64_t start_ms;
+    grub_uint64_t last_ms;
+}ventoy_hash_ctx;
+
+static const char *g_hash_name[VTOY_HASH_NUM] = { "md5", "sha1", "sha256", "sha512" };
+
+static grub_uint32_t g_hash_cache_next = 0;
+static ventoy_hash_cache g_hash_cache[VTOY_HASH_CACHE_NUM];
+
+static ventoy_hash_cache * ventoy_hash_find_cache(grub_file_t file, grub_uint64_t first_sector)
+{
+    int i;
+    ventoy_hash_cache *node = NULL;
+
+    for (i = 0; i < VTOY_HASH_CACHE_NUM; i++)
+    {
+        node = g_hash_cache + i;
+        if (node->mask && node->size == file->size && node->first_sector == first_sector &&
+            node->part_start == file->device->disk->partition->start &&
+            grub_strcmp(node->disk, file->device->disk->name) == 0)
+        {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+static void ventoy_hash_progress(ventoy_hash_ctx *hash, int force)
+{
+    grub_uint64_t now;
+    grub_uint64_t speed;
+
+    now = grub_get_time_ms();
+    if (!force && now - hash->last_ms < 500)
+    {
+        return;
+    }
+    hash->last_ms = now;
+
+    speed = (now > hash->start_ms) ? (hash->done / (now - hash->start_ms) * 1000) >> 20 : 0;
+
+    grub_printf("\r%3d%%  %lluMB/%lluMB  %lluMB/s   ",
+                (int)(hash->total ? hash->done * 100 / hash->total : 100),
+                (ulonglong)(hash->done >> 20), (ulonglong)(hash->total >> 20), (ulonglong)speed);
+    grub_refresh();
+}
+
+/* feed the data to all the digests, return 1 (with the error set) if the user pressed ESC */
+static int ventoy_hash_update(ventoy_hash_ctx *hash, const void *buf, grub_size_t len)
+{
+    int i;
+
+    for (i = 0; i < VTOY_HASH_NUM; i++)
+    {
+        if (hash->mask & (1U << i))
+        {
+            hash->md[i]->write(hash->ctx[i], buf, len);
+        }
+    }
+
+    hash->done += len;
+    ventoy_hash_progress(hash, 0);
+
+    if (grub_getkey_noblock() == GRUB_TERM_ESC)
+    {
+        grub_error(GRUB_ERR_TEST_FAILURE, "Hash canceled by user");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int ventoy_hash_by_chunk(grub_file_t file, ventoy_img_chunk_list *chunklist,
+    ventoy_hash_ctx *hash, char *buf)
+{
+    grub_uint32_t i;
+    grub_uint32_t len;
+    grub_uint64_t sector;
+    grub_uint64_t remain;
+    grub_uint64_t chunksize;
+    ventoy_img_chunk *chunk = NULL;
+
+    remain = file->size;
+
+    for (i = 0; i < chunklist->cur_chunk && remain > 0; i++)
+    {
+        chunk = chunklist->chunk + i;
+        sector = chunk->disk_start_sector;
+        chunksize = (chunk->disk_end_sector + 1 - chunk->disk_start_sector) * 512;
+        if (chunksize > remain)
+        {
+            chunksize = remain;
+        }
+
+        while (chunksize > 0)
+        {
+            len = (chunksize > VTOY_HASH_BUF_SIZE) ? VTOY_HASH_BUF_SIZE : (grub_uint32_t)chunksize;
+            if (grub_disk_read(file->device->disk, sector, 0, len, buf))
+            {
+                grub_error(GRUB_ERR_READ_ERROR, "Failed to read disk sector %llu len %u", (ulonglong)sector, len);
+                return 1;
+            }
+
+            if (ventoy_hash_update(hash, buf, len))
+            {
+                return 1;
+            }
+
+            sector += len >> 9;
+            chunksize -= len;
+            remain -= len;
+        }
+    }
+
+    if (remain)
+    {
+        grub_error(GRUB_ERR_READ_ERROR, "Block list ends %llu bytes before the file", (ulonglong)remain);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int ventoy_hash_by_file(grub_file_t file, ventoy_hash_ctx *hash, char *buf)
+{
+    grub_ssize_t len;
+
+    grub_file_seek(file, 0);
+
+    while (hash->done < file->size)
+    {
+        len = grub_file_read(file, buf, VTOY_HASH_BUF_SIZE);
+        if (len <= 0)
+        {
+            grub_error(GRUB_ERR_FILE_READ_ERROR, "Failed to read file at %llu", (ulonglong)hash->done);
+            return 1;
+        }
+
+        if (ventoy_hash_update(hash, buf, len))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* vt_img_hash {file} [md5] [sha1] [sha256] [sha512], sha256 if no digest is given */
+grub_err_t ventoy_cmd_img_hash(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    int i;
+    int j;
+    int rc = 1;
+    int bychunk = 0;
+    grub_uint32_t mask = 0;
+    grub_uint64_t first_sector = 0;
+    grub_uint8_t *digest = NULL;
+    char *buf = NULL;
+    char name[32];
+    grub_file_t file = NULL;
+    ventoy_hash_ctx hash;
+    ventoy_hash_cache result;
+    ventoy_hash_cache *cache = NULL;
+    ventoy_img_chunk_list chunklist;
+
+    if (argc < 1)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s {file} [md5] [sha1] [sha256] [sha512]\n", cmd_raw_name);
+    }
+
+    for (i = 1; i < argc; i++)
+    {
+        for (j = 0; j < VTOY_HASH_NUM; j++)
+        {
+            if (grub_strcmp(args[i], g_hash_name[j]) == 0)
+            {
+                mask |= (1U << j);
+                break;
+            }
+        }
+
+        if (j >= VTOY_HASH_NUM)
+        {
+            return grub_error(GRUB_ERR_BAD_ARGUMENT, "Unknown hash %s\n", args[i]);
+        }
+    }
+
+    if (mask == 0)
+    {
+        mask = (1U << 2);
+    }
+
+    grub_memset(&hash, 0, sizeof(hash));
+    grub_memset(&chunklist, 0, sizeof(chunklist));
+
+    file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s", args[0]);
+    if (!file)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Can't open file %s\n", args[0]);
+    }
+
+    if (file->device->disk && file->device->disk->partition)
+    {
+        chunklist.chunk = grub_malloc(sizeof(ventoy_img_chunk) * DEFAULT_CHUNK_NUM);
+        if (chunklist.chunk)
+        {
+            chunklist.max_chunk = DEFAULT_CHUNK_NUM;
+            ventoy_get_block_list(file, &chunklist, 0);
+            file->read_hook = NULL;
+            file->read_hook_data = NULL;
+            if (chunklist.cur_chunk > 0 && ventoy_check_block_list(file, &chunklist, 0) == 0)
+            {
+                bychunk = 1;
+                first_sector = chunklist.chunk[0].disk_start_sector;
+            }
+        }
+    }
+
+    if (bychunk)
+    {
+        cache = ventoy_hash_find_cache(file, first_sector);
+        if (cache && (cache->mask & mask) == mask)
+        {
+            debug("hash cache hit %s\n", args[0]);
+            goto print;
+        }
+    }
+
+    hash.mask = mask;
+    hash.total = file->size;
+
+    for (i = 0; i < VTOY_HASH_NUM; i++)
+    {
+        if ((mask & (1U << i)) == 0)
+        {
+            continue;
+        }
+
+        hash.md[i] = grub_crypto_lookup_md_by_name(g_hash_name[i]);
+        if (!hash.md[i])
+        {
+            grub_error(GRUB_ERR_NOT_IMPLEMENTED_YET, "Hash %s not supported\n", g_hash_name[i]);
+            goto end;
+        }
+
+        hash.ctx[i] = grub_zalloc(hash.md[i]->contextsize);
+        if (!hash.ctx[i])
+        {
+            grub_error(GRUB_ERR_OUT_OF_MEMORY, "Can't allocate hash context\n");
+            goto end;
+        }
+        hash.md[i]->init(hash.ctx[i]);
+    }
+
+    buf = grub_malloc(VTOY_HASH_BUF_SIZE);
+    if (!buf)
+    {
+        grub_error(GRUB_ERR_OUT_OF_MEMORY, "Can't allocate hash buffer\n");
+        goto end;
+    }
+
+    hash.start_ms = grub_get_time_ms();
+
+    if (bychunk)
+    {
+        rc = ventoy_hash_by_chunk(file, &chunklist, &hash, buf);
+    }
+    else
+    {
+        rc = ventoy_hash_by_file(file, &hash, buf);
+    }
+
+    ventoy_hash_progress(&hash, 1);
+    grub_printf("\n");
+
+    if (rc)
+    {
+        grub_printf("Hash not finished, %llu of %llu bytes\n", (ulonglong)hash.done, (ulonglong)hash.total);
+        goto end;
+    }
+
+    debug("hash %llu bytes in %llu ms bychunk:%d\n", (ulonglong)hash.done,
+          (ulonglong)(grub_get_time_ms() - hash.start_ms), bychunk);
+
+    if (!bychunk)
+    {
+        /* only a file with a chunk list has an identity to be found again */
+        cache = &result;
+        grub_memset(cache, 0, sizeof(ventoy_hash_cache));
+    }
+    else if (!cache)
+    {
+        cache = g_hash_cache + g_hash_cache_next;
+        g_hash_cache_next = (g_hash_cache_next + 1) % VTOY_HASH_CACHE_NUM;
+
+        grub_memset(cache, 0, sizeof(ventoy_hash_cache));
+        grub_snprintf(cache->disk, sizeof(cache->disk), "%s", file->device->disk->name);
+        cache->part_start = file->device->disk->partition->start;
+        cache->size = file->size;
+        cache->first_sector = first_sector;
+    }
+
+    for (i = 0; i < VTOY_HASH_NUM; i++)
+    {
+        if ((mask & (1U << i)) == 0)
+        {
+            continue;
+        }
+
+        hash.md[i]->final(hash.ctx[i]);
+        digest = hash.md[i]->read(hash.ctx[i]);
+        for (j = 0; j < (int)hash.md[i]->mdlen && j < VTOY_HASH_MAX_LEN; j++)
+        {
+            grub_snprintf(cache->hex[i] + j * 2, 3, "%02x", digest[j]);
+        }
+        cache->mask |= (1U << i);
+    }
+
+print:
+    for (i = 0; i < VTOY_HASH_NUM; i++)
+    {
+        if (mask & (1U << i))
+        {
+            grub_printf("%-6s : %s\n", g_hash_name[i], cache->hex[i]);
+            grub_snprintf(name, sizeof(name), "vt_hash_%s", g_hash_name[i]);
+            grub_env_set(name, cache->hex[i]);
+        }
+    }
+
+    rc = 0;
+
+end:
+    for (i = 0; i < VTOY_HASH_NUM; i++)
+    {
+        grub_check_free(hash.ctx[i]);
+    }
+    grub_check_free(buf);
+    grub_check_free(chunklist.chunk);
+    grub_file_close(file);
+
+    if (rc)
+    {
+        return grub_errno;
+    }
+
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+}
+
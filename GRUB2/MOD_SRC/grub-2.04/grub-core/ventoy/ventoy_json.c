@@ -38,6 +38,9 @@
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
+/* the arena JSON_NEW_ITEM allocates from, only valid inside vtoy_json_parse */
+static ventoy_arena *g_json_arena = NULL;
+
 static void json_debug(const char *fmt, ...)
 {
     va_list args;
@@ -54,25 +57,6 @@ static void json_debug(const char *fmt, ...)
     grub_printf("\n");
 }
 
-static void vtoy_json_free(VTOY_JSON *pstJsonHead)
-{
-    VTOY_JSON *pstNext = NULL;
-
-    while (NULL != pstJsonHead)
-    {
-        pstNext = pstJsonHead->pstNext;
-        if ((pstJsonHead->enDataType < JSON_TYPE_BUTT) && (NULL != pstJsonHead->pstChild))
-        {
-            vtoy_json_free(pstJsonHead->pstChild);
-        }
-
-        grub_free(pstJsonHead);
-        pstJsonHead = pstNext;
-    }
-
-    return;
-}
-
 static char *vtoy_json_skip(const char *pcData)
 {
     while ((NULL != pcData) && ('\0' != *pcData) && (*pcData <= 32))
@@ -412,11 +396,13 @@ VTOY_JSON * vtoy_json_create(void)
 {
     VTOY_JSON *pstJson = NULL;
 
-    pstJson = (VTOY_JSON *)grub_zalloc(sizeof(VTOY_JSON));
+    pstJson = (VTOY_JSON *)grub_zalloc(sizeof(VTOY_JSON) + sizeof(ventoy_arena));
     if (NULL == pstJson)
     {
         return NULL;
     }
+
+    ventoy_arena_init(JSON_ROOT_ARENA(pstJson), 0);
     
     return pstJson;
 }
@@ -427,9 +413,18 @@ int vtoy_json_parse(VTOY_JSON *pstJson, const char *szJsonData)
     int Ret = JSON_SUCCESS;
     char *pcNewBuf = NULL;
     const char *pcEnd = NULL;
+    ventoy_arena *pstArena = JSON_ROOT_ARENA(pstJson);
 
     uiMemSize = grub_strlen(szJsonData) + 1;
-    pcNewBuf = (char *)grub_malloc(uiMemSize);
+
+    /* 
+     * The text copy and all the nodes go to the same arena, strings are used in place.
+     * Size the first block for the text plus roughly one node every 16 bytes.
+     */
+    ventoy_arena_free(pstArena);
+    ventoy_arena_init(pstArena, uiMemSize + (uiMemSize / 16 + 16) * sizeof(VTOY_JSON));
+
+    pcNewBuf = (char *)ventoy_arena_zalloc(pstArena, uiMemSize);
     if (NULL == pcNewBuf)
     {
         json_debug("Failed to alloc new buf.");
@@ -438,7 +433,9 @@ int vtoy_json_parse(VTOY_JSON *pstJson, const char *szJsonData)
     grub_memcpy(pcNewBuf, szJsonData, uiMemSize);
     pcNewBuf[uiMemSize - 1] = 0;
 
+    g_json_arena = pstArena;
     Ret = vtoy_json_parse_value(pcNewBuf, (char *)szJsonData, pstJson, szJsonData, &pcEnd);
+    g_json_arena = NULL;
     if (JSON_SUCCESS != Ret)
     {
         json_debug("Failed to parse json data %s start=%p, end=%p:%s.", 
@@ -724,16 +721,7 @@ int vtoy_json_destroy(VTOY_JSON *pstJson)
         return JSON_SUCCESS;
     }
 
-    if (NULL != pstJson->pstChild)
-    {
-        vtoy_json_free(pstJson->pstChild);
-    }
-
-    if (NULL != pstJson->pstNext)
-    {
-        vtoy_json_free(pstJson->pstNext);
-    }
-
+    ventoy_arena_free(JSON_ROOT_ARENA(pstJson));
     grub_free(pstJson);
     
     return JSON_SUCCESS;
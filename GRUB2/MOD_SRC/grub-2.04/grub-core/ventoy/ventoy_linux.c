@@ -38,6 +38,12 @@
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
+static int g_ventoy_cpio_busybox64 = 0;
+static grub_uint64_t g_ventoy_cpio_base_fsize = 0;
+static char g_ventoy_cpio_base_path[256];
+static grub_uint8_t *g_ventoy_cpio_trailer_buf = NULL;
+static char *g_ventoy_trace_buf = NULL;
+
 char * ventoy_get_line(char *start)
 {
     if (start == NULL)
@@ -524,25 +530,20 @@ end:
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
 
-grub_err_t ventoy_cmd_specify_initrd_file(grub_extcmd_context_t ctxt, int argc, char **args)
+static int ventoy_linux_add_initrd(const char *name)
 {
     initrd_info *img = NULL;
 
-    (void)ctxt;
-    (void)argc;
-
-    debug("ventoy_cmd_specify_initrd_file %s\n", args[0]);
-
     img = grub_zalloc(sizeof(initrd_info));
     if (!img)
     {
         return 1;
     }
 
-    grub_strncpy(img->name, args[0], sizeof(img->name));
+    grub_strncpy(img->name, name, sizeof(img->name));
     if (ventoy_find_initrd_by_name(g_initrd_img_list, img->name))
     {
-        debug("%s is already exist\n", args[0]);
+        debug("%s is already exist\n", name);
         grub_free(img);
     }
     else
@@ -561,6 +562,404 @@ grub_err_t ventoy_cmd_specify_initrd_file(grub_extcmd_context_t ctxt, int argc,
         g_initrd_img_count++;
     }
 
+    return 0;
+}
+
+grub_err_t ventoy_cmd_specify_initrd_file(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    (void)ctxt;
+    (void)argc;
+
+    debug("ventoy_cmd_specify_initrd_file %s\n", args[0]);
+
+    if (ventoy_linux_add_initrd(args[0]))
+    {
+        return 1;
+    }
+
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+}
+
+/*
+ * Known initrd locations, in the same order as the old if/elif chains in grub.cfg.
+ * Rules with chain=1 form an elif chain (only the first matching one is used),
+ * rules with chain=0 are always checked.
+ */
+static initrd_probe_rule g_initrd_probe_phase1[] = 
+{
+    { 1, VTOY_PROBE_ANY,  "/boot/all.rdz", { "/boot/all.rdz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_ANY,  "/boot/xen.gz", { "/install.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_DIR,  "/casper", { "/casper/initrd", "/casper/initrd.gz", "/casper/initrd-oem" }, NULL },
+    { 1, VTOY_PROBE_ANY,  "/boot/grub/initrd.xz", { "/boot/grub/initrd.xz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_ANY,  "/initrd.gz", { "/initrd.gz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_ANY,  "/slax/boot/initrfs.img", { "/slax/boot/initrfs.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_ANY,  "/pmagic/initrd.img", { "/pmagic/initrd.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_ANY,  "/boot/initrd.xz", { "/boot/initrd.xz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_ANY,  "/boot/initrd.gz", { "/boot/initrd.gz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/boot/initrd", { "/boot/initrd", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/boot/x86_64/loader/initrd", { "/boot/x86_64/loader/initrd", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/boot/initramfs-x86_64.img", { "/boot/initramfs-x86_64.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/boot/isolinux/initramfs_data64.cpio.gz", { "/boot/isolinux/initramfs_data64.cpio.gz", NULL, NULL }, NULL },
+    { 0, VTOY_PROBE_FILE, "/isolinux/initrd.gz", { "/isolinux/initrd.gz", NULL, NULL }, NULL },
+};
+
+static initrd_probe_rule g_initrd_probe_phase2[] = 
+{
+    { 1, VTOY_PROBE_FILE, "/boot/initrd.img", { "/boot/initrd.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/Setup/initrd.gz", { "/Setup/initrd.gz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/isolinux/initramfs", { "/isolinux/initramfs", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/boot/iniramfs.igz", { "/boot/iniramfs.igz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/initrd-x86_64", { "/initrd-x86_64", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/live/initrd.img", { "/live/initrd.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/initrd.img", { "/initrd.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/sysresccd/boot/x86_64/sysresccd.img", { "/sysresccd/boot/x86_64/sysresccd.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/CDlinux/initrd", { "/CDlinux/initrd", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/parabola/boot/x86_64/parabolaiso.img", 
+        { "/parabola/boot/x86_64/parabolaiso.img", "/parabola/boot/i686/parabolaiso.img", NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/hyperbola/boot/x86_64/hyperiso.img", 
+        { "/hyperbola/boot/x86_64/hyperiso.img", "/hyperbola/boot/i686/hyperiso.img", NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/EFI/BOOT/initrd.img", { "/EFI/BOOT/initrd.img", NULL, NULL }, "initrd.img" }, /* Qubes */
+    { 1, VTOY_PROBE_FILE, "/initrd", { "/initrd", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/live/initrd1", { "/live/initrd1", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/isolinux/initrd.img", { "/isolinux/initrd.img", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/isolinux/initrd.gz", { "/isolinux/initrd.gz", NULL, NULL }, NULL },
+    { 1, VTOY_PROBE_FILE, "/syslinux/kernel/initramfs.gz", { "/syslinux/kernel/initramfs.gz", NULL, NULL }, NULL },
+};
+
+static int ventoy_initrd_probe_find_node(initrd_probe_ctx *ctx, const char *path)
+{
+    int i;
+
+    for (i = 0; i < ctx->nodenum; i++)
+    {
+        if (grub_strcmp(ctx->nodes[i].path, path) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int ventoy_initrd_probe_add_node(initrd_probe_ctx *ctx, const char *path)
+{
+    int len;
+    int index;
+    int parent;
+    char *pos = NULL;
+    char dir[256];
+    initrd_probe_node *node = NULL;
+
+    index = ventoy_initrd_probe_find_node(ctx, path);
+    if (index >= 0)
+    {
+        return index;
+    }
+
+    len = (int)grub_strlen(path);
+    if (len <= 1 || len >= (int)sizeof(dir) || path[0] != '/')
+    {
+        return -1;
+    }
+
+    /* parent node must be added before child node */
+    grub_strncpy(dir, path, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = 0;
+    pos = grub_strrchr(dir, '/');
+    if (pos == dir)
+    {
+        parent = 0;
+    }
+    else
+    {
+        *pos = 0;
+        parent = ventoy_initrd_probe_add_node(ctx, dir);
+        if (parent < 0)
+        {
+            return -1;
+        }
+    }
+
+    if (ctx->nodenum >= VTOY_MAX_PROBE_NODE)
+    {
+        debug("too many initrd probe nodes %d\n", ctx->nodenum);
+        return -1;
+    }
+
+    node = ctx->nodes + ctx->nodenum;
+    grub_memset(node, 0, sizeof(initrd_probe_node));
+    grub_strncpy(node->path, path, sizeof(node->path) - 1);
+    node->name = node->path + (grub_strrchr(path, '/') - path) + 1;
+    node->parent = parent;
+    ctx->nodes[parent].haschild = 1;
+
+    return ctx->nodenum++;
+}
+
+static int ventoy_initrd_probe_dir_hook(const char *filename, const struct grub_dirhook_info *info, void *data)
+{
+    int i;
+    int match;
+    initrd_probe_ctx *ctx = (initrd_probe_ctx *)data;
+    initrd_probe_node *node = NULL;
+
+    for (i = ctx->curdir + 1; i < ctx->nodenum; i++)
+    {
+        node = ctx->nodes + i;
+        if (node->parent != ctx->curdir || node->exist)
+        {
+            continue;
+        }
+
+        if (info->case_insensitive)
+        {
+            match = (grub_strcasecmp(node->name, filename) == 0);
+        }
+        else
+        {
+            match = (grub_strcmp(node->name, filename) == 0);
+        }
+
+        if (match)
+        {
+            node->exist = 1;
+            node->isdir = info->dir;
+        }
+    }
+
+    return 0;
+}
+
+static void ventoy_initrd_probe_enum(initrd_probe_ctx *ctx)
+{
+    int i;
+    initrd_probe_node *node = NULL;
+
+    /* parent always comes before its children, so one pass is enough */
+    for (i = 0; i < ctx->nodenum; i++)
+    {
+        node = ctx->nodes + i;
+        if (node->exist && node->haschild)
+        {
+            /*
+             * A rock ridge symlink is reported with dir=0, but fs_dir follows it.
+             * So a symlinked directory is listed here and counts as a directory.
+             */
+            ctx->curdir = i;
+            if (ctx->fs->fs_dir(ctx->dev, node->path, ventoy_initrd_probe_dir_hook, ctx) == GRUB_ERR_NONE && !node->isdir)
+            {
+                debug("initrd probe %s is a link to directory\n", node->path);
+                node->isdir = 1;
+            }
+            grub_errno = GRUB_ERR_NONE;
+            ctx->dircnt++;
+        }
+    }
+}
+
+static int ventoy_initrd_probe_exist(initrd_probe_ctx *ctx, int type, const char *path)
+{
+    int index;
+    initrd_probe_node *node = NULL;
+
+    index = ventoy_initrd_probe_find_node(ctx, path);
+    if (index < 0)
+    {
+        return 0;
+    }
+
+    node = ctx->nodes + index;
+    if (!node->exist)
+    {
+        return 0;
+    }
+
+    if (type == VTOY_PROBE_FILE)
+    {
+        return node->isdir ? 0 : 1;
+    }
+    else if (type == VTOY_PROBE_DIR)
+    {
+        return node->isdir ? 1 : 0;
+    }
+
+    return 1;
+}
+
+static int ventoy_initrd_probe_rules(initrd_probe_ctx *ctx, initrd_probe_rule *rules, int num)
+{
+    int i, j;
+    int chain = 0;
+    int count = 0;
+    char cmd[300];
+
+    for (i = 0; i < num; i++)
+    {
+        if (rules[i].chain && chain)
+        {
+            continue;
+        }
+
+        if (!ventoy_initrd_probe_exist(ctx, rules[i].type, rules[i].cond))
+        {
+            continue;
+        }
+
+        debug("initrd probe rule <%s> matched\n", rules[i].cond);
+
+        if (rules[i].chain)
+        {
+            chain = 1;
+        }
+
+        for (j = 0; j < VTOY_PROBE_INITRD_NUM && rules[i].initrd[j]; j++)
+        {
+            if (ventoy_initrd_probe_exist(ctx, VTOY_PROBE_ANY, rules[i].initrd[j]))
+            {
+                ventoy_linux_add_initrd(rules[i].initrd[j]);
+                count++;
+            }
+        }
+
+        if (rules[i].replace && ventoy_is_efi_os())
+        {
+            grub_snprintf(cmd, sizeof(cmd), "vt_add_replace_file 0 \"%s\"", rules[i].replace);
+            grub_script_execute_sourcecode(cmd);
+        }
+    }
+
+    return count;
+}
+
+static void ventoy_initrd_probe_add_rules(initrd_probe_ctx *ctx, initrd_probe_rule *rules, int num)
+{
+    int i, j;
+
+    for (i = 0; i < num; i++)
+    {
+        ventoy_initrd_probe_add_node(ctx, rules[i].cond);
+        for (j = 0; j < VTOY_PROBE_INITRD_NUM && rules[i].initrd[j]; j++)
+        {
+            ventoy_initrd_probe_add_node(ctx, rules[i].initrd[j]);
+        }
+    }
+}
+
+grub_err_t ventoy_cmd_linux_probe_initrd(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    int i;
+    int num = 0;
+    int count = 0;
+    int usernum = 0;
+    char path[64];
+    char *device_name = NULL;
+    initrd_probe_ctx *ctx = NULL;
+    initrd_probe_rule *rules = NULL;
+    initrd_probe_rule *userrules = NULL;
+    initrd_probe_config *config = NULL;
+
+    (void)ctxt;
+
+    if (argc != 2)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s (loop) {phase}", cmd_raw_name); 
+    }
+
+    if (args[1][0] == '2')
+    {
+        rules = g_initrd_probe_phase2;
+        num = (int)ARRAY_SIZE(g_initrd_probe_phase2);
+    }
+    else
+    {
+        rules = g_initrd_probe_phase1;
+        num = (int)ARRAY_SIZE(g_initrd_probe_phase1);
+        
+        for (config = ventoy_plugin_get_initrd_probe(); config; config = config->next)
+        {
+            usernum++;
+        }
+    }
+
+    ctx = grub_zalloc(sizeof(initrd_probe_ctx));
+    if (!ctx)
+    {
+        return 1;
+    }
+
+    if (usernum > 0)
+    {
+        userrules = grub_zalloc(usernum * sizeof(initrd_probe_rule));
+        if (!userrules)
+        {
+            goto end;
+        }
+
+        for (i = 0, config = ventoy_plugin_get_initrd_probe(); config; config = config->next, i++)
+        {
+            userrules[i].chain = 1;
+            userrules[i].type = VTOY_PROBE_FILE;
+            userrules[i].cond = config->initrd;
+            userrules[i].initrd[0] = config->initrd;
+        }
+    }
+
+    grub_snprintf(path, sizeof(path), "%s/", args[0]);
+    device_name = grub_file_get_device_name(path);
+    if (!device_name)
+    {
+        debug("failed to get device name %s\n", path);
+        goto end;
+    }
+
+    ctx->dev = grub_device_open(device_name);
+    if (!ctx->dev)
+    {
+        debug("failed to open device %s\n", device_name);
+        goto end;
+    }
+
+    ctx->fs = grub_fs_probe(ctx->dev);
+    if (!ctx->fs)
+    {
+        debug("failed to probe fs %d\n", grub_errno);
+        goto end;
+    }
+
+    /* node 0 is the root directory */
+    grub_strcpy(ctx->nodes[0].path, "/");
+    ctx->nodes[0].exist = 1;
+    ctx->nodes[0].isdir = 1;
+    ctx->nodenum = 1;
+
+    if (userrules)
+    {
+        ventoy_initrd_probe_add_rules(ctx, userrules, usernum);
+    }
+    ventoy_initrd_probe_add_rules(ctx, rules, num);
+
+    ventoy_initrd_probe_enum(ctx);
+
+    if (userrules)
+    {
+        count = ventoy_initrd_probe_rules(ctx, userrules, usernum);
+    }
+
+    if (count == 0)
+    {
+        count = ventoy_initrd_probe_rules(ctx, rules, num);
+    }
+
+    debug("initrd probe phase %s: %d nodes, %d directory reads, %d initrd found\n", 
+          args[1], ctx->nodenum, ctx->dircnt, count);
+
+end:
+    grub_errno = GRUB_ERR_NONE;
+    check_free(device_name, grub_free);
+    check_free(ctx->dev, grub_device_close);
+    grub_check_free(userrules);
+    grub_free(ctx);
+
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
 
@@ -625,6 +1024,12 @@ int ventoy_cpio_newc_fill_head(void *buf, int filesize, const void *filedata, co
     return headlen;
 }
 
+static void ventoy_linux_copy_cpio(char *dst)
+{
+    grub_memcpy(dst, g_ventoy_cpio_base, g_ventoy_cpio_base_size);
+    grub_memcpy(dst + g_ventoy_cpio_base_size, g_ventoy_cpio_buf, g_ventoy_cpio_size - g_ventoy_cpio_base_size);
+}
+
 static grub_uint32_t ventoy_linux_get_virt_chunk_size(void)
 {
     return (sizeof(ventoy_virt_chunk) + g_ventoy_cpio_size) * g_valid_initrd_count;
@@ -649,6 +1054,11 @@ static void ventoy_linux_fill_virt_data(    grub_uint64_t isosize, ventoy_chain_
     offset = g_valid_initrd_count * sizeof(ventoy_virt_chunk);
     cur = (ventoy_virt_chunk *)override;
 
+    if (g_ventoy_trace_buf)
+    {
+        ventoy_trace_dump(g_ventoy_trace_buf, VTOY_TRACE_BUF_SIZE);
+    }
+
     for (node = g_initrd_img_list; node; node = node->next)
     {
         if (node->size == 0)
@@ -673,7 +1083,7 @@ static void ventoy_linux_fill_virt_data(    grub_uint64_t isosize, ventoy_chain_
         grub_memcpy(g_ventoy_initrd_head + 1, name, 16);
         ventoy_cpio_newc_fill_int((grub_uint32_t)node->size, g_ventoy_initrd_head->c_filesize, 8);
 
-        grub_memcpy(override + offset, g_ventoy_cpio_buf, g_ventoy_cpio_size);
+        ventoy_linux_copy_cpio(override + offset);
 
         chain->virt_img_size_in_bytes += g_ventoy_cpio_size + initrd_secs * 2048;
 
@@ -910,24 +1320,33 @@ grub_err_t ventoy_cmd_linux_locate_initrd(grub_extcmd_context_t ctxt, int argc,
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
 
-static int ventoy_cpio_busybox64(cpio_newc_header *head)
+static int ventoy_cpio_busybox64(cpio_newc_header *head, int enable)
 {
     char *name;
     int namelen;
     int offset;
     int count = 0;
-    
+    const char *from1 = enable ? "ventoy/busybox/ash" : "ventoy/busybox/32h";
+    const char *to1   = enable ? "ventoy/busybox/32h" : "ventoy/busybox/ash";
+    const char *from2 = enable ? "ventoy/busybox/64h" : "ventoy/busybox/ash";
+    const char *to2   = enable ? "ventoy/busybox/ash" : "ventoy/busybox/64h";
+
+    if (g_ventoy_cpio_busybox64 == enable)
+    {
+        return 0;
+    }
+
     name = (char *)(head + 1);
     while (name[0] && count < 2)
     {
-        if (grub_strcmp(name, "ventoy/busybox/ash") == 0)
+        if (grub_strcmp(name, from1) == 0)
         {
-            grub_memcpy(name, "ventoy/busybox/32h", 18);
+            grub_memcpy(name, to1, 18);
             count++;
         }
-        else if (grub_strcmp(name, "ventoy/busybox/64h") == 0)
+        else if (grub_strcmp(name, from2) == 0)
         {
-            grub_memcpy(name, "ventoy/busybox/ash", 18);
+            grub_memcpy(name, to2, 18);
             count++;
         }
 
@@ -941,6 +1360,7 @@ static int ventoy_cpio_busybox64(cpio_newc_header *head)
         name = (char *)(head + 1);
     }
 
+    g_ventoy_cpio_busybox64 = enable;
     return 0;
 }
 
@@ -952,10 +1372,73 @@ grub_err_t ventoy_cmd_cpio_busybox_64(grub_extcmd_context_t ctxt, int argc, char
     (void)args;
 
     debug("ventoy_cmd_busybox_64 %d\n", argc);
-    ventoy_cpio_busybox64((cpio_newc_header *)g_ventoy_cpio_buf);
+    if (g_ventoy_cpio_base)
+    {
+        ventoy_cpio_busybox64((cpio_newc_header *)g_ventoy_cpio_base, 1);
+    }
     return 0;
 }
 
+/* 
+ * ventoy.cpio is the same for every image, so it is only read once per grub session.
+ * Everything before its TRAILER!!! is kept in g_ventoy_cpio_base and the per image
+ * members are appended after it later.
+ */
+static grub_err_t ventoy_linux_load_cpio_base(const char *path)
+{
+    grub_uint8_t *buf = NULL;
+    grub_file_t file;
+
+    file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s", path);
+    if (!file)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Can't open file %s\n", path); 
+    }
+
+    if (g_ventoy_cpio_base && g_ventoy_cpio_base_fsize == file->size && 
+        grub_strcmp(g_ventoy_cpio_base_path, path) == 0)
+    {
+        debug("reuse cpio base %s size:%u\n", path, g_ventoy_cpio_base_size);
+        grub_file_close(file);
+        return GRUB_ERR_NONE;
+    }
+
+    grub_check_free(g_ventoy_cpio_base);
+    g_ventoy_cpio_base_size = 0;
+    g_ventoy_cpio_base_fsize = 0;
+    g_ventoy_cpio_busybox64 = 0;
+
+    g_ventoy_cpio_base = grub_malloc(file->size);
+    if (NULL == g_ventoy_cpio_base)
+    {
+        grub_file_close(file);
+        return grub_error(GRUB_ERR_OUT_OF_MEMORY, "Can't alloc memory %llu\n", (ulonglong)file->size); 
+    }
+
+    grub_file_read(file, g_ventoy_cpio_base, file->size);
+
+    buf = (grub_uint8_t *)(g_ventoy_cpio_base + file->size - 4);
+    while (buf >= g_ventoy_cpio_base && *((grub_uint32_t *)buf) != 0x37303730)
+    {
+        buf -= 4;
+    }
+
+    if (buf < g_ventoy_cpio_base)
+    {
+        grub_file_close(file);
+        grub_check_free(g_ventoy_cpio_base);
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Invalid cpio file %s\n", path); 
+    }
+
+    g_ventoy_cpio_base_size = (grub_uint32_t)(buf - g_ventoy_cpio_base);
+    g_ventoy_cpio_base_fsize = file->size;
+    grub_snprintf(g_ventoy_cpio_base_path, sizeof(g_ventoy_cpio_base_path), "%s", path);
+
+    debug("load cpio base %s size:%u\n", path, g_ventoy_cpio_base_size);
+
+    grub_file_close(file);
+    return GRUB_ERR_NONE;
+}
 
 grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **args)
 {
@@ -974,7 +1457,6 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
     grub_uint32_t template_size = 0;
     grub_uint32_t persistent_size = 0;
     grub_uint32_t injection_size = 0;
-    grub_file_t file;
     grub_file_t tmpfile;
     ventoy_img_chunk_list chunk_list;
 
@@ -993,19 +1475,19 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
 
     img_chunk_size = g_img_chunk_list.cur_chunk * sizeof(ventoy_img_chunk);
 
-    file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s", args[0]);
-    if (!file)
-    {
-        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Can't open file %s\n", args[0]); 
-    }
-
     if (g_ventoy_cpio_buf)
     {
         grub_free(g_ventoy_cpio_buf);
         g_ventoy_cpio_buf = NULL;
+        g_ventoy_trace_buf = NULL;
         g_ventoy_cpio_size = 0;
     }
 
+    if (ventoy_linux_load_cpio_base(args[0]))
+    {
+        return grub_errno;
+    }
+
     rc = ventoy_plugin_get_persistent_chunklist(args[1], -1, &chunk_list);
     if (rc == 0 && chunk_list.cur_chunk > 0 && chunk_list.chunk)
     {
@@ -1067,20 +1549,17 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
         debug("injection not configed %s\n", args[1]);
     }
 
-    g_ventoy_cpio_buf = grub_malloc(file->size + 4096 + template_size + persistent_size + injection_size + img_chunk_size);
+    g_ventoy_cpio_buf = grub_malloc(4096 + VTOY_TRACE_BUF_SIZE + template_size + persistent_size + injection_size + img_chunk_size);
     if (NULL == g_ventoy_cpio_buf)
     {
-        grub_file_close(file);
-        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Can't alloc memory %llu\n", file->size + 4096 + img_chunk_size); 
+        grub_check_free(template_buf);
+        grub_check_free(persistent_buf);
+        grub_check_free(injection_buf);
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Can't alloc memory %u\n", 4096 + img_chunk_size); 
     }
 
-    grub_file_read(file, g_ventoy_cpio_buf, file->size);
-
-    buf = (grub_uint8_t *)(g_ventoy_cpio_buf + file->size - 4);
-    while (*((grub_uint32_t *)buf) != 0x37303730)
-    {
-        buf -= 4;
-    }
+    /* per image members start at the TRAILER!!! of the base cpio */
+    buf = g_ventoy_cpio_buf;
 
     /* get initrd head len */
     initrd_head_len = ventoy_cpio_newc_fill_head(buf, 0, NULL, "initrd000.xx");
@@ -1093,6 +1572,9 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
     {
         headlen = ventoy_cpio_newc_fill_head(buf, template_size, template_buf, "ventoy/autoinstall");
         buf += headlen + ventoy_align(template_size, 4);
+
+        grub_free(template_buf);
+        template_buf = NULL;
     }
 
     if (persistent_size > 0 && persistent_buf)
@@ -1113,10 +1595,16 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
         injection_buf = NULL;
     }
 
+    /* boot trace, the data will be updated before chain boot */
+    headlen = ventoy_cpio_newc_fill_head(buf, VTOY_TRACE_BUF_SIZE, NULL, "ventoy/ventoy_trace");
+    g_ventoy_trace_buf = (char *)buf + headlen;
+    grub_memset(g_ventoy_trace_buf, 0, VTOY_TRACE_BUF_SIZE);
+    buf += headlen + VTOY_TRACE_BUF_SIZE;
+
     /* step2: insert os param to cpio */
     headlen = ventoy_cpio_newc_fill_head(buf, 0, NULL, "ventoy/ventoy_os_param");
     padlen = sizeof(ventoy_os_param);
-    g_ventoy_cpio_size = (grub_uint32_t)(buf - g_ventoy_cpio_buf) + headlen + padlen + initrd_head_len;
+    g_ventoy_cpio_size = g_ventoy_cpio_base_size + (grub_uint32_t)(buf - g_ventoy_cpio_buf) + headlen + padlen + initrd_head_len;
     mod = g_ventoy_cpio_size % 2048;
     if (mod)
     {
@@ -1132,12 +1620,14 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
     g_ventoy_initrd_head = (cpio_newc_header *)(g_ventoy_runtime_buf + padlen);
     ventoy_cpio_newc_fill_head(g_ventoy_initrd_head, 0, NULL, "initrd000.xx");
 
-    grub_file_close(file);
-
     if (grub_strcmp(args[3], "busybox=64") == 0)
     {
         debug("cpio busybox proc %s\n", args[3]);
-        ventoy_cpio_busybox64((cpio_newc_header *)g_ventoy_cpio_buf);
+        ventoy_cpio_busybox64((cpio_newc_header *)g_ventoy_cpio_base, 1);
+    }
+    else
+    {
+        ventoy_cpio_busybox64((cpio_newc_header *)g_ventoy_cpio_base, 0);
     }
 
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
@@ -1149,6 +1639,7 @@ grub_err_t ventoy_cmd_trailer_cpio(grub_extcmd_context_t ctxt, int argc, char **
     int bufsize;
     int namelen;
     int offset;
+    int tailsize;
     char *name;
     grub_uint8_t *bufend;
     cpio_newc_header *head;
@@ -1179,10 +1670,27 @@ grub_err_t ventoy_cmd_trailer_cpio(grub_extcmd_context_t ctxt, int argc, char **
 
     grub_file_close(file);
 
-    grub_memcpy(g_ventoy_initrd_head, trailler, sizeof(trailler));
-    bufend = (grub_uint8_t *)g_ventoy_initrd_head + sizeof(trailler);
+    /* the initrd is loaded by grub from memory here, so the cpio must be contiguous */
+    tailsize = (int)((grub_uint8_t *)g_ventoy_initrd_head - g_ventoy_cpio_buf);
+    bufsize = (int)g_ventoy_cpio_base_size + tailsize + (int)sizeof(trailler);
+
+    if (g_ventoy_trace_buf)
+    {
+        ventoy_trace_dump(g_ventoy_trace_buf, VTOY_TRACE_BUF_SIZE);
+    }
+
+    grub_check_free(g_ventoy_cpio_trailer_buf);
+    g_ventoy_cpio_trailer_buf = grub_malloc(bufsize + 512);
+    if (!g_ventoy_cpio_trailer_buf)
+    {
+        return grub_error(GRUB_ERR_OUT_OF_MEMORY, "Can't alloc memory %d\n", bufsize + 512);
+    }
+
+    grub_memcpy(g_ventoy_cpio_trailer_buf, g_ventoy_cpio_base, g_ventoy_cpio_base_size);
+    grub_memcpy(g_ventoy_cpio_trailer_buf + g_ventoy_cpio_base_size, g_ventoy_cpio_buf, tailsize);
+    grub_memcpy(g_ventoy_cpio_trailer_buf + g_ventoy_cpio_base_size + tailsize, trailler, sizeof(trailler));
+    bufend = g_ventoy_cpio_trailer_buf + bufsize;
 
-    bufsize = (int)(bufend - g_ventoy_cpio_buf);
     mod = bufsize % 512;
     if (mod)
     {
@@ -1192,7 +1700,7 @@ grub_err_t ventoy_cmd_trailer_cpio(grub_extcmd_context_t ctxt, int argc, char **
 
     if (argc > 1 && grub_strcmp(args[2], "noinit") == 0)
     {
-        head = (cpio_newc_header *)g_ventoy_cpio_buf;
+        head = (cpio_newc_header *)g_ventoy_cpio_trailer_buf;
         name = (char *)(head + 1);
 
         while (grub_strcmp(name, "TRAILER!!!"))
@@ -1225,7 +1733,7 @@ grub_err_t ventoy_cmd_trailer_cpio(grub_extcmd_context_t ctxt, int argc, char **
         }
     }
     
-    grub_snprintf(value, sizeof(value), "0x%llx", (ulonglong)(ulong)g_ventoy_cpio_buf);
+    grub_snprintf(value, sizeof(value), "0x%llx", (ulonglong)(ulong)g_ventoy_cpio_trailer_buf);
     ventoy_set_env("ventoy_cpio_addr", value);
     grub_snprintf(value, sizeof(value), "%d", bufsize);
     ventoy_set_env("ventoy_cpio_size", value);
@@ -45,6 +45,10 @@ static persistence_config *g_persistence_head = NULL;
 static menu_alias *g_menu_alias_head = NULL;
 static menu_class *g_menu_class_head = NULL;
 static injection_config *g_injection_head = NULL;
+static initrd_probe_config *g_initrd_probe_head = NULL;
+
+/* all the plugin tables below are allocated from this arena and released together on reload */
+static ventoy_arena g_plugin_arena;
 
 static int ventoy_plugin_control_check(VTOY_JSON *json, const char *isodisk)
 {
@@ -415,7 +419,7 @@ static int ventoy_plugin_parse_fullpath
             return 1;
         }
         
-        path = (file_fullpath *)grub_zalloc(sizeof(file_fullpath));
+        path = (file_fullpath *)ventoy_arena_zalloc(&g_plugin_arena, sizeof(file_fullpath));
         if (path)
         {
             grub_snprintf(path->path, sizeof(path->path), "%s", node->unData.pcStrVal);
@@ -437,7 +441,7 @@ static int ventoy_plugin_parse_fullpath
         }
         debug("%s is array type data, count=%d\n", node->pcName, count);
         
-        path = (file_fullpath *)grub_zalloc(sizeof(file_fullpath) * count);
+        path = (file_fullpath *)ventoy_arena_zalloc(&g_plugin_arena, sizeof(file_fullpath) * count);
         if (path)
         {
             *fullpath = path;
@@ -521,7 +525,6 @@ static int ventoy_plugin_auto_install_entry(VTOY_JSON *json, const char *isodisk
     const char *iso = NULL;
     VTOY_JSON *pNode = NULL;
     install_template *node = NULL;
-    install_template *next = NULL;
     file_fullpath *templatepath = NULL;
 
     if (json->enDataType != JSON_TYPE_ARRAY)
@@ -530,17 +533,8 @@ static int ventoy_plugin_auto_install_entry(VTOY_JSON *json, const char *isodisk
         return 0;
     }
 
-    if (g_install_template_head)
-    {
-        for (node = g_install_template_head; node; node = next)
-        {
-            next = node->next;
-            grub_check_free(node->templatepath);
-            grub_free(node);
-        }
-
-        g_install_template_head = NULL;
-    }
+    /* the old nodes are released with g_plugin_arena */
+    g_install_template_head = NULL;
 
     for (pNode = json->pstChild; pNode; pNode = pNode->pstNext)
     {
@@ -549,7 +543,7 @@ static int ventoy_plugin_auto_install_entry(VTOY_JSON *json, const char *isodisk
         {
             if (0 == ventoy_plugin_parse_fullpath(pNode->pstChild, isodisk, "template", &templatepath, &pathnum))
             {
-                node = grub_zalloc(sizeof(install_template));
+                node = ventoy_arena_zalloc(&g_plugin_arena, sizeof(install_template));
                 if (node)
                 {
                     node->pathlen = grub_snprintf(node->isopath, sizeof(node->isopath), "%s", iso);
@@ -640,7 +634,6 @@ static int ventoy_plugin_persistence_entry(VTOY_JSON *json, const char *isodisk)
     const char *iso = NULL;
     VTOY_JSON *pNode = NULL;
     persistence_config *node = NULL;
-    persistence_config *next = NULL;
     file_fullpath *backendpath = NULL;
 
     (void)isodisk;
@@ -651,17 +644,8 @@ static int ventoy_plugin_persistence_entry(VTOY_JSON *json, const char *isodisk)
         return 0;
     }
 
-    if (g_persistence_head)
-    {
-        for (node = g_persistence_head; node; node = next)
-        {
-            next = node->next;
-            grub_check_free(node->backendpath);
-            grub_free(node);
-        }
-
-        g_persistence_head = NULL;
-    }
+    /* the old nodes are released with g_plugin_arena */
+    g_persistence_head = NULL;
 
     for (pNode = json->pstChild; pNode; pNode = pNode->pstNext)
     {
@@ -670,7 +654,7 @@ static int ventoy_plugin_persistence_entry(VTOY_JSON *json, const char *isodisk)
         {
             if (0 == ventoy_plugin_parse_fullpath(pNode->pstChild, isodisk, "backend", &backendpath, &pathnum))
             {
-                node = grub_zalloc(sizeof(persistence_config));
+                node = ventoy_arena_zalloc(&g_plugin_arena, sizeof(persistence_config));
                 if (node)
                 {
                     node->pathlen = grub_snprintf(node->isopath, sizeof(node->isopath), "%s", iso);
@@ -765,7 +749,6 @@ static int ventoy_plugin_menualias_entry(VTOY_JSON *json, const char *isodisk)
     const char *alias = NULL;
     VTOY_JSON *pNode = NULL;
     menu_alias *node = NULL;
-    menu_alias *next = NULL;
 
     (void)isodisk;
 
@@ -775,16 +758,8 @@ static int ventoy_plugin_menualias_entry(VTOY_JSON *json, const char *isodisk)
         return 0;
     }
 
-    if (g_menu_alias_head)
-    {
-        for (node = g_menu_alias_head; node; node = next)
-        {
-            next = node->next;
-            grub_free(node);
-        }
-
-        g_menu_alias_head = NULL;
-    }
+    /* the old nodes are released with g_plugin_arena */
+    g_menu_alias_head = NULL;
 
     for (pNode = json->pstChild; pNode; pNode = pNode->pstNext)
     {
@@ -799,7 +774,7 @@ static int ventoy_plugin_menualias_entry(VTOY_JSON *json, const char *isodisk)
         alias = vtoy_json_get_string_ex(pNode->pstChild, "alias");
         if (path && path[0] == '/' && alias)
         {
-            node = grub_zalloc(sizeof(menu_alias));
+            node = ventoy_arena_zalloc(&g_plugin_arena, sizeof(menu_alias));
             if (node)
             {
                 node->type = type;
@@ -863,7 +838,6 @@ static int ventoy_plugin_injection_entry(VTOY_JSON *json, const char *isodisk)
     const char *archive = NULL;
     VTOY_JSON *pNode = NULL;
     injection_config *node = NULL;
-    injection_config *next = NULL;
 
     (void)isodisk;
 
@@ -873,16 +847,8 @@ static int ventoy_plugin_injection_entry(VTOY_JSON *json, const char *isodisk)
         return 0;
     }
 
-    if (g_injection_head)
-    {
-        for (node = g_injection_head; node; node = next)
-        {
-            next = node->next;
-            grub_free(node);
-        }
-
-        g_injection_head = NULL;
-    }
+    /* the old nodes are released with g_plugin_arena */
+    g_injection_head = NULL;
 
     for (pNode = json->pstChild; pNode; pNode = pNode->pstNext)
     {
@@ -890,7 +856,7 @@ static int ventoy_plugin_injection_entry(VTOY_JSON *json, const char *isodisk)
         archive = vtoy_json_get_string_ex(pNode->pstChild, "archive");
         if (path && path[0] == '/' && archive && archive[0] == '/')
         {
-            node = grub_zalloc(sizeof(injection_config));
+            node = ventoy_arena_zalloc(&g_plugin_arena, sizeof(injection_config));
             if (node)
             {
                 node->pathlen = grub_snprintf(node->isopath, sizeof(node->isopath), "%s", path);
@@ -917,7 +883,6 @@ static int ventoy_plugin_menuclass_entry(VTOY_JSON *json, const char *isodisk)
     VTOY_JSON *pNode = NULL;
     menu_class *tail = NULL;
     menu_class *node = NULL;
-    menu_class *next = NULL;
 
     (void)isodisk;
 
@@ -927,16 +892,8 @@ static int ventoy_plugin_menuclass_entry(VTOY_JSON *json, const char *isodisk)
         return 0;
     }
 
-    if (g_menu_class_head)
-    {
-        for (node = g_menu_class_head; node; node = next)
-        {
-            next = node->next;
-            grub_free(node);
-        }
-
-        g_menu_class_head = NULL;
-    }
+    /* the old nodes are released with g_plugin_arena */
+    g_menu_class_head = NULL;
 
     for (pNode = json->pstChild; pNode; pNode = pNode->pstNext)
     {
@@ -951,7 +908,7 @@ static int ventoy_plugin_menuclass_entry(VTOY_JSON *json, const char *isodisk)
         class = vtoy_json_get_string_ex(pNode->pstChild, "class");
         if (key && class)
         {
-            node = grub_zalloc(sizeof(menu_class));
+            node = ventoy_arena_zalloc(&g_plugin_arena, sizeof(menu_class));
             if (node)
             {
                 node->type = type;
@@ -1010,6 +967,78 @@ static int ventoy_plugin_menuclass_check(VTOY_JSON *json, const char *isodisk)
     return 0;
 }
 
+static int ventoy_plugin_initrd_probe_check(VTOY_JSON *json, const char *isodisk)
+{
+    const char *initrd = NULL;
+    VTOY_JSON *pNode = NULL;
+
+    (void)isodisk;
+
+    if (json->enDataType != JSON_TYPE_ARRAY)
+    {
+        grub_printf("Not array %d\n", json->enDataType);
+        return 1;
+    }
+
+    for (pNode = json->pstChild; pNode; pNode = pNode->pstNext)
+    {
+        initrd = vtoy_json_get_string_ex(pNode->pstChild, "initrd");
+        if (!initrd)
+        {
+            grub_printf("initrd not found\n");
+            continue;
+        }
+
+        grub_printf("initrd: <%s> [%s]\n", initrd, (initrd[0] == '/') ? "OK" : "INVALID");
+    }
+
+    return 0;
+}
+
+static int ventoy_plugin_initrd_probe_entry(VTOY_JSON *json, const char *isodisk)
+{
+    const char *initrd = NULL;
+    VTOY_JSON *pNode = NULL;
+    initrd_probe_config *tail = NULL;
+    initrd_probe_config *node = NULL;
+
+    (void)isodisk;
+
+    if (json->enDataType != JSON_TYPE_ARRAY)
+    {
+        debug("Not array %d\n", json->enDataType);
+        return 0;
+    }
+
+    /* the old nodes are released with g_plugin_arena */
+    g_initrd_probe_head = NULL;
+
+    for (pNode = json->pstChild; pNode; pNode = pNode->pstNext)
+    {
+        initrd = vtoy_json_get_string_ex(pNode->pstChild, "initrd");
+        if (initrd && initrd[0] == '/')
+        {
+            node = ventoy_arena_zalloc(&g_plugin_arena, sizeof(initrd_probe_config));
+            if (node)
+            {
+                grub_snprintf(node->initrd, sizeof(node->initrd), "%s", initrd);
+
+                if (g_initrd_probe_head)
+                {
+                    tail->next = node;
+                }
+                else
+                {
+                    g_initrd_probe_head = node;
+                }
+                tail = node;
+            }
+        }
+    }
+
+    return 0;
+}
+
 static plugin_entry g_plugin_entries[] = 
 {
     { "control", ventoy_plugin_control_entry, ventoy_plugin_control_check },
@@ -1019,6 +1048,7 @@ static plugin_entry g_plugin_entries[] =
     { "menu_alias", ventoy_plugin_menualias_entry, ventoy_plugin_menualias_check },
     { "menu_class", ventoy_plugin_menuclass_entry, ventoy_plugin_menuclass_check },
     { "injection", ventoy_plugin_injection_entry, ventoy_plugin_injection_check },
+    { "initrd_probe", ventoy_plugin_initrd_probe_entry, ventoy_plugin_initrd_probe_check },
 };
 
 static int ventoy_parse_plugin_config(VTOY_JSON *json, const char *isodisk)
@@ -1046,6 +1076,19 @@ static int ventoy_parse_plugin_config(VTOY_JSON *json, const char *isodisk)
     return 0;
 }
 
+static void ventoy_plugin_reset(void)
+{
+    g_install_template_head = NULL;
+    g_persistence_head = NULL;
+    g_menu_alias_head = NULL;
+    g_menu_class_head = NULL;
+    g_injection_head = NULL;
+    g_initrd_probe_head = NULL;
+
+    ventoy_arena_free(&g_plugin_arena);
+    ventoy_arena_init(&g_plugin_arena, VTOY_ARENA_DEF_BLOCK);
+}
+
 grub_err_t ventoy_cmd_load_plugin(grub_extcmd_context_t ctxt, int argc, char **args)
 {
     int ret = 0;
@@ -1081,12 +1124,13 @@ grub_err_t ventoy_cmd_load_plugin(grub_extcmd_context_t ctxt, int argc, char **a
         return 1;
     }
 
-    
+    ventoy_plugin_reset();
 
     ret = vtoy_json_parse(json, buf);
     if (ret)
     {
         debug("Failed to parse json string %d\n", ret);
+        vtoy_json_destroy(json);
         grub_free(buf);
         return 1;
     }
@@ -1332,6 +1376,11 @@ const char * ventoy_plugin_get_menu_class(int type, const char *name)
     return NULL;
 }
 
+initrd_probe_config * ventoy_plugin_get_initrd_probe(void)
+{
+    return g_initrd_probe_head;
+}
+
 grub_err_t ventoy_cmd_plugin_check_json(grub_extcmd_context_t ctxt, int argc, char **args)
 {
     int i = 0;
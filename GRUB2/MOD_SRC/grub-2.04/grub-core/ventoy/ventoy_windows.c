@@ -37,6 +37,7 @@
 #include <grub/crypto.h>
 #include <grub/ventoy.h>
 #include "ventoy_def.h"
+#include "vtoywim.h"
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -50,9 +51,6 @@ static grub_uint32_t g_suppress_wincd_override_data = 0;
 
 grub_uint8_t g_temp_buf[512];
 
-grub_ssize_t lzx_decompress ( const void *data, grub_size_t len, void *buf );
-grub_ssize_t xca_decompress ( const void *data, grub_size_t len, void *buf );
-
 static wim_patch *ventoy_find_wim_patch(const char *path)
 {
     int len = (int)grub_strlen(path);
@@ -430,18 +428,10 @@ static int ventoy_get_override_info(grub_file_t file, wim_tail *wim_data)
 
 static int ventoy_read_resource(grub_file_t fp, wim_header *wimhdr, wim_resource_header *head, void **buffer)
 {
-    int decompress_len = 0;
-    int total_decompress = 0;
-    grub_uint32_t i = 0;
-    grub_uint32_t chunk_num = 0;
-    grub_uint32_t chunk_size = 0;
-    grub_uint32_t last_chunk_size = 0;
-    grub_uint32_t last_decompress_size = 0;
-    grub_uint32_t cur_offset = 0;
-    grub_uint8_t *cur_dst = NULL;
+    int rc;
     grub_uint8_t *buffer_compress = NULL;
     grub_uint8_t *buffer_decompress = NULL;
-    grub_uint32_t *chunk_offset = NULL;
+    vtoy_wim_chunk *chunks = NULL;
 
     buffer_decompress = (grub_uint8_t *)grub_malloc(head->raw_size + head->size_in_wim);
     if (NULL == buffer_decompress)
@@ -461,69 +451,21 @@ static int ventoy_read_resource(grub_file_t fp, wim_header *wimhdr, wim_resource
     buffer_compress = buffer_decompress + head->raw_size;
     grub_file_read(fp, buffer_compress, head->size_in_wim);
 
-    chunk_num = (head->raw_size + WIM_CHUNK_LEN - 1) / WIM_CHUNK_LEN;
-    cur_offset = (chunk_num - 1) * 4;
-    chunk_offset = (grub_uint32_t *)buffer_compress;
-    
-    cur_dst = buffer_decompress;
-    
-    for (i = 0; i < chunk_num - 1; i++)
+    chunks = grub_malloc(vtoy_wim_chunk_num(head->raw_size) * sizeof(vtoy_wim_chunk));
+    if (NULL == chunks)
     {
-        chunk_size = (i == 0) ? chunk_offset[i] : chunk_offset[i] - chunk_offset[i - 1];
-
-        if (WIM_CHUNK_LEN == chunk_size)
-        {
-            grub_memcpy(cur_dst, buffer_compress + cur_offset, chunk_size);
-            decompress_len = (int)chunk_size; 
-        }
-        else
-        {
-            if (wimhdr->flags & FLAG_HEADER_COMPRESS_XPRESS)
-            {
-                decompress_len = (int)xca_decompress(buffer_compress + cur_offset, chunk_size, cur_dst);
-            }
-            else
-            {
-                decompress_len = (int)lzx_decompress(buffer_compress + cur_offset, chunk_size, cur_dst);                
-            }
-        }
-
-        //debug("chunk_size:%u decompresslen:%d\n", chunk_size, decompress_len);
-        
-        total_decompress += decompress_len;
-        cur_dst += decompress_len;
-        cur_offset += chunk_size;
+        grub_free(buffer_decompress);
+        return 1;
     }
 
-    /* last chunk */
-    last_chunk_size = (grub_uint32_t)(head->size_in_wim - cur_offset);
-    last_decompress_size = head->raw_size - total_decompress;
-    
-    if (last_chunk_size < WIM_CHUNK_LEN && last_chunk_size == last_decompress_size)
-    {
-        debug("Last chunk %u uncompressed\n", last_chunk_size);
-        grub_memcpy(cur_dst, buffer_compress + cur_offset, last_chunk_size);
-        decompress_len = (int)last_chunk_size; 
-    }
-    else
-    {
-        if (wimhdr->flags & FLAG_HEADER_COMPRESS_XPRESS)
-        {
-            decompress_len = (int)xca_decompress(buffer_compress + cur_offset, head->size_in_wim - cur_offset, cur_dst);
-        }
-        else
-        {
-            decompress_len = (int)lzx_decompress(buffer_compress + cur_offset, head->size_in_wim - cur_offset, cur_dst);
-        }
-    }
-    
-    cur_dst += decompress_len;
-    total_decompress += decompress_len;
+    rc = vtoy_wim_decompress(vtoy_wim_comp_type(wimhdr->flags), buffer_compress, head->size_in_wim, 
+                             head->raw_size, chunks, buffer_decompress);
+    grub_free(chunks);
 
-    if (cur_dst != buffer_decompress + head->raw_size)
+    if (rc)
     {
-        debug("head->size_in_wim:%llu head->raw_size:%llu cur_dst:%p buffer_decompress:%p total_decompress:%d\n", 
-            (ulonglong)head->size_in_wim, (ulonglong)head->raw_size, cur_dst, buffer_decompress, total_decompress);
+        debug("head->size_in_wim:%llu head->raw_size:%llu decompress failed\n", 
+            (ulonglong)head->size_in_wim, (ulonglong)head->raw_size);
         grub_free(buffer_decompress);
         return 1;
     }
@@ -0,0 +1,573 @@
+/******************************************************************************
+ * ventoy_xzdisk.c
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/disk.h>
+#include <grub/device.h>
+#include <grub/term.h>
+#include <grub/partition.h>
+#include <grub/file.h>
+#include <grub/normal.h>
+#include <grub/extcmd.h>
+#include <grub/i18n.h>
+#include <grub/ventoy.h>
+#include "ventoy_def.h"
+
+/*
+ * ventoy.disk.img.xz is compressed with fixed size xz blocks (xz --block-size).
+ * The stream index tells where each block is, so a read only needs to decode
+ * the blocks it covers. A block is decoded by wrapping it as a standalone
+ * single block xz stream and passing it through the xzio file filter.
+ */
+
+#define VTOY_XZ_HEADER_SIZE     12
+#define VTOY_XZ_FOOTER_SIZE     12
+#define VTOY_XZ_INDEX_MAX       (1024 * 1024)
+#define VTOY_XZ_CACHE_NUM       8
+
+typedef struct ventoy_xz_block
+{
+    grub_uint64_t offset;   /* compressed data offset in file */
+    grub_uint64_t unpadded; /* unpadded size in index */
+    grub_uint64_t size;     /* uncompressed size */
+}ventoy_xz_block;
+
+typedef struct ventoy_xz_cache
+{
+    grub_int32_t  block;
+    grub_uint32_t lru;
+    char *data;
+}ventoy_xz_cache;
+
+typedef struct ventoy_xzdisk
+{
+    char name[64];
+    grub_file_t file;
+    grub_uint8_t header[VTOY_XZ_HEADER_SIZE];
+
+    grub_uint64_t disksize;
+    grub_uint64_t blocksize;
+    grub_uint32_t blocknum;
+    ventoy_xz_block *blocks;
+
+    grub_uint32_t streamsize;
+    grub_uint8_t *stream;
+
+    grub_uint32_t lru;
+    ventoy_xz_cache cache[VTOY_XZ_CACHE_NUM];
+}ventoy_xzdisk;
+
+static ventoy_xzdisk *g_ventoy_xzdisk = NULL;
+static int g_ventoy_xzdisk_registered = 0;
+
+static grub_uint32_t ventoy_xz_crc32(const grub_uint8_t *buf, grub_uint32_t len)
+{
+    int i;
+    grub_uint32_t crc = 0xFFFFFFFF;
+
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+static int ventoy_xz_get_vli(const grub_uint8_t *buf, grub_uint32_t len, grub_uint32_t *pos, grub_uint64_t *value)
+{
+    int i;
+
+    *value = 0;
+    for (i = 0; i < 9 && *pos < len; i++)
+    {
+        *value |= (grub_uint64_t)(buf[*pos] & 0x7F) << (i * 7);
+        if ((buf[(*pos)++] & 0x80) == 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static grub_uint32_t ventoy_xz_put_vli(grub_uint8_t *buf, grub_uint64_t value)
+{
+    grub_uint32_t pos = 0;
+
+    while (value >= 0x80)
+    {
+        buf[pos++] = (grub_uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[pos++] = (grub_uint8_t)value;
+
+    return pos;
+}
+
+static int ventoy_xzdisk_parse_index(ventoy_xzdisk *xzdisk)
+{
+    int ret = 1;
+    grub_uint32_t i;
+    grub_uint32_t pos = 0;
+    grub_uint32_t indexsize = 0;
+    grub_uint64_t num = 0;
+    grub_uint64_t offset = 0;
+    grub_uint64_t maxblock = 0;
+    grub_uint8_t footer[VTOY_XZ_FOOTER_SIZE];
+    grub_uint8_t *index = NULL;
+    grub_file_t file = xzdisk->file;
+
+    if (file->size < VTOY_XZ_HEADER_SIZE + VTOY_XZ_FOOTER_SIZE)
+    {
+        return 1;
+    }
+
+    grub_file_seek(file, 0);
+    grub_file_read(file, xzdisk->header, VTOY_XZ_HEADER_SIZE);
+    if (grub_memcmp(xzdisk->header, "\xFD" "7zXZ\0", 6))
+    {
+        debug("Not xz file %s\n", file->name);
+        return 1;
+    }
+
+    grub_file_seek(file, file->size - VTOY_XZ_FOOTER_SIZE);
+    grub_file_read(file, footer, VTOY_XZ_FOOTER_SIZE);
+    if (footer[10] != 'Y' || footer[11] != 'Z')
+    {
+        debug("Invalid xz footer %s\n", file->name);
+        return 1;
+    }
+
+    indexsize = (grub_get_unaligned32(footer + 4) + 1) * 4;
+    if (indexsize > VTOY_XZ_INDEX_MAX || indexsize + VTOY_XZ_HEADER_SIZE + VTOY_XZ_FOOTER_SIZE > file->size)
+    {
+        debug("Invalid xz index size %u\n", indexsize);
+        return 1;
+    }
+
+    index = grub_malloc(indexsize);
+    if (!index)
+    {
+        return 1;
+    }
+
+    grub_file_seek(file, file->size - VTOY_XZ_FOOTER_SIZE - indexsize);
+    grub_file_read(file, index, indexsize);
+
+    pos = 1;
+    if (index[0] != 0 || ventoy_xz_get_vli(index, indexsize, &pos, &num) || num == 0 || num > 0xFFFFFF)
+    {
+        debug("Invalid xz index %u\n", index[0]);
+        goto end;
+    }
+
+    xzdisk->blocks = grub_zalloc(num * sizeof(ventoy_xz_block));
+    if (!xzdisk->blocks)
+    {
+        goto end;
+    }
+
+    offset = VTOY_XZ_HEADER_SIZE;
+    for (i = 0; i < num; i++)
+    {
+        if (ventoy_xz_get_vli(index, indexsize, &pos, &(xzdisk->blocks[i].unpadded)) ||
+            ventoy_xz_get_vli(index, indexsize, &pos, &(xzdisk->blocks[i].size)))
+        {
+            goto end;
+        }
+
+        xzdisk->blocks[i].offset = offset;
+        offset += (xzdisk->blocks[i].unpadded + 3) & (~3ULL);
+
+        if (xzdisk->blocks[i].unpadded > maxblock)
+        {
+            maxblock = xzdisk->blocks[i].unpadded;
+        }
+        xzdisk->disksize += xzdisk->blocks[i].size;
+    }
+
+    xzdisk->blocknum = (grub_uint32_t)num;
+    xzdisk->blocksize = xzdisk->blocks[0].size;
+
+    /* all blocks except the last one must have the same size */
+    for (i = 0; i + 1 < num; i++)
+    {
+        if (xzdisk->blocks[i].size != xzdisk->blocksize)
+        {
+            debug("xz block %u size %llu mismatch\n", i, (ulonglong)xzdisk->blocks[i].size);
+            goto end;
+        }
+    }
+
+    if (xzdisk->blocksize == 0 || (xzdisk->blocksize % 512) || (xzdisk->disksize % 512) ||
+        maxblock > 0x7FFFFFFF || offset + indexsize + VTOY_XZ_FOOTER_SIZE > file->size)
+    {
+        debug("Invalid xz block layout %llu %llu\n", (ulonglong)xzdisk->blocksize, (ulonglong)xzdisk->disksize);
+        goto end;
+    }
+
+    /* header + block + index (at most 4 + 2 * 9 + padding + crc) + footer */
+    xzdisk->streamsize = VTOY_XZ_HEADER_SIZE + (grub_uint32_t)((maxblock + 3) & (~3ULL)) + 32 + VTOY_XZ_FOOTER_SIZE;
+
+    debug("xz disk %u blocks, blocksize %llu disksize %llu\n", xzdisk->blocknum,
+        (ulonglong)xzdisk->blocksize, (ulonglong)xzdisk->disksize);
+    ret = 0;
+
+end:
+    grub_free(index);
+    return ret;
+}
+
+static grub_uint32_t ventoy_xzdisk_make_stream(ventoy_xzdisk *xzdisk, grub_uint32_t blk)
+{
+    grub_uint32_t pos = 0;
+    grub_uint32_t start = 0;
+    grub_uint32_t crc = 0;
+    grub_uint32_t padded = 0;
+    grub_uint8_t *buf = xzdisk->stream;
+    ventoy_xz_block *block = xzdisk->blocks + blk;
+
+    padded = (grub_uint32_t)((block->unpadded + 3) & (~3ULL));
+
+    grub_memcpy(buf, xzdisk->header, VTOY_XZ_HEADER_SIZE);
+    pos = VTOY_XZ_HEADER_SIZE;
+
+    grub_file_seek(xzdisk->file, block->offset);
+    if (grub_file_read(xzdisk->file, buf + pos, padded) != (grub_ssize_t)padded)
+    {
+        return 0;
+    }
+    pos += padded;
+
+    /* index with only this block */
+    start = pos;
+    buf[pos++] = 0;
+    pos += ventoy_xz_put_vli(buf + pos, 1);
+    pos += ventoy_xz_put_vli(buf + pos, block->unpadded);
+    pos += ventoy_xz_put_vli(buf + pos, block->size);
+    while (pos & 3)
+    {
+        buf[pos++] = 0;
+    }
+
+    crc = ventoy_xz_crc32(buf + start, pos - start);
+    grub_set_unaligned32(buf + pos, crc);
+    pos += 4;
+
+    /* footer: crc32, backward size, stream flags, magic */
+    grub_set_unaligned32(buf + pos + 4, (pos - start) / 4 - 1);
+    buf[pos + 8] = xzdisk->header[6];
+    buf[pos + 9] = xzdisk->header[7];
+    crc = ventoy_xz_crc32(buf + pos + 4, 6);
+    grub_set_unaligned32(buf + pos, crc);
+    buf[pos + 10] = 'Y';
+    buf[pos + 11] = 'Z';
+    pos += VTOY_XZ_FOOTER_SIZE;
+
+    return pos;
+}
+
+static int ventoy_xzdisk_decode(ventoy_xzdisk *xzdisk, grub_uint32_t blk, char *data)
+{
+    int ret = 1;
+    grub_uint32_t len = 0;
+    grub_file_t file = NULL;
+    grub_file_t xzfile = NULL;
+    char name[64];
+
+    len = ventoy_xzdisk_make_stream(xzdisk, blk);
+    if (len == 0)
+    {
+        debug("Failed to read xz block %u\n", blk);
+        return 1;
+    }
+
+    /* mem: files bypass the file filters, so apply xzio by hand */
+    grub_snprintf(name, sizeof(name), "mem:0x%llx:size:%u", (ulonglong)(ulong)xzdisk->stream, len);
+    file = grub_file_open(name, GRUB_FILE_TYPE_NONE);
+    if (!file)
+    {
+        return 1;
+    }
+
+    if (!grub_file_filters[GRUB_FILE_FILTER_XZIO])
+    {
+        grub_file_close(file);
+        return 1;
+    }
+
+    xzfile = grub_file_filters[GRUB_FILE_FILTER_XZIO](file, GRUB_FILE_TYPE_NONE);
+    if (!xzfile || xzfile == file)
+    {
+        debug("xzio open failed for block %u\n", blk);
+        grub_file_close(file);
+        grub_errno = GRUB_ERR_NONE;
+        return 1;
+    }
+
+    /* grub_file_read checks the name for mem: files */
+    xzfile->name = grub_strdup("vtoyxz");
+    if (xzfile->name &&
+        grub_file_read(xzfile, data, xzdisk->blocks[blk].size) == (grub_ssize_t)xzdisk->blocks[blk].size)
+    {
+        ret = 0;
+    }
+
+    grub_check_free(xzfile->name);
+    grub_file_close(xzfile);
+    grub_errno = GRUB_ERR_NONE;
+
+    return ret;
+}
+
+static char * ventoy_xzdisk_get_block(ventoy_xzdisk *xzdisk, grub_uint32_t blk)
+{
+    int i;
+    ventoy_xz_cache *slot = NULL;
+
+    xzdisk->lru++;
+
+    for (i = 0; i < VTOY_XZ_CACHE_NUM; i++)
+    {
+        if (xzdisk->cache[i].block == (grub_int32_t)blk && xzdisk->cache[i].data)
+        {
+            xzdisk->cache[i].lru = xzdisk->lru;
+            return xzdisk->cache[i].data;
+        }
+
+        if (NULL == slot || xzdisk->cache[i].lru < slot->lru)
+        {
+            slot = xzdisk->cache + i;
+        }
+    }
+
+    if (!slot->data)
+    {
+        slot->data = grub_malloc(xzdisk->blocksize);
+        if (!slot->data)
+        {
+            return NULL;
+        }
+    }
+
+    slot->block = -1;
+    if (ventoy_xzdisk_decode(xzdisk, blk, slot->data))
+    {
+        return NULL;
+    }
+
+    slot->block = (grub_int32_t)blk;
+    slot->lru = xzdisk->lru;
+    return slot->data;
+}
+
+static void ventoy_xzdisk_free(ventoy_xzdisk *xzdisk)
+{
+    int i;
+
+    for (i = 0; i < VTOY_XZ_CACHE_NUM; i++)
+    {
+        grub_check_free(xzdisk->cache[i].data);
+    }
+
+    grub_check_free(xzdisk->blocks);
+    grub_check_free(xzdisk->stream);
+    check_free(xzdisk->file, grub_file_close);
+    grub_free(xzdisk);
+}
+
+static int ventoy_xzdisk_iterate(grub_disk_dev_iterate_hook_t hook, void *hook_data, grub_disk_pull_t pull)
+{
+    if (pull != GRUB_DISK_PULL_NONE || !g_ventoy_xzdisk)
+    {
+        return 0;
+    }
+
+    return hook(g_ventoy_xzdisk->name, hook_data);
+}
+
+static grub_err_t ventoy_xzdisk_open(const char *name, grub_disk_t disk)
+{
+    if (!g_ventoy_xzdisk || grub_strcmp(name, g_ventoy_xzdisk->name))
+    {
+        return grub_error(GRUB_ERR_UNKNOWN_DEVICE, "can't open device");
+    }
+
+    disk->total_sectors = g_ventoy_xzdisk->disksize >> GRUB_DISK_SECTOR_BITS;
+    disk->max_agglomerate = GRUB_DISK_MAX_MAX_AGGLOMERATE;
+    disk->id = 0;
+    disk->data = g_ventoy_xzdisk;
+
+    return GRUB_ERR_NONE;
+}
+
+static void ventoy_xzdisk_close(grub_disk_t disk)
+{
+    (void)disk;
+}
+
+static grub_err_t ventoy_xzdisk_read(grub_disk_t disk, grub_disk_addr_t sector, grub_size_t size, char *buf)
+{
+    char *data = NULL;
+    grub_uint32_t blk = 0;
+    grub_uint64_t len = 0;
+    grub_uint64_t skip = 0;
+    grub_uint64_t offset = sector << GRUB_DISK_SECTOR_BITS;
+    grub_uint64_t total = (grub_uint64_t)size << GRUB_DISK_SECTOR_BITS;
+    ventoy_xzdisk *xzdisk = (ventoy_xzdisk *)disk->data;
+
+    if (offset + total > xzdisk->disksize)
+    {
+        return grub_error(GRUB_ERR_OUT_OF_RANGE, "attempt to read outside of disk `%s'", disk->name);
+    }
+
+    while (total > 0)
+    {
+        blk = (grub_uint32_t)grub_divmod64(offset, xzdisk->blocksize, &skip);
+
+        data = ventoy_xzdisk_get_block(xzdisk, blk);
+        if (!data)
+        {
+            return grub_error(GRUB_ERR_READ_ERROR, "failed to decode xz block %u", blk);
+        }
+
+        len = xzdisk->blocks[blk].size - skip;
+        if (len > total)
+        {
+            len = total;
+        }
+
+        grub_memcpy(buf, data + skip, len);
+        buf += len;
+        offset += len;
+        total -= len;
+    }
+
+    return GRUB_ERR_NONE;
+}
+
+static grub_err_t ventoy_xzdisk_write(grub_disk_t disk, grub_disk_addr_t sector, grub_size_t size, const char *buf)
+{
+    (void)disk;
+    (void)sector;
+    (void)size;
+    (void)buf;
+    return grub_error(GRUB_ERR_NOT_IMPLEMENTED_YET, "xz disk write is not supported");
+}
+
+static struct grub_disk_dev g_ventoy_xzdisk_dev =
+{
+    .name = "vtoyxz",
+    .id = GRUB_DISK_DEVICE_VTOYXZ_ID,
+    .disk_iterate = ventoy_xzdisk_iterate,
+    .disk_open = ventoy_xzdisk_open,
+    .disk_close = ventoy_xzdisk_close,
+    .disk_read = ventoy_xzdisk_read,
+    .disk_write = ventoy_xzdisk_write,
+    .next = 0
+};
+
+grub_err_t ventoy_cmd_xz_disk(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    int i;
+    ventoy_xzdisk *xzdisk = NULL;
+
+    (void)ctxt;
+
+    if (argc != 2)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s {name} {xzfile}", cmd_raw_name);
+    }
+
+    if (g_ventoy_xzdisk)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "xz disk %s already exist", g_ventoy_xzdisk->name);
+    }
+
+    xzdisk = grub_zalloc(sizeof(ventoy_xzdisk));
+    if (!xzdisk)
+    {
+        return grub_error(GRUB_ERR_OUT_OF_MEMORY, "Can't alloc memory");
+    }
+
+    for (i = 0; i < VTOY_XZ_CACHE_NUM; i++)
+    {
+        xzdisk->cache[i].block = -1;
+    }
+
+    grub_snprintf(xzdisk->name, sizeof(xzdisk->name), "%s", args[0]);
+
+    xzdisk->file = grub_file_open(args[1], VENTOY_FILE_TYPE);
+    if (!xzdisk->file)
+    {
+        debug("Failed to open %s\n", args[1]);
+        goto fail;
+    }
+
+    if (ventoy_xzdisk_parse_index(xzdisk))
+    {
+        goto fail;
+    }
+
+    /* a single block image is faster to decode at once with loopback */
+    if (xzdisk->blocknum < 2)
+    {
+        debug("xz file only has %u block\n", xzdisk->blocknum);
+        goto fail;
+    }
+
+    xzdisk->stream = grub_malloc(xzdisk->streamsize);
+    if (!xzdisk->stream)
+    {
+        goto fail;
+    }
+
+    if (!g_ventoy_xzdisk_registered)
+    {
+        grub_disk_dev_register(&g_ventoy_xzdisk_dev);
+        g_ventoy_xzdisk_registered = 1;
+    }
+
+    g_ventoy_xzdisk = xzdisk;
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+
+fail:
+    ventoy_xzdisk_free(xzdisk);
+    grub_errno = GRUB_ERR_NONE;
+    return 1;
+}
+
+void ventoy_xzdisk_fini(void)
+{
+    if (g_ventoy_xzdisk_registered)
+    {
+        grub_disk_dev_unregister(&g_ventoy_xzdisk_dev);
+        g_ventoy_xzdisk_registered = 0;
+    }
+
+    check_free(g_ventoy_xzdisk, ventoy_xzdisk_free);
+}
@@ -50,6 +50,7 @@ enum grub_disk_dev_id
     GRUB_DISK_DEVICE_UBOOTDISK_ID,
     GRUB_DISK_DEVICE_XEN,
     GRUB_DISK_DEVICE_OBDISK_ID,
+    GRUB_DISK_DEVICE_VTOYXZ_ID,
   };
 
 struct grub_disk;
@@ -249,6 +250,28 @@ struct grub_disk_cache
 
 extern struct grub_disk_cache EXPORT_VAR(grub_disk_cache_table)[GRUB_DISK_CACHE_NUM];
 
+/* Read accounting, used by the ventoy boot trace.  */
+#define GRUB_DISK_IO_STAT_MAX	16
+
+struct grub_disk_io_stat
+{
+  enum grub_disk_dev_id dev_id;
+  unsigned long disk_id;
+  char name[32];
+
+  /* Calls to grub_disk_read.  */
+  grub_uint64_t read_count;
+  grub_uint64_t read_bytes;
+
+  /* Requests that missed the cache and went to the device driver.  */
+  grub_uint64_t dev_count;
+  grub_uint64_t dev_bytes;
+};
+
+extern struct grub_disk_io_stat EXPORT_VAR(grub_disk_io_total);
+extern struct grub_disk_io_stat EXPORT_VAR(grub_disk_io_stat)[GRUB_DISK_IO_STAT_MAX];
+extern int EXPORT_VAR(grub_disk_io_stat_num);
+
 #if defined (GRUB_UTIL)
 void grub_lvm_init (void);
 void grub_ldm_init (void);
@@ -240,12 +240,26 @@ typedef struct ventoy_grub_param
 
 #pragma pack()
 
+typedef struct grub_iso9660_cache_stat
+{
+    int enable;
+    int entry;
+    grub_uint32_t lookup;
+    grub_uint32_t hit;
+    grub_uint32_t negative_hit;
+    grub_uint32_t miss;
+    grub_uint32_t evict;
+    grub_uint32_t flush;
+}grub_iso9660_cache_stat;
 
 int grub_ext_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list);
 int grub_fat_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list);
 void grub_iso9660_set_nojoliet(int nojoliet);
 grub_uint64_t grub_iso9660_get_last_read_pos(grub_file_t file);
 grub_uint64_t grub_iso9660_get_last_file_dirent_pos(grub_file_t file);
+void grub_iso9660_flush_cache(void);
+void grub_iso9660_set_cache(int enable, int clear_stat);
+void grub_iso9660_get_cache_stat(grub_iso9660_cache_stat *stat);
 grub_uint64_t grub_udf_get_file_offset(grub_file_t file);
 grub_uint64_t grub_udf_get_last_pd_size_offset(void);
 grub_uint64_t grub_udf_get_last_file_attr_offset
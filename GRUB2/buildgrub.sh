@@ -14,6 +14,7 @@ mkdir PXE
 tar -xvf grub-2.04.tar.xz -C ./SRC/
 
 /bin/cp -a ./MOD_SRC/grub-2.04  ./SRC/
+/bin/cp -a ../vtoywim/*.c ../vtoywim/*.h ./SRC/grub-2.04/grub-core/ventoy/
 
 cd ./SRC/grub-2.04
 
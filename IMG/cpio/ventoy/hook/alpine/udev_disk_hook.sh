@@ -47,7 +47,7 @@ PATH=$BUSYBOX_PATH:$VTOY_PATH/tool:$PATH
 #   3. unmount and delete the squashfs file
 #
 
-vtoydm -i -f $VTOY_PATH/ventoy_image_map -d /dev/${MDEV:0:-1} > $VTOY_PATH/iso_file_list
+vtoydm -i -f $VTOY_PATH/ventoy_image_map -d /dev/${MDEV:0:-1} -m 'modloop-lts' > $VTOY_PATH/iso_file_list
 
 vtLine=$(grep '[-][-] modloop-lts ' $VTOY_PATH/iso_file_list)
 sector=$(echo $vtLine | awk '{print $(NF-1)}')
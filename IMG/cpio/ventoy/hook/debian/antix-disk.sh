@@ -30,7 +30,7 @@ ventoy_os_install_dmsetup_by_unsquashfs() {
     vtKoPo=$(ventoy_get_module_postfix)
     vtlog "vtKoPo=$vtKoPo"
 
-    vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $1 > $VTOY_PATH/iso_file_list
+    vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $1 -m 'linuxfs' > $VTOY_PATH/iso_file_list
 
     vtline=$(grep '[-][-] linuxfs '  $VTOY_PATH/iso_file_list)    
     sector=$(echo $vtline | awk '{print $(NF-1)}')
@@ -37,7 +37,7 @@ if [ "$vtdiskname" = "unknown" ]; then
 fi
 
 
-vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $vtdiskname > $VTOY_PATH/iso_file_list
+vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $vtdiskname -m 'drivers-*.squashfs' > $VTOY_PATH/iso_file_list
 
 vtline=$(grep '[-][-] drivers-.*\.squashfs'  $VTOY_PATH/iso_file_list)
 sector=$(echo $vtline | awk '{print $(NF-1)}')
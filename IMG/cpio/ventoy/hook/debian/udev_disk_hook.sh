@@ -26,7 +26,7 @@ ventoy_os_install_dmsetup() {
     vt_usb_disk=$1
 
     # dump iso file location
-    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} > $VTOY_PATH/iso_file_list
+    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} -m 'dmsetup*.udeb' -m 'libdevmapper*.udeb' -M 'md-modules*.udeb' -m 'libc6-*.udeb' > $VTOY_PATH/iso_file_list
 
     # install dmsetup 
     LINE=$($GREP ' dmsetup.*\.udeb'  $VTOY_PATH/iso_file_list)
@@ -97,12 +97,13 @@ fi
 
 vtlog "==== $0 $* ====" 
 
-dmsetup_path=$(ventoy_find_bin_path dmsetup)
-if [ -z "$dmsetup_path" ]; then
+# md-modules brings the dm module
+if ! $GREP -q 'device-mapper' /proc/devices; then
     ventoy_os_install_dmsetup "/dev/${1:0:-1}"
 fi
 
-if ! $GREP -q 'device-mapper' /proc/devices; then
+dmsetup_path=$(ventoy_find_bin_path dmsetup)
+if [ -z "$dmsetup_path" ] && ! ventoy_create_dm_by_ioctl "/dev/${1:0:-1}" $(ventoy_image_dm_mode); then
     ventoy_os_install_dmsetup "/dev/${1:0:-1}"
 fi
 
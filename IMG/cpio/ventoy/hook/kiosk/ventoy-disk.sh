@@ -28,7 +28,7 @@ ventoy_os_install_dmsetup_by_unsquashfs() {
     vtKoPo=$(ventoy_get_module_postfix)
     vtlog "vtKerVer=$vtKerVer vtKoPo=$vtKoPo"
 
-    vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $1 > $VTOY_PATH/iso_file_list
+    vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $1 -m '*kernel.xzm' > $VTOY_PATH/iso_file_list
 
     vtline=$(grep '[-][-] .*kernel.xzm '  $VTOY_PATH/iso_file_list)    
     sector=$(echo $vtline | awk '{print $(NF-1)}')
@@ -27,7 +27,7 @@ ventoy_os_install_device_mapper_by_unsquashfs() {
     vtKoExt=$(ventoy_get_module_postfix)
     vtlog "vtKoExt=$vtKoExt"
 
-    vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $1 > $VTOY_PATH/iso_file_list
+    vtoydm -i -f $VTOY_PATH/ventoy_image_map -d $1 -m 'livecd.sqfs' > $VTOY_PATH/iso_file_list
 
     vtline=$(grep '[-][-] livecd.sqfs '  $VTOY_PATH/iso_file_list)    
     sector=$(echo $vtline | awk '{print $(NF-1)}')
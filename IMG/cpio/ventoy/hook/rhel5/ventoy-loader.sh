@@ -25,7 +25,7 @@ ventoy_os_install_dmsetup() {
     vt_usb_disk=$1
     
     # dump iso file location
-    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} > $VTOY_PATH/iso_file_list
+    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} -m 'minstg2.img' > $VTOY_PATH/iso_file_list
 
     # install dmsetup 
     LINE=$($GREP 'minstg2.img'  $VTOY_PATH/iso_file_list)
@@ -56,7 +56,7 @@ vtlog "##### $0 $* ########"
 vtdiskname=$(get_ventoy_disk_name)
 
 dmsetup_path=$(ventoy_find_bin_path dmsetup)
-if [ -z "$dmsetup_path" ]; then
+if [ -z "$dmsetup_path" ] && ! ventoy_create_dm_by_ioctl "$vtdiskname" $(ventoy_image_dm_mode); then
     ventoy_os_install_dmsetup "$vtdiskname"
     ventoy_udev_disk_common_hook "${vtdiskname#/dev/}2" "noreplace"
     
@@ -30,7 +30,7 @@ ventoy_os_install_dmsetup() {
     $BUSYBOX_PATH/modprobe linear
     
     # dump iso file location
-    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} > $VTOY_PATH/iso_file_list
+    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} -m 'device-mapper-[0-9]*.rpm' > $VTOY_PATH/iso_file_list
 
     # install dmsetup 
     LINE=$($GREP 'device-mapper-[0-9].*\.rpm'  $VTOY_PATH/iso_file_list)
@@ -60,7 +60,7 @@ if is_ventoy_hook_finished || not_ventoy_disk "${1:0:-1}"; then
 fi
 
 dmsetup_path=$(ventoy_find_bin_path dmsetup)
-if [ -z "$dmsetup_path" ]; then
+if [ -z "$dmsetup_path" ] && ! ventoy_create_dm_by_ioctl "/dev/${1:0:-1}" $(ventoy_image_dm_mode); then
     ventoy_os_install_dmsetup "/dev/${1:0:-1}"
 fi
 
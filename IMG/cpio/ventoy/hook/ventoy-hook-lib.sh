@@ -83,6 +83,13 @@ get_ventoy_iso_name() {
 }
 
 wait_for_usb_disk_ready() {
+    line=$($VTOY_PATH/tool/vtoydump --wait -f $VTOY_PATH/ventoy_os_param)
+    if [ $? -eq 0 ]; then
+        usb_disk=${line%%#*}
+        vtlog "wait_for_usb_disk_ready $usb_disk finish"
+        return
+    fi
+
 	while [ -n "Y" ]; do
 		usb_disk=$(get_ventoy_disk_name)
         vtlog "wait_for_usb_disk_ready $usb_disk ..."
@@ -190,23 +197,74 @@ ventoy_check_dm_module() {
     fi
 }
 
+# vtoydm -c creates the device mapper and its /dev/mapper node through ioctl.
+# It comes with the same vtoytool build as vtoyhook. When it works the distro
+# hooks need not install dmsetup from the ISO, the fallbacks use the inbox one.
+ventoy_has_vtoydm_create() {
+    [ -e $VTOY_PATH/tool/vtoyhook ]
+}
+
+# create the ventoy device mapper through ioctl, its dev number is kept in ventoy_dm_devno
+ventoy_create_dm_by_ioctl() {
+    if ! ventoy_has_vtoydm_create; then
+        $BUSYBOX_PATH/false; return
+    fi
+    
+    if [ -s $VTOY_PATH/ventoy_dm_devno ]; then
+        $BUSYBOX_PATH/true; return
+    fi
+    
+    if ventoy_check_dm_module "$1"; then
+        vtlog "device-mapper module check success"
+    else
+        vterr "Error: no dm module avaliable"
+    fi
+    
+    if [ "$2" = "--readonly" ]; then
+        vtHookRO="-r"
+    else
+        vtHookRO=""
+    fi
+    
+    if $VTOY_PATH/tool/vtoyhook -c -d $1 -f $VTOY_PATH/ventoy_image_map -n ventoy $vtHookRO > $VTOY_PATH/ventoy_dm_devno 2>>$VTLOG; then
+        vtlog "vtoyhook create ventoy dm $($CAT $VTOY_PATH/ventoy_dm_devno)"
+        $BUSYBOX_PATH/true; return
+    fi
+    
+    vtlog "vtoyhook create dm failed"
+    $BUSYBOX_PATH/rm -f $VTOY_PATH/ventoy_dm_devno
+    $BUSYBOX_PATH/false
+}
+
+ventoy_image_dm_mode() {
+    if [ -e /vtoy/vtoy ]; then
+        echo ""
+    else
+        echo "--readonly"
+    fi
+}
+
 create_ventoy_device_mapper() {
     vtlog "create_ventoy_device_mapper $*"
     
-    VT_DM_BIN=$(ventoy_find_bin_path dmsetup)
-    if [ -z "$VT_DM_BIN" ]; then
-        vtlog "no dmsetup avaliable, lastly try inbox dmsetup"
-        VT_DM_BIN=$VTOY_PATH/tool/dmsetup
+    if ventoy_create_dm_by_ioctl "$1" "$2"; then
+        $BUSYBOX_PATH/true; return
     fi
     
-    vtlog "dmsetup avaliable in system $VT_DM_BIN"
-        
     if ventoy_check_dm_module "$1"; then
         vtlog "device-mapper module check success"
     else
         vterr "Error: no dm module avaliable"
     fi
     
+    VT_DM_BIN=$(ventoy_find_bin_path dmsetup)
+    if [ -z "$VT_DM_BIN" ]; then
+        vtlog "no dmsetup avaliable, lastly try inbox dmsetup"
+        VT_DM_BIN=$VTOY_PATH/tool/dmsetup
+    fi
+    
+    vtlog "dmsetup avaliable in system $VT_DM_BIN"
+    
     $VTOY_PATH/tool/vtoydm -p -f $VTOY_PATH/ventoy_image_map -d $1 > $VTOY_PATH/ventoy_dm_table        
     if [ -z "$2" ]; then
         $VT_DM_BIN create ventoy $VTOY_PATH/ventoy_dm_table >>$VTLOG 2>&1
@@ -218,6 +276,22 @@ create_ventoy_device_mapper() {
 create_persistent_device_mapper() {
     vtlog "create_persistent_device_mapper $*"
     
+    if ventoy_check_dm_module "$1"; then
+        vtlog "device-mapper module check success"
+    else
+        vterr "Error: no dm module avaliable"
+    fi
+    
+    if ventoy_has_vtoydm_create; then
+        if $VTOY_PATH/tool/vtoydm -c -f $VTOY_PATH/ventoy_persistent_map -d $1 -n vtoy_persistent > $VTOY_PATH/persistent_dm_devno 2>>$VTLOG; then
+            vtlog "vtoydm create vtoy_persistent dm $($CAT $VTOY_PATH/persistent_dm_devno)"
+            $BUSYBOX_PATH/true; return
+        fi
+        
+        vtlog "vtoydm create dm failed, now try dmsetup"
+        $BUSYBOX_PATH/rm -f $VTOY_PATH/persistent_dm_devno
+    fi
+    
     VT_DM_BIN=$(ventoy_find_bin_path dmsetup)
     if [ -z "$VT_DM_BIN" ]; then
         vtlog "no dmsetup avaliable, lastly try inbox dmsetup"
@@ -225,12 +299,6 @@ create_persistent_device_mapper() {
     fi
     
     vtlog "dmsetup avaliable in system $VT_DM_BIN"
-        
-    if ventoy_check_dm_module "$1"; then
-        vtlog "device-mapper module check success"
-    else
-        vterr "Error: no dm module avaliable"
-    fi
     
     $VTOY_PATH/tool/vtoydm -p -f $VTOY_PATH/ventoy_persistent_map -d $1 > $VTOY_PATH/persistent_dm_table        
     $VT_DM_BIN create vtoy_persistent $VTOY_PATH/persistent_dm_table >>$VTLOG 2>&1
@@ -405,6 +473,13 @@ install_rpm_from_line() {
 }
 
 dump_whole_iso_file() {
+    if $VTOY_PATH/tool/vtoydm -x -D -a -f $VTOY_PATH/ventoy_image_map -d $usb_disk -o "$1" >>$VTLOG 2>&1; then
+        return
+    fi
+    
+    vtlog "vtoydm copy iso failed, now try dd"
+    $BUSYBOX_PATH/rm -f "$1"
+    
    $VTOY_PATH/tool/vtoydm -p -f $VTOY_PATH/ventoy_image_map -d $usb_disk | while read vtline; do
         vtlog "dmtable line: $vtline"
         vtcount=$(echo $vtline | $AWK '{print $2}')
@@ -423,6 +498,12 @@ ventoy_copy_device_mapper() {
         vtlog "replace block device $1..."
         $BUSYBOX_PATH/mv "$1" $VTOY_PATH/dev_backup_${1#/dev/}            
         $BUSYBOX_PATH/cp -a "$VTOY_DM_PATH" "$1"
+    elif [ -s $VTOY_PATH/ventoy_dm_devno ]; then
+        vtlog "$VTOY_DM_PATH not exist, use dev number from vtoyhook ..."
+        DM_VT_ID=$($CAT $VTOY_PATH/ventoy_dm_devno)
+        vtlog "DM_VT_ID=$DM_VT_ID ..."
+        $BUSYBOX_PATH/mv "$1" $VTOY_PATH/dev_backup_${1#/dev/}            
+        $BUSYBOX_PATH/mknod -m 0666 "$1" b $DM_VT_ID
     else
     
         vtlog "$VTOY_DM_PATH not exist, now check /dev/dm-X ..."
@@ -441,7 +522,12 @@ ventoy_copy_device_mapper() {
 
 # create link for device-mapper
 ventoy_create_persistent_link() {
-    blkdev_num=$($VTOY_PATH/tool/dmsetup ls | grep vtoy_persistent | sed 's/.*(\([0-9][0-9]*\),.*\([0-9][0-9]*\).*/\1:\2/')  
+    if [ -s $VTOY_PATH/persistent_dm_devno ]; then
+        read vtMajor vtMinor < $VTOY_PATH/persistent_dm_devno
+        blkdev_num="$vtMajor:$vtMinor"
+    else
+        blkdev_num=$($VTOY_PATH/tool/dmsetup ls | grep vtoy_persistent | sed 's/.*(\([0-9][0-9]*\),.*\([0-9][0-9]*\).*/\1:\2/')  
+    fi
     vtDM=$(ventoy_find_dm_id ${blkdev_num})
 
     if ! [ -d /dev/disk/by-label ]; then
@@ -467,11 +553,7 @@ ventoy_udev_disk_common_hook() {
     
     VTDISK="${1:0:-1}"
     
-    if [ -e /vtoy/vtoy ]; then
-        VTRWMOD=""
-    else
-        VTRWMOD="--readonly"
-    fi
+    VTRWMOD=$(ventoy_image_dm_mode)
     
     # create device mapper for iso image file
     if create_ventoy_device_mapper "/dev/$VTDISK" $VTRWMOD; then
@@ -511,7 +593,11 @@ ventoy_udev_disk_common_hook() {
 }
 
 ventoy_create_dev_ventoy_part() {   
-    blkdev_num=$($VTOY_PATH/tool/dmsetup ls | $GREP ventoy | $SED 's/.*(\([0-9][0-9]*\),.*\([0-9][0-9]*\).*/\1 \2/')
+    if [ -s $VTOY_PATH/ventoy_dm_devno ]; then
+        blkdev_num=$($CAT $VTOY_PATH/ventoy_dm_devno)
+    else
+        blkdev_num=$($VTOY_PATH/tool/dmsetup ls | $GREP ventoy | $SED 's/.*(\([0-9][0-9]*\),.*\([0-9][0-9]*\).*/\1 \2/')
+    fi
     $BUSYBOX_PATH/mknod -m 0666 /dev/ventoy b $blkdev_num
     
     if [ -e /vtoy_dm_table ]; then
@@ -519,9 +605,13 @@ ventoy_create_dev_ventoy_part() {
         
         $CAT /vtoy_dm_table | while read vtline; do
             echo $vtline > /ventoy/dm_table_part${vtPartid}
-            $VTOY_PATH/tool/dmsetup create ventoy${vtPartid} /ventoy/dm_table_part${vtPartid}
             
-            blkdev_num=$($VTOY_PATH/tool/dmsetup ls | $GREP ventoy${vtPartid} | $SED 's/.*(\([0-9][0-9]*\),.*\([0-9][0-9]*\).*/\1 \2/')
+            if ventoy_has_vtoydm_create && $VTOY_PATH/tool/vtoydm -c -T /ventoy/dm_table_part${vtPartid} -n ventoy${vtPartid} > $VTOY_PATH/part_dm_devno 2>>$VTLOG; then
+                blkdev_num=$($CAT $VTOY_PATH/part_dm_devno)
+            else
+                $VTOY_PATH/tool/dmsetup create ventoy${vtPartid} /ventoy/dm_table_part${vtPartid}
+                blkdev_num=$($VTOY_PATH/tool/dmsetup ls | $GREP ventoy${vtPartid} | $SED 's/.*(\([0-9][0-9]*\),.*\([0-9][0-9]*\).*/\1 \2/')
+            fi
             $BUSYBOX_PATH/mknod -m 0666 /dev/ventoy${vtPartid} b $blkdev_num
             
             vtPartid=$(expr $vtPartid + 1)
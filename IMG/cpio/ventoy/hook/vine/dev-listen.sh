@@ -34,14 +34,19 @@ vine_wait_for_exist /sys/block
 vine_wait_for_exist /proc/ide
 
 
-while [ -n "Y" ]; do
-    vtdiskname=$(get_ventoy_disk_name)
-    if [ "$vtdiskname" != "unknown" ]; then
-        break
-    else
-        $SLEEP 0.5
-    fi
-done
+vtline=$($VTOY_PATH/tool/vtoydump --wait -f $VTOY_PATH/ventoy_os_param)
+if [ $? -eq 0 ]; then
+    vtdiskname=${vtline%%#*}
+else
+    while [ -n "Y" ]; do
+        vtdiskname=$(get_ventoy_disk_name)
+        if [ "$vtdiskname" != "unknown" ]; then
+            break
+        else
+            $SLEEP 0.5
+        fi
+    done
+fi
 
 vtshortdev=${vtdiskname#/dev/}
 
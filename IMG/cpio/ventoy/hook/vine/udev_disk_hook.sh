@@ -44,7 +44,7 @@ ventoy_os_install_dmsetup_by_rpm() {
     vt_usb_disk=$1
 
     # dump iso file location
-    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} > $VTOY_PATH/iso_file_list
+    $VTOY_PATH/tool/vtoydm -i -f $VTOY_PATH/ventoy_image_map -d ${vt_usb_disk} -m 'kernel-[0-9]*.rpm' > $VTOY_PATH/iso_file_list
 
     # install dmsetup 
     LINE=$($GREP 'kernel-[0-9].*\.rpm'  $VTOY_PATH/iso_file_list)
@@ -310,6 +310,15 @@ ventoy_get_os_type() {
 
 VTOS=$(ventoy_get_os_type)
 echo "OS=###${VTOS}###" >>$VTLOG
+
+#only unpack the hook of the detected OS
+if [ -f "$VTOY_PATH/hookpkg/$VTOS.cpio.xz" ]; then
+    cd $VTOY_PATH
+    $BUSYBOX_PATH/xz -d -c "hookpkg/$VTOS.cpio.xz" | $BUSYBOX_PATH/cpio -idm 2>>$VTLOG
+    cd /
+fi
+$BUSYBOX_PATH/rm -rf $VTOY_PATH/hookpkg
+
 if [ -e "$VTOY_PATH/hook/$VTOS/ventoy-hook.sh" ]; then
     $BUSYBOX_PATH/sh "$VTOY_PATH/hook/$VTOS/ventoy-hook.sh"
 fi
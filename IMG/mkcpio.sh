@@ -38,6 +38,34 @@ rm -rf loop
 xz ventoy_chain.sh
 xz ventoy_loop.sh
 
+# hook.cpio only keeps the common hook library and the default hook.
+# Every distro hook is packed alone in hookpkg/<os>.cpio.xz and only the one
+# matching the detected OS is unpacked at boot time (see ventoy_chain.sh).
+hook_deps() {
+    case $1 in
+        daphile) echo gentoo;;
+    esac
+}
+
+mkdir hookpkg
+for vtos in $(ls -1 hook); do
+    if ! [ -d hook/$vtos ] || [ "$vtos" = "default" ]; then
+        continue
+    fi
+    
+    vtdirs="./hook/$vtos"
+    for vtdep in $(hook_deps $vtos); do
+        vtdirs="$vtdirs ./hook/$vtdep"
+    done
+    
+    find $vtdirs | cpio  -o -H newc>hookpkg/$vtos.cpio
+    xz hookpkg/$vtos.cpio
+done
+
+for vtos in $(ls -1 hookpkg); do
+    rm -rf hook/${vtos%.cpio.xz}
+done
+
 find ./hook | cpio  -o -H newc>hook.cpio
 xz hook.cpio
 rm -rf hook
@@ -3,13 +3,16 @@
 size=1024
 fstype=ext4
 label=casper-rw
+imgfile=persistence.dat
 
 print_usage() {
-    echo 'Usage:  CreatePersistentImg.sh [ -s size ] [ -t fstype ] [ -l LABEL ]'
+    echo 'Usage:  CreatePersistentImg.sh [ -s size ] [ -t fstype ] [ -l LABEL ] [ -o FILE ] [ -r ]'
     echo '  OPTION: (optional)'
     echo '   -s size in MB, default is 1024'
     echo '   -t filesystem type, default is ext4  ext2/ext3/ext4/xfs are supported now'
     echo '   -l label, default is casper-rw'
+    echo '   -o image file, default is persistence.dat'
+    echo '   -r resize an existing ext2/ext3/ext4 image file to the size, the data in it will be kept'
     echo ''
 }
 
@@ -23,6 +26,11 @@ while [ -n "$1" ]; do
     elif [ "$1" = "-l" ]; then
         shift
         label=$1
+    elif [ "$1" = "-o" ]; then
+        shift
+        imgfile=$1
+    elif [ "$1" = "-r" ]; then
+        resize=1
     else
         print_usage
         exit 1
@@ -61,17 +69,76 @@ else
     exit 1
 fi
 
-# 00->ff avoid sparse file
-dd if=/dev/zero  bs=1M count=$size | tr '\000' '\377' > persistence.dat
-sync
+if uname -a | egrep -q 'x86_64|amd64'; then
+    vtoypersist=$(dirname $0)/tool/vtoypersist_64
+else
+    vtoypersist=$(dirname $0)/tool/vtoypersist_32
+fi
+
+# tools are xz compressed in the release package
+if ! [ -f $vtoypersist ] && [ -f $vtoypersist.xz ] && [ -f $(dirname $0)/tool/xzcat ]; then
+    chmod +x $(dirname $0)/tool/xzcat
+    if $(dirname $0)/tool/xzcat $vtoypersist.xz > $vtoypersist; then
+        chmod +x $vtoypersist
+    else
+        rm -f $vtoypersist
+    fi
+fi
+
+if ! [ -f $vtoypersist ]; then
+    vtoypersist=''
+fi
+
+if [ -n "$resize" ]; then
+    if ! [ -f $imgfile ]; then
+        echo "$imgfile does not exist"
+        exit 1
+    fi
+    
+    if ! echo $fstype | grep -q '^ext[234]$'; then
+        echo "resize is only supported for ext2/ext3/ext4"
+        exit 1
+    fi
+    
+    if [ -z "$vtoypersist" ]; then
+        echo "vtoypersist is not found, resize is not supported"
+        exit 1
+    fi
 
-freeloop=$(losetup -f)
+    cursize=$(expr $(stat -c %s $imgfile) / 1048576)
+    
+    e2fsck -f -y $imgfile || exit 1
+    
+    if [ $size -lt $cursize ]; then
+        # shrink the filesystem first, then the file
+        resize2fs $imgfile ${size}M || exit 1
+        $vtoypersist -s $size $imgfile || exit 1
+    else
+        # grow the file first (only the new part is filled), then the filesystem
+        $vtoypersist -s $size $imgfile || exit 1
+        resize2fs $imgfile ${size}M || exit 1
+    fi
+    
+    sync
+    exit 0
+fi
 
-losetup $freeloop persistence.dat
+if [ -n "$vtoypersist" ]; then
+    # preallocate and fill with 0xff (avoid sparse file) by large writes
+    rm -f $imgfile
+    $vtoypersist -s $size $imgfile || exit 1
+else
+    # 00->ff avoid sparse file
+    dd if=/dev/zero  bs=1M count=$size | tr '\000' '\377' > $imgfile
+    sync
+fi
+
+# mkfs works on the image file directly, no loop device is needed
+if echo $fstype | grep -q '^ext[234]$'; then
+    fsopt="$fsopt -F"
+fi
 
-mkfs -t $fstype $fsopt -L $label $freeloop 
+mkfs -t $fstype $fsopt -L $label $imgfile
 
 sync
 
-losetup -d $freeloop
-
@@ -26,6 +26,12 @@ sh build.sh || exit 1
 cd $VTOY_PATH/vtoygpt
 sh build.sh || exit 1
 
+cd $VTOY_PATH/vtoyinstall
+sh build.sh || exit 1
+
+cd $VTOY_PATH/vtoypersist
+sh build.sh || exit 1
+
 cd $VTOY_PATH/ExFAT
 sh buidlibfuse.sh || exit 1
 sh buidexfat.sh || exit 1
@@ -208,7 +208,7 @@ if [ "$MODE" = "install" ]; then
         exit 1
     fi
 
-    if ! dd if=/dev/zero of=$DISK bs=1 count=512 status=none conv=fsync; then
+    if ! dd if=/dev/zero of=$DISK bs=512 count=1 status=none conv=fsync; then
         vterr "Write data to $DISK failed, please check whether it's in use."
         exit 1
     fi
@@ -244,23 +244,31 @@ if [ "$MODE" = "install" ]; then
 
     vtinfo "writing data to disk ..."
     
-    dd status=none conv=fsync if=./boot/boot.img of=$DISK bs=1 count=446
-    
     if [ -n "$VTGPT" ]; then
-        echo -en '\x22' | dd status=none of=$DISK conv=fsync bs=1 count=1 seek=92        
-        ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2014 seek=34
-        echo -en '\x23' | dd of=$DISK conv=fsync bs=1 count=1 seek=17908 status=none
-    else
-        ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2047 seek=1
+        VTINSTOPT="-g"
     fi
     
-    ./tool/xzcat ./ventoy/ventoy.disk.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=$VENTOY_SECTOR_NUM seek=$part2_start_sector
-    
-    #disk uuid
-    ./tool/vtoy_gen_uuid | dd status=none conv=fsync of=${DISK} seek=384 bs=1 count=16
-    
-    #disk signature
-    ./tool/vtoy_gen_uuid | dd status=none conv=fsync of=${DISK} skip=12 seek=440 bs=1 count=4
+    if ventoy_write_disk_data -i -s $part2_start_sector $VTINSTOPT $DISK; then
+        vtdebug "write data by vtoyinstall success"
+    else
+        dd status=none conv=fsync if=./boot/boot.img of=$DISK bs=1 count=446
+        
+        if [ -n "$VTGPT" ]; then
+            echo -en '\x22' | dd status=none of=$DISK conv=fsync bs=1 count=1 seek=92        
+            ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2014 seek=34
+            echo -en '\x23' | dd of=$DISK conv=fsync bs=1 count=1 seek=17908 status=none
+        else
+            ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2047 seek=1
+        fi
+        
+        ./tool/xzcat ./ventoy/ventoy.disk.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=$VENTOY_SECTOR_NUM seek=$part2_start_sector
+        
+        #disk uuid
+        ./tool/vtoy_gen_uuid | dd status=none conv=fsync of=${DISK} seek=384 bs=1 count=16
+        
+        #disk signature
+        ./tool/vtoy_gen_uuid | dd status=none conv=fsync of=${DISK} skip=12 seek=440 bs=1 count=4
+    fi
 
     vtinfo "sync data ..."
     sync
@@ -332,29 +340,33 @@ else
     SHORT_PART2=${PART2#/dev/}
     part2_start=$(cat /sys/class/block/$SHORT_PART2/start)
     
-    PART1_TYPE=$(dd if=$DISK bs=1 count=1 skip=450 status=none | ./tool/hexdump -n1 -e  '1/1 "%02X"')
-    
-    if [ "$PART1_TYPE" = "EE" ]; then
-        vtdebug "This is GPT partition style ..."        
-        ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2014 seek=34
-        echo -en '\x23' | dd of=$DISK conv=fsync bs=1 count=1 seek=17908 status=none
+    if ventoy_write_disk_data -u -s $part2_start $DISK; then
+        vtdebug "update data by vtoyinstall success"
     else
-        vtdebug "This is MBR partition style ..."
-        dd status=none conv=fsync if=./boot/boot.img of=$DISK bs=1 count=440
+        PART1_TYPE=$(dd if=$DISK bs=1 count=1 skip=450 status=none | ./tool/hexdump -n1 -e  '1/1 "%02X"')
     
-        PART1_ACTIVE=$(dd if=$DISK bs=1 count=1 skip=446 status=none | ./tool/hexdump -n1 -e  '1/1 "%02X"')
-        PART2_ACTIVE=$(dd if=$DISK bs=1 count=1 skip=462 status=none | ./tool/hexdump -n1 -e  '1/1 "%02X"')
+        if [ "$PART1_TYPE" = "EE" ]; then
+            vtdebug "This is GPT partition style ..."        
+            ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2014 seek=34
+            echo -en '\x23' | dd of=$DISK conv=fsync bs=1 count=1 seek=17908 status=none
+        else
+            vtdebug "This is MBR partition style ..."
+            dd status=none conv=fsync if=./boot/boot.img of=$DISK bs=1 count=440
+    
+            PART1_ACTIVE=$(dd if=$DISK bs=1 count=1 skip=446 status=none | ./tool/hexdump -n1 -e  '1/1 "%02X"')
+            PART2_ACTIVE=$(dd if=$DISK bs=1 count=1 skip=462 status=none | ./tool/hexdump -n1 -e  '1/1 "%02X"')
         
-        vtdebug "PART1_ACTIVE=$PART1_ACTIVE  PART2_ACTIVE=$PART2_ACTIVE"
-        if [ "$PART1_ACTIVE" = "00" ] && [ "$PART2_ACTIVE" = "80" ]; then
-            vtdebug "change 1st partition active, 2nd partition inactive ..."
-            echo -en '\x80' | dd of=$DISK conv=fsync bs=1 count=1 seek=446 status=none
-            echo -en '\x00' | dd of=$DISK conv=fsync bs=1 count=1 seek=462 status=none
+            vtdebug "PART1_ACTIVE=$PART1_ACTIVE  PART2_ACTIVE=$PART2_ACTIVE"
+            if [ "$PART1_ACTIVE" = "00" ] && [ "$PART2_ACTIVE" = "80" ]; then
+                vtdebug "change 1st partition active, 2nd partition inactive ..."
+                echo -en '\x80' | dd of=$DISK conv=fsync bs=1 count=1 seek=446 status=none
+                echo -en '\x00' | dd of=$DISK conv=fsync bs=1 count=1 seek=462 status=none
+            fi
+            ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2047 seek=1
         fi
-        ./tool/xzcat ./boot/core.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=2047 seek=1
-    fi
 
-    ./tool/xzcat ./ventoy/ventoy.disk.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=$VENTOY_SECTOR_NUM seek=$part2_start
+        ./tool/xzcat ./ventoy/ventoy.disk.img.xz | dd status=none conv=fsync of=$DISK bs=512 count=$VENTOY_SECTOR_NUM seek=$part2_start
+    fi
 
     sync
     
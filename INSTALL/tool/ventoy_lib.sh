@@ -81,6 +81,32 @@ check_tool_work_ok() {
 }
 
 
+#write boot.img, core.img and ventoy.disk.img to the disk in one process (one open and one fsync)
+#usage: ventoy_write_disk_data -i|-u -s part2_start [-g] /dev/sdX
+ventoy_write_disk_data() {
+    if ventoy_is_linux64; then
+        vtoyinstall=./tool/vtoyinstall_64
+    else
+        vtoyinstall=./tool/vtoyinstall_32
+    fi
+
+    if ! [ -f $vtoyinstall ]; then
+        vtdebug "$vtoyinstall not found, use dd ..."
+        ventoy_false
+        return
+    fi
+
+    vtdebug "$vtoyinstall $* ..."
+    if $vtoyinstall -n $VENTOY_SECTOR_NUM -b ./boot/boot.img -c ./boot/core.img.xz -e ./ventoy/ventoy.disk.img.xz -x ./tool/xzcat "$@" >>./log.txt 2>&1; then
+        vtdebug "$vtoyinstall success"
+        ventoy_true
+    else
+        vtdebug "$vtoyinstall failed, use dd ..."
+        ventoy_false
+    fi
+}
+
+
 get_disk_part_name() {
     DISK=$1
     
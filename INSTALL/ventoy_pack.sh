@@ -75,7 +75,8 @@ mkdir -p $tmpdir/ventoy
 echo $curver > $tmpdir/ventoy/version
 dd if=$LOOP of=$tmpdir/boot/boot.img bs=1 count=512  status=none
 dd if=$LOOP of=$tmpdir/boot/core.img bs=512 count=2047 skip=1 status=none
-xz --check=crc32 $tmpdir/boot/core.img
+#independent xz blocks, so the installers can decode them in parallel (vtoyxz.c)
+xz --check=crc32 --block-size=256KiB $tmpdir/boot/core.img
 
 cp -a ./tool $tmpdir/
 rm -f $tmpdir/ENROLL_THIS_KEY_IN_MOKMANAGER.cer
@@ -88,7 +89,9 @@ dos2unix -q $tmpdir/CreatePersistentImg.sh
 
 #32MB disk img
 dd status=none if=$LOOP of=$tmpdir/ventoy/ventoy.disk.img bs=512 count=$VENTOY_SECTOR_NUM skip=$part2_start_sector
-xz --check=crc32 $tmpdir/ventoy/ventoy.disk.img
+#independent 256KB xz blocks, so grub can decode only the blocks it reads (vt_xz_disk)
+#and the installers can decode them in parallel (vtoyxz.c)
+xz --check=crc32 --block-size=256KiB --lzma2=preset=6,dict=256KiB $tmpdir/ventoy/ventoy.disk.img
 
 losetup -d $LOOP && rm -f img.bin
 
@@ -9,6 +9,9 @@ rm -rf ./ipxe-3fe683e/src/drivers
 
 /bin/cp -a ipxe_mod_code/ipxe-3fe683e ./
 
+/bin/cp -a ../vtoychain/vtoychain.h ./ipxe-3fe683e/src/include/
+/bin/cp -a ../vtoychain/vtoychain.c ./ipxe-3fe683e/src/arch/x86/core/
+
 cd ipxe-3fe683e/src
 
 sh build.sh
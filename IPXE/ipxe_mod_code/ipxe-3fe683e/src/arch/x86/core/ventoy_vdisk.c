@@ -31,7 +31,6 @@ size_t g_initrd_len;
 ventoy_chain_head *g_chain;
 ventoy_img_chunk *g_chunk;
 uint32_t g_img_chunk_num;
-ventoy_img_chunk *g_cur_chunk;
 uint32_t g_disk_sector_size;
 uint8_t *g_os_param_reserved;
 
@@ -42,7 +41,7 @@ uint32_t g_override_chunk_num;
 ventoy_virt_chunk *g_virt_chunk;
 uint32_t g_virt_chunk_num;
 
-ventoy_sector_flag g_sector_flag[128];
+vtoy_chain g_vchain;
 
 #define VENTOY_ISO9660_SECTOR_OVERFLOW  2097152
 
@@ -55,59 +54,34 @@ uint64  g_fixup_iso9660_secover_tot_secs = 0;
 static struct int13_disk_address __bss16 ( ventoy_address );
 #define ventoy_address __use_data16 ( ventoy_address )
 
-static uint64_t ventoy_remap_lba(uint64_t lba, uint32_t *count)
+static void ventoy_override_hook(void *ctx, const ventoy_override_chunk *node)
 {
-    uint32_t i;
-    uint32_t max_sectors;
-    ventoy_img_chunk *cur;
+    ventoy_iso9660_override *dirent;
 
-    if ((NULL == g_cur_chunk) || ((lba) < g_cur_chunk->img_start_sector) || ((lba) > g_cur_chunk->img_end_sector))
-    {
-        g_cur_chunk = NULL;
-        for (i = 0; i < g_img_chunk_num; i++)
-        {
-            cur = g_chunk + i;
-            if (lba >= cur->img_start_sector && lba <= cur->img_end_sector)
-            {
-                g_cur_chunk = cur;
-                break;
-            }
-        }
-    }
+    (void)ctx;
 
-    if (g_cur_chunk)
+    if (g_fixup_iso9660_secover_enable && (!g_fixup_iso9660_secover_start) && 
+        node->override_size == sizeof(ventoy_iso9660_override))
     {
-        max_sectors = g_cur_chunk->img_end_sector - lba + 1;
-        if (*count > max_sectors)
+        dirent = (ventoy_iso9660_override *)node->override_data;
+        if (dirent->first_sector >= VENTOY_ISO9660_SECTOR_OVERFLOW)
         {
-            *count = max_sectors;
+            g_fixup_iso9660_secover_start = 1;
+            g_fixup_iso9660_secover_cur_secs = 0;
         }
-
-        if (512 == g_disk_sector_size)
-        {
-            return g_cur_chunk->disk_start_sector + ((lba - g_cur_chunk->img_start_sector) << 2);            
-        }
-        return g_cur_chunk->disk_start_sector + (lba - g_cur_chunk->img_start_sector) * 2048 / g_disk_sector_size;
     }
-    return lba;
 }
 
 static int ventoy_vdisk_read_real(uint64_t lba, unsigned int count, unsigned long buffer)
 {
-    uint32_t i = 0;
     uint32_t left = 0;
     uint32_t readcount = 0;
     uint32_t tmpcount = 0;
     uint16_t status = 0;
     uint64_t curlba = 0;
     uint64_t maplba = 0;
-    uint64_t start = 0;
-    uint64_t end = 0;
-    uint64_t override_start = 0;
-    uint64_t override_end = 0;
     unsigned long phyaddr;
     unsigned long databuffer = buffer;
-    uint8_t *override_data;
 
     curlba = lba;
     left = count;
@@ -115,7 +89,10 @@ static int ventoy_vdisk_read_real(uint64_t lba, unsigned int count, unsigned lon
     while (left > 0)
     {
         readcount = left;
-        maplba = ventoy_remap_lba(curlba, &readcount);
+        if (vtoy_chain_map(&g_vchain, curlba, &readcount, &maplba))
+        {
+            maplba = curlba;
+        }
         
         if (g_disk_sector_size == 512)
         {
@@ -165,64 +142,17 @@ static int ventoy_vdisk_read_real(uint64_t lba, unsigned int count, unsigned lon
         buffer += (readcount * 2048);
     }
 
-    start = lba * 2048;
-    if (start > g_chain->real_img_size_in_bytes)
-    {
-        goto end;
-    }
-
-    end = start + count * 2048;
-    for (i = 0; i < g_override_chunk_num; i++)
-    {
-        override_data = g_override_chunk[i].override_data;
-        override_start = g_override_chunk[i].img_offset;
-        override_end = override_start + g_override_chunk[i].override_size;
-
-        if (end <= override_start || start >= override_end)
-        {
-            continue;
-        }
-
-        if (start <= override_start)
-        {
-            if (end <= override_end)
-            {
-                memcpy((char *)databuffer + override_start - start, override_data, end - override_start);  
-            }
-            else
-            {
-                memcpy((char *)databuffer + override_start - start, override_data, override_end - override_start);
-            }
-        }
-        else
-        {
-            if (end <= override_end)
-            {
-                memcpy((char *)databuffer, override_data + start - override_start, end - start);     
-            }
-            else
-            {
-                memcpy((char *)databuffer, override_data + start - override_start, override_end - start);
-            }
-        }
-
-        if (g_fixup_iso9660_secover_enable && (!g_fixup_iso9660_secover_start) && 
-            g_override_chunk[i].override_size == sizeof(ventoy_iso9660_override))
-        {
-            ventoy_iso9660_override *dirent = (ventoy_iso9660_override *)override_data;
-            if (dirent->first_sector >= VENTOY_ISO9660_SECTOR_OVERFLOW)
-            {
-                g_fixup_iso9660_secover_start = 1;
-                g_fixup_iso9660_secover_cur_secs = 0;
-            }
-        }
-    }
-
-end:
+    vtoy_chain_override(&g_vchain, lba, count, (void *)databuffer, ventoy_override_hook, NULL);
 
     return 0;
 }
 
+static int ventoy_vdisk_read_remap(void *ctx, uint64_t lba, uint32_t count, uint8_t *buf)
+{
+    (void)ctx;
+    return ventoy_vdisk_read_real(lba, count, (unsigned long)buf);
+}
+
 uint64_t ventoy_fixup_iso9660_sector(uint64_t Lba, uint32_t secNum)
 {
     uint32_t i = 0;
@@ -278,15 +208,7 @@ end:
 
 int ventoy_vdisk_read(struct san_device *sandev, uint64_t lba, unsigned int count, unsigned long buffer)
 {
-    uint32_t i, j;
-    uint64_t curlba;
-    uint64_t lastlba = 0;
-    uint32_t lbacount = 0;
-    unsigned long lastbuffer;
     uint64_t readend;
-    ventoy_virt_chunk *node;
-    ventoy_sector_flag *cur_flag;
-    ventoy_sector_flag *sector_flag = g_sector_flag;
     struct i386_all_regs *ix86;
 
     if (INT13_EXTENDED_READ != sandev->int13_command)
@@ -311,66 +233,7 @@ int ventoy_vdisk_read(struct san_device *sandev, uint64_t lba, unsigned int coun
         return 0;
     }
 
-    if (count > sizeof(g_sector_flag))
-    {
-        sector_flag = (ventoy_sector_flag *)malloc(count * sizeof(ventoy_sector_flag));
-    }
-
-    for (curlba = lba, cur_flag = sector_flag, j = 0; j < count; j++, curlba++, cur_flag++)
-    {
-        cur_flag->flag = 0;
-        for (node = g_virt_chunk, i = 0; i < g_virt_chunk_num; i++, node++)
-        {
-            if (curlba >= node->mem_sector_start && curlba < node->mem_sector_end)
-            {
-                memcpy((void *)(buffer + j * 2048), 
-                       (char *)g_virt_chunk + node->mem_sector_offset + (curlba - node->mem_sector_start) * 2048,
-                       2048);
-                cur_flag->flag = 1;
-                break;
-            }
-            else if (curlba >= node->remap_sector_start && curlba < node->remap_sector_end)
-            {
-                cur_flag->remap_lba = node->org_sector_start + curlba - node->remap_sector_start;
-                cur_flag->flag = 2;
-                break;
-            }
-        }
-    }
-
-    for (curlba = lba, cur_flag = sector_flag, j = 0; j < count; j++, curlba++, cur_flag++)
-    {
-        if (cur_flag->flag == 2)
-        {
-            if (lastlba == 0)
-            {
-                lastbuffer = buffer + j * 2048;
-                lastlba = cur_flag->remap_lba;
-                lbacount = 1;
-            }
-            else if (lastlba + lbacount == cur_flag->remap_lba)
-            {
-                lbacount++;
-            }
-            else
-            {
-                ventoy_vdisk_read_real(lastlba, lbacount, lastbuffer);
-                lastbuffer = buffer + j * 2048;
-                lastlba = cur_flag->remap_lba;
-                lbacount = 1;
-            }
-        }
-    }
-
-    if (lbacount > 0)
-    {
-        ventoy_vdisk_read_real(lastlba, lbacount, lastbuffer);
-    }
-
-    if (sector_flag != g_sector_flag)
-    {
-        free(sector_flag);
-    }
+    vtoy_chain_virt_read(&g_vchain, lba, count, (void *)buffer, ventoy_vdisk_read_remap, NULL);
 
     ix86->regs.dl = sandev->drive;
     return 0;
@@ -569,7 +432,6 @@ int ventoy_boot_vdisk(void *data)
     g_chunk = (ventoy_img_chunk *)((char *)g_chain + g_chain->img_chunk_offset);
     g_img_chunk_num = g_chain->img_chunk_num;
     g_disk_sector_size = g_chain->disk_sector_size;
-    g_cur_chunk = g_chunk;
 
     g_os_param_reserved = (uint8_t *)(g_chain->os_param.vtoy_reserved);
 
@@ -585,6 +447,11 @@ int ventoy_boot_vdisk(void *data)
     g_virt_chunk = (ventoy_virt_chunk *)((char *)g_chain + g_chain->virt_chunk_offset);
     g_virt_chunk_num = g_chain->virt_chunk_num;
 
+    if (vtoy_chain_init_head(&g_vchain, g_chain, g_initrd_len))
+    {
+        printf("invalid chunk table in chain head\n");
+    }
+
     if (g_debug)
     {
         for (i = 0; i < sizeof(ventoy_os_param); i++)
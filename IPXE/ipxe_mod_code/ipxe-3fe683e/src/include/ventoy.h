@@ -4,6 +4,8 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <vtoychain.h>
+
 #define grub_uint64_t  uint64_t
 #define grub_uint32_t  uint32_t
 #define grub_uint16_t  uint16_t
@@ -133,35 +135,6 @@ typedef struct ventoy_chain_head
     grub_uint32_t virt_chunk_num;
 }ventoy_chain_head;
 
-
-typedef struct ventoy_img_chunk
-{
-    grub_uint32_t img_start_sector; //2KB
-    grub_uint32_t img_end_sector;
-
-    grub_uint64_t disk_start_sector; // in disk_sector_size
-    grub_uint64_t disk_end_sector;
-}ventoy_img_chunk;
-
-
-typedef struct ventoy_override_chunk
-{
-    grub_uint64_t img_offset;
-    grub_uint32_t override_size;
-    grub_uint8_t  override_data[512];
-}ventoy_override_chunk;
-
-typedef struct ventoy_virt_chunk
-{
-    grub_uint32_t mem_sector_start;
-    grub_uint32_t mem_sector_end;
-    grub_uint32_t mem_sector_offset;
-    grub_uint32_t remap_sector_start;
-    grub_uint32_t remap_sector_end;
-    grub_uint32_t org_sector_start;
-}ventoy_virt_chunk;
-
-
 #pragma pack()
 
 
@@ -172,12 +145,6 @@ typedef struct ventoy_virt_chunk
     printf("\n");\
 }
 
-typedef struct ventoy_sector_flag
-{
-    uint8_t flag; // 0:init   1:mem  2:remap
-    uint64_t remap_lba;    
-}ventoy_sector_flag;
-
 #define VENTOY_BIOS_FAKE_DRIVE  0xFE
 #define VENTOY_BOOT_FIXBIN_DRIVE  0xFD
 
@@ -11,6 +11,7 @@
 #include <netinet/in.h>
 #include "dat.h"
 #include "fns.h"
+#include "vtoychain.h"
 
 enum {
 	Nmasks= 32,
@@ -22,8 +23,6 @@ uchar masks[Nmasks*Alen];
 int nmasks;
 uchar srr[Nsrr*Alen];
 int nsrr;
-char config[Nconfig];
-int nconfig = 0;
 int maxscnt = 2;
 char *ifname;
 int bufcnt = Bufcount;
@@ -32,174 +31,131 @@ int bufcnt = Bufcount;
 #define O_BINARY 0
 #endif
 
-typedef unsigned long long u64_t;
-typedef unsigned int    u32_t;
-
-#pragma pack(4)
-typedef struct ventoy_img_chunk
-{
-    u32_t img_start_sector; // sector size: 2KB
-    u32_t img_end_sector;   // included
-
-    u64_t disk_start_sector; // in disk_sector_size
-    u64_t disk_end_sector;   // included
-}ventoy_img_chunk;
+enum {
+	Ndisks= Ntargets,
+	Cachemb= 32,	// default cache size
+};
 
-typedef struct ventoy_disk_map
+// a block file, opened once for all the targets on it
+typedef struct Disk Disk;
+struct Disk
 {
-    u64_t img_start_sector;
-    u64_t img_end_sector;
-    u64_t disk_start_sector;
-    u64_t disk_end_sector;
-}ventoy_disk_map;
-#pragma pack()
+	char	*name;
+	dev_t	dev;
+	ino_t	ino;
+	int	fd;
+};
 
 static int verbose = 0;
-static u64_t g_iso_file_size = 0;
-static int g_img_map_num = 0;
-static ventoy_disk_map *g_img_map = NULL;
-
-static ventoy_disk_map * vtoydm_get_img_map_data(const char *img_map_file, int *plen)
-{
-    int i;
-    int len;
-    int rc = 1;
-    u64_t sector_num;
-    FILE *fp = NULL;
-    ventoy_img_chunk *chunk = NULL;
-    ventoy_disk_map *map = NULL;
-    
-    fp = fopen(img_map_file, "rb");
-    if (NULL == fp)
-    {
-        fprintf(stderr, "Failed to open file %s\n", img_map_file);
-        return NULL;
-    }
-
-    fseek(fp, 0, SEEK_END);
-    len = (int)ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+static Disk disks[Ndisks];
+static int ndisks;
 
-    chunk = (ventoy_img_chunk *)malloc(len);
-    if (NULL == chunk)
-    {
-        fprintf(stderr, "Failed to malloc memory len:%d\n", len);
-        goto end;
-    }
-
-    if (fread(chunk, 1, len, fp) != len)
-    {
-        fprintf(stderr, "Failed to read file\n");
-        goto end;
-    }
-
-    if (len % sizeof(ventoy_img_chunk))
-    {
-        fprintf(stderr, "image map file size %d is not aligned with %d\n", 
-                len, (int)sizeof(ventoy_img_chunk));
-        goto end;
-    }
-
-    map = (ventoy_disk_map *)malloc((len / sizeof(ventoy_img_chunk)) * sizeof(ventoy_disk_map));
-    if (NULL == map)
-    {
-        fprintf(stderr, "Failed to malloc memory\n");
-        goto end;
-    }
-    
-    for (i = 0; i < len / sizeof(ventoy_img_chunk); i++)
-    {
-        sector_num = chunk[i].img_end_sector - chunk[i].img_start_sector + 1;
-        g_iso_file_size += sector_num * 2048;
-        
-        map[i].img_start_sector = chunk[i].img_start_sector << 2;
-        map[i].img_end_sector = (chunk[i].img_end_sector << 2) + 3;
-        map[i].disk_start_sector = chunk[i].disk_start_sector;
-        map[i].disk_end_sector = chunk[i].disk_end_sector;
-    }
-
-    rc = 0;
-end:
-    fclose(fp);
-
-    if (chunk)
-    {
-        free(chunk);
-        chunk = NULL;
-    }
-
-    *plen = len;
-    return map;
-}
-
-static void parse_img_chunk(const char *img_map_file)
+static int
+opendisk(char *name, int omode)
 {
-    int len;
+	struct stat st;
+	Disk *d;
+	int i;
 
-    g_img_map = vtoydm_get_img_map_data(img_map_file, &len);
-    if (g_img_map)
-    {
-        g_img_map_num = len / sizeof(ventoy_img_chunk);
-    }
+	if (stat(name, &st) < 0) {
+		perror(name);
+		exit(1);
+	}
+	for (i = 0; i < ndisks; i++)
+		if (disks[i].dev == st.st_dev && disks[i].ino == st.st_ino)
+			return i;
+	if (ndisks >= Ndisks) {
+		fprintf(stderr, "too many block files\n");
+		exit(1);
+	}
+	d = &disks[ndisks];
+	d->fd = open(name, omode);
+	if (d->fd == -1) {
+		perror("open");
+		exit(1);
+	}
+	d->name = strdup(name);
+	d->dev = st.st_dev;
+	d->ino = st.st_ino;
+	return ndisks++;
 }
 
-static u64_t get_disk_sector(u64_t lba)
+// load the ventoy image map, return the image size in sectors
+static vlong
+loadmap(Target *t, char *file)
 {
-    int i;
-    ventoy_disk_map *cur = g_img_map;
-    
-    for (i = 0; i < g_img_map_num; i++, cur++)
-    {
-        if (lba >= cur->img_start_sector && lba <= cur->img_end_sector)
-        {
-            return (lba - cur->img_start_sector) + cur->disk_start_sector;
-        }
-    }
+	FILE *fp;
+	ventoy_img_chunk *chunk;
+	long len;
+	int i, n;
+	vlong isosize;
 
-    return 0;
+	fp = fopen(file, "rb");
+	if (fp == nil) {
+		fprintf(stderr, "Failed to open file %s\n", file);
+		exit(1);
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (len <= 0 || len % sizeof(ventoy_img_chunk)) {
+		fprintf(stderr, "image map file size %ld is not aligned with %d\n",
+			len, (int)sizeof(ventoy_img_chunk));
+		exit(1);
+	}
+	chunk = malloc(len);
+	t->chain = malloc(sizeof *t->chain);
+	if (chunk == nil || t->chain == nil) {
+		perror("malloc");
+		exit(1);
+	}
+	if (fread(chunk, 1, len, fp) != len) {
+		fprintf(stderr, "Failed to read file %s\n", file);
+		exit(1);
+	}
+	fclose(fp);
+
+	n = len / sizeof(ventoy_img_chunk);
+	isosize = 0;
+	for (i = 0; i < n; i++)
+		isosize += (vlong)(chunk[i].img_end_sector - chunk[i].img_start_sector + 1) * 2048;
+	vtoy_chain_init(t->chain, chunk, len, 0, n, 0, 0, 0, 0, isosize, 512);
+	return isosize / 512;
 }
 
-int getsec(int fd, uchar *place, vlong lba, int nsec)
+// read nsec sectors of the target at lba, the holes in the image map read as zero
+int
+readsec(Target *t, uchar *place, vlong lba, int nsec)
 {
-    int i;
-    int count = 0;
-    u64_t last_sector;
-    u64_t sector;
-
-    count = 1;
-    last_sector = get_disk_sector((u64_t)lba);
-    
-    for (i = 1; i < nsec; i++)
-    {
-        sector = get_disk_sector((u64_t)(lba + i));
-        if (sector == (last_sector + count))
-        {
-            count++;
-        }
-        else
-        {
-            lseek(fd, last_sector * 512, SEEK_SET);
-            read(fd, place, count * 512);
-
-            last_sector = sector;
-            count = 1;
-        }
-    }
-
-    lseek(fd, last_sector * 512, SEEK_SET);
-    read(fd, place, count * 512);
-
+	vtoy_u32 count;
+	vtoy_u64 dsec;
+	int done, n;
+
+	for (done = 0; done < nsec; done += count) {
+		count = nsec - done;
+		if (t->chain == nil)
+			dsec = lba + done;
+		else if (vtoy_chain_map_512(t->chain, lba + done, &count, &dsec)) {
+			memset(place + done*512, 0, count*512);
+			continue;
+		}
+		n = cacheread(t->disk, disks[t->disk].fd, place + done*512, (vlong)dsec*512, count*512);
+		if (n != count*512)
+			return n < 0 ? -1 : done*512 + n;
+	}
 	return nsec * 512;
 }
+
 // read only
-int putsec(int fd, uchar *place, vlong lba, int nsec)
+int
+writesec(Target *t, uchar *place, vlong lba, int nsec)
 {
-    return nsec * 512;
+	return nsec * 512;
 }
 
 
 void
-aoead(int fd)	// advertise the virtual blade
+aoead(Target *t, int fd)	// advertise the virtual blade
 {
 	uchar buf[2000];
 	Conf *p;
@@ -211,23 +167,23 @@ aoead(int fd)	// advertise the virtual blade
 	memmove(p->h.src, mac, 6);
 	p->h.type = htons(0x88a2);
 	p->h.flags = Resp;
-	p->h.maj = htons(shelf);
-	p->h.min = slot;
+	p->h.maj = htons(t->shelf);
+	p->h.min = t->slot;
 	p->h.cmd = Config;
 	p->bufcnt = htons(bufcnt);
 	p->scnt = maxscnt = (getmtu(sfd, ifname) - sizeof (Ata)) / 512;
 	p->firmware = htons(FWV);
 	p->vercmd = 0x10 | Qread;
-	memcpy(p->data, config, nconfig);
-	p->len = htons(nconfig);
+	memcpy(p->data, t->config, t->nconfig);
+	p->len = htons(t->nconfig);
 	if (nmasks == 0)
-	if (putpkt(fd, buf, sizeof *p - sizeof p->data + nconfig) == -1) {
+	if (putpkt(fd, buf, sizeof *p - sizeof p->data + t->nconfig) == -1) {
 		perror("putpkt aoe id");
 		return;
 	}
 	for (i=0; i<nmasks; i++) {
 		memcpy(p->h.dst, &masks[i*Alen], Alen);
-		if (putpkt(fd, buf, sizeof *p - sizeof p->data + nconfig) == -1)
+		if (putpkt(fd, buf, sizeof *p - sizeof p->data + t->nconfig) == -1)
 			perror("putpkt aoe id");
 	}
 }
@@ -253,7 +209,7 @@ getlba(uchar *p)
 }
 
 int
-aoeata(Ata *p, int pktlen)	// do ATA reqeust
+aoeata(Target *t, Ata *p, int pktlen)	// do ATA reqeust
 {
 	Ataregs r;
 	int len = 60;
@@ -269,7 +225,7 @@ aoeata(Ata *p, int pktlen)	// do ATA reqeust
 		p->h.error = Res;
 		return len;
 	}
-	if (atacmd(&r, (uchar *)(p+1), maxscnt*512, pktlen - sizeof(*p)) < 0) {
+	if (atacmd(t, &r, (uchar *)(p+1), maxscnt*512, pktlen - sizeof(*p)) < 0) {
 		p->h.flags |= Error;
 		p->h.error = BadArg;
 		return len;
@@ -290,7 +246,7 @@ aoeata(Ata *p, int pktlen)	// do ATA reqeust
 // yes, this makes unnecessary copies.
 
 int
-confcmd(Conf *p, int payload)	// process conf request
+confcmd(Target *t, Conf *p, int payload)	// process conf request
 {
 	int len;
 
@@ -300,40 +256,40 @@ confcmd(Conf *p, int payload)	// process conf request
 		return 0;	// if you can't play nice ...
 	switch (QCMD(p)) {
 	case Qtest:
-		if (len != nconfig)
+		if (len != t->nconfig)
 			return 0;
 		// fall thru
 	case Qprefix:
-		if (len > nconfig)
+		if (len > t->nconfig)
 			return 0;
-		if (memcmp(config, p->data, len))
+		if (memcmp(t->config, p->data, len))
 			return 0;
 		// fall thru
 	case Qread:
 		break;
 	case Qset:
-		if (nconfig)
-		if (nconfig != len || memcmp(config, p->data, len)) {
+		if (t->nconfig)
+		if (t->nconfig != len || memcmp(t->config, p->data, len)) {
 			p->h.flags |= Error;
 			p->h.error = ConfigErr;
 			break;
 		}
 		// fall thru
 	case Qfset:
-		nconfig = len;
-		memcpy(config, p->data, nconfig);
+		t->nconfig = len;
+		memcpy(t->config, p->data, t->nconfig);
 		break;
 	default:
 		p->h.flags |= Error;
 		p->h.error = BadArg;
 	}
-	memmove(p->data, config, nconfig);
-	p->len = htons(nconfig);
+	memmove(p->data, t->config, t->nconfig);
+	p->len = htons(t->nconfig);
 	p->bufcnt = htons(bufcnt);
 	p->scnt = maxscnt = (getmtu(sfd, ifname) - sizeof (Ata)) / 512;
 	p->firmware = htons(FWV);
 	p->vercmd = 0x10 | QCMD(p);	// aoe v.1
-	return nconfig + sizeof *p - sizeof p->data;
+	return t->nconfig + sizeof *p - sizeof p->data;
 }
 
 static int
@@ -453,7 +409,7 @@ e:	return n + Nmaskhdr;
 }
 
 void
-doaoe(Aoehdr *p, int n)
+doaoe(Target *t, Aoehdr *p, int n)
 {
 	int len;
 
@@ -461,12 +417,12 @@ doaoe(Aoehdr *p, int n)
 	case ATAcmd:
 		if (n < Natahdr)
 			return;
-		len = aoeata((Ata*)p, n);
+		len = aoeata(t, (Ata*)p, n);
 		break;
 	case Config:
 		if (n < Ncfghdr)
 			return;
-		len = confcmd((Conf *)p, n);
+		len = confcmd(t, (Conf *)p, n);
 		break;
 	case Mask:
 		if (n < Nmaskhdr)
@@ -488,8 +444,8 @@ doaoe(Aoehdr *p, int n)
 		return;
 	memmove(p->dst, p->src, 6);
 	memmove(p->src, mac, 6);
-	p->maj = htons(shelf);
-	p->min = slot;
+	p->maj = htons(t->shelf);
+	p->min = t->slot;
 	p->flags |= Resp;
 	if (putpkt(sfd, (uchar *) p, len) == -1) {
 		perror("write to network");
@@ -497,20 +453,42 @@ doaoe(Aoehdr *p, int n)
 	}
 }
 
+static int
+tcmp(const void *a, const void *b)
+{
+	const Target *x = a, *y = b;
+
+	if (x->shelf != y->shelf)
+		return x->shelf - y->shelf;
+	return x->slot - y->slot;
+}
+
+static Target *
+findtarget(int sh, int sl)
+{
+	Target key;
+
+	key.shelf = sh;
+	key.slot = sl;
+	return bsearch(&key, targets, ntargets, sizeof key, tcmp);
+}
+
 void
 aoe(void)
 {
 	Aoehdr *p;
-	uchar *buf;
-	int n, sh;
+	Target *t;
+	uchar *buf, *req;
+	int n, i, sh, sl, hit;
 	long pagesz;
+	ulong npkt;
 	enum { bufsz = 1<<16, };
 
 	if ((pagesz = sysconf(_SC_PAGESIZE)) < 0) {
 		perror("sysconf");
 		exit(1);
 	}        
-	if ((buf = malloc(bufsz + pagesz)) == NULL) {
+	if ((buf = malloc(bufsz + pagesz)) == NULL || (req = malloc(bufsz)) == NULL) {
 		perror("malloc");
 		exit(1);
 	}
@@ -518,14 +496,17 @@ aoe(void)
 	if (n & (pagesz - 1))
 		buf += pagesz - (n & (pagesz - 1));
 
-	aoead(sfd);
+	for (i = 0; i < ntargets; i++)
+		aoead(&targets[i], sfd);
 
-	for (;;) {
+	for (npkt = 1;; npkt++) {
 		n = getpkt(sfd, buf, bufsz);
 		if (n < 0) {
 			perror("read network");
 			exit(1);
 		}
+		if (verbose && (npkt & 0xffff) == 0)
+			cachestat();
 		if (n < sizeof(Aoehdr))
 			continue;
 		p = (Aoehdr *) buf;
@@ -533,22 +514,36 @@ aoe(void)
 			continue;
 		if (p->flags & Resp)
 			continue;
-		sh = ntohs(p->maj);
-		if (sh != shelf && sh != (ushort)~0)
-			continue;
-		if (p->min != slot && p->min != (uchar)~0)
-			continue;
 		if (nmasks && !maskok(p->src))
 			continue;
-		doaoe(p, n);
+		sh = ntohs(p->maj);
+		sl = p->min;
+		if (sh != (ushort)~0 && sl != (uchar)~0) {
+			if ((t = findtarget(sh, sl)) != nil)
+				doaoe(t, p, n);
+			continue;
+		}
+		// broadcast, every matched target answers its own copy of the request
+		memcpy(req, buf, n);
+		for (i = 0, hit = 0; i < ntargets; i++) {
+			t = &targets[i];
+			if (sh != t->shelf && sh != (ushort)~0)
+				continue;
+			if (sl != t->slot && sl != (uchar)~0)
+				continue;
+			if (hit++)
+				memcpy(buf, req, n);
+			doaoe(t, p, n);
+		}
 	}
 }
 
 void
 usage(void)
 {
-	fprintf(stderr, "usage: %s [-b bufcnt] [-o offset] [-l length] [-d ] [-s] [-r] [ -m mac[,mac...] ] shelf slot netif filename\n", 
-		progname);
+	fprintf(stderr, "usage: %s [-b bufcnt] [-o offset] [-l length] [-d ] [-s] [-r] [-c cachemb] [ -m mac[,mac...] ] [-f mapfile] shelf slot netif filename\n"
+		"       %s [-b bufcnt] [-d ] [-s] [-r] [-c cachemb] [ -m mac[,mac...] ] -T tablefile netif\n", 
+		progname, progname);
 	exit(1);
 }
 
@@ -617,21 +612,99 @@ rrok(uchar *ea)
 }
 
 void
-setserial(int sh, int sl)
+setserial(Target *t)
 {
 	char h[32];
 
 	h[0] = 0;
 	gethostname(h, sizeof h);
-	snprintf(serial, Nserial, "%d.%d:%.*s", sh, sl, (int) sizeof h, h);
+	snprintf(t->serial, Nserial, "%d.%d:%.*s", t->shelf, t->slot, (int) sizeof h, h);
+}
+
+void
+addtarget(int sh, int sl, char *file, char *map, int omode, vlong offset, vlong length)
+{
+	Target *t;
+	vlong size;
+
+	if (ntargets >= Ntargets) {
+		fprintf(stderr, "too many targets, at most %d\n", Ntargets);
+		exit(1);
+	}
+	if (sh < 0 || sh >= 0xffff || sl < 0 || sl >= 0xff) {
+		fprintf(stderr, "bad shelf.slot %d.%d\n", sh, sl);
+		exit(1);
+	}
+	t = &targets[ntargets];
+	memset(t, 0, sizeof *t);
+	t->shelf = sh;
+	t->slot = sl;
+	t->disk = opendisk(file, omode);
+	if (map && map[0])
+		size = loadmap(t, map);
+	else
+		size = getsize(disks[t->disk].fd) / 512;
+	if (size <= offset) {
+                if (offset)
+                        fprintf(stderr,
+                                "Offset %lld too large for %lld-sector export\n",
+                                offset,
+                                size);
+                else
+                        fputs("0-sector file size is too small\n", stderr);
+		exit(1);
+	}
+	size -= offset;
+	if (length) {
+		if (length > size) {
+			fprintf(stderr, "Length %llu too big - exceeds size of file!\n", offset);
+			exit(1);
+		}
+		size = length;
+	}
+	t->size = size;
+	t->offset = offset;
+	setserial(t);
+	atainit(t);
+	ntargets++;
+}
+
+// each line is "shelf slot filename [mapfile]", # for comment
+void
+loadtable(char *table, int omode)
+{
+	FILE *fp;
+	char line[1024], file[512], map[512];
+	int sh, sl, n;
+
+	fp = fopen(table, "r");
+	if (fp == nil) {
+		perror(table);
+		exit(1);
+	}
+	while (fgets(line, sizeof line, fp)) {
+		if (line[0] == '#')
+			continue;
+		map[0] = 0;
+		n = sscanf(line, "%d %d %511s %511s", &sh, &sl, file, map);
+		if (n <= 0)
+			continue;
+		if (n < 3) {
+			fprintf(stderr, "bad line in %s: %s", table, line);
+			exit(1);
+		}
+		addtarget(sh, sl, file, map, omode, 0, 0);
+	}
+	fclose(fp);
 }
 
 int
 main(int argc, char **argv)
 {
-	int ch, omode = 0, readonly = 0;
-	vlong length = 0;
+	int i, ch, omode = 0, readonly = 0;
+	vlong length = 0, offset = 0, cachemb = Cachemb;
 	char *end;
+	char *table = nil;
     char filepath[300] = {0};
 
     /* Avoid to be killed by systemd */
@@ -641,10 +714,9 @@ main(int argc, char **argv)
 	}
 
 	bufcnt = Bufcount;
-	offset = 0;
 	setbuf(stdin, NULL);
 	progname = *argv;
-	while ((ch = getopt(argc, argv, "b:dsrm:f:tv::o:l:")) != -1) {
+	while ((ch = getopt(argc, argv, "b:dsrm:f:tv::o:l:c:T:")) != -1) {
 		switch (ch) {
 		case 'b':
 			bufcnt = atoi(optarg);
@@ -671,6 +743,14 @@ main(int argc, char **argv)
         case 'f':
             strncpy(filepath, optarg, sizeof(filepath) - 1);
             break;
+		case 'c':
+			cachemb = strtoll(optarg, &end, 0);
+			if (end == optarg || cachemb < 0)
+				usage();
+			break;
+		case 'T':
+			table = optarg;
+			break;
 		case 'o':
 			offset = strtoll(optarg, &end, 0);
 			if (end == optarg || offset < 0)
@@ -688,53 +768,44 @@ main(int argc, char **argv)
 	}
 	argc -= optind;
 	argv += optind;
-	if (argc != 4 || bufcnt <= 0)
+	if (argc != (table ? 1 : 4) || bufcnt <= 0)
 		usage();
 	omode |= readonly ? O_RDONLY : O_RDWR;
-    parse_img_chunk(filepath);
-	bfd = open(argv[3], omode);
-	if (bfd == -1) {
-		perror("open");
-		exit(1);
+	cacheinit(cachemb * 1024 * 1024);
+	if (table) {
+		loadtable(table, omode);
+		ifname = argv[0];
+	} else {
+		addtarget(atoi(argv[0]), atoi(argv[1]), argv[3], filepath, omode, offset, length);
+		ifname = argv[2];
 	}
-	shelf = atoi(argv[0]);
-	slot = atoi(argv[1]);
-	setserial(shelf, slot);
-	size = g_iso_file_size; //getsize(bfd);
-	size /= 512;
-	if (size <= offset) {
-                if (offset)
-                        fprintf(stderr,
-                                "Offset %lld too large for %lld-sector export\n",
-                                offset,
-                                size);
-                else
-                        fputs("0-sector file size is too small\n", stderr);
+	if (ntargets == 0) {
+		fprintf(stderr, "no target to export\n");
 		exit(1);
 	}
-	size -= offset;
-	if (length) {
-		if (length > size) {
-			fprintf(stderr, "Length %llu too big - exceeds size of file!\n", offset);
+	qsort(targets, ntargets, sizeof targets[0], tcmp);
+	for (i = 1; i < ntargets; i++)
+		if (tcmp(&targets[i-1], &targets[i]) == 0) {
+			fprintf(stderr, "duplicate target e%d.%d\n", targets[i].shelf, targets[i].slot);
 			exit(1);
 		}
-		size = length;
-	}
-	ifname = argv[2];
+
+	// the kernel filters the packets for a single target
+	shelf = ntargets == 1 ? targets[0].shelf : -1;
+	slot = ntargets == 1 ? targets[0].slot : -1;
 	sfd = dial(ifname, bufcnt);
 	if (sfd < 0)
 		return 1;
 	getea(sfd, ifname, mac);
 
     if (verbose) {
-        printf("pid %ld: e%d.%d, %lld sectors %s\n",
-		    (long) getpid(), shelf, slot, size,
-		    readonly ? "O_RDONLY" : "O_RDWR");
+        for (i = 0; i < ntargets; i++)
+            printf("pid %ld: e%d.%d, %lld sectors %s\n",
+                (long) getpid(), targets[i].shelf, targets[i].slot, targets[i].size,
+                readonly ? "O_RDONLY" : "O_RDWR");
     }
     
 	fflush(stdout);
-	atainit();
 	aoe();
 	return 0;
 }
-
@@ -23,8 +23,6 @@ enum {
 	ERR =	1<<0,
 };
 
-static ushort ident[256];
-
 static void
 setfld(ushort *a, int idx, int len, char *str)	// set field in ident
 {
@@ -82,9 +80,10 @@ setushort(ushort *a, int i, ushort n)
 }
 
 void
-atainit(void)
+atainit(Target *t)
 {
 	char buf[64];
+	ushort *ident = t->ident;
 
 	setushort(ident, 47, 0x8000);
 	setushort(ident, 49, 0x0200);
@@ -97,7 +96,7 @@ atainit(void)
 	setfld(ident, 27, 40, "Coraid EtherDrive vblade");
 	sprintf(buf, "V%d", VBLADE_VERSION);
 	setfld(ident, 23, 8, buf);
-	setfld(ident, 10, 20, serial);
+	setfld(ident, 10, 20, t->serial);
 }
 
 
@@ -107,7 +106,7 @@ atainit(void)
  * check for that.
  */
 int
-atacmd(Ataregs *p, uchar *dp, int ndp, int payload) // do the ata cmd
+atacmd(Target *t, Ataregs *p, uchar *dp, int ndp, int payload) // do the ata cmd
 {
 	vlong lba;
 	ushort *ip;
@@ -126,13 +125,13 @@ atacmd(Ataregs *p, uchar *dp, int ndp, int payload) // do the ata cmd
 	case 0xec:		// identify device
 		if (p->sectors != 1 || ndp < 512)
 			return -1;
-		memmove(dp, ident, 512);
+		memmove(dp, t->ident, 512);
 		ip = (ushort *)dp;
-		if (size & ~MAXLBA28SIZE)
+		if (t->size & ~MAXLBA28SIZE)
 			setlba28(ip, MAXLBA28SIZE);
 		else
-			setlba28(ip, size);
-		setlba48(ip, size);
+			setlba28(ip, t->size);
+		setlba48(ip, t->size);
 		p->err = 0;
 		p->status = DRDY;
 		p->sectors = 0;
@@ -157,19 +156,19 @@ atacmd(Ataregs *p, uchar *dp, int ndp, int payload) // do the ata cmd
 	if (p->sectors > maxscnt || p->sectors*512 > ndp)
 		return -1;
 
-	if (lba + p->sectors > size) {
+	if (lba + p->sectors > t->size) {
 		p->err = IDNF;
 		p->status = DRDY | ERR;
 		p->lba = lba;
 		return 0;
 	}
 	if (p->cmd == 0x20 || p->cmd == 0x24)
-		n = getsec(bfd, dp, lba+offset, p->sectors);
+		n = readsec(t, dp, lba+t->offset, p->sectors);
 	else {
 		// packet should be big enough to contain the data
 		if (payload < 512 * p->sectors)
 			return -1;
-		n = putsec(bfd, dp, lba+offset, p->sectors);
+		n = writesec(t, dp, lba+t->offset, p->sectors);
 	}
 	n /= 512;
 	if (n != p->sectors) {
@@ -109,6 +109,25 @@ create_bpf_program(int shelf, int slot)
 		/* INVALID: return 0 (ignore the packet) */
 		BPF_STMT(BPF_RET+BPF_K, 0),
 	};
+	struct bpf_insn anyinsns[] = {	// shelf -1: any shelf and slot
+		BPF_STMT(BPF_LD+BPF_H+BPF_ABS, 12),
+		BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, 0x88a2, 0, 4),
+		BPF_STMT(BPF_LD+BPF_B+BPF_ABS, 14),
+		BPF_STMT(BPF_ALU+BPF_AND+BPF_K, Resp),
+		BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, 0, 0, 1),
+		BPF_STMT(BPF_RET+BPF_K, -1),
+		BPF_STMT(BPF_RET+BPF_K, 0),
+	};
+	if (shelf < 0) {
+		if ((bpf_program = malloc(sizeof(struct bpf_program))) == NULL
+		    || (bpf_program->bf_insns = malloc(sizeof(anyinsns))) == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		bpf_program->bf_len = sizeof(anyinsns)/sizeof(struct bpf_insn);
+		memcpy(bpf_program->bf_insns, anyinsns, sizeof(anyinsns));
+		return (void *)bpf_program;
+	}
 	if ((bpf_program = malloc(sizeof(struct bpf_program))) == NULL
 	    || (bpf_program->bf_insns = malloc(sizeof(insns))) == NULL) {
 		perror("malloc");
@@ -2,8 +2,8 @@
 
 rm -f vblade_*
 
-gcc linux.c aoe.c ata.c bpf.c -Os -o vblade_64
-gcc linux.c aoe.c ata.c bpf.c -Os -m32 -o vblade_32
+gcc linux.c aoe.c ata.c bpf.c cache.c ../../vtoychain/vtoychain.c -I../../vtoychain -Os -o vblade_64
+gcc linux.c aoe.c ata.c bpf.c cache.c ../../vtoychain/vtoychain.c -I../../vtoychain -Os -m32 -o vblade_32
 
 if [ -e vblade_64 ] && [ -e vblade_32 ]; then
     echo -e '\n################## SUCCESS ######################\n'
@@ -0,0 +1,182 @@
+// cache.c: block cache shared by all the targets
+#define _GNU_SOURCE
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "dat.h"
+#include "fns.h"
+
+/*
+ * The cache holds Cblksz aligned blocks of the block files, keyed by the
+ * file (disk) and the block number, and drops the least recently used
+ * one when it is full.  Many clients booting the same image then read
+ * it from the disk once, and the small AoE requests of one client are
+ * served from one large read.  The export is read only, so there is
+ * nothing to write back or invalidate.
+ */
+
+enum {
+	Cblksz = 64*1024,
+};
+
+typedef struct Cblock Cblock;
+
+struct Cblock
+{
+	int	disk;		// -1 if not used
+	vlong	blk;
+	int	len;		// valid bytes, short at the end of the file
+	Cblock	*hnext;
+	Cblock	*prev;		// lru list, most recent first
+	Cblock	*next;
+	uchar	*data;
+};
+
+static Cblock *cblocks;
+static int ncblocks;
+static Cblock **chash;
+static int nhash;
+static Cblock lru;
+static vlong hits, misses;
+
+static int
+hashkey(int disk, vlong blk)
+{
+	return (int)(((ulong)blk * 2654435761UL + (ulong)disk * 40503UL) & (nhash - 1));
+}
+
+static void
+lrudel(Cblock *b)
+{
+	b->prev->next = b->next;
+	b->next->prev = b->prev;
+}
+
+static void
+lruadd(Cblock *b)
+{
+	b->next = lru.next;
+	b->prev = &lru;
+	lru.next->prev = b;
+	lru.next = b;
+}
+
+static void
+unhash(Cblock *b)
+{
+	Cblock **pp;
+
+	if (b->disk < 0)
+		return;
+	for (pp = &chash[hashkey(b->disk, b->blk)]; *pp; pp = &(*pp)->hnext)
+		if (*pp == b) {
+			*pp = b->hnext;
+			break;
+		}
+	b->disk = -1;
+}
+
+static Cblock *
+lookup(int disk, vlong blk)
+{
+	Cblock *b;
+
+	for (b = chash[hashkey(disk, blk)]; b; b = b->hnext)
+		if (b->disk == disk && b->blk == blk)
+			return b;
+	return nil;
+}
+
+void
+cacheinit(vlong bytes)	// bytes 0 disables the cache
+{
+	uchar *data;
+	long pagesz;
+	int i;
+
+	lru.next = lru.prev = &lru;
+	ncblocks = bytes / Cblksz;
+	if (ncblocks <= 0) {
+		ncblocks = 0;
+		return;
+	}
+	if ((pagesz = sysconf(_SC_PAGESIZE)) < 0)
+		pagesz = 4096;
+	// aligned for O_DIRECT
+	if (posix_memalign((void **)&data, pagesz, (size_t)ncblocks * Cblksz)) {
+		fprintf(stderr, "no memory for %d cache blocks, cache disabled\n", ncblocks);
+		ncblocks = 0;
+		return;
+	}
+	for (nhash = 1; nhash < ncblocks; nhash <<= 1)
+		;
+	cblocks = calloc(ncblocks, sizeof *cblocks);
+	chash = calloc(nhash, sizeof *chash);
+	if (cblocks == nil || chash == nil) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < ncblocks; i++) {
+		cblocks[i].disk = -1;
+		cblocks[i].data = data + (size_t)i * Cblksz;
+		lruadd(&cblocks[i]);
+	}
+}
+
+// read len bytes at off of the block file, return the bytes read or -1
+int
+cacheread(int disk, int fd, uchar *place, vlong off, int len)
+{
+	Cblock *b;
+	vlong blk;
+	int boff, n, done, h;
+
+	if (ncblocks == 0)
+		return pread(fd, place, len, off);
+
+	for (done = 0; done < len; done += n) {
+		blk = (off + done) / Cblksz;
+		boff = (off + done) % Cblksz;
+		n = len - done;
+		if (n > Cblksz - boff)
+			n = Cblksz - boff;
+
+		b = lookup(disk, blk);
+		if (b == nil) {
+			b = lru.prev;
+			unhash(b);
+			b->len = pread(fd, b->data, Cblksz, blk * Cblksz);
+			if (b->len < 0) {
+				b->len = 0;
+				return done ? done : -1;
+			}
+			b->disk = disk;
+			b->blk = blk;
+			h = hashkey(disk, blk);
+			b->hnext = chash[h];
+			chash[h] = b;
+			misses++;
+		} else
+			hits++;
+		lrudel(b);
+		lruadd(b);
+
+		if (boff >= b->len)
+			break;		// end of the file
+		if (n > b->len - boff)
+			n = b->len - boff;
+		memcpy(place + done, b->data + boff, n);
+	}
+	return done;
+}
+
+void
+cachestat(void)
+{
+	if (ncblocks)
+		printf("cache %d blocks of %dKB, %lld hits %lld misses\n",
+			ncblocks, Cblksz / 1024, hits, misses);
+}
@@ -36,6 +36,7 @@ typedef struct Ataregs Ataregs;
 typedef struct Mdir Mdir;
 typedef struct Aoemask Aoemask;
 typedef struct Aoesrr Aoesrr;
+typedef struct Target Target;
 
 struct Ataregs
 {
@@ -161,14 +162,29 @@ enum {
 	Nsrrhdr= Naoehdr + 2,
 
 	Nserial= 20,
+
+	Ntargets= 256,
+};
+
+// an exported image, found by its shelf.slot
+struct Target
+{
+	int	shelf;
+	int	slot;
+	int	disk;		// index of the block file, shared by the targets on it
+	vlong	size;		// size of vblade
+	vlong	offset;
+	struct vtoy_chain *chain;	// ventoy image map, nil for the plain file
+	char	serial[Nserial+1];
+	char	config[Nconfig];
+	int	nconfig;
+	ushort	ident[256];
 };
 
-int	shelf, slot;
+int	shelf, slot;	// for the packet filter, -1 for any
 ulong	aoetag;
 uchar	mac[6];
-int	bfd;		// block file descriptor
 int	sfd;		// socket file descriptor
-vlong	size;		// size of vblade
-vlong	offset;
 char	*progname;
-char	serial[Nserial+1];
+Target	targets[Ntargets];	// sorted by shelf.slot
+int	ntargets;
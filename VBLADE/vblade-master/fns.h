@@ -6,17 +6,25 @@ void	aoe(void);
 void	aoeinit(void);
 void	aoequery(void);
 void	aoeconfig(void);
-void	aoead(int);
+void	aoead(Target *, int);
 void	aoeflush(int, int);
 void	aoetick(void);
 void	aoerequest(int, int, vlong, int, uchar *, int);
 int	maskok(uchar *);
 int	rrok(uchar *);
+int	readsec(Target *, uchar *, vlong, int);
+int	writesec(Target *, uchar *, vlong, int);
 
 // ata.c
 
-void	atainit(void);
-int	atacmd(Ataregs *, uchar *, int, int);
+void	atainit(Target *);
+int	atacmd(Target *, Ataregs *, uchar *, int, int);
+
+// cache.c
+
+void	cacheinit(vlong);
+int	cacheread(int, int, uchar *, vlong, int);
+void	cachestat(void);
 
 // bpf.c
 
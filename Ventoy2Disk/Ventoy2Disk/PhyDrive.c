@@ -977,21 +977,40 @@ int VentoyProcSecureBoot(BOOL SecureBoot)
 
 static int disk_xz_flush(void *src, unsigned int size)
 {
-    unsigned int i;
+    unsigned int len;
+    unsigned int left = size;
     BYTE *buf = (BYTE *)src;
 
-    for (i = 0; i < size; i++)
+    /* copy whole spans, split only at the 1MB buffer boundary */
+    while (left > 0)
     {
-        *g_part_img_pos = *buf++;
+        if (g_disk_unxz_len >= VENTOY_EFI_PART_SIZE)
+        {
+            return -1;
+        }
+
+        len = SIZE_1MB - (g_disk_unxz_len % SIZE_1MB);
+        if (len > left)
+        {
+            len = left;
+        }
+
+        memcpy(g_part_img_pos, buf, len);
+        buf += len;
+        left -= len;
 
-        g_disk_unxz_len++;
-        if ((g_disk_unxz_len % SIZE_1MB) == 0)
+        g_disk_unxz_len += len;
+        if (g_disk_unxz_len >= VENTOY_EFI_PART_SIZE)
+        {
+            g_part_img_pos = NULL;
+        }
+        else if ((g_disk_unxz_len % SIZE_1MB) == 0)
         {
             g_part_img_pos = g_part_img_buf[g_disk_unxz_len / SIZE_1MB];
         }
         else
         {
-            g_part_img_pos++;
+            g_part_img_pos += len;
         }
     }
 
@@ -1036,8 +1055,8 @@ static int FormatPart2Fat(HANDLE hDrive, UINT64 StartSectorId)
     int i;
     int rc = 0;
     int len = 0;
-    int writelen = 0;
     int partwrite = 0;
+    unsigned int outlen = 0;
     DWORD dwSize = 0;
     BOOL bRet;
     unsigned char *data = NULL;
@@ -1064,9 +1083,10 @@ static int FormatPart2Fat(HANDLE hDrive, UINT64 StartSectorId)
     if (g_part_img_buf[0])
     {
         Log("Malloc whole img buffer success, now decompress ...");
-        unxz(data, len, NULL, NULL, g_part_img_buf[0], &writelen, unxz_error);
 
-        if (len == writelen)
+        /* ventoy.disk.img.xz is packed with independent xz blocks, decode them in parallel */
+        if (vtoy_xz_decode(data, len, g_part_img_buf[0], VENTOY_EFI_PART_SIZE, 0, &outlen) == 0 &&
+            outlen == VENTOY_EFI_PART_SIZE)
         {
             Log("decompress finished success");
 
@@ -1166,9 +1186,9 @@ End:
 static int WriteGrubStage1ToPhyDrive(HANDLE hDrive, int PartStyle)
 {
     int Len = 0;
-    int readLen = 0;
     BOOL bRet;
     DWORD dwSize;
+    unsigned int outlen = 0;
     BYTE *ImgBuf = NULL;
     BYTE *RawBuf = NULL;
 
@@ -1187,7 +1207,13 @@ static int WriteGrubStage1ToPhyDrive(HANDLE hDrive, int PartStyle)
         return 1;
     }
 
-    unxz(ImgBuf, Len, NULL, NULL, RawBuf, &readLen, unxz_error);
+    if (vtoy_xz_decode(ImgBuf, Len, RawBuf, SIZE_1MB, 0, &outlen))
+    {
+        Log("Failed to decompress stage1 img");
+        free(RawBuf);
+        free(ImgBuf);
+        return 1;
+    }
 
     if (PartStyle)
     {
@@ -201,6 +201,7 @@ int INIT unxz(unsigned char *in, int in_size,
     int(*flush)(void *src, unsigned int size),
     unsigned char *out, int *in_used,
     void(*error)(char *x));
+int vtoy_xz_decode(const unsigned char *in, unsigned int insize, unsigned char *out, unsigned int outsize, int threads, unsigned int *outlen);
 void disk_io_set_param(HANDLE Handle, UINT64 SectorCount);
 INT_PTR CALLBACK PartDialogProc(HWND hWnd, UINT Message, WPARAM wParam, LPARAM lParam);
 int GetReservedSpaceInMB(void);
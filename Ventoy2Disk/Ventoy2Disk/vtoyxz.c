@@ -0,0 +1,389 @@
+/******************************************************************************
+ * vtoyxz.c
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Block parallel xz decoder, shared by Ventoy2Disk.exe and the linux vtoyinstall.
+ *
+ * ventoy.disk.img.xz and core.img.xz are packed with fixed size xz blocks (xz --block-size).
+ * The stream index tells where each block is and how large it is uncompressed, so every
+ * block can be decoded by its own thread straight into its final place in the output buffer.
+ * A block is decoded by wrapping it as a standalone single block stream and running the
+ * xz-embedded decoder in single-call mode on it (the output buffer is the dictionary).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include "xz.h"
+
+#define VTOY_XZ_HEADER_SIZE     12
+#define VTOY_XZ_FOOTER_SIZE     12
+#define VTOY_XZ_MAX_THREAD      32
+
+typedef struct vtoy_xz_block
+{
+    unsigned int offset;    /* compressed data offset in the input */
+    unsigned int unpadded;  /* unpadded size in index */
+    unsigned int outpos;    /* uncompressed data offset in the output */
+    unsigned int size;      /* uncompressed size */
+}vtoy_xz_block;
+
+typedef struct vtoy_xz_ctx
+{
+    const unsigned char *in;
+    unsigned char *out;
+    unsigned int blocknum;
+    unsigned int maxblock;
+    vtoy_xz_block *blocks;
+
+    volatile long next;
+    volatile long error;
+}vtoy_xz_ctx;
+
+#ifdef _WIN32
+#define VTOY_XZ_FETCH_NEXT(ctx)  (InterlockedIncrement(&((ctx)->next)) - 1)
+#define VTOY_XZ_SET_ERROR(ctx)   InterlockedExchange(&((ctx)->error), 1)
+#else
+#define VTOY_XZ_FETCH_NEXT(ctx)  __sync_fetch_and_add(&((ctx)->next), 1)
+#define VTOY_XZ_SET_ERROR(ctx)   __sync_lock_test_and_set(&((ctx)->error), 1)
+#endif
+
+static unsigned int vtoy_xz_get32(const unsigned char *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((unsigned int)buf[3] << 24);
+}
+
+static void vtoy_xz_put32(unsigned char *buf, unsigned int value)
+{
+    buf[0] = (unsigned char)value;
+    buf[1] = (unsigned char)(value >> 8);
+    buf[2] = (unsigned char)(value >> 16);
+    buf[3] = (unsigned char)(value >> 24);
+}
+
+static int vtoy_xz_get_vli(const unsigned char *buf, unsigned int len, unsigned int *pos, unsigned int *value)
+{
+    int i;
+    unsigned long long v = 0;
+
+    for (i = 0; i < 9 && *pos < len; i++)
+    {
+        v |= (unsigned long long)(buf[*pos] & 0x7F) << (i * 7);
+        if ((buf[(*pos)++] & 0x80) == 0)
+        {
+            if (v > 0x7FFFFFFF)
+            {
+                return 1;
+            }
+
+            *value = (unsigned int)v;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static unsigned int vtoy_xz_put_vli(unsigned char *buf, unsigned int value)
+{
+    unsigned int pos = 0;
+
+    while (value >= 0x80)
+    {
+        buf[pos++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buf[pos++] = (unsigned char)value;
+
+    return pos;
+}
+
+static int vtoy_xz_parse_index(vtoy_xz_ctx *ctx, unsigned int insize, unsigned int outsize)
+{
+    unsigned int i;
+    unsigned int num = 0;
+    unsigned int pos = 1;
+    unsigned int indexsize;
+    unsigned int offset;
+    unsigned int outpos = 0;
+    const unsigned char *index = NULL;
+    const unsigned char *footer = ctx->in + insize - VTOY_XZ_FOOTER_SIZE;
+
+    if (insize < VTOY_XZ_HEADER_SIZE + VTOY_XZ_FOOTER_SIZE ||
+        memcmp(ctx->in, "\xFD" "7zXZ\0", 6) || footer[10] != 'Y' || footer[11] != 'Z')
+    {
+        return 1;
+    }
+
+    indexsize = (vtoy_xz_get32(footer + 4) + 1) * 4;
+    if (indexsize == 0 || indexsize > insize - VTOY_XZ_HEADER_SIZE - VTOY_XZ_FOOTER_SIZE)
+    {
+        return 1;
+    }
+
+    index = footer - indexsize;
+    if (index[0] != 0 || vtoy_xz_get_vli(index, indexsize, &pos, &num) || num == 0 || num > insize / 16)
+    {
+        return 1;
+    }
+
+    ctx->blocks = (vtoy_xz_block *)malloc(num * sizeof(vtoy_xz_block));
+    if (!ctx->blocks)
+    {
+        return 1;
+    }
+
+    offset = VTOY_XZ_HEADER_SIZE;
+    for (i = 0; i < num; i++)
+    {
+        if (vtoy_xz_get_vli(index, indexsize, &pos, &(ctx->blocks[i].unpadded)) ||
+            vtoy_xz_get_vli(index, indexsize, &pos, &(ctx->blocks[i].size)))
+        {
+            return 1;
+        }
+
+        ctx->blocks[i].offset = offset;
+        ctx->blocks[i].outpos = outpos;
+
+        offset += (ctx->blocks[i].unpadded + 3) & (~3U);
+        outpos += ctx->blocks[i].size;
+
+        if (offset > (unsigned int)(index - ctx->in) || outpos > outsize || outpos < ctx->blocks[i].size)
+        {
+            return 1;
+        }
+
+        if (ctx->blocks[i].unpadded > ctx->maxblock)
+        {
+            ctx->maxblock = ctx->blocks[i].unpadded;
+        }
+    }
+
+    if (offset != (unsigned int)(index - ctx->in))
+    {
+        return 1;
+    }
+
+    ctx->blocknum = num;
+    return 0;
+}
+
+/* header + block + index with only this block + footer */
+static unsigned int vtoy_xz_make_stream(vtoy_xz_ctx *ctx, vtoy_xz_block *block, unsigned char *buf)
+{
+    unsigned int pos;
+    unsigned int start;
+    unsigned int padded = (block->unpadded + 3) & (~3U);
+
+    memcpy(buf, ctx->in, VTOY_XZ_HEADER_SIZE);
+    memcpy(buf + VTOY_XZ_HEADER_SIZE, ctx->in + block->offset, padded);
+    pos = VTOY_XZ_HEADER_SIZE + padded;
+
+    start = pos;
+    buf[pos++] = 0;
+    pos += vtoy_xz_put_vli(buf + pos, 1);
+    pos += vtoy_xz_put_vli(buf + pos, block->unpadded);
+    pos += vtoy_xz_put_vli(buf + pos, block->size);
+    while (pos & 3)
+    {
+        buf[pos++] = 0;
+    }
+
+    vtoy_xz_put32(buf + pos, xz_crc32(buf + start, pos - start, 0));
+    pos += 4;
+
+    /* footer: crc32, backward size, stream flags, magic */
+    vtoy_xz_put32(buf + pos + 4, (pos - start) / 4 - 1);
+    buf[pos + 8] = ctx->in[6];
+    buf[pos + 9] = ctx->in[7];
+    vtoy_xz_put32(buf + pos, xz_crc32(buf + pos + 4, 6, 0));
+    buf[pos + 10] = 'Y';
+    buf[pos + 11] = 'Z';
+
+    return pos + VTOY_XZ_FOOTER_SIZE;
+}
+
+static int vtoy_xz_single_call(const unsigned char *in, unsigned int insize, unsigned char *out, unsigned int outsize, unsigned int *outlen)
+{
+    enum xz_ret ret;
+    struct xz_buf b;
+    struct xz_dec *s = NULL;
+
+    s = xz_dec_init(XZ_SINGLE, 0);
+    if (!s)
+    {
+        return 1;
+    }
+
+    b.in = in;
+    b.in_pos = 0;
+    b.in_size = insize;
+    b.out = out;
+    b.out_pos = 0;
+    b.out_size = outsize;
+
+    ret = xz_dec_run(s, &b);
+    xz_dec_end(s);
+
+    *outlen = (unsigned int)b.out_pos;
+    return (ret == XZ_STREAM_END) ? 0 : 1;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI vtoy_xz_worker(LPVOID param)
+#else
+static void * vtoy_xz_worker(void *param)
+#endif
+{
+    long blk;
+    unsigned int len;
+    unsigned int outlen;
+    unsigned char *stream = NULL;
+    vtoy_xz_block *block = NULL;
+    vtoy_xz_ctx *ctx = (vtoy_xz_ctx *)param;
+
+    stream = (unsigned char *)malloc(VTOY_XZ_HEADER_SIZE + ctx->maxblock + 64 + VTOY_XZ_FOOTER_SIZE);
+    if (!stream)
+    {
+        VTOY_XZ_SET_ERROR(ctx);
+        return 0;
+    }
+
+    while (ctx->error == 0)
+    {
+        blk = VTOY_XZ_FETCH_NEXT(ctx);
+        if (blk >= (long)ctx->blocknum)
+        {
+            break;
+        }
+
+        block = ctx->blocks + blk;
+        len = vtoy_xz_make_stream(ctx, block, stream);
+
+        if (vtoy_xz_single_call(stream, len, ctx->out + block->outpos, block->size, &outlen) || outlen != block->size)
+        {
+            VTOY_XZ_SET_ERROR(ctx);
+            break;
+        }
+    }
+
+    free(stream);
+    return 0;
+}
+
+static int vtoy_xz_cpu_num(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long num = sysconf(_SC_NPROCESSORS_ONLN);
+    return (num > 0) ? (int)num : 1;
+#endif
+}
+
+/*
+ * Decode the xz stream in[insize] to out[outsize], *outlen is the decompressed size.
+ * threads is the decode thread number, 0 means one for each CPU.
+ * A stream without a usable block index (e.g. only one block) is decoded in the calling thread.
+ * Return 0 for success.
+ */
+int vtoy_xz_decode(const unsigned char *in, unsigned int insize, unsigned char *out, unsigned int outsize, int threads, unsigned int *outlen)
+{
+    int i;
+    int num = 0;
+    vtoy_xz_ctx ctx;
+#ifdef _WIN32
+    HANDLE handles[VTOY_XZ_MAX_THREAD];
+#else
+    pthread_t handles[VTOY_XZ_MAX_THREAD];
+#endif
+
+    xz_crc32_init();
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.in = in;
+    ctx.out = out;
+
+    if (vtoy_xz_parse_index(&ctx, insize, outsize) || ctx.blocknum <= 1)
+    {
+        free(ctx.blocks);
+        return vtoy_xz_single_call(in, insize, out, outsize, outlen);
+    }
+
+    if (threads <= 0)
+    {
+        threads = vtoy_xz_cpu_num();
+    }
+
+    if (threads > VTOY_XZ_MAX_THREAD)
+    {
+        threads = VTOY_XZ_MAX_THREAD;
+    }
+
+    if (threads > (int)ctx.blocknum)
+    {
+        threads = (int)ctx.blocknum;
+    }
+
+    /* the calling thread is one of the workers, a failed thread creation only makes it slower */
+    for (i = 0; i < threads - 1; i++)
+    {
+#ifdef _WIN32
+        handles[num] = CreateThread(NULL, 0, vtoy_xz_worker, &ctx, 0, NULL);
+        if (handles[num])
+        {
+            num++;
+        }
+#else
+        if (pthread_create(handles + num, NULL, vtoy_xz_worker, &ctx) == 0)
+        {
+            num++;
+        }
+#endif
+    }
+
+    vtoy_xz_worker(&ctx);
+
+    for (i = 0; i < num; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+#else
+        pthread_join(handles[i], NULL);
+#endif
+    }
+
+    *outlen = ctx.blocks[ctx.blocknum - 1].outpos + ctx.blocks[ctx.blocknum - 1].size;
+    free(ctx.blocks);
+
+    return ctx.error ? 1 : 0;
+}
+
@@ -29,32 +29,26 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/vfs.h>
+#include <time.h>
 #include <linux/fs.h>
+#include <linux/dm-ioctl.h>
+#include <fnmatch.h>
 #include "biso.h"
 #include "biso_list.h"
 #include "biso_util.h"
 #include "biso_plat.h"
 #include "biso_9660.h"
+#include "vtoychain.h"
 
 #ifndef O_BINARY
 #define O_BINARY 0
 #endif
 
-#ifndef USE_DIET_C
-typedef unsigned long long uint64_t;
-typedef unsigned int    uint32_t;
+#ifndef O_DIRECT
+#define O_DIRECT 040000 /* x86 */
 #endif
 
-#pragma pack(4)
-typedef struct ventoy_img_chunk
-{
-    uint32_t img_start_sector; // sector size: 2KB
-    uint32_t img_end_sector;   // included
-
-    uint64_t disk_start_sector; // in disk_sector_size
-    uint64_t disk_end_sector;   // included
-}ventoy_img_chunk;
-#pragma pack()
 
 static int verbose = 0;
 #define debug(fmt, ...) if(verbose) printf(fmt, ##__VA_ARGS__)
@@ -64,12 +58,40 @@ static int verbose = 0;
 #define CMD_DUMP_ISO_INFO     3
 #define CMD_EXTRACT_ISO_FILE  4
 #define CMD_PRINT_EXTRACT_ISO_FILE  5
+#define CMD_COPY_ISO_FILE     6
+
+#define VTOYDM_COPY_BUF_SIZE  (4 * 1024 * 1024)
+
+#define VTOYDM_ISO_CACHE_SECTORS  64
+#define VTOYDM_ISO_MAX_DEPTH      32
+#define VTOYDM_ISO_MAX_PATTERN    8
+
+#define VTOYDM_CONTROL        "/dev/mapper/control"
+#define VTOYDM_PARAM_MAX      160
+#define VTOYDM_TABLE_MAX      16
+
+#define VTOYDM_MKDEV(major, minor) \
+    ((((major) & 0xfff) << 8) | ((minor) & 0xff) | (((minor) & ~0xff) << 12))
 
 static uint64_t g_iso_file_size;
 static char g_disk_name[128];
 static int g_img_chunk_num = 0;
 static ventoy_img_chunk *g_img_chunk = NULL;
+static vtoy_chain g_img_chain;
 static unsigned char g_iso_sector_buf[2048];
+static int g_disk_fd = -1;
+
+static uint32_t g_iso_sector_total = 0;
+static uint32_t g_iso_cache_start = 0;
+static uint32_t g_iso_cache_num = 0;
+static unsigned char *g_iso_cache_buf = NULL;
+static int g_iso_rr = 0;
+static int g_iso_rr_skip = 0;
+static int g_iso_walk_stop = 0;
+static int g_iso_pattern_num = 0;
+static const char *g_iso_pattern[VTOYDM_ISO_MAX_PATTERN];
+static int g_iso_pattern_hit[VTOYDM_ISO_MAX_PATTERN];
+static int g_iso_pattern_all[VTOYDM_ISO_MAX_PATTERN];
 
 ventoy_img_chunk * vtoydm_get_img_map_data(const char *img_map_file, int *plen)
 {
@@ -180,48 +202,45 @@ INT64 vtoydm_seek_file(BISO_FILE_S *pstFile, INT64 i64Offset, INT iFromWhere)
 
 UINT64 vtoydm_map_iso_sector(UINT64 sector)
 {
-    int i;
-    UINT64 disk_sector = 0;
-    
-    for (i = 0; i < g_img_chunk_num; i++)
+    uint32_t count = 1;
+    uint64_t disk_sector = 0;
+
+    if (vtoy_chain_map(&g_img_chain, sector, &count, &disk_sector))
     {
-        if (sector >= g_img_chunk[i].img_start_sector && sector <= g_img_chunk[i].img_end_sector)
-        {
-            disk_sector = ((sector - g_img_chunk[i].img_start_sector) << 2) + g_img_chunk[i].disk_start_sector;
-            break;
-        }
+        return 0;
     }
 
     return disk_sector;
 }
 
-int vtoydm_read_iso_sector(UINT64 sector, void *buf)
+static int vtoydm_open_disk(void)
 {
-    int i;
-    int fd;
-    UINT64 disk_sector = 0;
-    
-    for (i = 0; i < g_img_chunk_num; i++)
+    if (g_disk_fd < 0)
     {
-        if (sector >= g_img_chunk[i].img_start_sector && sector <= g_img_chunk[i].img_end_sector)
+        g_disk_fd = open(g_disk_name, O_RDONLY | O_BINARY);
+        if (g_disk_fd < 0)
         {
-            disk_sector = ((sector - g_img_chunk[i].img_start_sector) << 2) + g_img_chunk[i].disk_start_sector;
-            break;
+            debug("Failed to open %s\n", g_disk_name);
         }
     }
 
-    fd = open(g_disk_name, O_RDONLY | O_BINARY);
+    return g_disk_fd;
+}
+
+int vtoydm_read_iso_sector(UINT64 sector, void *buf)
+{
+    int fd;
+    UINT64 disk_sector = 0;
+
+    disk_sector = vtoydm_map_iso_sector(sector);
+
+    fd = vtoydm_open_disk();
     if (fd < 0)
     {
-        debug("Failed to open %s\n", g_disk_name);
         return 1;
     }
 
-    lseek(fd, disk_sector * 512, SEEK_SET);
-
-    read(fd, buf, 2048);
-
-    close(fd);
+    pread(fd, buf, 2048, (off_t)(disk_sector * 512));
     return 0;
 }
 
@@ -280,9 +299,410 @@ UINT64 vtoydm_read_file
     return uiBlkSize * uiBlkNum;
 }
 
+/*
+ * Fast ISO directory reader for vtoydm -i
+ * BabyISO builds the whole tree with one 2048 bytes read for each sector, here we
+ * walk the directory records directly. Sectors that are continuous both in the image
+ * and in the disk are read with one pread, and reads go through a 128KB window, as
+ * mkisofs/xorriso put all the directory extents next to each other.
+ */
+static int vtoydm_read_iso_sectors(uint32_t sector, uint32_t count, unsigned char *buf)
+{
+    int fd;
+    uint32_t num;
+    uint64_t disk_sector = 0;
+
+    fd = vtoydm_open_disk();
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    while (count > 0)
+    {
+        num = count;
+        if (vtoy_chain_map(&g_img_chain, sector, &num, &disk_sector))
+        {
+            debug("iso sector %u out of range\n", sector);
+            return 1;
+        }
+
+        if (pread(fd, buf, num * 2048, (off_t)(disk_sector * 512)) != (ssize_t)(num * 2048))
+        {
+            debug("Failed to read %u sectors at %llu err:%d\n", num, (unsigned long long)disk_sector, errno);
+            return 1;
+        }
+
+        buf += num * 2048;
+        sector += num;
+        count -= num;
+    }
+
+    return 0;
+}
+
+static int vtoydm_read_iso_cache(uint32_t sector, uint32_t count, unsigned char *buf)
+{
+    uint32_t num;
+
+    if (count > VTOYDM_ISO_CACHE_SECTORS)
+    {
+        return vtoydm_read_iso_sectors(sector, count, buf);
+    }
+
+    if (sector < g_iso_cache_start || sector + count > g_iso_cache_start + g_iso_cache_num)
+    {
+        if (sector + count > g_iso_sector_total)
+        {
+            return 1;
+        }
+
+        num = VTOYDM_ISO_CACHE_SECTORS;
+        if (sector + num > g_iso_sector_total)
+        {
+            num = g_iso_sector_total - sector;
+        }
+
+        g_iso_cache_num = 0;
+        if (vtoydm_read_iso_sectors(sector, num, g_iso_cache_buf))
+        {
+            return 1;
+        }
+
+        g_iso_cache_start = sector;
+        g_iso_cache_num = num;
+    }
+
+    memcpy(buf, g_iso_cache_buf + (sector - g_iso_cache_start) * 2048, count * 2048);
+    return 0;
+}
+
+static uint32_t vtoydm_iso_le32(unsigned char *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/* Same as BabyISO: FILE.EXT;1 --> file.ext */
+static void vtoydm_iso_fmt_name(char *name)
+{
+    int i;
+    int dot = 0;
+    int sep = -1;
+    int len = (int)strlen(name);
+
+    for (i = 0; i < len; i++)
+    {
+        if (name[i] == ';')
+        {
+            if (sep >= 0)
+            {
+                return;
+            }
+            sep = i;
+        }
+        else if (name[i] == '.')
+        {
+            if (dot++ > 0)
+            {
+                return;
+            }
+        }
+        else if (name[i] >= 'a' && name[i] <= 'z')
+        {
+            return;
+        }
+        else if (sep >= 0 && (name[i] < '0' || name[i] > '9'))
+        {
+            return;
+        }
+    }
+
+    if (sep <= 0 || dot != 1)
+    {
+        return;
+    }
+
+    name[sep] = 0;
+    if (sep > 1 && name[sep - 1] == '.')
+    {
+        name[sep - 1] = 0;
+    }
+
+    for (i = 0; name[i]; i++)
+    {
+        if (name[i] >= 'A' && name[i] <= 'Z')
+        {
+            name[i] = name[i] - 'A' + 'a';
+        }
+    }
+}
+
+/* Rock Ridge NM name if exist, otherwise the ISO9660 name */
+static void vtoydm_iso_record_name(unsigned char *record, char *name, int len)
+{
+    int pos;
+    int nmlen = 0;
+    int namelen = record[32];
+    int reclen = record[0];
+    unsigned char *entry = NULL;
+
+    pos = 33 + namelen + ((namelen & 1) ? 0 : 1) + g_iso_rr_skip;
+    while (pos + 4 <= reclen)
+    {
+        entry = record + pos;
+        if (entry[2] < 4 || pos + entry[2] > reclen)
+        {
+            break;
+        }
+
+        if (entry[0] == 'N' && entry[1] == 'M' && entry[2] > 5 && nmlen + entry[2] - 5 < len)
+        {
+            memcpy(name + nmlen, entry + 5, entry[2] - 5);
+            nmlen += entry[2] - 5;
+        }
+
+        pos += entry[2];
+    }
+
+    if (nmlen > 0)
+    {
+        name[nmlen] = 0;
+        return;
+    }
+
+    if (namelen >= len)
+    {
+        namelen = len - 1;
+    }
+    memcpy(name, record + 33, namelen);
+    name[namelen] = 0;
+
+    /* BabyISO only does this for files in image without rock ridge */
+    if (g_iso_rr == 0 && (record[25] & 0x02) == 0 && namelen > 2)
+    {
+        vtoydm_iso_fmt_name(name);
+    }
+}
+
+static int vtoydm_iso_match(const char *name)
+{
+    int i;
+    int match = 0;
+
+    if (g_iso_pattern_num == 0)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < g_iso_pattern_num; i++)
+    {
+        if (fnmatch(g_iso_pattern[i], name, 0) == 0)
+        {
+            g_iso_pattern_hit[i] = 1;
+            match = 1;
+        }
+    }
+
+    return match;
+}
+
+/* a -M pattern wants every match in the image, so it never lets the walk stop early */
+static int vtoydm_iso_all_matched(void)
+{
+    int i;
+
+    for (i = 0; i < g_iso_pattern_num; i++)
+    {
+        if (g_iso_pattern_hit[i] == 0 || g_iso_pattern_all[i])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int vtoydm_iso_walk_dir(uint32_t extent, uint32_t size, int depth)
+{
+    int i;
+    int pass;
+    int isdir;
+    int hit = 0;
+    uint32_t pos;
+    uint32_t secnum;
+    uint32_t child_extent;
+    uint32_t child_size;
+    unsigned char *buf = NULL;
+    unsigned char *record = NULL;
+    char name[256];
+
+    if (depth > VTOYDM_ISO_MAX_DEPTH)
+    {
+        return 0;
+    }
+
+    secnum = (size + 2047) / 2048;
+    buf = malloc(secnum * 2048);
+    if (NULL == buf)
+    {
+        return 1;
+    }
+
+    if (vtoydm_read_iso_cache(extent, secnum, buf))
+    {
+        free(buf);
+        return 1;
+    }
+
+    /* 
+     * pass 0 for directories and pass 1 for files, BabyISO dumps sub directories first.
+     * When matching, check the files first so that we can stop earlier.
+     */
+    for (pass = 0; pass < 2 && g_iso_walk_stop == 0; pass++)
+    {
+        pos = 0;
+        while (pos < size && g_iso_walk_stop == 0)
+        {
+            record = buf + pos;
+            if (record[0] == 0)
+            {
+                /* records never cross sector boundary, the rest of this sector is padding */
+                pos = (pos / 2048 + 1) * 2048;
+                continue;
+            }
+
+            if (record[0] < 34 || pos + record[0] > secnum * 2048)
+            {
+                break;
+            }
+            pos += record[0];
+
+            /* . and .. */
+            if (record[32] == 1 && (record[33] == 0 || record[33] == 1))
+            {
+                continue;
+            }
+
+            isdir = (record[25] & 0x02) ? 1 : 0;
+            if (isdir != (g_iso_pattern_num > 0 ? pass : 1 - pass))
+            {
+                continue;
+            }
+
+            child_extent = vtoydm_iso_le32(record + 2);
+            child_size = vtoydm_iso_le32(record + 10);
+            vtoydm_iso_record_name(record, name, sizeof(name));
+
+            if (vtoydm_iso_match(name))
+            {
+                for (i = 0; i + 1 < depth; i++)
+                {
+                    printf("    ");
+                }
+                /* BabyISO builds directories from the path table, with size 0 */
+                printf("|-- %s %u %u\n", name, child_extent, isdir ? 0 : child_size);
+                hit = 1;
+            }
+
+            if (isdir && vtoydm_iso_walk_dir(child_extent, child_size, depth + 1))
+            {
+                free(buf);
+                return 1;
+            }
+        }
+    }
+
+    /* stop when all the patterns are matched, but only after the whole directory is listed */
+    if (hit && g_iso_pattern_num > 0 && vtoydm_iso_all_matched())
+    {
+        g_iso_walk_stop = 1;
+    }
+
+    free(buf);
+    return 0;
+}
+
+/* return -1 if the image is not parsed at all, so that BabyISO can have a try */
+static int vtoydm_fast_dump_iso(void)
+{
+    int i;
+    unsigned char *pvd = NULL;
+    unsigned char *root = NULL;
+    char label[64] = {0};
+
+    g_iso_cache_buf = malloc(VTOYDM_ISO_CACHE_SECTORS * 2048);
+    pvd = malloc(2048 * 2);
+    if (NULL == g_iso_cache_buf || NULL == pvd)
+    {
+        goto fail;
+    }
+
+    g_iso_cache_start = g_iso_cache_num = 0;
+    if (vtoydm_read_iso_cache(16, 1, pvd) || pvd[0] != 1 || memcmp(pvd + 1, "CD001", 5))
+    {
+        debug("primary volume descriptor not found\n");
+        free(pvd);
+        free(g_iso_cache_buf);
+        g_iso_cache_buf = NULL;
+        return -1;
+    }
+
+    memcpy(label, pvd + 40, 32);
+    for (i = 31; i >= 0; i--)
+    {
+        if (label[i] != 0 && label[i] != ' ')
+        {
+            break;
+        }
+        label[i] = 0;
+    }
+
+    if (label[0] && g_iso_pattern_num == 0)
+    {
+        printf("VENTOY_ISO_LABEL %s\n", label);
+    }
+
+    /* the SP entry in the first record of root directory tells the rock ridge skip length */
+    root = pvd + 156;
+    if (vtoydm_read_iso_cache(vtoydm_iso_le32(root + 2), 1, pvd + 2048) == 0)
+    {
+        root = pvd + 2048;
+        if (root[0] >= 34 + 7 && root[34] == 'S' && root[35] == 'P' && root[38] == 0xBE && root[39] == 0xEF)
+        {
+            g_iso_rr = 1;
+            g_iso_rr_skip = root[40];
+        }
+    }
+
+    root = pvd + 156;
+    g_iso_walk_stop = 0;
+    if (vtoydm_iso_walk_dir(vtoydm_iso_le32(root + 2), vtoydm_iso_le32(root + 10), 1))
+    {
+        goto fail;
+    }
+
+    free(pvd);
+    free(g_iso_cache_buf);
+    g_iso_cache_buf = NULL;
+    return 0;
+
+fail:
+    if (pvd)
+    {
+        free(pvd);
+    }
+    if (g_iso_cache_buf)
+    {
+        free(g_iso_cache_buf);
+        g_iso_cache_buf = NULL;
+    }
+    return 1;
+}
+
 int vtoydm_dump_iso(const char *img_map_file, const char *diskname)
 {
     int i = 0;
+    int rc = 0;
     int len = 0;
     uint64_t sector_num;
     unsigned long ret;
@@ -306,9 +726,18 @@ int vtoydm_dump_iso(const char *img_map_file, const char *diskname)
     strncpy(g_disk_name, diskname, sizeof(g_disk_name) - 1);
     g_img_chunk = chunk;
     g_img_chunk_num = len / sizeof(ventoy_img_chunk);
+    vtoy_chain_init(&g_img_chain, g_img_chunk, len, 0, g_img_chunk_num, 0, 0, 0, 0, 0, 512);
 
     debug("iso file size : %llu\n", (unsigned long long)g_iso_file_size);
 
+    g_iso_sector_total = (uint32_t)(g_iso_file_size / 2048);
+    rc = vtoydm_fast_dump_iso();
+    if (rc >= 0)
+    {
+        free(chunk);
+        return rc;
+    }
+
     iso = BISO_AllocReadHandle();
     if (iso == NULL)
     {
@@ -366,6 +795,7 @@ static int vtoydm_extract_iso
 
     strncpy(g_disk_name, diskname, sizeof(g_disk_name) - 1);
     g_img_chunk_num = len / sizeof(ventoy_img_chunk);
+    vtoy_chain_init(&g_img_chain, g_img_chunk, len, 0, g_img_chunk_num, 0, 0, 0, 0, 0, 512);
 
     fp = fopen(outfile, "wb");
     if (fp == NULL)
@@ -422,6 +852,7 @@ static int vtoydm_print_extract_iso
 
     strncpy(g_disk_name, diskname, sizeof(g_disk_name) - 1);
     g_img_chunk_num = len / sizeof(ventoy_img_chunk);
+    vtoy_chain_init(&g_img_chain, g_img_chunk, len, 0, g_img_chunk_num, 0, 0, 0, 0, 0, 512);
 
     fp = fopen(outfile, "wb");
     if (fp == NULL)
@@ -482,6 +913,203 @@ static int vtoydm_print_extract_iso
 
 
 
+static int vtoydm_open_copy_src(const char *diskname, int direct)
+{
+    int fd;
+
+    fd = open(diskname, O_RDONLY | O_BINARY | (direct ? O_DIRECT : 0));
+    if (fd < 0)
+    {
+        return fd;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return fd;
+}
+
+/*
+ * Copy the whole image to a file (normally in tmpfs) for the toram distros.
+ * Each chunk is read with large aligned preads in disk order, optionally with O_DIRECT
+ * to bypass the page cache of the USB disk. If the disk refuses O_DIRECT (e.g. the chunk
+ * is not aligned with a 4K sector) we fall back to the buffered read.
+ */
+static int vtoydm_copy_iso
+(
+    const char *img_map_file, 
+    const char *diskname,
+    const char *outfile,
+    int direct,
+    int prealloc
+)
+{
+    int i;
+    int len;
+    int num;
+    int rc = 1;
+    int fd = -1;
+    int outfd = -1;
+    int tty = 0;
+    int percent = 0;
+    int last = -1;
+    ssize_t rdlen;
+    uint64_t total = 0;
+    uint64_t done = 0;
+    uint64_t remain;
+    uint64_t offset;
+    uint64_t outpos;
+    uint64_t freesize;
+    time_t start;
+    struct statfs fsinfo;
+    unsigned char *buf = MAP_FAILED;
+    ventoy_img_chunk *chunk = NULL;
+
+    chunk = vtoydm_get_img_map_data(img_map_file, &len);
+    if (NULL == chunk)
+    {
+        return 1;
+    }
+
+    num = len / sizeof(ventoy_img_chunk);
+    for (i = 0; i < num; i++)
+    {
+        total += (chunk[i].disk_end_sector + 1 - chunk[i].disk_start_sector) * 512;
+    }
+
+    fd = vtoydm_open_copy_src(diskname, direct);
+    if (fd < 0 && direct)
+    {
+        debug("Failed to open %s with O_DIRECT, try without it\n", diskname);
+        direct = 0;
+        fd = vtoydm_open_copy_src(diskname, direct);
+    }
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", diskname, errno);
+        goto end;
+    }
+
+    outfd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (outfd < 0)
+    {
+        fprintf(stderr, "Failed to create file %s err:%d\n", outfile, errno);
+        goto end;
+    }
+
+    if (prealloc)
+    {
+        /* fail at once instead of after copying gigabytes into a too small tmpfs */
+        if (fstatfs(outfd, &fsinfo) == 0)
+        {
+            freesize = (uint64_t)fsinfo.f_bavail * fsinfo.f_bsize;
+            if (freesize < total)
+            {
+                fprintf(stderr, "No enough space for %s, need %llu free %llu\n", outfile, 
+                        (unsigned long long)total, (unsigned long long)freesize);
+                goto end;
+            }
+        }
+
+        if (ftruncate(outfd, (off_t)total) < 0)
+        {
+            fprintf(stderr, "Failed to set file size %llu err:%d\n", (unsigned long long)total, errno);
+            goto end;
+        }
+    }
+
+    /* mmap buffer is page aligned, as O_DIRECT needs */
+    buf = mmap(NULL, VTOYDM_COPY_BUF_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to alloc memory len:%d err:%d\n", VTOYDM_COPY_BUF_SIZE, errno);
+        goto end;
+    }
+
+    tty = isatty(2);
+    start = time(NULL);
+
+    for (i = 0; i < num; i++)
+    {
+        offset = chunk[i].disk_start_sector * 512;
+        remain = (chunk[i].disk_end_sector + 1 - chunk[i].disk_start_sector) * 512;
+        outpos = (uint64_t)chunk[i].img_start_sector * 2048;
+
+        while (remain > 0)
+        {
+            rdlen = pread(fd, buf, remain > VTOYDM_COPY_BUF_SIZE ? VTOYDM_COPY_BUF_SIZE : (size_t)remain, (off_t)offset);
+            if (rdlen < 0 && errno == EINVAL && direct)
+            {
+                debug("O_DIRECT read failed at %llu, try without it\n", (unsigned long long)offset);
+                close(fd);
+                direct = 0;
+                fd = vtoydm_open_copy_src(diskname, direct);
+                if (fd < 0)
+                {
+                    fprintf(stderr, "Failed to open %s err:%d\n", diskname, errno);
+                    goto end;
+                }
+                continue;
+            }
+
+            if (rdlen <= 0)
+            {
+                fprintf(stderr, "Failed to read %s at %llu err:%d\n", diskname, (unsigned long long)offset, errno);
+                goto end;
+            }
+
+            if (pwrite(outfd, buf, rdlen, (off_t)outpos) != rdlen)
+            {
+                fprintf(stderr, "Failed to write %s err:%d\n", outfile, errno);
+                goto end;
+            }
+
+            offset += rdlen;
+            outpos += rdlen;
+            remain -= rdlen;
+            done += rdlen;
+
+            percent = (int)(done * 100 / total);
+            if (tty && percent != last)
+            {
+                fprintf(stderr, "\rcopy %d%%  %lluMB/%lluMB ", percent, 
+                        (unsigned long long)(done >> 20), (unsigned long long)(total >> 20));
+                last = percent;
+            }
+        }
+    }
+
+    if (tty)
+    {
+        fprintf(stderr, "\n");
+    }
+
+    printf("copy %lluMB to %s in %lds direct:%d\n", (unsigned long long)(total >> 20), 
+           outfile, (long)(time(NULL) - start), direct);
+    rc = 0;
+
+end:
+    if (buf != MAP_FAILED)
+    {
+        munmap(buf, VTOYDM_COPY_BUF_SIZE);
+    }
+
+    if (outfd >= 0)
+    {
+        close(outfd);
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    free(chunk);
+    return rc;
+}
+
 static int vtoydm_print_linear_table(const char *img_map_file, const char *diskname)
 {
     int i;
@@ -517,13 +1145,333 @@ static int vtoydm_print_linear_table(const char *img_map_file, const char *diskn
     return 0;
 }
 
+static int vtoydm_open_control(void)
+{
+    int fd;
+    FILE *fp = NULL;
+    unsigned int major = 0;
+    unsigned int minor = 0;
+
+    fd = open(VTOYDM_CONTROL, O_RDWR);
+    if (fd >= 0)
+    {
+        return fd;
+    }
+
+    /* udev has not created the control node yet, do it ourselves */
+    fp = fopen("/sys/class/misc/device-mapper/dev", "r");
+    if (fp)
+    {
+        if (fscanf(fp, "%u:%u", &major, &minor) != 2)
+        {
+            major = 0;
+        }
+        fclose(fp);
+    }
+
+    if (major == 0)
+    {
+        fprintf(stderr, "device-mapper is not available\n");
+        return -1;
+    }
+
+    debug("create %s %u:%u\n", VTOYDM_CONTROL, major, minor);
+
+    mkdir("/dev/mapper", 0755);
+    unlink(VTOYDM_CONTROL);
+    if (mknod(VTOYDM_CONTROL, S_IFCHR | 0600, VTOYDM_MKDEV(major, minor)) < 0)
+    {
+        fprintf(stderr, "Failed to create %s err:%d\n", VTOYDM_CONTROL, errno);
+        return -1;
+    }
+
+    fd = open(VTOYDM_CONTROL, O_RDWR);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", VTOYDM_CONTROL, errno);
+    }
+
+    return fd;
+}
+
+/*
+ * Create /dev/mapper/dmname for the new device as dmsetup does when there is no udev.
+ * A node left there with another dev number is replaced.
+ */
+static int vtoydm_create_node(const char *dmname, unsigned int major, unsigned int minor)
+{
+    char path[300];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "/dev/mapper/%s", dmname);
+
+    if (stat(path, &st) == 0)
+    {
+        if (S_ISBLK(st.st_mode) && st.st_rdev == VTOYDM_MKDEV(major, minor))
+        {
+            return 0;
+        }
+        unlink(path);
+    }
+
+    debug("create %s %u:%u\n", path, major, minor);
+
+    mkdir("/dev/mapper", 0755);
+    if (mknod(path, S_IFBLK | 0600, VTOYDM_MKDEV(major, minor)) < 0)
+    {
+        fprintf(stderr, "Failed to create %s err:%d\n", path, errno);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void vtoydm_init_ioctl(struct dm_ioctl *io, uint32_t size, const char *dmname, uint32_t flags)
+{
+    memset(io, 0, sizeof(struct dm_ioctl));
+
+    io->version[0] = DM_VERSION_MAJOR;
+    io->version[1] = 0;
+    io->version[2] = 0;
+    io->data_size = size;
+    io->data_start = sizeof(struct dm_ioctl);
+    io->flags = flags;
+    strncpy(io->name, dmname, sizeof(io->name) - 1);
+}
+
+/* append one target to the DM_TABLE_LOAD buffer, the params are padded to 8 bytes */
+static uint32_t vtoydm_add_target(char *buf, uint32_t pos, uint64_t start, uint64_t len, const char *type, const char *params)
+{
+    uint32_t paramlen;
+    struct dm_target_spec *spec = (struct dm_target_spec *)(buf + pos);
+
+    spec->sector_start = start;
+    spec->length = len;
+    strncpy(spec->target_type, type, sizeof(spec->target_type) - 1);
+
+    paramlen = snprintf((char *)(spec + 1), VTOYDM_PARAM_MAX, "%s", params);
+    paramlen = (paramlen + 1 + 7) & (~7U);
+
+    spec->next = sizeof(struct dm_target_spec) + paramlen;
+    return pos + spec->next;
+}
+
+/*
+ * DM_DEV_CREATE, DM_TABLE_LOAD with the num targets already in buf, then resume.
+ * The dm is removed again if any step fails.
+ */
+static int vtoydm_load_dm
+(
+    const char *dmname, 
+    int readonly,
+    char *buf, 
+    uint32_t pos, 
+    int num,
+    unsigned int *major,
+    unsigned int *minor
+)
+{
+    int fd = -1;
+    int rc = 1;
+    int created = 0;
+    uint32_t flags;
+    struct dm_ioctl *io = (struct dm_ioctl *)buf;
+
+    fd = vtoydm_open_control();
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    flags = readonly ? DM_READONLY_FLAG : 0;
+
+    vtoydm_init_ioctl(io, sizeof(struct dm_ioctl), dmname, flags);
+    if (ioctl(fd, DM_DEV_CREATE, io) < 0)
+    {
+        fprintf(stderr, "Failed to create dm %s err:%d\n", dmname, errno);
+        goto end;
+    }
+    created = 1;
+
+    vtoydm_init_ioctl(io, pos, dmname, flags);
+    io->target_count = num;
+    if (ioctl(fd, DM_TABLE_LOAD, io) < 0)
+    {
+        fprintf(stderr, "Failed to load dm table for %s err:%d\n", dmname, errno);
+        goto end;
+    }
+
+    /* DM_DEV_SUSPEND without DM_SUSPEND_FLAG means resume */
+    vtoydm_init_ioctl(io, sizeof(struct dm_ioctl), dmname, 0);
+    if (ioctl(fd, DM_DEV_SUSPEND, io) < 0)
+    {
+        fprintf(stderr, "Failed to resume dm %s err:%d\n", dmname, errno);
+        goto end;
+    }
+
+    *major = (unsigned int)((io->dev >> 8) & 0xfff);
+    *minor = (unsigned int)((io->dev & 0xff) | ((io->dev >> 12) & 0xfff00));
+
+    debug("dm %s created %u:%u with %d targets\n", dmname, *major, *minor, num);
+
+    if (vtoydm_create_node(dmname, *major, *minor))
+    {
+        goto end;
+    }
+
+    rc = 0;
+
+end:
+    if (rc && created)
+    {
+        vtoydm_init_ioctl(io, sizeof(struct dm_ioctl), dmname, 0);
+        ioctl(fd, DM_DEV_REMOVE, io);
+    }
+
+    close(fd);
+    return rc;
+}
+
+/*
+ * Create a linear device-mapper device for the image map, the same table
+ * as vtoydm -p prints, but loaded through DM_DEV_CREATE/DM_TABLE_LOAD/DM_DEV_SUSPEND
+ * so that no dmsetup is needed. The dev number of the new device is returned and
+ * /dev/mapper/dmname is created for it.
+ */
+int vtoydm_create_dm
+(
+    const char *img_map_file, 
+    const char *diskname, 
+    const char *dmname, 
+    int readonly,
+    unsigned int *major,
+    unsigned int *minor
+)
+{
+    int i;
+    int len = 0;
+    int num = 0;
+    int rc = 1;
+    uint32_t pos;
+    uint32_t size;
+    char params[VTOYDM_PARAM_MAX];
+    char *buf = NULL;
+    ventoy_img_chunk *chunk = NULL;
+
+    chunk = vtoydm_get_img_map_data(img_map_file, &len);
+    if (NULL == chunk)
+    {
+        return 1;
+    }
+
+    num = len / sizeof(ventoy_img_chunk);
+    size = sizeof(struct dm_ioctl) + num * (sizeof(struct dm_target_spec) + VTOYDM_PARAM_MAX);
+
+    buf = malloc(size);
+    if (NULL == buf)
+    {
+        fprintf(stderr, "Failed to malloc memory len:%u err:%d\n", size, errno);
+        goto end;
+    }
+    memset(buf, 0, size);
+
+    pos = sizeof(struct dm_ioctl);
+    for (i = 0; i < num; i++)
+    {
+        /* same as vtoydm -p, the image map is relative to the first partition */
+        snprintf(params, sizeof(params), "%s1 %llu", 
+                 diskname, (unsigned long long)chunk[i].disk_start_sector - 2048);
+        pos = vtoydm_add_target(buf, pos, (uint64_t)chunk[i].img_start_sector << 2,
+                                chunk[i].disk_end_sector + 1 - chunk[i].disk_start_sector, "linear", params);
+    }
+
+    rc = vtoydm_load_dm(dmname, readonly, buf, pos, num, major, minor);
+
+end:
+    if (buf)
+    {
+        free(buf);
+    }
+
+    free(chunk);
+    return rc;
+}
+
+/*
+ * Create a device-mapper device from a dmsetup table file, one target per line:
+ * "start length type params", e.g. the vtoy_dm_table lines grub passes for the
+ * partitions of a vtoy image.
+ */
+int vtoydm_create_table_dm
+(
+    const char *table_file, 
+    const char *dmname, 
+    int readonly,
+    unsigned int *major,
+    unsigned int *minor
+)
+{
+    int num = 0;
+    int rc = 1;
+    uint32_t pos;
+    unsigned long long start;
+    unsigned long long len;
+    char type[16];
+    char params[VTOYDM_PARAM_MAX];
+    char line[256];
+    char buf[sizeof(struct dm_ioctl) + VTOYDM_TABLE_MAX * (sizeof(struct dm_target_spec) + VTOYDM_PARAM_MAX)];
+    FILE *fp = NULL;
+
+    fp = fopen(table_file, "r");
+    if (NULL == fp)
+    {
+        fprintf(stderr, "Failed to open file %s err:%d\n", table_file, errno);
+        return 1;
+    }
+
+    memset(buf, 0, sizeof(buf));
+    pos = sizeof(struct dm_ioctl);
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        params[0] = 0;
+        if (sscanf(line, "%llu %llu %15s %159[^\n]", &start, &len, type, params) < 3)
+        {
+            continue;
+        }
+
+        if (num >= VTOYDM_TABLE_MAX)
+        {
+            fprintf(stderr, "Too many targets in %s\n", table_file);
+            goto end;
+        }
+
+        pos = vtoydm_add_target(buf, pos, start, len, type, params);
+        num++;
+    }
+
+    if (num == 0)
+    {
+        fprintf(stderr, "No target in %s\n", table_file);
+        goto end;
+    }
+
+    rc = vtoydm_load_dm(dmname, readonly, buf, pos, num, major, minor);
+
+end:
+    fclose(fp);
+    return rc;
+}
+
 static int vtoydm_print_help(FILE *fp)
 {
     fprintf(fp, "Usage: \n"
             "   vtoydm -p -f img_map_file -d diskname [ -v ] \n"
-            "   vtoydm -c -f img_map_file -d diskname [ -v ] \n"
-            "   vtoydm -i -f img_map_file -d diskname [ -v ] \n"
+            "   vtoydm -c -f img_map_file -d diskname [ -n dmname ] [ -r ] [ -v ] \n"
+            "   vtoydm -c -T dm_table_file [ -n dmname ] [ -r ] [ -v ] \n"
+            "   vtoydm -i -f img_map_file -d diskname [ -m pattern | -M pattern ]... [ -v ] \n"
             "   vtoydm -e -f img_map_file -d diskname -s sector -l len -o file [ -v ] \n"
+            "   vtoydm -x -f img_map_file -d diskname -o file [ -D ] [ -a ] [ -v ] \n"
             );
     return 0;        
 }
@@ -532,13 +1480,20 @@ int vtoydm_main(int argc, char **argv)
 {
     int ch;
     int cmd = 0;
+    int readonly = 0;
+    int direct = 0;
+    int prealloc = 0;
+    unsigned int major = 0;
+    unsigned int minor = 0;
     unsigned long first_sector = 0;
     unsigned long long file_size = 0;
     char diskname[128] = {0};
     char filepath[300] = {0};
     char outfile[300] = {0};
+    char dmname[128] = {0};
+    char tablepath[300] = {0};
 
-    while ((ch = getopt(argc, argv, "s:l:o:d:f:v::i::p::c::h::e::E::")) != -1)
+    while ((ch = getopt(argc, argv, "s:l:o:d:f:n:m:M:T:r::v::i::p::c::h::e::E::x::D::a::")) != -1)
     {
         if (ch == 'd')
         {
@@ -568,6 +1523,18 @@ int vtoydm_main(int argc, char **argv)
         {
             cmd = CMD_PRINT_EXTRACT_ISO_FILE;
         }
+        else if (ch == 'x')
+        {
+            cmd = CMD_COPY_ISO_FILE;
+        }
+        else if (ch == 'D')
+        {
+            direct = 1;
+        }
+        else if (ch == 'a')
+        {
+            prealloc = 1;
+        }
         else if (ch == 's')
         {
             first_sector = strtoul(optarg, NULL, 10);
@@ -580,6 +1547,26 @@ int vtoydm_main(int argc, char **argv)
         {
             strncpy(outfile, optarg, sizeof(outfile) - 1);
         }
+        else if (ch == 'n')
+        {
+            strncpy(dmname, optarg, sizeof(dmname) - 1);
+        }
+        else if (ch == 'T')
+        {
+            strncpy(tablepath, optarg, sizeof(tablepath) - 1);
+        }
+        else if (ch == 'r')
+        {
+            readonly = 1;
+        }
+        else if (ch == 'm' || ch == 'M')
+        {
+            if (g_iso_pattern_num < VTOYDM_ISO_MAX_PATTERN)
+            {
+                g_iso_pattern_all[g_iso_pattern_num] = (ch == 'M') ? 1 : 0;
+                g_iso_pattern[g_iso_pattern_num++] = optarg;
+            }
+        }
         else if (ch == 'v')
         {
             verbose = 1;
@@ -595,6 +1582,17 @@ int vtoydm_main(int argc, char **argv)
         }
     }
 
+    if (cmd == CMD_CREATE_DM && tablepath[0])
+    {
+        if (vtoydm_create_table_dm(tablepath, dmname[0] ? dmname : "ventoy", readonly, &major, &minor))
+        {
+            return 1;
+        }
+
+        printf("%u %u\n", major, minor);
+        return 0;
+    }
+
     if (filepath[0] == 0 || diskname[0] == 0)
     {
         fprintf(stderr, "Must input file and disk\n");
@@ -612,7 +1610,13 @@ int vtoydm_main(int argc, char **argv)
         }
         case CMD_CREATE_DM:
         {
-            break;
+            if (vtoydm_create_dm(filepath, diskname, dmname[0] ? dmname : "ventoy", readonly, &major, &minor))
+            {
+                return 1;
+            }
+
+            printf("%u %u\n", major, minor);
+            return 0;
         }
         case CMD_DUMP_ISO_INFO:
         {
@@ -626,6 +1630,10 @@ int vtoydm_main(int argc, char **argv)
         {
             return vtoydm_print_extract_iso(filepath, diskname, first_sector, file_size, outfile);
         }
+        case CMD_COPY_ISO_FILE:
+        {
+            return vtoydm_copy_iso(filepath, diskname, outfile, direct, prealloc);
+        }
         default :
         {
             fprintf(stderr, "Invalid cmd \n");
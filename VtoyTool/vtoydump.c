@@ -30,7 +30,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <linux/fs.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
 #include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/time.h>
+#include <getopt.h>
 
 #define IS_DIGIT(x) ((x) >= '0' && (x) <= '9')
 
@@ -134,6 +140,15 @@ typedef struct ventoy_os_param
 #define MMAP_FLAGS          MAP_PRIVATE
 #endif
 
+#define VTOY_UEVENT_LEN     4096
+#define VTOY_DISK_CACHE     "/ventoy/vtoydump_disk_cache"
+
+/*
+ * Without uevent (or with mdev creating the nodes a bit later than the uevent)
+ * we still recheck the disk at this interval.
+ */
+#define VTOY_RECHECK_MS     500
+
 #define SEARCH_MEM_START 0x80000
 #define SEARCH_MEM_LEN   0x1c000
 
@@ -242,8 +257,7 @@ static int vtoy_get_disk_guid(const char *diskname, uint8_t *vtguid)
     fd = open(devdisk, O_RDONLY | O_BINARY);
     if (fd >= 0)
     {
-        lseek(fd, 0x180, SEEK_SET);
-        read(fd, vtguid, 16);
+        pread(fd, vtguid, 16, 0x180);
         close(fd);
 
         debug("GUID for %s: <", devdisk);
@@ -380,10 +394,15 @@ static int vtoy_find_disk_by_size(unsigned long long size, char *diskname)
     return rc;    
 }
 
-static int vtoy_find_disk_by_guid(uint8_t *guid, char *diskname)
+/*
+ * size is used to filter the disks before opening them to read the GUID,
+ * 0 means no filter. Same as vtoy_check_device, the disk may be 512 bytes less.
+ */
+static int vtoy_find_disk_by_guid(uint8_t *guid, unsigned long long size, char *diskname)
 {
     int rc = 0;
     int count = 0;
+    unsigned long long cursize = 0;
     DIR* dir = NULL;
     struct dirent* p = NULL;
     uint8_t vtguid[16];
@@ -401,6 +420,16 @@ static int vtoy_find_disk_by_guid(uint8_t *guid, char *diskname)
             debug("disk %s is filted by name\n", p->d_name);        
             continue;
         }
+
+        if (size > 0)
+        {
+            cursize = vtoy_get_disk_size_in_byte(p->d_name);
+            if (cursize != size && cursize + 512 != size)
+            {
+                debug("disk %s is filted by size %llu\n", p->d_name, cursize);
+                continue;
+            }
+        }
     
         memset(vtguid, 0, sizeof(vtguid));
         rc = vtoy_get_disk_guid(p->d_name, vtguid);
@@ -421,23 +450,326 @@ static int vtoy_printf_iso_path(ventoy_os_param *param)
     return 0;
 }
 
-static int vtoy_print_os_param(ventoy_os_param *param, char *diskname)
+static unsigned long long vtoy_get_uevent_seqnum(void)
 {
-    int   cnt = 0;
-    char *path = param->vtoy_img_path;
-    const char *fs;
+    int fd;
+    char buf[64] = {0};
+
+    fd = open("/sys/kernel/uevent_seqnum", O_RDONLY | O_BINARY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+
+    return strtoull(buf, NULL, 10);
+}
+
+static void vtoy_disk_cache_key(ventoy_os_param *param, char *key)
+{
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        sprintf(key + i * 2, "%02x", param->vtoy_disk_guid[i]);
+    }
+    sprintf(key + 32, "-%llu", (unsigned long long)param->vtoy_disk_size);
+}
+
+/*
+ * The hooks look for the ventoy disk again and again, while the block devices
+ * only change with uevent. So the result is cached with the uevent seqnum.
+ */
+static int vtoy_read_disk_cache(ventoy_os_param *param, unsigned long long seqnum, char *diskname)
+{
+    int rc = 1;
+    FILE *fp = NULL;
+    unsigned long long cacheseq = 0;
+    char key[64];
+    char cachekey[64];
+    char name[128];
+    char path[256];
+
+    fp = fopen(VTOY_DISK_CACHE, "r");
+    if (NULL == fp)
+    {
+        return 1;
+    }
+
+    vtoy_disk_cache_key(param, key);
+    if (fscanf(fp, "%llu %63s %127s", &cacheseq, cachekey, name) == 3 &&
+        cacheseq == seqnum && strcmp(key, cachekey) == 0)
+    {
+        snprintf(path, sizeof(path), "/sys/block/%s", name);
+        if (access(path, F_OK) >= 0)
+        {
+            debug("find disk %s in cache, seqnum %llu\n", name, seqnum);
+            sprintf(diskname, "%s", name);
+            rc = 0;
+        }
+    }
+
+    fclose(fp);
+    return rc;
+}
+
+static void vtoy_write_disk_cache(ventoy_os_param *param, unsigned long long seqnum, const char *diskname)
+{
+    FILE *fp = NULL;
+    char key[64];
+
+    fp = fopen(VTOY_DISK_CACHE, "w");
+    if (fp)
+    {
+        vtoy_disk_cache_key(param, key);
+        fprintf(fp, "%llu %s %s\n", seqnum, key, diskname);
+        fclose(fp);
+    }
+}
+
+static int vtoy_find_ventoy_disk(ventoy_os_param *param, char *diskname)
+{
+    int cnt = 0;
+    unsigned long long seqnum;
+
+    /* get seqnum before scan, so that any uevent during the scan invalidates the cache */
+    seqnum = vtoy_get_uevent_seqnum();
+    if (seqnum > 0 && vtoy_read_disk_cache(param, seqnum, diskname) == 0)
+    {
+        return 1;
+    }
 
     cnt = vtoy_find_disk_by_size(param->vtoy_disk_size, diskname);
     if (cnt > 1)
     {
-        cnt = vtoy_find_disk_by_guid(param->vtoy_disk_guid, diskname);
+        cnt = vtoy_find_disk_by_guid(param->vtoy_disk_guid, param->vtoy_disk_size, diskname);
     }
     else if (cnt == 0)
     {
-        cnt = vtoy_find_disk_by_guid(param->vtoy_disk_guid, diskname);
+        cnt = vtoy_find_disk_by_guid(param->vtoy_disk_guid, param->vtoy_disk_size, diskname);
+        if (cnt == 0)
+        {
+            cnt = vtoy_find_disk_by_guid(param->vtoy_disk_guid, 0, diskname);
+        }
         debug("find 0 disk by size, try with guid cnt=%d...\n", cnt);
     }
 
+    if (cnt == 1 && seqnum > 0)
+    {
+        vtoy_write_disk_cache(param, seqnum, diskname);
+    }
+
+    return cnt;
+}
+
+static int vtoy_uevent_open(void)
+{
+    int fd;
+    struct sockaddr_nl addr;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0)
+    {
+        debug("Failed to open uevent socket err:%d\n", errno);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_pid = 0;
+    addr.nl_groups = 1; /* kernel events, no matter whether udev is running */
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        debug("Failed to bind uevent socket err:%d\n", errno);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Read all the pending uevents, return 1 if any of them is a block device add/change.
+ * The message is "ACTION@DEVPATH\0KEY=VALUE\0KEY=VALUE\0..."
+ */
+static int vtoy_uevent_block(int fd, char *buf, int buflen)
+{
+    int i;
+    int len;
+    int block = 0;
+    int action = 0;
+    int subsys = 0;
+    char *key = NULL;
+
+    while ((len = (int)recv(fd, buf, buflen - 1, MSG_DONTWAIT)) > 0)
+    {
+        buf[len] = 0;
+        action = subsys = 0;
+
+        for (i = 0; i < len; i += strlen(buf + i) + 1)
+        {
+            key = buf + i;
+            if (strcmp(key, "ACTION=add") == 0 || strcmp(key, "ACTION=change") == 0)
+            {
+                action = 1;
+            }
+            else if (strcmp(key, "SUBSYSTEM=block") == 0)
+            {
+                subsys = 1;
+            }
+        }
+
+        debug("uevent <%s> action:%d block:%d\n", buf, action, subsys);
+        if (action && subsys)
+        {
+            block = 1;
+        }
+    }
+
+    return block;
+}
+
+/* partition N of sdb is sdbN, and for nvme0n1/mmcblk0 it's nvme0n1pN/mmcblk0pN */
+static int vtoy_part_ready(const char *diskname, int part)
+{
+    int i;
+    int devnode;
+    char path[300];
+    const char *fmt[2] = { "%s%d", "%sp%d" };
+    char partname[128];
+
+    /* some hooks create the nodes by themselves, then only wait for the kernel */
+    snprintf(path, sizeof(path), "/dev/%s", diskname);
+    devnode = (access(path, F_OK) >= 0);
+
+    for (i = 0; i < 2; i++)
+    {
+        snprintf(partname, sizeof(partname), fmt[i], diskname, part);
+        snprintf(path, sizeof(path), "/sys/block/%s/%s", diskname, partname);
+        if (access(path, F_OK) < 0)
+        {
+            continue;
+        }
+
+        if (devnode == 0)
+        {
+            return 1;
+        }
+
+        snprintf(path, sizeof(path), "/dev/%s", partname);
+        if (access(path, F_OK) >= 0)
+        {
+            return 1;
+        }
+
+        debug("%s not ready\n", path);
+        return 0;
+    }
+
+    debug("partition %d of %s not found\n", part, diskname);
+    return 0;
+}
+
+static uint64_t vtoy_dump_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*
+ * Wait until the ventoy disk and its 2 partitions are there.
+ * Instead of a sleep loop, we wait for kernel uevent of block device through netlink.
+ * A block uevent triggers the check at once, and it is done anyway every VTOY_RECHECK_MS,
+ * however many other uevents arrive meanwhile.
+ */
+static int vtoy_wait_disk(ventoy_os_param *param, char *diskname, int timeout)
+{
+    int fd;
+    int rc = 1;
+    int wait;
+    int recheck = 1;
+    time_t start;
+    uint64_t now;
+    uint64_t next = 0;
+    struct pollfd pfd;
+    char *buf = NULL;
+
+    buf = malloc(VTOY_UEVENT_LEN);
+    if (NULL == buf)
+    {
+        fprintf(stderr, "failed to alloc memory with size %d error %d\n", VTOY_UEVENT_LEN, errno);
+        return 1;
+    }
+
+    /* open the socket before the first check, so that no event is missed between */
+    fd = vtoy_uevent_open();
+    start = time(NULL);
+
+    while (1)
+    {
+        now = vtoy_dump_ms();
+        if (recheck || now >= next)
+        {
+            next = now + VTOY_RECHECK_MS;
+            if (vtoy_find_ventoy_disk(param, diskname) == 1 && 
+                vtoy_part_ready(diskname, 1) && vtoy_part_ready(diskname, 2))
+            {
+                debug("ventoy disk %s is ready\n", diskname);
+                rc = 0;
+                break;
+            }
+        }
+
+        if (timeout > 0 && time(NULL) - start > timeout)
+        {
+            fprintf(stderr, "Wait for ventoy disk timeout\n");
+            break;
+        }
+
+        /* wait no longer than the next timed check */
+        now = vtoy_dump_ms();
+        wait = (next > now) ? (int)(next - now) : 0;
+        recheck = 0;
+
+        if (fd >= 0)
+        {
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            if (poll(&pfd, 1, wait) > 0)
+            {
+                recheck = vtoy_uevent_block(fd, buf, VTOY_UEVENT_LEN);
+            }
+        }
+        else
+        {
+            usleep(wait * 1000);
+        }
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    free(buf);
+    return rc;
+}
+
+static int vtoy_print_os_param(ventoy_os_param *param, char *diskname)
+{
+    int   cnt = 0;
+    char *path = param->vtoy_img_path;
+    const char *fs;
+
+    cnt = vtoy_find_ventoy_disk(param, diskname);
+
     if (param->vtoy_disk_part_type < ventoy_fs_max)
     {
         fs = g_ventoy_fs[param->vtoy_disk_part_type];
@@ -484,6 +816,30 @@ static int vtoy_check_device(ventoy_os_param *param, const char *device)
     }
 }
 
+/*
+ * Same as vtoydump --wait but only output the disk, e.g. /dev/sdb
+ * Used by vtoyhook in the same process instead of spawning vtoydump.
+ */
+int vtoydump_wait_disk(const char *filename, char *diskname, int len, int timeout)
+{
+    char name[256] = {0};
+    ventoy_os_param param;
+
+    memset(&param, 0, sizeof(param));
+    if (vtoy_os_param_from_file(filename, &param))
+    {
+        return 1;
+    }
+
+    if (vtoy_wait_disk(&param, name, timeout))
+    {
+        return 1;
+    }
+
+    snprintf(diskname, len, "/dev/%s", name);
+    return 0;
+}
+
 /*
  *  Find disk and image path from ventoy runtime data.
  *  By default data is read from phymem(legacy bios) or efivar(UEFI), if -f is input, data is read from file.
@@ -492,18 +848,27 @@ static int vtoy_check_device(ventoy_os_param *param, const char *device)
  *  -c /dev/xxx     check ventoy disk
  *  -v              be verbose
  *  -l              also print image disk location 
+ *  --wait          wait until the ventoy disk and its partitions are ready, then print it
+ *  -t timeout      timeout in seconds for --wait, default 0 (forever)
  */
 int vtoydump_main(int argc, char **argv)
 {
     int rc;
     int ch;
     int print_path = 0;
+    int wait = 0;
+    int timeout = 0;
     char filename[256] = {0};
     char diskname[256] = {0};
     char device[64] = {0};
     ventoy_os_param *param = NULL;
+    struct option long_options[] = 
+    {
+        { "wait", no_argument, NULL, 'w' },
+        { NULL,   0,           NULL,  0  }
+    };
 
-    while ((ch = getopt(argc, argv, "c:f:p:v::")) != -1)
+    while ((ch = getopt_long(argc, argv, "c:f:p:t:v::", long_options, NULL)) != -1)
     {
         if (ch == 'f')
         {
@@ -522,16 +887,24 @@ int vtoydump_main(int argc, char **argv)
             print_path = 1;
             strncpy(filename, optarg, sizeof(filename) - 1);
         }
+        else if (ch == 'w')
+        {
+            wait = 1;
+        }
+        else if (ch == 't')
+        {
+            timeout = (int)strtol(optarg, NULL, 10);
+        }
         else
         {
-            fprintf(stderr, "Usage: %s -f datafile [ -v ] \n", argv[0]);
+            fprintf(stderr, "Usage: %s -f datafile [ --wait [ -t timeout ] ] [ -v ] \n", argv[0]);
             return 1;
         }
     }
 
     if (filename[0] == 0)
     {
-        fprintf(stderr, "Usage: %s -f datafile [ -v ] \n", argv[0]);
+        fprintf(stderr, "Usage: %s -f datafile [ --wait [ -t timeout ] ] [ -v ] \n", argv[0]);
         return 1;
     }
 
@@ -568,6 +941,15 @@ int vtoydump_main(int argc, char **argv)
     }
     else
     {
+        if (wait)
+        {
+            rc = vtoy_wait_disk(param, diskname, timeout);
+            if (rc)
+            {
+                goto end;
+            }
+        }
+
         // print os param, you can change the output format in the function
         rc = vtoy_print_os_param(param, diskname);
     }
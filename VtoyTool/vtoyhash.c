@@ -0,0 +1,809 @@
+/******************************************************************************
+ * vtoyhash.c  ---- ventoy image checksum through the image chunk map
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "vtoychain.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define VTOYHASH_NUM        4
+#define VTOYHASH_BUF_SIZE   (4 * 1024 * 1024)
+
+static int verbose = 0;
+#define debug(fmt, ...) if(verbose) printf(fmt, ##__VA_ARGS__)
+
+ventoy_img_chunk * vtoydm_get_img_map_data(const char *img_map_file, int *plen);
+
+/*
+ * The same digests as vt_img_hash in grub, computed in one pass over the image chunks,
+ * so the result (and the read speed) of the grub command can be checked on Linux.
+ * The state is 32bit words for md5/sha1/sha256 and 64bit words for sha512.
+ */
+typedef struct vtoy_hash_ctx
+{
+    union
+    {
+        uint32_t w32[8];
+        uint64_t w64[8];
+    }state;
+    uint64_t total;
+    uint32_t used;
+    uint8_t  block[128];
+}vtoy_hash_ctx;
+
+typedef struct vtoy_hash_algo
+{
+    const char *name;
+    uint32_t blocksize;
+    uint32_t mdlen;
+    void (*init)(vtoy_hash_ctx *ctx);
+    void (*compress)(vtoy_hash_ctx *ctx, const uint8_t *block);
+    void (*output)(vtoy_hash_ctx *ctx, uint8_t *md);
+    int  bigendian;
+}vtoy_hash_algo;
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static uint32_t vtoy_get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t vtoy_get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t vtoy_get_be64(const uint8_t *p)
+{
+    return ((uint64_t)vtoy_get_be32(p) << 32) | vtoy_get_be32(p + 4);
+}
+
+static void vtoy_put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void vtoy_put_be64(uint8_t *p, uint64_t v)
+{
+    vtoy_put_be32(p, (uint32_t)(v >> 32));
+    vtoy_put_be32(p + 4, (uint32_t)v);
+}
+
+/* ======================================= MD5 ======================================= */
+static const uint32_t g_md5_k[64] =
+{
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const uint8_t g_md5_r[64] =
+{
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static void vtoy_md5_init(vtoy_hash_ctx *ctx)
+{
+    ctx->state.w32[0] = 0x67452301;
+    ctx->state.w32[1] = 0xefcdab89;
+    ctx->state.w32[2] = 0x98badcfe;
+    ctx->state.w32[3] = 0x10325476;
+}
+
+static void vtoy_md5_compress(vtoy_hash_ctx *ctx, const uint8_t *block)
+{
+    int i;
+    uint32_t f, g, t;
+    uint32_t m[16];
+    uint32_t a = ctx->state.w32[0];
+    uint32_t b = ctx->state.w32[1];
+    uint32_t c = ctx->state.w32[2];
+    uint32_t d = ctx->state.w32[3];
+
+    for (i = 0; i < 16; i++)
+    {
+        m[i] = vtoy_get_le32(block + i * 4);
+    }
+
+    for (i = 0; i < 64; i++)
+    {
+        if (i < 16)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if (i < 32)
+        {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) & 15;
+        }
+        else if (i < 48)
+        {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) & 15;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7 * i) & 15;
+        }
+
+        t = d;
+        d = c;
+        c = b;
+        b = b + ROL32(a + f + g_md5_k[i] + m[g], g_md5_r[i]);
+        a = t;
+    }
+
+    ctx->state.w32[0] += a;
+    ctx->state.w32[1] += b;
+    ctx->state.w32[2] += c;
+    ctx->state.w32[3] += d;
+}
+
+static void vtoy_md5_output(vtoy_hash_ctx *ctx, uint8_t *md)
+{
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        md[i] = (uint8_t)(ctx->state.w32[i / 4] >> ((i % 4) * 8));
+    }
+}
+
+/* ======================================= SHA1 ====================================== */
+static void vtoy_sha1_init(vtoy_hash_ctx *ctx)
+{
+    ctx->state.w32[0] = 0x67452301;
+    ctx->state.w32[1] = 0xefcdab89;
+    ctx->state.w32[2] = 0x98badcfe;
+    ctx->state.w32[3] = 0x10325476;
+    ctx->state.w32[4] = 0xc3d2e1f0;
+}
+
+static void vtoy_sha1_compress(vtoy_hash_ctx *ctx, const uint8_t *block)
+{
+    int i;
+    uint32_t f, k, t;
+    uint32_t w[80];
+    uint32_t a = ctx->state.w32[0];
+    uint32_t b = ctx->state.w32[1];
+    uint32_t c = ctx->state.w32[2];
+    uint32_t d = ctx->state.w32[3];
+    uint32_t e = ctx->state.w32[4];
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = vtoy_get_be32(block + i * 4);
+    }
+
+    for (i = 16; i < 80; i++)
+    {
+        w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    for (i = 0; i < 80; i++)
+    {
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+
+        t = ROL32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL32(b, 30);
+        b = a;
+        a = t;
+    }
+
+    ctx->state.w32[0] += a;
+    ctx->state.w32[1] += b;
+    ctx->state.w32[2] += c;
+    ctx->state.w32[3] += d;
+    ctx->state.w32[4] += e;
+}
+
+static void vtoy_sha1_output(vtoy_hash_ctx *ctx, uint8_t *md)
+{
+    int i;
+
+    for (i = 0; i < 5; i++)
+    {
+        vtoy_put_be32(md + i * 4, ctx->state.w32[i]);
+    }
+}
+
+/* ====================================== SHA256 ===================================== */
+static const uint32_t g_sha256_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void vtoy_sha256_init(vtoy_hash_ctx *ctx)
+{
+    ctx->state.w32[0] = 0x6a09e667;
+    ctx->state.w32[1] = 0xbb67ae85;
+    ctx->state.w32[2] = 0x3c6ef372;
+    ctx->state.w32[3] = 0xa54ff53a;
+    ctx->state.w32[4] = 0x510e527f;
+    ctx->state.w32[5] = 0x9b05688c;
+    ctx->state.w32[6] = 0x1f83d9ab;
+    ctx->state.w32[7] = 0x5be0cd19;
+}
+
+static void vtoy_sha256_compress(vtoy_hash_ctx *ctx, const uint8_t *block)
+{
+    int i;
+    uint32_t s0, s1, t1, t2;
+    uint32_t w[64];
+    uint32_t v[8];
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = vtoy_get_be32(block + i * 4);
+    }
+
+    for (i = 16; i < 64; i++)
+    {
+        s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(v, ctx->state.w32, sizeof(v));
+
+    for (i = 0; i < 64; i++)
+    {
+        t1 = v[7] + (ROR32(v[4], 6) ^ ROR32(v[4], 11) ^ ROR32(v[4], 25)) +
+             ((v[4] & v[5]) ^ (~v[4] & v[6])) + g_sha256_k[i] + w[i];
+        t2 = (ROR32(v[0], 2) ^ ROR32(v[0], 13) ^ ROR32(v[0], 22)) +
+             ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+        memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + t2;
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        ctx->state.w32[i] += v[i];
+    }
+}
+
+static void vtoy_sha256_output(vtoy_hash_ctx *ctx, uint8_t *md)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        vtoy_put_be32(md + i * 4, ctx->state.w32[i]);
+    }
+}
+
+/* ====================================== SHA512 ===================================== */
+static const uint64_t g_sha512_k[80] =
+{
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static void vtoy_sha512_init(vtoy_hash_ctx *ctx)
+{
+    ctx->state.w64[0] = 0x6a09e667f3bcc908ULL;
+    ctx->state.w64[1] = 0xbb67ae8584caa73bULL;
+    ctx->state.w64[2] = 0x3c6ef372fe94f82bULL;
+    ctx->state.w64[3] = 0xa54ff53a5f1d36f1ULL;
+    ctx->state.w64[4] = 0x510e527fade682d1ULL;
+    ctx->state.w64[5] = 0x9b05688c2b3e6c1fULL;
+    ctx->state.w64[6] = 0x1f83d9abfb41bd6bULL;
+    ctx->state.w64[7] = 0x5be0cd19137e2179ULL;
+}
+
+static void vtoy_sha512_compress(vtoy_hash_ctx *ctx, const uint8_t *block)
+{
+    int i;
+    uint64_t s0, s1, t1, t2;
+    uint64_t w[80];
+    uint64_t v[8];
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = vtoy_get_be64(block + i * 8);
+    }
+
+    for (i = 16; i < 80; i++)
+    {
+        s0 = ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+        s1 = ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(v, ctx->state.w64, sizeof(v));
+
+    for (i = 0; i < 80; i++)
+    {
+        t1 = v[7] + (ROR64(v[4], 14) ^ ROR64(v[4], 18) ^ ROR64(v[4], 41)) +
+             ((v[4] & v[5]) ^ (~v[4] & v[6])) + g_sha512_k[i] + w[i];
+        t2 = (ROR64(v[0], 28) ^ ROR64(v[0], 34) ^ ROR64(v[0], 39)) +
+             ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+        memmove(v + 1, v, 7 * sizeof(uint64_t));
+        v[4] += t1;
+        v[0] = t1 + t2;
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        ctx->state.w64[i] += v[i];
+    }
+}
+
+static void vtoy_sha512_output(vtoy_hash_ctx *ctx, uint8_t *md)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        vtoy_put_be64(md + i * 8, ctx->state.w64[i]);
+    }
+}
+
+static vtoy_hash_algo g_hash_algo[VTOYHASH_NUM] =
+{
+    { "md5",     64, 16, vtoy_md5_init,    vtoy_md5_compress,    vtoy_md5_output,    0 },
+    { "sha1",    64, 20, vtoy_sha1_init,   vtoy_sha1_compress,   vtoy_sha1_output,   1 },
+    { "sha256",  64, 32, vtoy_sha256_init, vtoy_sha256_compress, vtoy_sha256_output, 1 },
+    { "sha512", 128, 64, vtoy_sha512_init, vtoy_sha512_compress, vtoy_sha512_output, 1 },
+};
+
+static void vtoy_hash_update(vtoy_hash_algo *algo, vtoy_hash_ctx *ctx, const uint8_t *data, uint64_t len)
+{
+    uint32_t n;
+
+    ctx->total += len;
+
+    if (ctx->used > 0)
+    {
+        n = algo->blocksize - ctx->used;
+        if (n > len)
+        {
+            n = (uint32_t)len;
+        }
+
+        memcpy(ctx->block + ctx->used, data, n);
+        ctx->used += n;
+        data += n;
+        len -= n;
+
+        if (ctx->used < algo->blocksize)
+        {
+            return;
+        }
+
+        algo->compress(ctx, ctx->block);
+        ctx->used = 0;
+    }
+
+    /* whole blocks straight from the read buffer */
+    while (len >= algo->blocksize)
+    {
+        algo->compress(ctx, data);
+        data += algo->blocksize;
+        len -= algo->blocksize;
+    }
+
+    if (len > 0)
+    {
+        memcpy(ctx->block, data, (size_t)len);
+        ctx->used = (uint32_t)len;
+    }
+}
+
+static void vtoy_hash_final(vtoy_hash_algo *algo, vtoy_hash_ctx *ctx, uint8_t *md)
+{
+    int i;
+    uint32_t lenpos;
+    uint64_t bits = ctx->total << 3;
+
+    /* the length field is 8 bytes, 16 bytes for sha512 (the high 8 bytes are 0 here) */
+    lenpos = algo->blocksize - ((algo->blocksize == 128) ? 16 : 8);
+
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > lenpos)
+    {
+        memset(ctx->block + ctx->used, 0, algo->blocksize - ctx->used);
+        algo->compress(ctx, ctx->block);
+        ctx->used = 0;
+    }
+
+    memset(ctx->block + ctx->used, 0, algo->blocksize - ctx->used);
+
+    for (i = 0; i < 8; i++)
+    {
+        if (algo->bigendian)
+        {
+            ctx->block[algo->blocksize - 1 - i] = (uint8_t)(bits >> (i * 8));
+        }
+        else
+        {
+            ctx->block[lenpos + i] = (uint8_t)(bits >> (i * 8));
+        }
+    }
+
+    algo->compress(ctx, ctx->block);
+    algo->output(ctx, md);
+}
+
+/* hash a buffer in one call (used by vtoywim), return 0 for success */
+int vtoyhash_buf(const char *name, const void *data, uint64_t len, uint8_t *md)
+{
+    int i;
+    vtoy_hash_ctx ctx;
+
+    for (i = 0; i < VTOYHASH_NUM; i++)
+    {
+        if (strcmp(name, g_hash_algo[i].name) == 0)
+        {
+            memset(&ctx, 0, sizeof(ctx));
+            g_hash_algo[i].init(&ctx);
+            vtoy_hash_update(g_hash_algo + i, &ctx, (const uint8_t *)data, len);
+            vtoy_hash_final(g_hash_algo + i, &ctx, md);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int vtoy_hash_print_help(FILE *fp)
+{
+    fprintf(fp, "Usage: vtoyhash -f img_map_file -d diskname [ -l file_size ] [ -t md5|sha1|sha256|sha512 ]... [ -v ] \n"
+            "   sha256 if no -t is given, the image size in the map (2048 aligned) if no -l is given \n");
+    return 0;
+}
+
+/*
+ * Hash the image in the map with 4MB preads.
+ * The kernel is asked to read the next buffer (WILLNEED) before the current one is hashed,
+ * so the disk read and the hash computing overlap.
+ */
+static int vtoy_hash_image
+(
+    const char *img_map_file,
+    const char *diskname,
+    uint64_t filesize,
+    uint32_t mask
+)
+{
+    int i;
+    int j;
+    int len;
+    int num;
+    int rc = 1;
+    int fd = -1;
+    int tty = 0;
+    int percent = 0;
+    int last = -1;
+    ssize_t rdlen;
+    size_t want;
+    uint64_t total = 0;
+    uint64_t done = 0;
+    uint64_t remain;
+    uint64_t offset;
+    uint64_t next;
+    time_t start;
+    uint8_t md[64];
+    unsigned char *buf = MAP_FAILED;
+    ventoy_img_chunk *chunk = NULL;
+    vtoy_hash_ctx ctx[VTOYHASH_NUM];
+
+    chunk = vtoydm_get_img_map_data(img_map_file, &len);
+    if (NULL == chunk)
+    {
+        return 1;
+    }
+
+    num = len / sizeof(ventoy_img_chunk);
+    for (i = 0; i < num; i++)
+    {
+        if (chunk[i].img_start_sector * 2048ULL != total)
+        {
+            fprintf(stderr, "image map is not in image order at chunk %d\n", i);
+            goto end;
+        }
+        total += (chunk[i].img_end_sector + 1 - chunk[i].img_start_sector) * 2048ULL;
+    }
+
+    if (filesize > 0 && filesize <= total)
+    {
+        total = filesize;
+    }
+
+    if (total == 0)
+    {
+        fprintf(stderr, "image map is empty\n");
+        goto end;
+    }
+
+    fd = open(diskname, O_RDONLY | O_BINARY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", diskname, errno);
+        goto end;
+    }
+
+    buf = mmap(NULL, VTOYHASH_BUF_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to alloc memory len:%d err:%d\n", VTOYHASH_BUF_SIZE, errno);
+        goto end;
+    }
+
+    memset(ctx, 0, sizeof(ctx));
+    for (j = 0; j < VTOYHASH_NUM; j++)
+    {
+        if (mask & (1U << j))
+        {
+            g_hash_algo[j].init(ctx + j);
+        }
+    }
+
+    tty = isatty(2);
+    start = time(NULL);
+
+    for (i = 0; i < num && done < total; i++)
+    {
+        offset = chunk[i].disk_start_sector * 512;
+        remain = (chunk[i].disk_end_sector + 1 - chunk[i].disk_start_sector) * 512;
+        if (remain > total - done)
+        {
+            remain = total - done;
+        }
+
+        while (remain > 0)
+        {
+            want = remain > VTOYHASH_BUF_SIZE ? VTOYHASH_BUF_SIZE : (size_t)remain;
+            rdlen = pread(fd, buf, want, (off_t)offset);
+            if (rdlen <= 0)
+            {
+                fprintf(stderr, "Failed to read %s at %llu err:%d\n", diskname, (unsigned long long)offset, errno);
+                goto end;
+            }
+
+#ifdef POSIX_FADV_WILLNEED
+            next = (remain > (uint64_t)rdlen) ? offset + rdlen : ((i + 1 < num) ? chunk[i + 1].disk_start_sector * 512 : 0);
+            if (next)
+            {
+                posix_fadvise(fd, (off_t)next, VTOYHASH_BUF_SIZE, POSIX_FADV_WILLNEED);
+            }
+#else
+            (void)next;
+#endif
+
+            for (j = 0; j < VTOYHASH_NUM; j++)
+            {
+                if (mask & (1U << j))
+                {
+                    vtoy_hash_update(g_hash_algo + j, ctx + j, buf, (uint64_t)rdlen);
+                }
+            }
+
+            offset += rdlen;
+            remain -= rdlen;
+            done += rdlen;
+
+            percent = (int)(done * 100 / total);
+            if (tty && percent != last)
+            {
+                fprintf(stderr, "\rhash %d%%  %lluMB/%lluMB ", percent,
+                        (unsigned long long)(done >> 20), (unsigned long long)(total >> 20));
+                last = percent;
+            }
+        }
+    }
+
+    if (tty)
+    {
+        fprintf(stderr, "\n");
+    }
+
+    if (done != total)
+    {
+        fprintf(stderr, "image map covers %llu of %llu bytes\n", (unsigned long long)done, (unsigned long long)total);
+        goto end;
+    }
+
+    for (j = 0; j < VTOYHASH_NUM; j++)
+    {
+        if (mask & (1U << j))
+        {
+            vtoy_hash_final(g_hash_algo + j, ctx + j, md);
+            printf("%-6s : ", g_hash_algo[j].name);
+            for (i = 0; i < (int)g_hash_algo[j].mdlen; i++)
+            {
+                printf("%02x", md[i]);
+            }
+            printf("\n");
+        }
+    }
+
+    debug("hash %lluMB in %lds\n", (unsigned long long)(total >> 20), (long)(time(NULL) - start));
+    rc = 0;
+
+end:
+    if (buf != MAP_FAILED)
+    {
+        munmap(buf, VTOYHASH_BUF_SIZE);
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    free(chunk);
+    return rc;
+}
+
+int vtoyhash_main(int argc, char **argv)
+{
+    int ch;
+    int i;
+    uint32_t mask = 0;
+    unsigned long long file_size = 0;
+    char diskname[128] = {0};
+    char filepath[300] = {0};
+
+    while ((ch = getopt(argc, argv, "f:d:l:t:v::h::")) != -1)
+    {
+        if (ch == 'f')
+        {
+            strncpy(filepath, optarg, sizeof(filepath) - 1);
+        }
+        else if (ch == 'd')
+        {
+            strncpy(diskname, optarg, sizeof(diskname) - 1);
+        }
+        else if (ch == 'l')
+        {
+            file_size = strtoull(optarg, NULL, 10);
+        }
+        else if (ch == 't')
+        {
+            for (i = 0; i < VTOYHASH_NUM; i++)
+            {
+                if (strcmp(optarg, g_hash_algo[i].name) == 0)
+                {
+                    mask |= (1U << i);
+                    break;
+                }
+            }
+
+            if (i >= VTOYHASH_NUM)
+            {
+                fprintf(stderr, "Unknown hash %s\n", optarg);
+                return 1;
+            }
+        }
+        else if (ch == 'v')
+        {
+            verbose = 1;
+        }
+        else if (ch == 'h')
+        {
+            return vtoy_hash_print_help(stdout);
+        }
+        else
+        {
+            vtoy_hash_print_help(stderr);
+            return 1;
+        }
+    }
+
+    if (filepath[0] == 0 || diskname[0] == 0)
+    {
+        fprintf(stderr, "Must input file and disk\n");
+        return 1;
+    }
+
+    if (mask == 0)
+    {
+        mask = (1U << 2);
+    }
+
+    debug("file=<%s> disk=<%s> file_size=%llu mask=0x%x\n", filepath, diskname, file_size, mask);
+
+    return vtoy_hash_image(filepath, diskname, (uint64_t)file_size, mask);
+}
+
+// wrapper main
+#ifndef BUILD_VTOY_TOOL
+int main(int argc, char **argv)
+{
+    return vtoyhash_main(argc, argv);
+}
+#endif
+
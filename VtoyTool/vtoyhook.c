@@ -0,0 +1,181 @@
+/******************************************************************************
+ * vtoyhook.c  ---- ventoy hook agent
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define CMD_WAIT_DISK   1
+#define CMD_CREATE_DM   2
+
+#define VTOYHOOK_OS_PARAM   "/ventoy/ventoy_os_param"
+#define VTOYHOOK_IMG_MAP    "/ventoy/ventoy_image_map"
+
+static int verbose = 0;
+#define debug(fmt, ...) if(verbose) printf(fmt, ##__VA_ARGS__)
+
+int vtoydump_wait_disk(const char *filename, char *diskname, int len, int timeout);
+int vtoydm_create_dm(const char *img_map_file, const char *diskname, const char *dmname,
+                     int readonly, unsigned int *major, unsigned int *minor);
+
+static int vtoyhook_print_help(FILE *fp)
+{
+    fprintf(fp, "Usage: \n"
+            "   vtoyhook -w [ -p os_param_file ] [ -t timeout ] [ -v ] \n"
+            "   vtoyhook -c [ -p os_param_file ] [ -d diskname ] [ -f img_map_file ] [ -n dmname ] [ -r ] [ -t timeout ] [ -v ] \n"
+            );
+    return 0;
+}
+
+/*
+ *  Ventoy hook agent, do the work of several hook script steps in one process.
+ *
+ *  -w              wait until the ventoy disk is ready and print it (e.g. /dev/sdb)
+ *  -c              create the device mapper for the image and print its dev number "major minor"
+ *  -p paramfile    os param file, default /ventoy/ventoy_os_param
+ *  -d diskname     ventoy disk, if not input, wait for it as -w does
+ *  -f mapfile      image map file, default /ventoy/ventoy_image_map
+ *  -n dmname       device mapper name, default ventoy
+ *  -r              create a readonly device mapper
+ *  -t timeout      timeout in seconds for waiting disk, default 0 (forever)
+ *  -v              be verbose
+ */
+int vtoyhook_main(int argc, char **argv)
+{
+    int ch;
+    int cmd = 0;
+    int readonly = 0;
+    int timeout = 0;
+    unsigned int major = 0;
+    unsigned int minor = 0;
+    char paramfile[256] = {0};
+    char diskname[256] = {0};
+    char mapfile[256] = {0};
+    char dmname[128] = {0};
+
+    while ((ch = getopt(argc, argv, "p:d:f:n:t:w::c::r::v::h::")) != -1)
+    {
+        if (ch == 'w')
+        {
+            cmd = CMD_WAIT_DISK;
+        }
+        else if (ch == 'c')
+        {
+            cmd = CMD_CREATE_DM;
+        }
+        else if (ch == 'p')
+        {
+            strncpy(paramfile, optarg, sizeof(paramfile) - 1);
+        }
+        else if (ch == 'd')
+        {
+            strncpy(diskname, optarg, sizeof(diskname) - 1);
+        }
+        else if (ch == 'f')
+        {
+            strncpy(mapfile, optarg, sizeof(mapfile) - 1);
+        }
+        else if (ch == 'n')
+        {
+            strncpy(dmname, optarg, sizeof(dmname) - 1);
+        }
+        else if (ch == 't')
+        {
+            timeout = (int)strtol(optarg, NULL, 10);
+        }
+        else if (ch == 'r')
+        {
+            readonly = 1;
+        }
+        else if (ch == 'v')
+        {
+            verbose = 1;
+        }
+        else if (ch == 'h')
+        {
+            return vtoyhook_print_help(stdout);
+        }
+        else
+        {
+            vtoyhook_print_help(stderr);
+            return 1;
+        }
+    }
+
+    if (paramfile[0] == 0)
+    {
+        strncpy(paramfile, VTOYHOOK_OS_PARAM, sizeof(paramfile) - 1);
+    }
+
+    if (mapfile[0] == 0)
+    {
+        strncpy(mapfile, VTOYHOOK_IMG_MAP, sizeof(mapfile) - 1);
+    }
+
+    if (dmname[0] == 0)
+    {
+        strncpy(dmname, "ventoy", sizeof(dmname) - 1);
+    }
+
+    debug("cmd=%d param=<%s> disk=<%s> map=<%s> dm=<%s> readonly=%d timeout=%d\n",
+          cmd, paramfile, diskname, mapfile, dmname, readonly, timeout);
+
+    switch (cmd)
+    {
+        case CMD_WAIT_DISK:
+        {
+            if (vtoydump_wait_disk(paramfile, diskname, sizeof(diskname), timeout))
+            {
+                return 1;
+            }
+
+            printf("%s\n", diskname);
+            return 0;
+        }
+        case CMD_CREATE_DM:
+        {
+            if (diskname[0] == 0 && vtoydump_wait_disk(paramfile, diskname, sizeof(diskname), timeout))
+            {
+                return 1;
+            }
+
+            if (vtoydm_create_dm(mapfile, diskname, dmname, readonly, &major, &minor))
+            {
+                return 1;
+            }
+
+            printf("%u %u\n", major, minor);
+            return 0;
+        }
+        default :
+        {
+            fprintf(stderr, "Invalid cmd \n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
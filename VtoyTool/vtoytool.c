@@ -36,6 +36,9 @@ int vtoydm_main(int argc, char **argv);
 int vtoytool_install(int argc, char **argv);
 int vtoyloader_main(int argc, char **argv);
 int vtoyvine_main(int argc, char **argv);
+int vtoyhook_main(int argc, char **argv);
+int vtoyhash_main(int argc, char **argv);
+int vtoywim_main(int argc, char **argv);
 
 static char *g_vtoytool_name = NULL;
 static cmd_def g_cmd_list[] = 
@@ -44,6 +47,9 @@ static cmd_def g_cmd_list[] =
     { "vtoydump",    vtoydump_main    },
     { "vtoydm",      vtoydm_main      },
     { "loader",      vtoyloader_main  },
+    { "vtoyhook",    vtoyhook_main    },
+    { "vtoyhash",    vtoyhash_main    },
+    { "vtoywim",     vtoywim_main     },
     { "--install",   vtoytool_install },
 };
 
@@ -0,0 +1,1020 @@
+/******************************************************************************
+ * vtoywimtool.c  ---- extract or patch a file in a wim image
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "vtoywim.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+static int verbose = 0;
+#define debug(fmt, ...) if(verbose) printf(fmt, ##__VA_ARGS__)
+
+int vtoyhash_buf(const char *name, const void *data, uint64_t len, uint8_t *md);
+
+/*
+ * The same wim layout that ventoy_windows.c patches in grub (see ventoy_def.h there).
+ * The resources are decompressed by vtoywim with a thread for each CPU, so a boot.wim
+ * can be checked or patched on Linux much faster than grub does it.
+ */
+
+#define WIM_RESHDR_FLAG_METADATA    0x02
+#define WIM_RESHDR_FLAG_COMPRESSED  0x04
+#define WIM_RESHDR_FLAG_SPANNED     0x08
+#define WIM_RESHDR_FLAG_PACKED      0x10
+
+#define WIM_HEAD_SIGNATURE   "MSWIM\0\0"
+
+#pragma pack(1)
+
+typedef struct wim_resource_header
+{
+    uint64_t size_in_wim:56;
+    uint64_t flags:8;
+    uint64_t offset;
+    uint64_t raw_size;
+}wim_resource_header;
+
+typedef struct wim_header
+{
+    uint8_t  signature[8];
+    uint32_t header_len;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t chunk_len;
+    uint8_t  guid[16];
+    uint16_t part;
+    uint16_t parts;
+    uint32_t images;
+    wim_resource_header lookup;
+    wim_resource_header xml;
+    wim_resource_header metadata;
+    uint32_t boot_index;
+    wim_resource_header integrity;
+    uint8_t  reserved[60];
+}wim_header;
+
+typedef struct wim_hash
+{
+    uint8_t sha1[20];
+}wim_hash;
+
+typedef struct wim_lookup_entry
+{
+    wim_resource_header resource;
+    uint16_t part;
+    uint32_t refcnt;
+    wim_hash hash;
+}wim_lookup_entry;
+
+typedef struct wim_security_header
+{
+    uint32_t len;
+    uint32_t count;
+}wim_security_header;
+
+typedef struct wim_directory_entry
+{
+    uint64_t len;
+    uint32_t attributes;
+    uint32_t security;
+    uint64_t subdir;
+    uint8_t  reserved1[16];
+    uint64_t created;
+    uint64_t accessed;
+    uint64_t written;
+    wim_hash hash;
+    uint8_t  reserved2[12];
+    uint16_t streams;
+    uint16_t short_name_len;
+    uint16_t name_len;
+}wim_directory_entry;
+
+typedef struct wim_stream_entry
+{
+    uint64_t len;
+    uint64_t reserved;
+    wim_hash hash;
+    uint16_t name_len;
+}wim_stream_entry;
+
+#pragma pack()
+
+typedef struct vtoy_wim
+{
+    int fd;
+    int comp;
+    int threads;
+    uint64_t filesize;
+    wim_header header;
+
+    wim_lookup_entry *lookup;
+    uint32_t lookup_num;
+
+    wim_lookup_entry *meta_look;
+    uint8_t *meta;
+    uint64_t meta_len;
+}vtoy_wim;
+
+static const wim_hash g_zero_hash;
+
+static uint64_t vtoy_wim_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static int vtoy_wim_pread(int fd, void *buf, uint64_t len, uint64_t offset)
+{
+    ssize_t rdlen;
+    uint8_t *pos = (uint8_t *)buf;
+
+    while (len > 0)
+    {
+        rdlen = pread(fd, pos, (size_t)len, (off_t)offset);
+        if (rdlen <= 0)
+        {
+            return 1;
+        }
+
+        pos += rdlen;
+        len -= rdlen;
+        offset += rdlen;
+    }
+
+    return 0;
+}
+
+static int vtoy_wim_pwrite(int fd, const void *buf, uint64_t len, uint64_t offset)
+{
+    ssize_t wrlen;
+    const uint8_t *pos = (const uint8_t *)buf;
+
+    while (len > 0)
+    {
+        wrlen = pwrite(fd, pos, (size_t)len, (off_t)offset);
+        if (wrlen <= 0)
+        {
+            return 1;
+        }
+
+        pos += wrlen;
+        len -= wrlen;
+        offset += wrlen;
+    }
+
+    return 0;
+}
+
+static void vtoy_wim_print_hash(const wim_hash *hash)
+{
+    int i;
+
+    for (i = 0; i < (int)sizeof(hash->sha1); i++)
+    {
+        printf("%02x", hash->sha1[i]);
+    }
+}
+
+/* the compressed data of the resource, the caller frees it */
+static uint8_t * vtoy_wim_load_resource(vtoy_wim *wim, const wim_resource_header *res)
+{
+    uint64_t len;
+    uint8_t *buf = NULL;
+
+    if (res->flags & (WIM_RESHDR_FLAG_SPANNED | WIM_RESHDR_FLAG_PACKED))
+    {
+        fprintf(stderr, "Spanned or packed resource is not supported flags:0x%x\n", (int)res->flags);
+        return NULL;
+    }
+
+    len = (res->flags & WIM_RESHDR_FLAG_COMPRESSED) ? res->size_in_wim : res->raw_size;
+    if (res->offset + len > wim->filesize || len != (size_t)len)
+    {
+        fprintf(stderr, "Invalid resource offset:%llu size:%llu\n",
+                (unsigned long long)res->offset, (unsigned long long)len);
+        return NULL;
+    }
+
+    buf = malloc((size_t)len + 1);
+    if (!buf)
+    {
+        fprintf(stderr, "Failed to alloc memory len:%llu\n", (unsigned long long)len);
+        return NULL;
+    }
+
+    if (vtoy_wim_pread(wim->fd, buf, len, res->offset))
+    {
+        fprintf(stderr, "Failed to read resource offset:%llu err:%d\n", (unsigned long long)res->offset, errno);
+        free(buf);
+        return NULL;
+    }
+
+    return buf;
+}
+
+/* decompress the loaded resource data, the caller frees the returned buffer */
+static uint8_t * vtoy_wim_unpack(vtoy_wim *wim, const wim_resource_header *res, uint8_t *data, int threads)
+{
+    uint8_t *out = NULL;
+
+    if ((res->flags & WIM_RESHDR_FLAG_COMPRESSED) == 0)
+    {
+        return data;
+    }
+
+    /* one more byte so that an empty resource still gets a buffer */
+    out = malloc((size_t)res->raw_size + 1);
+    if (!out)
+    {
+        fprintf(stderr, "Failed to alloc memory len:%llu\n", (unsigned long long)res->raw_size);
+        return NULL;
+    }
+
+    if (vtoy_wim_decompress_mt(wim->comp, data, res->size_in_wim, res->raw_size, out, threads))
+    {
+        fprintf(stderr, "Failed to decompress resource offset:%llu size:%llu\n",
+                (unsigned long long)res->offset, (unsigned long long)res->size_in_wim);
+        free(out);
+        return NULL;
+    }
+
+    return out;
+}
+
+static uint8_t * vtoy_wim_read_resource(vtoy_wim *wim, const wim_resource_header *res)
+{
+    uint8_t *data = NULL;
+    uint8_t *out = NULL;
+
+    data = vtoy_wim_load_resource(wim, res);
+    if (!data)
+    {
+        return NULL;
+    }
+
+    out = vtoy_wim_unpack(wim, res, data, wim->threads);
+    if (out != data)
+    {
+        free(data);
+    }
+
+    return out;
+}
+
+static wim_lookup_entry * vtoy_wim_find_look_entry(vtoy_wim *wim, const wim_hash *hash)
+{
+    uint32_t i;
+
+    for (i = 0; i < wim->lookup_num; i++)
+    {
+        if (memcmp(&wim->lookup[i].hash, hash, sizeof(wim_hash)) == 0)
+        {
+            return wim->lookup + i;
+        }
+    }
+
+    return NULL;
+}
+
+static wim_lookup_entry * vtoy_wim_find_meta_entry(vtoy_wim *wim, uint32_t index)
+{
+    uint32_t i;
+    uint32_t n = 0;
+
+    for (i = 0; i < wim->lookup_num; i++)
+    {
+        if (wim->lookup[i].resource.flags & WIM_RESHDR_FLAG_METADATA)
+        {
+            if (++n == index)
+            {
+                return wim->lookup + i;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void vtoy_wim_close(vtoy_wim *wim)
+{
+    if (wim->fd >= 0)
+    {
+        close(wim->fd);
+    }
+
+    free(wim->lookup);
+    free(wim->meta);
+    memset(wim, 0, sizeof(vtoy_wim));
+    wim->fd = -1;
+}
+
+/* open the wim and read the header and the lookup table, index 0 means the boot image */
+static int vtoy_wim_open(vtoy_wim *wim, const char *path, int writable, int threads)
+{
+    struct stat st;
+
+    memset(wim, 0, sizeof(vtoy_wim));
+    wim->threads = threads;
+
+    wim->fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_BINARY);
+    if (wim->fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", path, errno);
+        return 1;
+    }
+
+    if (fstat(wim->fd, &st) || vtoy_wim_pread(wim->fd, &wim->header, sizeof(wim_header), 0))
+    {
+        fprintf(stderr, "Failed to read wim header err:%d\n", errno);
+        return 1;
+    }
+    wim->filesize = (uint64_t)st.st_size;
+
+    if (memcmp(wim->header.signature, WIM_HEAD_SIGNATURE, sizeof(wim->header.signature)))
+    {
+        fprintf(stderr, "Not a valid wim file\n");
+        return 1;
+    }
+
+    if (wim->header.parts != 1)
+    {
+        fprintf(stderr, "Split wim is not supported parts:%u\n", wim->header.parts);
+        return 1;
+    }
+
+    wim->comp = vtoy_wim_comp_type(wim->header.flags);
+    if (wim->comp < 0 ||
+        (wim->comp != VTOY_WIM_COMP_NONE && wim->header.chunk_len != 0 && wim->header.chunk_len != VTOY_WIM_CHUNK_LEN))
+    {
+        fprintf(stderr, "Compression is not supported flags:0x%x chunk:%u\n", wim->header.flags, wim->header.chunk_len);
+        return 1;
+    }
+
+    wim->lookup = (wim_lookup_entry *)vtoy_wim_read_resource(wim, &wim->header.lookup);
+    if (!wim->lookup)
+    {
+        return 1;
+    }
+    wim->lookup_num = (uint32_t)(wim->header.lookup.raw_size / sizeof(wim_lookup_entry));
+
+    debug("wim flags:0x%x comp:%d images:%u boot:%u lookup:%u\n", wim->header.flags, wim->comp,
+          wim->header.images, wim->header.boot_index, wim->lookup_num);
+    return 0;
+}
+
+static int vtoy_wim_load_meta(vtoy_wim *wim, uint32_t index)
+{
+    if (index == 0)
+    {
+        index = wim->header.boot_index ? wim->header.boot_index : 1;
+    }
+
+    wim->meta_look = vtoy_wim_find_meta_entry(wim, index);
+    if (!wim->meta_look)
+    {
+        fprintf(stderr, "Image %u not found\n", index);
+        return 1;
+    }
+
+    wim->meta = vtoy_wim_read_resource(wim, &wim->meta_look->resource);
+    if (!wim->meta)
+    {
+        return 1;
+    }
+    wim->meta_len = wim->meta_look->resource.raw_size;
+
+    if (wim->meta_len < sizeof(wim_security_header) + sizeof(wim_directory_entry))
+    {
+        fprintf(stderr, "Invalid metadata len:%llu\n", (unsigned long long)wim->meta_len);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the directory entry at offset in the metadata, NULL at the end of a directory */
+static wim_directory_entry * vtoy_wim_dirent(vtoy_wim *wim, uint64_t offset)
+{
+    wim_directory_entry *dir = NULL;
+
+    if (offset + sizeof(uint64_t) > wim->meta_len)
+    {
+        return NULL;
+    }
+
+    dir = (wim_directory_entry *)(wim->meta + offset);
+    if (dir->len < sizeof(wim_directory_entry) || offset + dir->len > wim->meta_len ||
+        sizeof(wim_directory_entry) + dir->name_len > dir->len)
+    {
+        return NULL;
+    }
+
+    return dir;
+}
+
+/* offset of the entry after dir, the stream entries of dir are skipped */
+static uint64_t vtoy_wim_next_dirent(vtoy_wim *wim, uint64_t offset)
+{
+    uint16_t i;
+    uint16_t streams;
+    wim_stream_entry *stream = NULL;
+
+    streams = ((wim_directory_entry *)(wim->meta + offset))->streams;
+    offset += (((wim_directory_entry *)(wim->meta + offset))->len + 7) & (~7ULL);
+
+    for (i = 0; i < streams && offset + sizeof(wim_stream_entry) <= wim->meta_len; i++)
+    {
+        stream = (wim_stream_entry *)(wim->meta + offset);
+        if (stream->len < sizeof(wim_stream_entry))
+        {
+            return wim->meta_len;
+        }
+        offset += (stream->len + 7) & (~7ULL);
+    }
+
+    return offset;
+}
+
+/* the hash of the file data, in the unnamed stream entry if the file has streams */
+static wim_hash * vtoy_wim_dirent_hash(vtoy_wim *wim, uint64_t offset)
+{
+    uint16_t i;
+    wim_directory_entry *dir = (wim_directory_entry *)(wim->meta + offset);
+    wim_stream_entry *stream = NULL;
+
+    if (dir->streams == 0 || memcmp(&dir->hash, &g_zero_hash, sizeof(wim_hash)))
+    {
+        return &dir->hash;
+    }
+
+    offset += (dir->len + 7) & (~7ULL);
+    for (i = 0; i < dir->streams && offset + sizeof(wim_stream_entry) <= wim->meta_len; i++)
+    {
+        stream = (wim_stream_entry *)(wim->meta + offset);
+        if (stream->len < sizeof(wim_stream_entry))
+        {
+            break;
+        }
+
+        if (stream->name_len == 0)
+        {
+            return &stream->hash;
+        }
+        offset += (stream->len + 7) & (~7ULL);
+    }
+
+    return &dir->hash;
+}
+
+static int vtoy_wim_name_cmp(const char *search, const uint16_t *name, uint16_t namelen)
+{
+    char c1;
+    char c2;
+    uint16_t i;
+
+    for (i = 0; i < namelen && search[i]; i++)
+    {
+        c1 = search[i];
+        c2 = (name[i] < 0x80) ? (char)name[i] : 0;
+
+        if (c1 >= 'a' && c1 <= 'z') c1 -= 32;
+        if (c2 >= 'a' && c2 <= 'z') c2 -= 32;
+
+        if (c1 != c2)
+        {
+            return 1;
+        }
+    }
+
+    return (i == namelen && search[i] == 0) ? 0 : 1;
+}
+
+/*
+ * Offset of the directory entry of path (/ or \ separated, case insensitive)
+ * in the loaded metadata, 0 if it is not there.
+ */
+static uint64_t vtoy_wim_find_path(vtoy_wim *wim, const char *path)
+{
+    int len;
+    char name[256];
+    uint64_t offset;
+    uint64_t found;
+    wim_directory_entry *dir = NULL;
+
+    /* the root entry is after the (8 aligned) security data */
+    found = (((wim_security_header *)wim->meta)->len + 7) & (~7U);
+    if (vtoy_wim_dirent(wim, found) == NULL)
+    {
+        fprintf(stderr, "Invalid root directory entry\n");
+        return 0;
+    }
+
+    while (*path)
+    {
+        while (*path == '/' || *path == '\\')
+        {
+            path++;
+        }
+
+        for (len = 0; path[len] && path[len] != '/' && path[len] != '\\'; len++)
+        {
+            ;
+        }
+
+        if (len == 0)
+        {
+            break;
+        }
+
+        if (len >= (int)sizeof(name))
+        {
+            return 0;
+        }
+
+        memcpy(name, path, len);
+        name[len] = 0;
+        path += len;
+
+        offset = ((wim_directory_entry *)(wim->meta + found))->subdir;
+        found = 0;
+
+        while (offset && (dir = vtoy_wim_dirent(wim, offset)) != NULL)
+        {
+            if (dir->name_len && vtoy_wim_name_cmp(name, (uint16_t *)(dir + 1), dir->name_len / 2) == 0)
+            {
+                found = offset;
+                break;
+            }
+            offset = vtoy_wim_next_dirent(wim, offset);
+        }
+
+        if (found == 0)
+        {
+            return 0;
+        }
+    }
+
+    return found;
+}
+
+static int vtoy_wim_list(vtoy_wim *wim)
+{
+    uint32_t i;
+    wim_lookup_entry *entry = NULL;
+
+    printf("version:0x%x flags:0x%x chunk:%u images:%u boot:%u resources:%u\n",
+           wim->header.version, wim->header.flags, wim->header.chunk_len,
+           wim->header.images, wim->header.boot_index, wim->lookup_num);
+
+    for (i = 0; i < wim->lookup_num; i++)
+    {
+        entry = wim->lookup + i;
+        printf("%5u flags:0x%02x offset:%llu size:%llu raw:%llu refcnt:%u ", i, (int)entry->resource.flags,
+               (unsigned long long)entry->resource.offset, (unsigned long long)entry->resource.size_in_wim,
+               (unsigned long long)entry->resource.raw_size, entry->refcnt);
+        vtoy_wim_print_hash(&entry->hash);
+        printf("\n");
+    }
+
+    return 0;
+}
+
+static int vtoy_wim_extract(vtoy_wim *wim, const char *path, const char *outfile)
+{
+    int fd;
+    int rc = 1;
+    uint64_t offset;
+    uint64_t len = 0;
+    uint8_t *data = NULL;
+    wim_hash *hash = NULL;
+    wim_lookup_entry *entry = NULL;
+
+    offset = vtoy_wim_find_path(wim, path);
+    if (offset == 0)
+    {
+        fprintf(stderr, "%s not found in the wim\n", path);
+        return 1;
+    }
+
+    /* a file without data has no lookup entry */
+    hash = vtoy_wim_dirent_hash(wim, offset);
+    if (memcmp(hash, &g_zero_hash, sizeof(wim_hash)))
+    {
+        entry = vtoy_wim_find_look_entry(wim, hash);
+        if (!entry)
+        {
+            fprintf(stderr, "No lookup entry for %s\n", path);
+            return 1;
+        }
+
+        data = vtoy_wim_read_resource(wim, &entry->resource);
+        if (!data)
+        {
+            return 1;
+        }
+        len = entry->resource.raw_size;
+    }
+
+    fd = open(outfile, O_CREAT | O_TRUNC | O_WRONLY | O_BINARY, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create %s err:%d\n", outfile, errno);
+        goto end;
+    }
+
+    if (vtoy_wim_pwrite(fd, data, len, 0))
+    {
+        fprintf(stderr, "Failed to write %s err:%d\n", outfile, errno);
+        close(fd);
+        goto end;
+    }
+
+    close(fd);
+    debug("extract %s len:%llu to %s\n", path, (unsigned long long)len, outfile);
+    rc = 0;
+
+end:
+    free(data);
+    return rc;
+}
+
+/*
+ * Replace the data of path with the new file, the same way as grub does it in memory:
+ * the new data, the (uncompressed) new metadata and lookup table are appended to the wim,
+ * then the header is updated to point to them. The old resources are left unused, a lookup
+ * entry that only this file used is given the new data or dropped from the new table.
+ */
+static int vtoy_wim_patch(vtoy_wim *wim, const char *path, const char *newfile)
+{
+    int fd = -1;
+    int rc = 1;
+    int same = 0;
+    int newlook = 0;
+    uint32_t num;
+    uint32_t drop;
+    uint64_t offset;
+    uint64_t pos;
+    uint8_t *data = NULL;
+    wim_hash hash;
+    wim_hash *old = NULL;
+    wim_header header;
+    wim_lookup_entry *entry = NULL;
+    wim_lookup_entry *oldlook = NULL;
+    wim_lookup_entry *lookup = NULL;
+    struct stat st;
+
+    offset = vtoy_wim_find_path(wim, path);
+    if (offset == 0)
+    {
+        fprintf(stderr, "%s not found in the wim\n", path);
+        return 1;
+    }
+
+    fd = open(newfile, O_RDONLY | O_BINARY);
+    if (fd < 0 || fstat(fd, &st))
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", newfile, errno);
+        goto end;
+    }
+
+    data = malloc((size_t)st.st_size + 1);
+    if (!data || vtoy_wim_pread(fd, data, (uint64_t)st.st_size, 0))
+    {
+        fprintf(stderr, "Failed to read %s err:%d\n", newfile, errno);
+        goto end;
+    }
+
+    vtoyhash_buf("sha1", data, (uint64_t)st.st_size, hash.sha1);
+
+    /* one more lookup entry in case the new data is not in the wim yet */
+    num = wim->lookup_num;
+    lookup = malloc((num + 1) * sizeof(wim_lookup_entry));
+    if (!lookup)
+    {
+        goto end;
+    }
+    memcpy(lookup, wim->lookup, num * sizeof(wim_lookup_entry));
+
+    pos = (wim->filesize + 7) & (~7ULL);
+
+    /* the file gets the data it already has, the refcnt stays as it is */
+    old = vtoy_wim_dirent_hash(wim, offset);
+    same = (st.st_size > 0 && memcmp(old, &hash, sizeof(wim_hash)) == 0);
+
+    if (!same && memcmp(old, &g_zero_hash, sizeof(wim_hash)))
+    {
+        oldlook = vtoy_wim_find_look_entry(wim, old);
+        if (oldlook && oldlook->refcnt > 1)
+        {
+            lookup[oldlook - wim->lookup].refcnt--;
+            oldlook = NULL;
+        }
+    }
+
+    /* an empty file has no lookup entry, its hash in the dirent is zero */
+    entry = (st.st_size > 0) ? vtoy_wim_find_look_entry(wim, &hash) : NULL;
+    if (entry)
+    {
+        if (!same)
+        {
+            lookup[entry - wim->lookup].refcnt++;
+        }
+    }
+    else if (st.st_size > 0)
+    {
+        if (vtoy_wim_pwrite(wim->fd, data, (uint64_t)st.st_size, pos))
+        {
+            fprintf(stderr, "Failed to write new data err:%d\n", errno);
+            goto end;
+        }
+
+        /* like grub, the entry of the old data is rewritten in place if no other file uses it */
+        if (oldlook)
+        {
+            entry = lookup + (oldlook - wim->lookup);
+            oldlook = NULL;
+        }
+        else
+        {
+            entry = lookup + num;
+            newlook = 1;
+        }
+
+        memset(entry, 0, sizeof(wim_lookup_entry));
+        entry->resource.size_in_wim = (uint64_t)st.st_size;
+        entry->resource.raw_size = (uint64_t)st.st_size;
+        entry->resource.offset = pos;
+        entry->part = 1;
+        entry->refcnt = 1;
+        memcpy(&entry->hash, &hash, sizeof(wim_hash));
+
+        pos = (pos + (uint64_t)st.st_size + 7) & (~7ULL);
+    }
+
+    memcpy(old, (st.st_size > 0) ? &hash : &g_zero_hash, sizeof(wim_hash));
+
+    /* new metadata */
+    entry = lookup + (wim->meta_look - wim->lookup);
+    if (vtoy_wim_pwrite(wim->fd, wim->meta, wim->meta_len, pos))
+    {
+        fprintf(stderr, "Failed to write new metadata err:%d\n", errno);
+        goto end;
+    }
+
+    entry->resource.flags = WIM_RESHDR_FLAG_METADATA;
+    entry->resource.size_in_wim = wim->meta_len;
+    entry->resource.raw_size = wim->meta_len;
+    entry->resource.offset = pos;
+    vtoyhash_buf("sha1", wim->meta, wim->meta_len, entry->hash.sha1);
+    pos = (pos + wim->meta_len + 7) & (~7ULL);
+
+    memcpy(&header, &wim->header, sizeof(wim_header));
+    if (wim->meta_look == vtoy_wim_find_meta_entry(wim, header.boot_index ? header.boot_index : 1))
+    {
+        memcpy(&header.metadata, &entry->resource, sizeof(wim_resource_header));
+    }
+
+    /* new lookup table, without the entry of the old data if nothing uses it any more */
+    num += newlook;
+    if (oldlook)
+    {
+        drop = (uint32_t)(oldlook - wim->lookup);
+        memmove(lookup + drop, lookup + drop + 1, (num - drop - 1) * sizeof(wim_lookup_entry));
+        num--;
+    }
+    if (vtoy_wim_pwrite(wim->fd, lookup, num * sizeof(wim_lookup_entry), pos))
+    {
+        fprintf(stderr, "Failed to write new lookup table err:%d\n", errno);
+        goto end;
+    }
+
+    header.lookup.flags = 0;
+    header.lookup.size_in_wim = num * sizeof(wim_lookup_entry);
+    header.lookup.raw_size = num * sizeof(wim_lookup_entry);
+    header.lookup.offset = pos;
+
+    /* the integrity table does not match the new content any more */
+    memset(&header.integrity, 0, sizeof(header.integrity));
+
+    if (fsync(wim->fd) || vtoy_wim_pwrite(wim->fd, &header, sizeof(wim_header), 0))
+    {
+        fprintf(stderr, "Failed to write wim header err:%d\n", errno);
+        goto end;
+    }
+
+    debug("patch %s with %s len:%llu\n", path, newfile, (unsigned long long)st.st_size);
+    rc = 0;
+
+end:
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    free(lookup);
+    free(data);
+    return rc;
+}
+
+/*
+ * Decompress every resource with 1 thread (as grub does) and with the worker pool,
+ * check the data against the SHA1 in the lookup table, and show the decode speed.
+ */
+static int vtoy_wim_bench(vtoy_wim *wim)
+{
+    int pass;
+    int threads;
+    uint32_t i;
+    uint32_t bad = 0;
+    uint64_t ms[2] = { 0, 0 };
+    uint64_t start;
+    uint64_t raw = 0;
+    uint64_t packed = 0;
+    uint8_t *data = NULL;
+    uint8_t *out = NULL;
+    wim_hash hash;
+    wim_lookup_entry *entry = NULL;
+
+    threads = (wim->threads > 0) ? wim->threads : vtoy_wim_cpu_num();
+
+    for (i = 0; i < wim->lookup_num; i++)
+    {
+        entry = wim->lookup + i;
+        if ((entry->resource.flags & WIM_RESHDR_FLAG_COMPRESSED) == 0)
+        {
+            continue;
+        }
+
+        data = vtoy_wim_load_resource(wim, &entry->resource);
+        if (!data)
+        {
+            bad++;
+            continue;
+        }
+
+        for (pass = 0; pass < 2; pass++)
+        {
+            start = vtoy_wim_ms();
+            out = vtoy_wim_unpack(wim, &entry->resource, data, pass ? threads : 1);
+            ms[pass] += vtoy_wim_ms() - start;
+
+            if (!out)
+            {
+                bad++;
+                break;
+            }
+
+            vtoyhash_buf("sha1", out, entry->resource.raw_size, hash.sha1);
+            if (memcmp(&hash, &entry->hash, sizeof(wim_hash)))
+            {
+                printf("resource %u SHA1 mismatch ", i);
+                vtoy_wim_print_hash(&hash);
+                printf("\n");
+                bad++;
+            }
+            free(out);
+        }
+
+        raw += entry->resource.raw_size;
+        packed += entry->resource.size_in_wim;
+        free(data);
+    }
+
+    printf("compressed:%lluKB raw:%lluKB bad:%u\n", (unsigned long long)(packed >> 10), (unsigned long long)(raw >> 10), bad);
+    printf("1 thread: %llums %lluMB/s\n", (unsigned long long)ms[0],
+           (unsigned long long)(ms[0] ? (raw * 1000 / ms[0]) >> 20 : 0));
+    printf("%d threads: %llums %lluMB/s\n", threads, (unsigned long long)ms[1],
+           (unsigned long long)(ms[1] ? (raw * 1000 / ms[1]) >> 20 : 0));
+
+    return bad ? 1 : 0;
+}
+
+static int vtoy_wim_print_help(FILE *fp)
+{
+    fprintf(fp, "Usage: vtoywim -f file.wim [ -i index ] [ -t threads ] [ -v ] action \n"
+            "   -l                  list the wim lookup table \n"
+            "   -x path -o file     extract path in the image to file \n"
+            "   -p path -r file     replace path in the image with file (the wim is modified) \n"
+            "   -b                  decompress all the resources, check SHA1 and show the speed \n"
+            "   the boot image if no -i is given, a thread for each CPU if no -t is given \n");
+    return 0;
+}
+
+int vtoywim_main(int argc, char **argv)
+{
+    int ch;
+    int rc = 1;
+    int action = 0;
+    int threads = 0;
+    uint32_t index = 0;
+    vtoy_wim wim;
+    char wimfile[300] = {0};
+    char path[300] = {0};
+    char file[300] = {0};
+
+    while ((ch = getopt(argc, argv, "f:i:t:x:p:o:r:lbv::h::")) != -1)
+    {
+        if (ch == 'f')
+        {
+            strncpy(wimfile, optarg, sizeof(wimfile) - 1);
+        }
+        else if (ch == 'i')
+        {
+            index = (uint32_t)strtoul(optarg, NULL, 10);
+        }
+        else if (ch == 't')
+        {
+            threads = (int)strtol(optarg, NULL, 10);
+        }
+        else if (ch == 'x' || ch == 'p')
+        {
+            action = ch;
+            strncpy(path, optarg, sizeof(path) - 1);
+        }
+        else if (ch == 'o' || ch == 'r')
+        {
+            strncpy(file, optarg, sizeof(file) - 1);
+        }
+        else if (ch == 'l' || ch == 'b')
+        {
+            action = ch;
+        }
+        else if (ch == 'v')
+        {
+            verbose = 1;
+        }
+        else if (ch == 'h')
+        {
+            return vtoy_wim_print_help(stdout);
+        }
+        else
+        {
+            vtoy_wim_print_help(stderr);
+            return 1;
+        }
+    }
+
+    if (wimfile[0] == 0 || action == 0 || ((action == 'x' || action == 'p') && file[0] == 0))
+    {
+        vtoy_wim_print_help(stderr);
+        return 1;
+    }
+
+    if (vtoy_wim_open(&wim, wimfile, action == 'p', threads) == 0)
+    {
+        if (action == 'l')
+        {
+            rc = vtoy_wim_list(&wim);
+        }
+        else if (action == 'b')
+        {
+            rc = vtoy_wim_bench(&wim);
+        }
+        else if (vtoy_wim_load_meta(&wim, index) == 0)
+        {
+            rc = (action == 'x') ? vtoy_wim_extract(&wim, path, file) : vtoy_wim_patch(&wim, path, file);
+        }
+    }
+
+    vtoy_wim_close(&wim);
+    return rc;
+}
+
+// wrapper main
+#ifndef BUILD_VTOY_TOOL
+int main(int argc, char **argv)
+{
+    return vtoywim_main(argc, argv);
+}
+#endif
+
@@ -0,0 +1,630 @@
+/******************************************************************************
+ * bench.c  ---- replay read traces through vtoychain
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * A synthetic chain head (a fragmented image, iso9660 overrides and virt chunks) is built
+ * from a seed, then the reads of a trace are replayed the way iPXE does it: vtoy_chain_map
+ * for each run on the disk, vtoy_chain_override on the data, and vtoy_chain_virt_read for
+ * the sectors beyond the real image. With -5 the trace is in 512 bytes sectors and goes
+ * through vtoy_chain_map_512, as the UEFI sector512 mode does.
+ *
+ * The disk is not read. The mapped sectors are hashed instead, so two builds of vtoychain
+ * must print the same hash for the same seed and trace, and -V checks every mapping
+ * against a plain linear search of the img chunks.
+ *
+ * A trace file has one read per line: "lba count", lines starting with # are skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "vtoychain_head.h"
+
+#define BENCH_MAX_READ      256     /* image sectors */
+#define BENCH_OVERRIDE_NUM  32
+#define BENCH_VIRT_NUM      4
+#define BENCH_VIRT_MEM      8       /* memory sectors of each virt chunk */
+#define BENCH_VIRT_REMAP    1024
+
+typedef struct bench_read
+{
+    vtoy_u64 lba;
+    vtoy_u32 count;
+}bench_read;
+
+static vtoy_u64 g_seed = 1;
+static vtoy_u64 g_hash;
+static vtoy_u64 g_disk_reads;
+static vtoy_u64 g_disk_sectors;
+static vtoy_u64 g_overrides;
+static vtoy_u64 g_bad;
+
+static int g_verify = 0;
+static int g_sector512 = 0;
+static ventoy_chain_head *g_head = NULL;
+static vtoy_u64 g_head_size;
+static vtoy_u64 g_real_sectors;
+static vtoy_u64 g_virt_sectors;
+static vtoy_chain g_chain;
+static vtoy_u8 *g_buf = NULL;
+
+static bench_read *g_trace = NULL;
+static vtoy_u32 g_trace_num;
+
+static vtoy_u32 bench_rand(void)
+{
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 7;
+    g_seed ^= g_seed << 17;
+    return (vtoy_u32)(g_seed >> 16);
+}
+
+static void bench_hash(vtoy_u64 value)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        g_hash ^= (value >> (i * 8)) & 0xFF;
+        g_hash *= 1099511628211ULL;
+    }
+}
+
+static vtoy_u64 bench_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (vtoy_u64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* image of imgsize bytes in chunknum fragments, with gaps between them on the disk */
+static int bench_build_head(vtoy_u32 chunknum, vtoy_u32 sectorsize, vtoy_u64 imgsize)
+{
+    vtoy_u32 i;
+    vtoy_u32 len;
+    vtoy_u32 per = 2048 / sectorsize;
+    vtoy_u64 sector = 0;
+    vtoy_u64 disk = 2048;
+    vtoy_u64 virt = 0;
+    ventoy_img_chunk *chunk = NULL;
+    ventoy_override_chunk *override = NULL;
+    ventoy_virt_chunk *node = NULL;
+
+    g_real_sectors = imgsize / 2048;
+    if (chunknum == 0 || chunknum > g_real_sectors)
+    {
+        fprintf(stderr, "invalid chunk number %u\n", chunknum);
+        return 1;
+    }
+
+    g_head_size = sizeof(ventoy_chain_head) + chunknum * sizeof(ventoy_img_chunk) +
+                  BENCH_OVERRIDE_NUM * sizeof(ventoy_override_chunk) +
+                  BENCH_VIRT_NUM * (sizeof(ventoy_virt_chunk) + BENCH_VIRT_MEM * 2048);
+
+    g_head = calloc(1, g_head_size);
+    if (NULL == g_head)
+    {
+        fprintf(stderr, "failed to alloc chain head %llu\n", (unsigned long long)g_head_size);
+        return 1;
+    }
+
+    g_head->disk_sector_size = sectorsize;
+    g_head->real_img_size_in_bytes = g_real_sectors * 2048;
+
+    g_head->img_chunk_offset = sizeof(ventoy_chain_head);
+    g_head->img_chunk_num = chunknum;
+    chunk = (ventoy_img_chunk *)((vtoy_u8 *)g_head + g_head->img_chunk_offset);
+
+    for (i = 0; i < chunknum; i++)
+    {
+        if (i + 1 == chunknum)
+        {
+            len = (vtoy_u32)(g_real_sectors - sector);
+        }
+        else
+        {
+            /* between half and one and a half times the average */
+            len = (vtoy_u32)(g_real_sectors / chunknum);
+            len = len / 2 + bench_rand() % (len + 1);
+            if (len == 0)
+            {
+                len = 1;
+            }
+            if (sector + len + (chunknum - i - 1) > g_real_sectors)
+            {
+                len = (vtoy_u32)(g_real_sectors - sector - (chunknum - i - 1));
+            }
+        }
+
+        chunk[i].img_start_sector = (vtoy_u32)sector;
+        chunk[i].img_end_sector = (vtoy_u32)(sector + len - 1);
+        chunk[i].disk_start_sector = disk;
+        chunk[i].disk_end_sector = disk + (vtoy_u64)len * per - 1;
+
+        sector += len;
+        disk = chunk[i].disk_end_sector + 1 + (bench_rand() % 4096) * per;
+    }
+
+    /* like the iso9660 directory records patched by grub, mostly in the first 64MB */
+    g_head->override_chunk_offset = g_head->img_chunk_offset + chunknum * sizeof(ventoy_img_chunk);
+    g_head->override_chunk_num = BENCH_OVERRIDE_NUM;
+    override = (ventoy_override_chunk *)((vtoy_u8 *)g_head + g_head->override_chunk_offset);
+
+    for (i = 0; i < BENCH_OVERRIDE_NUM; i++)
+    {
+        override[i].img_offset = (vtoy_u64)(bench_rand() % 32768) * 2048 + bench_rand() % 2048;
+        if (i % 8 == 7)
+        {
+            override[i].img_offset = ((vtoy_u64)bench_rand() * 2048) % (g_real_sectors * 2048);
+        }
+
+        override[i].override_size = 1 + bench_rand() % VTOY_CHAIN_OVERRIDE_MAX;
+        if (override[i].img_offset + override[i].override_size > g_real_sectors * 2048)
+        {
+            override[i].img_offset = g_real_sectors * 2048 - override[i].override_size;
+        }
+        memset(override[i].override_data, 0x30 + i, override[i].override_size);
+    }
+
+    /* memory sectors and a remapped run after the real image, like the injected initrd */
+    g_head->virt_chunk_offset = g_head->override_chunk_offset + BENCH_OVERRIDE_NUM * sizeof(ventoy_override_chunk);
+    g_head->virt_chunk_num = BENCH_VIRT_NUM;
+    node = (ventoy_virt_chunk *)((vtoy_u8 *)g_head + g_head->virt_chunk_offset);
+
+    virt = g_real_sectors;
+    for (i = 0; i < BENCH_VIRT_NUM; i++)
+    {
+        node[i].mem_sector_start = (vtoy_u32)virt;
+        node[i].mem_sector_end = node[i].mem_sector_start + BENCH_VIRT_MEM;
+        node[i].mem_sector_offset = BENCH_VIRT_NUM * sizeof(ventoy_virt_chunk) + i * BENCH_VIRT_MEM * 2048;
+        node[i].remap_sector_start = node[i].mem_sector_end;
+        node[i].remap_sector_end = node[i].remap_sector_start + BENCH_VIRT_REMAP;
+        node[i].org_sector_start = bench_rand() % (vtoy_u32)(g_real_sectors - BENCH_VIRT_REMAP);
+
+        virt = node[i].remap_sector_end;
+    }
+
+    g_virt_sectors = virt - g_real_sectors;
+    g_head->virt_img_size_in_bytes = virt * 2048;
+
+    return 0;
+}
+
+/* mostly sequential reads as a boot does, some random ones and some in the virt chunks */
+static int bench_gen_trace(vtoy_u32 num)
+{
+    vtoy_u32 i;
+    vtoy_u32 type;
+    vtoy_u64 lba = 0;
+    vtoy_u32 count = 0;
+
+    g_trace = malloc(num * sizeof(bench_read));
+    if (NULL == g_trace)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        type = bench_rand() % 10;
+        if (type < 6)
+        {
+            lba += count;
+            count = 16 + bench_rand() % 49;
+        }
+        else if (type < 9)
+        {
+            lba = bench_rand() % g_real_sectors;
+            count = 1 + bench_rand() % 64;
+        }
+        else
+        {
+            lba = g_real_sectors + bench_rand() % g_virt_sectors;
+            count = 1 + bench_rand() % 16;
+            if (lba + count > g_real_sectors + g_virt_sectors)
+            {
+                count = (vtoy_u32)(g_real_sectors + g_virt_sectors - lba);
+            }
+        }
+
+        if (lba < g_real_sectors && lba + count > g_real_sectors)
+        {
+            lba = 0;
+        }
+
+        g_trace[i].lba = lba;
+        g_trace[i].count = count;
+
+        if (g_sector512)
+        {
+            g_trace[i].lba = lba * 4 + bench_rand() % 4;
+            g_trace[i].count = count * 4 - (vtoy_u32)(g_trace[i].lba & 3);
+        }
+    }
+
+    g_trace_num = num;
+    return 0;
+}
+
+static int bench_load_trace(const char *file)
+{
+    vtoy_u32 max = 4096;
+    unsigned int count;
+    unsigned long long lba;
+    char line[256];
+    FILE *fp = NULL;
+
+    fp = fopen(file, "r");
+    if (NULL == fp)
+    {
+        fprintf(stderr, "failed to open %s\n", file);
+        return 1;
+    }
+
+    g_trace = malloc(max * sizeof(bench_read));
+    g_trace_num = 0;
+
+    while (g_trace && fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#' || sscanf(line, "%llu %u", &lba, &count) != 2)
+        {
+            continue;
+        }
+
+        if (count == 0 || count > BENCH_MAX_READ * (g_sector512 ? 4 : 1))
+        {
+            fprintf(stderr, "skip read %llu %u\n", lba, count);
+            continue;
+        }
+
+        if (g_trace_num == max)
+        {
+            max *= 2;
+            g_trace = realloc(g_trace, max * sizeof(bench_read));
+            if (NULL == g_trace)
+            {
+                break;
+            }
+        }
+
+        g_trace[g_trace_num].lba = lba;
+        g_trace[g_trace_num].count = count;
+        g_trace_num++;
+    }
+
+    fclose(fp);
+    return g_trace ? 0 : 1;
+}
+
+/* linear search over the img chunks, with lba and count in 1/unit image sectors */
+static void bench_verify(vtoy_u64 lba, vtoy_u32 unit, vtoy_u32 reqcount, int rc, vtoy_u32 count, vtoy_u64 disk)
+{
+    vtoy_u32 i;
+    vtoy_u32 per;
+    vtoy_u64 max = reqcount;
+    vtoy_u64 expect = 0;
+    int found = -1;
+    ventoy_img_chunk *chunk = g_chain.img_chunk;
+
+    for (i = 0; i < g_chain.img_chunk_num; i++)
+    {
+        if (lba >= (vtoy_u64)chunk[i].img_start_sector * unit && lba < ((vtoy_u64)chunk[i].img_end_sector + 1) * unit)
+        {
+            found = (int)i;
+            max = ((vtoy_u64)chunk[i].img_end_sector + 1) * unit - lba;
+            break;
+        }
+
+        if ((vtoy_u64)chunk[i].img_start_sector * unit > lba && (vtoy_u64)chunk[i].img_start_sector * unit - lba < max)
+        {
+            max = (vtoy_u64)chunk[i].img_start_sector * unit - lba;
+        }
+    }
+
+    if (max > reqcount)
+    {
+        max = reqcount;
+    }
+
+    if (found >= 0)
+    {
+        per = 2048 / g_chain.disk_sector_size;
+        expect = chunk[found].disk_start_sector + (lba - (vtoy_u64)chunk[found].img_start_sector * unit) * per / unit;
+    }
+
+    if ((rc == 0) != (found >= 0) || count != max || (found >= 0 && disk != expect))
+    {
+        if (g_bad++ < 10)
+        {
+            fprintf(stderr, "mismatch lba:%llu count:%u rc:%d/%d count:%u/%llu disk:%llu/%llu\n",
+                    (unsigned long long)lba, reqcount, rc, found >= 0 ? 0 : 1, count,
+                    (unsigned long long)max, (unsigned long long)disk, (unsigned long long)expect);
+        }
+    }
+}
+
+static int bench_read_real(vtoy_u64 lba, vtoy_u32 count, vtoy_u8 *buf)
+{
+    int rc;
+    vtoy_u32 left = count;
+    vtoy_u32 readcount;
+    vtoy_u64 curlba = lba;
+    vtoy_u64 maplba = 0;
+
+    while (left > 0)
+    {
+        readcount = left;
+        rc = vtoy_chain_map(&g_chain, curlba, &readcount, &maplba);
+        if (g_verify)
+        {
+            bench_verify(curlba, 1, left, rc, readcount, maplba);
+        }
+
+        if (readcount == 0)
+        {
+            readcount = 1;
+        }
+
+        if (rc == 0)
+        {
+            bench_hash(maplba);
+            bench_hash(readcount);
+            g_disk_reads++;
+            g_disk_sectors += readcount;
+        }
+
+        curlba += readcount;
+        left -= readcount;
+    }
+
+    g_overrides += vtoy_chain_override(&g_chain, lba, count, buf, NULL, NULL);
+    return 0;
+}
+
+static int bench_read_remap(void *ctx, vtoy_u64 lba, vtoy_u32 count, vtoy_u8 *buf)
+{
+    (void)ctx;
+    return bench_read_real(lba, count, buf);
+}
+
+static void bench_read_512(vtoy_u64 lba512, vtoy_u32 count)
+{
+    int rc;
+    vtoy_u32 left = count;
+    vtoy_u32 readcount;
+    vtoy_u64 curlba = lba512;
+    vtoy_u64 maplba = 0;
+
+    while (left > 0)
+    {
+        readcount = left;
+        rc = vtoy_chain_map_512(&g_chain, curlba, &readcount, &maplba);
+        if (g_verify)
+        {
+            bench_verify(curlba, 4, left, rc, readcount, maplba);
+        }
+
+        if (readcount == 0)
+        {
+            readcount = 1;
+        }
+
+        if (rc == 0)
+        {
+            bench_hash(maplba);
+            bench_hash(readcount);
+            g_disk_reads++;
+            g_disk_sectors += readcount;
+        }
+
+        curlba += readcount;
+        left -= readcount;
+    }
+
+    g_overrides += vtoy_chain_override_bytes(&g_chain, lba512 * 512, (vtoy_u64)count * 512, g_buf, NULL, NULL);
+}
+
+static void bench_replay(void)
+{
+    vtoy_u32 i;
+    bench_read *read = NULL;
+
+    for (i = 0; i < g_trace_num; i++)
+    {
+        read = g_trace + i;
+
+        if (g_sector512)
+        {
+            bench_read_512(read->lba, read->count);
+        }
+        else if (read->lba < g_real_sectors)
+        {
+            bench_read_real(read->lba, read->count, g_buf);
+        }
+        else
+        {
+            vtoy_chain_virt_read(&g_chain, read->lba, read->count, g_buf, bench_read_remap, NULL);
+        }
+
+        bench_hash(g_buf[0]);
+    }
+}
+
+static int bench_print_help(FILE *fp)
+{
+    fprintf(fp, "Usage: bench [ -t trace ] [ -w trace ] [ -n reads ] [ -c chunks ] [ -S sector_size ]\n"
+            "             [ -i image_mb ] [ -r rounds ] [ -s seed ] [ -5 ] [ -V ]\n"
+            "  -t  replay the reads in trace instead of generated ones\n"
+            "  -w  save the generated reads to trace and exit\n"
+            "  -5  the reads are in 512 bytes sectors (vtoy_chain_map_512)\n"
+            "  -V  check every mapping with a linear search\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ch;
+    int rounds = 10;
+    vtoy_u32 i;
+    vtoy_u32 reads = 100000;
+    vtoy_u32 chunknum = 1000;
+    vtoy_u32 sectorsize = 512;
+    vtoy_u64 imgmb = 4096;
+    vtoy_u64 seed;
+    vtoy_u64 start;
+    vtoy_u64 cost;
+    vtoy_u64 sectors = 0;
+    char *trace = NULL;
+    char *save = NULL;
+    FILE *fp = NULL;
+
+    while ((ch = getopt(argc, argv, "t:w:n:c:S:i:r:s:5Vh")) != -1)
+    {
+        if (ch == 't')
+        {
+            trace = optarg;
+        }
+        else if (ch == 'w')
+        {
+            save = optarg;
+        }
+        else if (ch == 'n')
+        {
+            reads = (vtoy_u32)strtoul(optarg, NULL, 10);
+        }
+        else if (ch == 'c')
+        {
+            chunknum = (vtoy_u32)strtoul(optarg, NULL, 10);
+        }
+        else if (ch == 'S')
+        {
+            sectorsize = (vtoy_u32)strtoul(optarg, NULL, 10);
+        }
+        else if (ch == 'i')
+        {
+            imgmb = strtoull(optarg, NULL, 10);
+        }
+        else if (ch == 'r')
+        {
+            rounds = (int)strtol(optarg, NULL, 10);
+        }
+        else if (ch == 's')
+        {
+            g_seed = strtoull(optarg, NULL, 0);
+        }
+        else if (ch == '5')
+        {
+            g_sector512 = 1;
+        }
+        else if (ch == 'V')
+        {
+            g_verify = 1;
+        }
+        else
+        {
+            return bench_print_help(ch == 'h' ? stdout : stderr);
+        }
+    }
+
+    if (sectorsize != 512 && sectorsize != 1024 && sectorsize != 2048)
+    {
+        fprintf(stderr, "sector size must be 512/1024/2048\n");
+        return 1;
+    }
+
+    if (g_seed == 0)
+    {
+        g_seed = 1;
+    }
+    seed = g_seed;
+
+    if (imgmb < 8 || bench_build_head(chunknum, sectorsize, imgmb * 1024 * 1024))
+    {
+        return 1;
+    }
+
+    if (vtoy_chain_init_head(&g_chain, g_head, g_head_size))
+    {
+        fprintf(stderr, "vtoy_chain_init rejects the chain head\n");
+        return 1;
+    }
+
+    if (trace ? bench_load_trace(trace) : bench_gen_trace(reads))
+    {
+        return 1;
+    }
+
+    if (save)
+    {
+        fp = fopen(save, "w");
+        if (NULL == fp)
+        {
+            fprintf(stderr, "failed to create %s\n", save);
+            return 1;
+        }
+
+        fprintf(fp, "# seed:%llu chunks:%u sector:%u image:%lluMB %s\n", (unsigned long long)seed,
+                chunknum, sectorsize, (unsigned long long)imgmb, g_sector512 ? "512" : "2048");
+        for (i = 0; i < g_trace_num; i++)
+        {
+            fprintf(fp, "%llu %u\n", (unsigned long long)g_trace[i].lba, g_trace[i].count);
+        }
+        fclose(fp);
+        return 0;
+    }
+
+    g_buf = malloc(BENCH_MAX_READ * 2048);
+    if (NULL == g_buf)
+    {
+        return 1;
+    }
+    memset(g_buf, 0, BENCH_MAX_READ * 2048);
+
+    for (i = 0; i < g_trace_num; i++)
+    {
+        sectors += g_trace[i].count;
+    }
+
+    start = bench_ms();
+    for (ch = 0; ch < rounds; ch++)
+    {
+        g_hash = 14695981039346656037ULL;
+        g_disk_reads = g_disk_sectors = g_overrides = 0;
+        bench_replay();
+    }
+    cost = bench_ms() - start;
+
+    printf("chunks:%u sector:%u image:%lluMB reads:%u sectors:%llu rounds:%d\n",
+           chunknum, sectorsize, (unsigned long long)imgmb, g_trace_num, (unsigned long long)sectors, rounds);
+    printf("disk reads:%llu disk sectors:%llu overrides:%llu hash:%016llx bad:%llu\n",
+           (unsigned long long)g_disk_reads, (unsigned long long)g_disk_sectors,
+           (unsigned long long)g_overrides, (unsigned long long)g_hash, (unsigned long long)g_bad);
+    printf("time:%llums  %.1f ns/read\n", (unsigned long long)cost,
+           g_trace_num ? (double)cost * 1000000.0 / ((double)g_trace_num * rounds) : 0.0);
+
+    free(g_buf);
+    free(g_trace);
+    free(g_head);
+    return g_bad ? 1 : 0;
+}
+
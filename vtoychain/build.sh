@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# host tools to measure and check vtoychain, they are not part of the release
+
+rm -f vtoychain_bench vtoychain_fuzz
+
+gcc -O2 -Wall bench.c vtoychain.c -o vtoychain_bench
+
+if which clang > /dev/null 2>&1; then
+    clang -g -O1 -Wall -fsanitize=fuzzer,address fuzz.c vtoychain.c -o vtoychain_fuzz
+else
+    # no libFuzzer, build the standalone driver
+    gcc -g -O1 -Wall -fsanitize=address,undefined -fno-sanitize=alignment -DVTOY_CHAIN_FUZZ_MAIN fuzz.c vtoychain.c -o vtoychain_fuzz
+fi
+
+if [ -e vtoychain_bench ] && [ -e vtoychain_fuzz ]; then
+    echo -e '\n############### SUCCESS ###############\n'
+else
+    echo -e '\n############### FAILED ################\n'
+    exit 1
+fi
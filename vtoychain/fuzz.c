@@ -0,0 +1,323 @@
+/******************************************************************************
+ * fuzz.c  ---- libFuzzer target for malformed chain heads
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The input is the chain head with its chunk tables, exactly as grub passes it (the buffer
+ * is allocated with the input size so that ASan catches any read beyond it). The reads to
+ * do are taken from boot_catalog_sector, 6 bytes each: a 4 bytes lba and a 2 bytes count.
+ *
+ * Build with clang -fsanitize=fuzzer,address. Without libFuzzer, build with
+ * -DVTOY_CHAIN_FUZZ_MAIN: it runs the files given on the command line, or mutates a
+ * valid chain head for a number of rounds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "vtoychain_head.h"
+
+#define FUZZ_READ_NUM   16
+#define FUZZ_READ_MAX   64
+
+typedef struct fuzz_ctx
+{
+    vtoy_u8 *buf;
+    vtoy_u32 len;
+}fuzz_ctx;
+
+/* the remapped runs that vtoy_chain_virt_read asks for must be inside the caller's buffer */
+static int fuzz_read(void *ctx, vtoy_u64 lba, vtoy_u32 count, vtoy_u8 *buf)
+{
+    fuzz_ctx *fuzz = (fuzz_ctx *)ctx;
+
+    (void)lba;
+
+    if (count == 0 || buf < fuzz->buf || buf + (vtoy_u64)count * 2048 > fuzz->buf + fuzz->len)
+    {
+        abort();
+    }
+
+    memset(buf, 0xAA, (size_t)count * 2048);
+    return 0;
+}
+
+static void fuzz_map(vtoy_chain *chain, vtoy_u64 lba, vtoy_u32 count, int sector512)
+{
+    int rc;
+    vtoy_u32 left = count;
+    vtoy_u32 readcount;
+    vtoy_u64 maplba;
+
+    while (left > 0)
+    {
+        readcount = left;
+        if (sector512)
+        {
+            rc = vtoy_chain_map_512(chain, lba, &readcount, &maplba);
+        }
+        else
+        {
+            rc = vtoy_chain_map(chain, lba, &readcount, &maplba);
+        }
+
+        /* the count can only be cut, and a hit maps at least one sector */
+        if (readcount > left || (rc == 0 && readcount == 0))
+        {
+            abort();
+        }
+
+        if (readcount == 0)
+        {
+            readcount = 1;
+        }
+
+        lba += readcount;
+        left -= readcount;
+    }
+}
+
+int LLVMFuzzerTestOneInput(const vtoy_u8 *data, size_t size)
+{
+    int i;
+    vtoy_u32 count;
+    vtoy_u64 lba;
+    vtoy_u8 *param = NULL;
+    ventoy_chain_head *head = NULL;
+    vtoy_chain chain;
+    fuzz_ctx ctx;
+
+    if (size < sizeof(ventoy_chain_head))
+    {
+        return 0;
+    }
+
+    head = malloc(size);
+    ctx.len = FUZZ_READ_MAX * 2048;
+    ctx.buf = malloc(ctx.len);
+    if (NULL == head || NULL == ctx.buf)
+    {
+        free(head);
+        free(ctx.buf);
+        return 0;
+    }
+    memcpy(head, data, size);
+
+    vtoy_chain_init_head(&chain, head, size);
+
+    param = head->boot_catalog_sector;
+    for (i = 0; i < FUZZ_READ_NUM; i++, param += 6)
+    {
+        lba = param[0] | (param[1] << 8) | (param[2] << 16) | ((vtoy_u64)param[3] << 24);
+        count = 1 + (param[4] | (param[5] << 8)) % FUZZ_READ_MAX;
+
+        fuzz_map(&chain, lba, count, 0);
+        fuzz_map(&chain, lba * 4 + (param[4] & 3), count * 4, 1);
+
+        vtoy_chain_override(&chain, lba, count, ctx.buf, NULL, NULL);
+        vtoy_chain_override_bytes(&chain, lba * 512 + param[5], count * 512, ctx.buf, NULL, NULL);
+
+        /* the virt chunks are beyond the real image, try both the lba as is and after it */
+        vtoy_chain_virt_read(&chain, lba, count, ctx.buf, fuzz_read, &ctx);
+        vtoy_chain_virt_read(&chain, (chain.real_img_size / 2048) + (lba & 0xFFFF), count, ctx.buf, fuzz_read, &ctx);
+    }
+
+    free(ctx.buf);
+    free(head);
+    return 0;
+}
+
+#ifdef VTOY_CHAIN_FUZZ_MAIN
+
+static vtoy_u64 g_seed = 1;
+
+static vtoy_u32 fuzz_rand(void)
+{
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 7;
+    g_seed ^= g_seed << 17;
+    return (vtoy_u32)(g_seed >> 16);
+}
+
+/* a small valid head: 3 img chunks, 2 override chunks, 1 virt chunk with 2 memory sectors */
+static vtoy_u32 fuzz_seed_head(vtoy_u8 *buf, vtoy_u32 max)
+{
+    vtoy_u32 i;
+    vtoy_u32 size;
+    ventoy_chain_head *head = (ventoy_chain_head *)buf;
+    ventoy_img_chunk *chunk;
+    ventoy_override_chunk *override;
+    ventoy_virt_chunk *virt;
+
+    size = sizeof(ventoy_chain_head) + 3 * sizeof(ventoy_img_chunk) +
+           2 * sizeof(ventoy_override_chunk) + sizeof(ventoy_virt_chunk) + 2 * 2048;
+    if (size > max)
+    {
+        return 0;
+    }
+
+    memset(buf, 0, size);
+    head->disk_sector_size = 512;
+    head->real_img_size_in_bytes = 3000 * 2048;
+
+    head->img_chunk_offset = sizeof(ventoy_chain_head);
+    head->img_chunk_num = 3;
+    chunk = (ventoy_img_chunk *)(buf + head->img_chunk_offset);
+    for (i = 0; i < 3; i++)
+    {
+        chunk[i].img_start_sector = i * 1000;
+        chunk[i].img_end_sector = i * 1000 + 999;
+        chunk[i].disk_start_sector = 2048 + i * 10000;
+        chunk[i].disk_end_sector = chunk[i].disk_start_sector + 3999;
+    }
+
+    head->override_chunk_offset = head->img_chunk_offset + 3 * sizeof(ventoy_img_chunk);
+    head->override_chunk_num = 2;
+    override = (ventoy_override_chunk *)(buf + head->override_chunk_offset);
+    override[0].img_offset = 16 * 2048 + 100;
+    override[0].override_size = 32;
+    override[1].img_offset = 1999 * 2048 + 2000;
+    override[1].override_size = 100;
+
+    head->virt_chunk_offset = head->override_chunk_offset + 2 * sizeof(ventoy_override_chunk);
+    head->virt_chunk_num = 1;
+    virt = (ventoy_virt_chunk *)(buf + head->virt_chunk_offset);
+    virt->mem_sector_start = 3000;
+    virt->mem_sector_end = 3002;
+    virt->mem_sector_offset = sizeof(ventoy_virt_chunk);
+    virt->remap_sector_start = 3002;
+    virt->remap_sector_end = 3100;
+    virt->org_sector_start = 500;
+
+    /* reads: 4 bytes lba, 2 bytes count */
+    for (i = 0; i < FUZZ_READ_NUM * 6; i++)
+    {
+        head->boot_catalog_sector[i] = (vtoy_u8)fuzz_rand();
+    }
+
+    return size;
+}
+
+/* the fields that point into the tables, mutated more often than the rest */
+static const vtoy_u32 g_fuzz_field[] =
+{
+    (vtoy_u32)offsetof(ventoy_chain_head, disk_sector_size),
+    (vtoy_u32)offsetof(ventoy_chain_head, real_img_size_in_bytes),
+    (vtoy_u32)offsetof(ventoy_chain_head, img_chunk_offset),
+    (vtoy_u32)offsetof(ventoy_chain_head, img_chunk_num),
+    (vtoy_u32)offsetof(ventoy_chain_head, override_chunk_offset),
+    (vtoy_u32)offsetof(ventoy_chain_head, override_chunk_num),
+    (vtoy_u32)offsetof(ventoy_chain_head, virt_chunk_offset),
+    (vtoy_u32)offsetof(ventoy_chain_head, virt_chunk_num),
+};
+
+static int fuzz_file(const char *file)
+{
+    long size;
+    vtoy_u8 *buf = NULL;
+    FILE *fp = NULL;
+
+    fp = fopen(file, "rb");
+    if (NULL == fp)
+    {
+        fprintf(stderr, "failed to open %s\n", file);
+        return 1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    buf = malloc(size > 0 ? size : 1);
+    if (buf && fread(buf, 1, size, fp) == (size_t)size)
+    {
+        LLVMFuzzerTestOneInput(buf, (size_t)size);
+    }
+
+    free(buf);
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    int j;
+    int rounds = 100000;
+    vtoy_u32 pos;
+    vtoy_u32 size;
+    vtoy_u32 max = 64 * 1024;
+    vtoy_u8 *buf = NULL;
+    char *end = NULL;
+
+    if (argc > 1)
+    {
+        rounds = (int)strtol(argv[1], &end, 10);
+        if (end == NULL || *end)
+        {
+            for (i = 1; i < argc; i++)
+            {
+                fuzz_file(argv[i]);
+            }
+            printf("%d files done\n", argc - 1);
+            return 0;
+        }
+    }
+
+    buf = malloc(max);
+    if (NULL == buf)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < rounds; i++)
+    {
+        size = fuzz_seed_head(buf, max);
+
+        for (j = 1 + fuzz_rand() % 4; j > 0; j--)
+        {
+            if (fuzz_rand() % 2)
+            {
+                pos = g_fuzz_field[fuzz_rand() % (sizeof(g_fuzz_field) / sizeof(g_fuzz_field[0]))] + fuzz_rand() % 4;
+            }
+            else
+            {
+                pos = sizeof(ventoy_chain_head) + fuzz_rand() % (size - sizeof(ventoy_chain_head));
+            }
+
+            buf[pos] = (fuzz_rand() % 4) ? (vtoy_u8)fuzz_rand() : 0xFF;
+        }
+
+        /* a truncated head, the tables may now end beyond it */
+        if (fuzz_rand() % 8 == 0)
+        {
+            size -= fuzz_rand() % (size - sizeof(ventoy_chain_head) + 1);
+        }
+
+        LLVMFuzzerTestOneInput(buf, size);
+    }
+
+    free(buf);
+    printf("%d rounds done\n", rounds);
+    return 0;
+}
+
+#endif /* VTOY_CHAIN_FUZZ_MAIN */
+
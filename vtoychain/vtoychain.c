@@ -0,0 +1,468 @@
+/******************************************************************************
+ * vtoychain.c  ---- ventoy chain head sector mapping
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef FILE_LICENCE
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#endif
+
+#include "vtoychain.h"
+
+/*
+ * Check that the tables are inside the chain head buffer (head_size 0 means unknown),
+ * a table that is not is dropped so that the lookups never go out of it.
+ * Return 0 if all the tables are good.
+ */
+int vtoy_chain_init
+(
+    vtoy_chain *chain,
+    void *head,
+    vtoy_u64 head_size,
+    vtoy_u32 img_chunk_offset,
+    vtoy_u32 img_chunk_num,
+    vtoy_u32 override_chunk_offset,
+    vtoy_u32 override_chunk_num,
+    vtoy_u32 virt_chunk_offset,
+    vtoy_u32 virt_chunk_num,
+    vtoy_u64 real_img_size,
+    vtoy_u32 disk_sector_size
+)
+{
+    int rc = 0;
+    vtoy_u32 i;
+    vtoy_u64 end;
+    ventoy_img_chunk *chunk;
+    ventoy_override_chunk *override;
+    ventoy_virt_chunk *virt;
+
+    chain->img_chunk = (ventoy_img_chunk *)((vtoy_u8 *)head + img_chunk_offset);
+    chain->img_chunk_num = img_chunk_num;
+    chain->override_chunk = (ventoy_override_chunk *)((vtoy_u8 *)head + override_chunk_offset);
+    chain->override_chunk_num = override_chunk_num;
+    chain->virt_chunk = (ventoy_virt_chunk *)((vtoy_u8 *)head + virt_chunk_offset);
+    chain->virt_chunk_num = virt_chunk_num;
+    chain->real_img_size = real_img_size;
+    chain->sorted = 1;
+    chain->cur = 0;
+    chain->override_start = 0;
+    chain->override_end = 0;
+
+    if (disk_sector_size < 512 || disk_sector_size > 4096 || (disk_sector_size & (disk_sector_size - 1)))
+    {
+        disk_sector_size = 512;
+        rc = 1;
+    }
+    chain->disk_sector_size = disk_sector_size;
+    chain->disk_sector_per_img = (disk_sector_size <= VTOY_CHAIN_IMG_SECTOR_SIZE) ?
+                                 VTOY_CHAIN_IMG_SECTOR_SIZE / disk_sector_size : 0;
+
+    if (head_size > 0)
+    {
+        if ((vtoy_u64)img_chunk_offset + (vtoy_u64)img_chunk_num * sizeof(ventoy_img_chunk) > head_size)
+        {
+            chain->img_chunk_num = 0;
+            rc = 1;
+        }
+
+        if ((vtoy_u64)override_chunk_offset + (vtoy_u64)override_chunk_num * sizeof(ventoy_override_chunk) > head_size)
+        {
+            chain->override_chunk_num = 0;
+            rc = 1;
+        }
+
+        if ((vtoy_u64)virt_chunk_offset + (vtoy_u64)virt_chunk_num * sizeof(ventoy_virt_chunk) > head_size)
+        {
+            chain->virt_chunk_num = 0;
+            rc = 1;
+        }
+    }
+
+    for (i = 0, chunk = chain->img_chunk; i < chain->img_chunk_num; i++, chunk++)
+    {
+        if (chunk->img_start_sector > chunk->img_end_sector)
+        {
+            chain->img_chunk_num = 0;
+            rc = 1;
+            break;
+        }
+
+        if (i > 0 && chunk->img_start_sector <= chunk[-1].img_end_sector)
+        {
+            chain->sorted = 0;
+        }
+    }
+
+    for (i = 0, override = chain->override_chunk; i < chain->override_chunk_num; i++, override++)
+    {
+        if (override->override_size > VTOY_CHAIN_OVERRIDE_MAX)
+        {
+            chain->override_chunk_num = 0;
+            rc = 1;
+            break;
+        }
+
+        end = override->img_offset + override->override_size;
+        if (i == 0 || override->img_offset < chain->override_start)
+        {
+            chain->override_start = override->img_offset;
+        }
+        if (end > chain->override_end)
+        {
+            chain->override_end = end;
+        }
+    }
+
+    if (chain->override_chunk_num == 0)
+    {
+        chain->override_start = chain->override_end = 0;
+    }
+
+    /* the memory sectors of virt chunk are located from the start of the virt chunk table */
+    for (i = 0, virt = chain->virt_chunk; i < chain->virt_chunk_num; i++, virt++)
+    {
+        if (virt->mem_sector_start > virt->mem_sector_end || virt->remap_sector_start > virt->remap_sector_end)
+        {
+            chain->virt_chunk_num = 0;
+            rc = 1;
+            break;
+        }
+
+        end = (vtoy_u64)virt_chunk_offset + virt->mem_sector_offset +
+              (vtoy_u64)(virt->mem_sector_end - virt->mem_sector_start) * VTOY_CHAIN_IMG_SECTOR_SIZE;
+        if (head_size > 0 && end > head_size)
+        {
+            chain->virt_chunk_num = 0;
+            rc = 1;
+            break;
+        }
+    }
+
+    return rc;
+}
+
+/*
+ * Find the img chunk which contains lba.
+ * Reads are mostly sequential, so try the last hit chunk and the one after it first.
+ * If not found, *next is set to the first chunk after lba (img_chunk_num if none).
+ */
+static int vtoy_chain_find(vtoy_chain *chain, vtoy_u32 lba, vtoy_u32 *next)
+{
+    vtoy_u32 i;
+    vtoy_u32 lo, hi, mid;
+    vtoy_u32 num = chain->img_chunk_num;
+    ventoy_img_chunk *chunk = chain->img_chunk;
+
+    for (i = chain->cur; i < num && i <= chain->cur + 1; i++)
+    {
+        if (lba >= chunk[i].img_start_sector && lba <= chunk[i].img_end_sector)
+        {
+            chain->cur = i;
+            return (int)i;
+        }
+    }
+
+    if (chain->sorted)
+    {
+        lo = 0;
+        hi = num;
+        while (lo < hi)
+        {
+            mid = lo + (hi - lo) / 2;
+            if (chunk[mid].img_end_sector < lba)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        if (lo < num && lba >= chunk[lo].img_start_sector)
+        {
+            chain->cur = lo;
+            return (int)lo;
+        }
+
+        *next = lo;
+        return -1;
+    }
+
+    *next = num;
+    for (i = 0; i < num; i++)
+    {
+        if (lba >= chunk[i].img_start_sector && lba <= chunk[i].img_end_sector)
+        {
+            chain->cur = i;
+            return (int)i;
+        }
+
+        if (chunk[i].img_start_sector > lba && (*next == num || chunk[i].img_start_sector < chunk[*next].img_start_sector))
+        {
+            *next = i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Map the image sector lba to the disk sector (in disk_sector_size).
+ * *count is cut to the sectors which are continuous on the disk.
+ * Return 0 if found, otherwise 1 and *count is cut to the sectors before the next img chunk.
+ */
+int vtoy_chain_map(vtoy_chain *chain, vtoy_u64 lba, vtoy_u32 *count, vtoy_u64 *disk_sector)
+{
+    int i;
+    vtoy_u32 next = 0;
+    vtoy_u64 max;
+    vtoy_u64 offset;
+    ventoy_img_chunk *chunk;
+
+    if (lba > 0xFFFFFFFFULL)
+    {
+        return 1;
+    }
+
+    i = vtoy_chain_find(chain, (vtoy_u32)lba, &next);
+    if (i < 0)
+    {
+        if (next < chain->img_chunk_num)
+        {
+            max = chain->img_chunk[next].img_start_sector - lba;
+            if (*count > max)
+            {
+                *count = (vtoy_u32)max;
+            }
+        }
+        return 1;
+    }
+
+    chunk = chain->img_chunk + i;
+
+    max = (vtoy_u64)chunk->img_end_sector + 1 - lba;
+    if (*count > max)
+    {
+        *count = (vtoy_u32)max;
+    }
+
+    offset = lba - chunk->img_start_sector;
+    if (chain->disk_sector_per_img)
+    {
+        *disk_sector = chunk->disk_start_sector + offset * chain->disk_sector_per_img;
+    }
+    else
+    {
+        *disk_sector = chunk->disk_start_sector + offset * VTOY_CHAIN_IMG_SECTOR_SIZE / chain->disk_sector_size;
+    }
+
+    return 0;
+}
+
+/*
+ * Map the 512 bytes sector lba512 of the image to the disk sector, only for 512 bytes sector disk.
+ * *count is in 512 bytes sectors, the return value is the same as vtoy_chain_map.
+ */
+int vtoy_chain_map_512(vtoy_chain *chain, vtoy_u64 lba512, vtoy_u32 *count, vtoy_u64 *disk_sector)
+{
+    int i;
+    vtoy_u32 next = 0;
+    vtoy_u64 lba = lba512 / 4;
+    vtoy_u64 max;
+    ventoy_img_chunk *chunk;
+
+    if (chain->disk_sector_size != 512 || lba > 0xFFFFFFFFULL)
+    {
+        return 1;
+    }
+
+    i = vtoy_chain_find(chain, (vtoy_u32)lba, &next);
+    if (i < 0)
+    {
+        if (next < chain->img_chunk_num)
+        {
+            max = (vtoy_u64)chain->img_chunk[next].img_start_sector * 4 - lba512;
+            if (*count > max)
+            {
+                *count = (vtoy_u32)max;
+            }
+        }
+        return 1;
+    }
+
+    chunk = chain->img_chunk + i;
+
+    max = ((vtoy_u64)chunk->img_end_sector + 1) * 4 - lba512;
+    if (*count > max)
+    {
+        *count = (vtoy_u32)max;
+    }
+
+    *disk_sector = chunk->disk_start_sector + (lba512 - (vtoy_u64)chunk->img_start_sector * 4);
+    return 0;
+}
+
+/*
+ * Copy the override data over the len bytes at offset of the image just read into buf.
+ * Return the number of override chunks applied.
+ */
+vtoy_u32 vtoy_chain_override_bytes(vtoy_chain *chain, vtoy_u64 offset, vtoy_u64 len, void *buf,
+                                   vtoy_chain_override_pf hook, void *ctx)
+{
+    vtoy_u32 i;
+    vtoy_u32 applied = 0;
+    vtoy_u64 start, end;
+    vtoy_u64 from, to;
+    vtoy_u64 override_start, override_end;
+    ventoy_override_chunk *node;
+
+    start = offset;
+    end = start + len;
+
+    if (start > chain->real_img_size)
+    {
+        return 0;
+    }
+
+    if (end <= chain->override_start || start >= chain->override_end)
+    {
+        return 0;
+    }
+
+    for (i = 0, node = chain->override_chunk; i < chain->override_chunk_num; i++, node++)
+    {
+        override_start = node->img_offset;
+        override_end = override_start + node->override_size;
+
+        if (end <= override_start || start >= override_end)
+        {
+            continue;
+        }
+
+        from = (start > override_start) ? start : override_start;
+        to = (end < override_end) ? end : override_end;
+
+        vtoy_chain_memcpy((vtoy_u8 *)buf + (from - start), node->override_data + (from - override_start), to - from);
+        applied++;
+
+        if (hook)
+        {
+            hook(ctx, node);
+        }
+    }
+
+    return applied;
+}
+
+/* the same as vtoy_chain_override_bytes, for count image sectors at lba */
+vtoy_u32 vtoy_chain_override(vtoy_chain *chain, vtoy_u64 lba, vtoy_u32 count, void *buf,
+                             vtoy_chain_override_pf hook, void *ctx)
+{
+    return vtoy_chain_override_bytes(chain, lba * VTOY_CHAIN_IMG_SECTOR_SIZE,
+                                     (vtoy_u64)count * VTOY_CHAIN_IMG_SECTOR_SIZE, buf, hook, ctx);
+}
+
+/*
+ * Look up the image sector lba (beyond the real image) in the virt chunks.
+ * VTOY_CHAIN_VIRT_MEM:   *mem is the 2048 bytes data of it
+ * VTOY_CHAIN_VIRT_REMAP: *remap is the real image sector to read
+ */
+int vtoy_chain_virt_sector(vtoy_chain *chain, vtoy_u64 lba, const vtoy_u8 **mem, vtoy_u64 *remap)
+{
+    vtoy_u32 i;
+    ventoy_virt_chunk *node;
+
+    for (i = 0, node = chain->virt_chunk; i < chain->virt_chunk_num; i++, node++)
+    {
+        if (lba >= node->mem_sector_start && lba < node->mem_sector_end)
+        {
+            *mem = (const vtoy_u8 *)chain->virt_chunk + node->mem_sector_offset +
+                   (lba - node->mem_sector_start) * VTOY_CHAIN_IMG_SECTOR_SIZE;
+            return VTOY_CHAIN_VIRT_MEM;
+        }
+        else if (lba >= node->remap_sector_start && lba < node->remap_sector_end)
+        {
+            *remap = node->org_sector_start + lba - node->remap_sector_start;
+            return VTOY_CHAIN_VIRT_REMAP;
+        }
+    }
+
+    return VTOY_CHAIN_VIRT_NONE;
+}
+
+/*
+ * Read count sectors at lba from the virtual image (real image + virt chunks).
+ * Memory sectors are copied, remapped sectors that are continuous both in the real image
+ * and in buf are read together with one read call. Sectors not in any chunk are left untouched.
+ */
+int vtoy_chain_virt_read(vtoy_chain *chain, vtoy_u64 lba, vtoy_u32 count, void *buf,
+                         vtoy_chain_read_pf read, void *ctx)
+{
+    int rc = 0;
+    vtoy_u32 i;
+    vtoy_u32 runcount = 0;
+    vtoy_u64 runlba = 0;
+    vtoy_u64 remap = 0;
+    vtoy_u8 *runbuf = NULL;
+    vtoy_u8 *cur = (vtoy_u8 *)buf;
+    const vtoy_u8 *mem = NULL;
+
+    for (i = 0; i < count; i++, lba++, cur += VTOY_CHAIN_IMG_SECTOR_SIZE)
+    {
+        switch (vtoy_chain_virt_sector(chain, lba, &mem, &remap))
+        {
+            case VTOY_CHAIN_VIRT_MEM:
+            {
+                vtoy_chain_memcpy(cur, mem, VTOY_CHAIN_IMG_SECTOR_SIZE);
+                break;
+            }
+            case VTOY_CHAIN_VIRT_REMAP:
+            {
+                if (runcount > 0 && runlba + runcount == remap &&
+                    runbuf + (vtoy_u64)runcount * VTOY_CHAIN_IMG_SECTOR_SIZE == cur)
+                {
+                    runcount++;
+                    break;
+                }
+
+                if (runcount > 0 && read(ctx, runlba, runcount, runbuf))
+                {
+                    rc = 1;
+                }
+
+                runlba = remap;
+                runbuf = cur;
+                runcount = 1;
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    if (runcount > 0 && read(ctx, runlba, runcount, runbuf))
+    {
+        rc = 1;
+    }
+
+    return rc;
+}
+
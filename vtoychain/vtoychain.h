@@ -0,0 +1,151 @@
+/******************************************************************************
+ * vtoychain.h  ---- ventoy chain head sector mapping
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The img/override/virt chunk tables that grub puts after the chain head, and the code
+ * that maps an image sector (2048 bytes) to the disk through them.
+ * It is shared by iPXE (BIOS), the UEFI chain loader, vtoytool and vtoy_fuse_iso, so it
+ * must not use anything beyond the integer types and a memcpy.
+ *
+ * Define VTOY_CHAIN_UEFI when building in EDK2, otherwise stdint.h/string.h are used.
+ */
+
+#ifndef __VTOYCHAIN_H__
+#define __VTOYCHAIN_H__
+
+#ifdef VTOY_CHAIN_UEFI
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+
+typedef UINT8  vtoy_u8;
+typedef UINT32 vtoy_u32;
+typedef UINT64 vtoy_u64;
+
+#define vtoy_chain_memcpy(dst, src, len)  CopyMem((dst), (src), (UINTN)(len))
+#else
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t  vtoy_u8;
+typedef uint32_t vtoy_u32;
+typedef uint64_t vtoy_u64;
+
+#define vtoy_chain_memcpy(dst, src, len)  memcpy((dst), (src), (size_t)(len))
+#endif
+
+#define VTOY_CHAIN_IMG_SECTOR_SIZE   2048
+#define VTOY_CHAIN_OVERRIDE_MAX      512
+
+#define VTOY_CHAIN_VIRT_NONE    0
+#define VTOY_CHAIN_VIRT_MEM     1
+#define VTOY_CHAIN_VIRT_REMAP   2
+
+#pragma pack(4)
+
+typedef struct ventoy_img_chunk
+{
+    vtoy_u32 img_start_sector; // sector size: 2KB
+    vtoy_u32 img_end_sector;   // included
+
+    vtoy_u64 disk_start_sector; // in disk_sector_size
+    vtoy_u64 disk_end_sector;   // included
+}ventoy_img_chunk;
+
+typedef struct ventoy_override_chunk
+{
+    vtoy_u64 img_offset;
+    vtoy_u32 override_size;
+    vtoy_u8  override_data[VTOY_CHAIN_OVERRIDE_MAX];
+}ventoy_override_chunk;
+
+typedef struct ventoy_virt_chunk
+{
+    vtoy_u32 mem_sector_start;
+    vtoy_u32 mem_sector_end;
+    vtoy_u32 mem_sector_offset;
+    vtoy_u32 remap_sector_start;
+    vtoy_u32 remap_sector_end;
+    vtoy_u32 org_sector_start;
+}ventoy_virt_chunk;
+
+#pragma pack()
+
+typedef struct vtoy_chain
+{
+    ventoy_img_chunk      *img_chunk;
+    vtoy_u32               img_chunk_num;
+    ventoy_override_chunk *override_chunk;
+    vtoy_u32               override_chunk_num;
+    ventoy_virt_chunk     *virt_chunk;
+    vtoy_u32               virt_chunk_num;
+
+    vtoy_u64 real_img_size;      /* in bytes */
+    vtoy_u32 disk_sector_size;
+    vtoy_u32 disk_sector_per_img; /* 2048 / disk_sector_size, 0 if the disk sector is larger */
+
+    vtoy_u32 sorted;  /* img chunks are ascending and not overlapped, so binary search can be used */
+    vtoy_u32 cur;     /* img chunk hit last time */
+
+    /* byte range covered by all the override chunks */
+    vtoy_u64 override_start;
+    vtoy_u64 override_end;
+}vtoy_chain;
+
+/* read count image sectors at lba (through the img and override chunks) into buf */
+typedef int (*vtoy_chain_read_pf)(void *ctx, vtoy_u64 lba, vtoy_u32 count, vtoy_u8 *buf);
+
+/* called for each override chunk applied to a read */
+typedef void (*vtoy_chain_override_pf)(void *ctx, const ventoy_override_chunk *node);
+
+int vtoy_chain_init
+(
+    vtoy_chain *chain,
+    void *head,
+    vtoy_u64 head_size,
+    vtoy_u32 img_chunk_offset,
+    vtoy_u32 img_chunk_num,
+    vtoy_u32 override_chunk_offset,
+    vtoy_u32 override_chunk_num,
+    vtoy_u32 virt_chunk_offset,
+    vtoy_u32 virt_chunk_num,
+    vtoy_u64 real_img_size,
+    vtoy_u32 disk_sector_size
+);
+
+/* head is a ventoy_chain_head, whose layout is the same everywhere */
+#define vtoy_chain_init_head(chain, head, size) \
+    vtoy_chain_init((chain), (head), (size), \
+                    (head)->img_chunk_offset, (head)->img_chunk_num, \
+                    (head)->override_chunk_offset, (head)->override_chunk_num, \
+                    (head)->virt_chunk_offset, (head)->virt_chunk_num, \
+                    (head)->real_img_size_in_bytes, (head)->disk_sector_size)
+
+int vtoy_chain_map(vtoy_chain *chain, vtoy_u64 lba, vtoy_u32 *count, vtoy_u64 *disk_sector);
+int vtoy_chain_map_512(vtoy_chain *chain, vtoy_u64 lba512, vtoy_u32 *count, vtoy_u64 *disk_sector);
+vtoy_u32 vtoy_chain_override(vtoy_chain *chain, vtoy_u64 lba, vtoy_u32 count, void *buf,
+                             vtoy_chain_override_pf hook, void *ctx);
+vtoy_u32 vtoy_chain_override_bytes(vtoy_chain *chain, vtoy_u64 offset, vtoy_u64 len, void *buf,
+                                   vtoy_chain_override_pf hook, void *ctx);
+int vtoy_chain_virt_sector(vtoy_chain *chain, vtoy_u64 lba, const vtoy_u8 **mem, vtoy_u64 *remap);
+int vtoy_chain_virt_read(vtoy_chain *chain, vtoy_u64 lba, vtoy_u32 count, void *buf,
+                         vtoy_chain_read_pf read, void *ctx);
+
+#endif /* __VTOYCHAIN_H__ */
+
@@ -0,0 +1,59 @@
+/******************************************************************************
+ * vtoychain_head.h  ---- ventoy chain head for the host tools
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The same layout as ventoy_chain_head in grub/iPXE/EDK2, with os_param kept opaque.
+ * Only bench.c and fuzz.c use it, the boot code has its own definition.
+ */
+
+#ifndef __VTOYCHAIN_HEAD_H__
+#define __VTOYCHAIN_HEAD_H__
+
+#include "vtoychain.h"
+
+#pragma pack(4)
+
+typedef struct ventoy_chain_head
+{
+    vtoy_u8  os_param[512];
+
+    vtoy_u32 disk_drive;
+    vtoy_u32 drive_map;
+    vtoy_u32 disk_sector_size;
+
+    vtoy_u64 real_img_size_in_bytes;
+    vtoy_u64 virt_img_size_in_bytes;
+    vtoy_u32 boot_catalog;
+    vtoy_u8  boot_catalog_sector[2048];
+
+    vtoy_u32 img_chunk_offset;
+    vtoy_u32 img_chunk_num;
+
+    vtoy_u32 override_chunk_offset;
+    vtoy_u32 override_chunk_num;
+
+    vtoy_u32 virt_chunk_offset;
+    vtoy_u32 virt_chunk_num;
+}ventoy_chain_head;
+
+#pragma pack()
+
+#endif /* __VTOYCHAIN_HEAD_H__ */
+
@@ -0,0 +1,17 @@
+#!/bin/bash
+
+XZ_DIR=../Ventoy2Disk/Ventoy2Disk/xz-embedded-20130513
+XZ_SRC="../Ventoy2Disk/Ventoy2Disk/vtoyxz.c $XZ_DIR/linux/lib/xz/xz_crc32.c $XZ_DIR/linux/lib/xz/xz_dec_stream.c $XZ_DIR/linux/lib/xz/xz_dec_lzma2.c"
+XZ_INC="-I$XZ_DIR/linux/include/linux -I$XZ_DIR/userspace"
+
+/opt/diet64/bin/diet -Os gcc -D_FILE_OFFSET_BITS=64 $XZ_INC vtoyinstall.c $XZ_SRC -lpthread -o  vtoyinstall_64
+/opt/diet32/bin/diet -Os gcc -D_FILE_OFFSET_BITS=64 -m32 $XZ_INC vtoyinstall.c $XZ_SRC -lpthread -o  vtoyinstall_32
+
+if [ -e vtoyinstall_64 ] && [ -e vtoyinstall_32 ]; then
+    echo -e '\n############### SUCCESS ###############\n'
+    mv vtoyinstall_64 ../INSTALL/tool/
+    mv vtoyinstall_32 ../INSTALL/tool/
+else
+    echo -e '\n############### FAILED ################\n'
+    exit 1
+fi
@@ -0,0 +1,633 @@
+/******************************************************************************
+ * vtoyinstall.c  ---- ventoy disk data writer for linux
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef O_DIRECT
+#define O_DIRECT 040000 /* x86 */
+#endif
+
+#define UINT64 unsigned long long
+#define UINT32 unsigned int
+#define UINT8  unsigned char
+
+#define VTOY_SECTOR_SIZE    512
+
+/* MBR/GPT and core.img, all in front of the 1st partition (start at 2048) */
+#define VTOY_HEAD_SECTORS   2048
+#define VTOY_HEAD_SIZE      (VTOY_HEAD_SECTORS * VTOY_SECTOR_SIZE)
+
+#define VTOY_BUF_SIZE       (4 * 1024 * 1024)
+
+#define VTOY_MODE_INSTALL   1
+#define VTOY_MODE_UPDATE    2
+
+static int verbose = 0;
+#define debug(fmt, ...) if(verbose) printf(fmt, ##__VA_ARGS__)
+
+static int g_disk_fd = -1;
+static int g_direct = 0;
+static const char *g_disk = NULL;
+static const char *g_xzcat = "./tool/xzcat";
+
+/* decompressed data of a .xz input */
+static UINT8 *g_xzdata = NULL;
+static UINT32 g_xzdata_size = 0;
+
+int vtoy_xz_decode(const unsigned char *in, unsigned int insize, unsigned char *out, unsigned int outsize, int threads, unsigned int *outlen);
+
+static int vtoy_print_help(FILE *fp)
+{
+    fprintf(fp, "Usage: \n"
+            "   vtoyinstall -i -s part2_start [ -g ] [ OPTION ] /dev/sdX \n"
+            "   vtoyinstall -u -s part2_start [ OPTION ] /dev/sdX \n"
+            "  OPTION: \n"
+            "   -b file    boot.img, default ./boot/boot.img \n"
+            "   -c file    core.img(.xz), default ./boot/core.img.xz \n"
+            "   -e file    ventoy.disk.img(.xz), default ./ventoy/ventoy.disk.img.xz \n"
+            "   -n num     sector count of the 2nd partition, default 65536 \n"
+            "   -x file    xzcat used for .xz files the builtin decoder can't handle, default ./tool/xzcat \n"
+            "   -v         be verbose \n"
+            );
+    return 0;
+}
+
+static int vtoy_open_disk(const char *disk)
+{
+    int fd;
+
+    fd = open(disk, O_RDWR | O_DIRECT);
+    if (fd >= 0)
+    {
+        g_direct = 1;
+        return fd;
+    }
+
+    debug("Failed to open %s with O_DIRECT err:%d, try without it\n", disk, errno);
+    g_direct = 0;
+    return open(disk, O_RDWR);
+}
+
+/*
+ * Some devices (e.g. files on tmpfs) accept O_DIRECT at open but refuse the I/O,
+ * drop the flag and go on with normal (but still large) I/O in that case.
+ */
+static int vtoy_drop_direct(void)
+{
+    int flags;
+
+    if (!g_direct)
+    {
+        return 1;
+    }
+
+    debug("O_DIRECT I/O refused, try without it\n");
+
+    flags = fcntl(g_disk_fd, F_GETFL);
+    if (flags < 0 || fcntl(g_disk_fd, F_SETFL, flags & ~O_DIRECT) < 0)
+    {
+        return 1;
+    }
+
+    g_direct = 0;
+    return 0;
+}
+
+static int vtoy_read_disk(void *buf, UINT32 len, UINT64 offset)
+{
+    ssize_t ret;
+
+    while (len > 0)
+    {
+        ret = pread(g_disk_fd, buf, len, (off_t)offset);
+        if (ret < 0 && errno == EINVAL && vtoy_drop_direct() == 0)
+        {
+            continue;
+        }
+
+        if (ret <= 0)
+        {
+            fprintf(stderr, "Failed to read %s at %llu err:%d\n", g_disk, offset, errno);
+            return 1;
+        }
+
+        buf = (UINT8 *)buf + ret;
+        len -= (UINT32)ret;
+        offset += ret;
+    }
+
+    return 0;
+}
+
+static int vtoy_write_disk(void *buf, UINT32 len, UINT64 offset)
+{
+    ssize_t ret;
+
+    while (len > 0)
+    {
+        ret = pwrite(g_disk_fd, buf, len, (off_t)offset);
+        if (ret < 0 && errno == EINVAL && vtoy_drop_direct() == 0)
+        {
+            continue;
+        }
+
+        if (ret <= 0)
+        {
+            fprintf(stderr, "Failed to write %s at %llu err:%d\n", g_disk, offset, errno);
+            return 1;
+        }
+
+        buf = (UINT8 *)buf + ret;
+        len -= (UINT32)ret;
+        offset += ret;
+    }
+
+    return 0;
+}
+
+static int vtoy_is_xz_file(const char *file)
+{
+    int len = (int)strlen(file);
+
+    return (len > 3 && strcmp(file + len - 3, ".xz") == 0) ? 1 : 0;
+}
+
+/*
+ * Decode a .xz file into g_xzdata with the block parallel decoder (one thread for each CPU).
+ * The caller falls back to xzcat if it fails (e.g. data larger than outsize).
+ */
+static int vtoy_decode_xz_file(const char *file, UINT32 outsize, UINT32 *outlen)
+{
+    int fd;
+    int rc = 1;
+    UINT8 *in = NULL;
+    struct stat st;
+
+    if (NULL == g_xzdata || outsize > g_xzdata_size)
+    {
+        return 1;
+    }
+
+    fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size < 0x7FFFFFFF)
+    {
+        in = malloc((size_t)st.st_size);
+        if (in && read(fd, in, (size_t)st.st_size) == (ssize_t)st.st_size)
+        {
+            rc = vtoy_xz_decode(in, (unsigned int)st.st_size, g_xzdata, outsize, 0, outlen);
+        }
+    }
+
+    if (in)
+    {
+        free(in);
+    }
+    close(fd);
+
+    debug("decode %s rc:%d len:%u\n", file, rc, (rc == 0) ? *outlen : 0);
+    return rc;
+}
+
+static FILE * vtoy_open_input(const char *file, int *ispipe)
+{
+    char cmd[512];
+
+    if (vtoy_is_xz_file(file))
+    {
+        *ispipe = 1;
+        snprintf(cmd, sizeof(cmd), "%s %s", g_xzcat, file);
+        return popen(cmd, "r");
+    }
+
+    *ispipe = 0;
+    return fopen(file, "rb");
+}
+
+static int vtoy_close_input(FILE *fp, int ispipe)
+{
+    char drain[4096];
+
+    if (ispipe)
+    {
+        /* we may only need part of the data (e.g. core.img for GPT), don't let xzcat die of SIGPIPE */
+        while (fread(drain, 1, sizeof(drain), fp) > 0)
+        {
+            ;
+        }
+        return pclose(fp) == 0 ? 0 : 1;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/* read at most len bytes, return the actual length (less only at the end of the input) */
+static UINT32 vtoy_read_input(FILE *fp, void *buf, UINT32 len)
+{
+    size_t ret;
+    UINT32 total = 0;
+
+    while (total < len)
+    {
+        ret = fread((UINT8 *)buf + total, 1, len - total, fp);
+        if (ret == 0)
+        {
+            break;
+        }
+        total += (UINT32)ret;
+    }
+
+    return total;
+}
+
+static int vtoy_read_file(const char *file, void *buf, UINT32 len, UINT32 *rdlen)
+{
+    int ispipe = 0;
+    UINT32 outlen = 0;
+    FILE *fp = NULL;
+
+    if (vtoy_is_xz_file(file) && vtoy_decode_xz_file(file, g_xzdata_size, &outlen) == 0)
+    {
+        *rdlen = (outlen > len) ? len : outlen;
+        memcpy(buf, g_xzdata, *rdlen);
+        return 0;
+    }
+
+    fp = vtoy_open_input(file, &ispipe);
+    if (NULL == fp)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", file, errno);
+        return 1;
+    }
+
+    *rdlen = vtoy_read_input(fp, buf, len);
+
+    if (vtoy_close_input(fp, ispipe))
+    {
+        fprintf(stderr, "Failed to decompress %s\n", file);
+        return 1;
+    }
+
+    debug("read %s %u bytes\n", file, *rdlen);
+    return 0;
+}
+
+static void vtoy_gen_uuid(UINT8 *uuid, int len)
+{
+    int i;
+    int fd;
+
+    fd = open("/dev/random", O_RDONLY);
+    if (fd >= 0 && read(fd, uuid, len) == len)
+    {
+        close(fd);
+        return;
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    srand(time(NULL));
+    for (i = 0; i < len; i++)
+    {
+        uuid[i] = (UINT8)(rand());
+    }
+}
+
+/*
+ * Compose the first 1MB of the disk in memory and write it back at once:
+ *   sector 0     boot.img boot code over the partition table made by parted/fdisk
+ *   sector 1-33  GPT (untouched)
+ *   sector 1/34  core.img (MBR/GPT)
+ */
+static int vtoy_write_head(int mode, int gpt, UINT8 *buf, const char *bootimg, const char *coreimg)
+{
+    UINT8 *mbr = buf;
+    UINT32 len = 0;
+    UINT32 bootlen;
+    UINT32 corestart;
+    UINT32 coremax;
+    UINT8 uuid[32];
+
+    if (vtoy_read_disk(buf, VTOY_HEAD_SIZE, 0))
+    {
+        return 1;
+    }
+
+    if (mode == VTOY_MODE_UPDATE)
+    {
+        gpt = (mbr[450] == 0xEE) ? 1 : 0;
+    }
+
+    debug("write head mode:%d gpt:%d\n", mode, gpt);
+
+    if (gpt)
+    {
+        corestart = 34;
+        coremax = 2014;
+    }
+    else
+    {
+        corestart = 1;
+        coremax = 2047;
+    }
+
+    /* GPT update keeps the protective MBR as it is */
+    if (mode == VTOY_MODE_INSTALL || gpt == 0)
+    {
+        if (vtoy_read_file(bootimg, buf + VTOY_HEAD_SIZE, VTOY_SECTOR_SIZE, &len))
+        {
+            return 1;
+        }
+
+        /* update keeps the disk signature at 440 */
+        bootlen = (mode == VTOY_MODE_INSTALL) ? 446 : 440;
+        memcpy(mbr, buf + VTOY_HEAD_SIZE, (len > bootlen) ? bootlen : len);
+    }
+
+    if (mode == VTOY_MODE_INSTALL)
+    {
+        if (gpt)
+        {
+            mbr[92] = 0x22; /* core.img start sector 34 in boot.img */
+        }
+
+        /* disk uuid and disk signature */
+        vtoy_gen_uuid(uuid, sizeof(uuid));
+        memcpy(mbr + 384, uuid, 16);
+        memcpy(mbr + 440, uuid + 16 + 12, 4);
+    }
+    else if (gpt == 0)
+    {
+        /* make the 1st partition active */
+        if (mbr[446] == 0x00 && mbr[462] == 0x80)
+        {
+            debug("change 1st partition active, 2nd partition inactive ...\n");
+            mbr[446] = 0x80;
+            mbr[462] = 0x00;
+        }
+    }
+
+    if (vtoy_read_file(coreimg, buf + corestart * VTOY_SECTOR_SIZE, coremax * VTOY_SECTOR_SIZE, &len))
+    {
+        return 1;
+    }
+
+    if (gpt)
+    {
+        buf[17908] = 0x23; /* next sector of core.img in diskboot.img */
+    }
+
+    return vtoy_write_disk(buf, VTOY_HEAD_SIZE, 0);
+}
+
+/*
+ * Write data to the disk, a tail shorter than one sector is merged with the disk data, same as dd does.
+ * data must have room up to the end of the tail sector.
+ */
+static int vtoy_write_span(UINT8 *data, UINT32 len, UINT64 offset, UINT8 *tail)
+{
+    UINT32 align;
+
+    align = len & (~(VTOY_SECTOR_SIZE - 1));
+    if (align < len)
+    {
+        if (vtoy_read_disk(tail, VTOY_SECTOR_SIZE, offset + align))
+        {
+            return 1;
+        }
+        memcpy(tail, data + align, len - align);
+        memcpy(data + align, tail, VTOY_SECTOR_SIZE);
+        len = align + VTOY_SECTOR_SIZE;
+    }
+
+    return vtoy_write_disk(data, len, offset);
+}
+
+/*
+ * Write the decompressed EFI partition image to the disk. A .xz image is decoded in memory
+ * and written at once, otherwise (or if that fails) it is streamed in 4MB aligned writes.
+ */
+static int vtoy_write_part2(UINT8 *buf, const char *diskimg, UINT64 start, UINT64 sectors)
+{
+    int rc = 1;
+    int ispipe = 0;
+    UINT32 len;
+    UINT64 offset = start * VTOY_SECTOR_SIZE;
+    UINT64 remain = sectors * VTOY_SECTOR_SIZE;
+    UINT8 *tail = buf + VTOY_BUF_SIZE;
+    FILE *fp = NULL;
+
+    if (vtoy_is_xz_file(diskimg) && vtoy_decode_xz_file(diskimg, (UINT32)remain, &len) == 0)
+    {
+        debug("write part2 %u bytes at sector %llu\n", len, start);
+        return vtoy_write_span(g_xzdata, len, offset, tail);
+    }
+
+    fp = vtoy_open_input(diskimg, &ispipe);
+    if (NULL == fp)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", diskimg, errno);
+        return 1;
+    }
+
+    while (remain > 0)
+    {
+        len = vtoy_read_input(fp, buf, remain > VTOY_BUF_SIZE ? VTOY_BUF_SIZE : (UINT32)remain);
+        if (len == 0)
+        {
+            break;
+        }
+
+        if (vtoy_write_span(buf, len, offset, tail))
+        {
+            goto end;
+        }
+
+        len = (len + VTOY_SECTOR_SIZE - 1) & (~(VTOY_SECTOR_SIZE - 1));
+        offset += len;
+        remain = (remain > len) ? (remain - len) : 0;
+    }
+
+    debug("write part2 %llu bytes at sector %llu\n", sectors * VTOY_SECTOR_SIZE - remain, start);
+    rc = 0;
+
+end:
+    if (vtoy_close_input(fp, ispipe) && rc == 0)
+    {
+        fprintf(stderr, "Failed to decompress %s\n", diskimg);
+        rc = 1;
+    }
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    int ch;
+    int rc = 1;
+    int gpt = 0;
+    int mode = 0;
+    UINT64 start = 0;
+    UINT64 sectors = 65536;
+    UINT8 *buf = MAP_FAILED;
+    const char *bootimg = "./boot/boot.img";
+    const char *coreimg = "./boot/core.img.xz";
+    const char *diskimg = "./ventoy/ventoy.disk.img.xz";
+
+    while ((ch = getopt(argc, argv, "s:n:b:c:e:x:i::u::g::v::h::")) != -1)
+    {
+        if (ch == 'i')
+        {
+            mode = VTOY_MODE_INSTALL;
+        }
+        else if (ch == 'u')
+        {
+            mode = VTOY_MODE_UPDATE;
+        }
+        else if (ch == 'g')
+        {
+            gpt = 1;
+        }
+        else if (ch == 's')
+        {
+            start = strtoull(optarg, NULL, 10);
+        }
+        else if (ch == 'n')
+        {
+            sectors = strtoull(optarg, NULL, 10);
+        }
+        else if (ch == 'b')
+        {
+            bootimg = optarg;
+        }
+        else if (ch == 'c')
+        {
+            coreimg = optarg;
+        }
+        else if (ch == 'e')
+        {
+            diskimg = optarg;
+        }
+        else if (ch == 'x')
+        {
+            g_xzcat = optarg;
+        }
+        else if (ch == 'v')
+        {
+            verbose = 1;
+        }
+        else if (ch == 'h')
+        {
+            return vtoy_print_help(stdout);
+        }
+        else
+        {
+            vtoy_print_help(stderr);
+            return 1;
+        }
+    }
+
+    if (mode == 0 || optind >= argc || start < VTOY_HEAD_SECTORS)
+    {
+        vtoy_print_help(stderr);
+        return 1;
+    }
+
+    g_disk = argv[optind];
+    g_disk_fd = vtoy_open_disk(g_disk);
+    if (g_disk_fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", g_disk, errno);
+        return 1;
+    }
+
+    /* mmap buffer is page aligned, as O_DIRECT needs, one more page for the tail sector */
+    buf = mmap(NULL, VTOY_BUF_SIZE + 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to alloc memory len:%d err:%d\n", VTOY_BUF_SIZE, errno);
+        goto end;
+    }
+
+    /* room for the whole decompressed EFI partition image (or core.img), xzcat is used if it fails */
+    if (sectors * VTOY_SECTOR_SIZE < 0x40000000)
+    {
+        g_xzdata_size = (UINT32)(sectors * VTOY_SECTOR_SIZE);
+        if (g_xzdata_size < VTOY_HEAD_SIZE)
+        {
+            g_xzdata_size = VTOY_HEAD_SIZE;
+        }
+
+        g_xzdata = mmap(NULL, g_xzdata_size + 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (g_xzdata == MAP_FAILED)
+        {
+            debug("Failed to alloc xz buffer len:%u err:%d\n", g_xzdata_size, errno);
+            g_xzdata = NULL;
+        }
+    }
+
+    if (vtoy_write_head(mode, gpt, buf, bootimg, coreimg))
+    {
+        goto end;
+    }
+
+    if (vtoy_write_part2(buf, diskimg, start, sectors))
+    {
+        goto end;
+    }
+
+    /* the only sync for all the data written above */
+    if (fsync(g_disk_fd) < 0)
+    {
+        fprintf(stderr, "Failed to sync %s err:%d\n", g_disk, errno);
+        goto end;
+    }
+
+    debug("write %s success, direct:%d\n", g_disk, g_direct);
+    rc = 0;
+
+end:
+    if (buf != MAP_FAILED)
+    {
+        munmap(buf, VTOY_BUF_SIZE + 4096);
+    }
+    if (g_xzdata)
+    {
+        munmap(g_xzdata, g_xzdata_size + 4096);
+    }
+    close(g_disk_fd);
+    return rc;
+}
+
@@ -0,0 +1,15 @@
+#!/bin/sh
+
+rm -f vtoypersist_64
+rm -f vtoypersist_32
+
+gcc -O2 -D_FILE_OFFSET_BITS=64 vtoypersist.c -o vtoypersist_64
+gcc -m32 -O2 -D_FILE_OFFSET_BITS=64 vtoypersist.c -o vtoypersist_32
+
+if [ -e vtoypersist_64 ] && [ -e vtoypersist_32 ]; then
+    echo -e "\n===== success =======\n"
+    [ -d ../INSTALL/tool/ ] && mv vtoypersist_32 ../INSTALL/tool/ && mv vtoypersist_64 ../INSTALL/tool/
+else
+    echo -e "\n===== failed =======\n"
+    exit 1
+fi
@@ -0,0 +1,262 @@
+/******************************************************************************
+ * vtoypersist.c  ---- ventoy persistence image file util
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef O_DIRECT
+#define O_DIRECT 040000 /* x86 */
+#endif
+
+#define UINT64 unsigned long long
+#define UINT32 unsigned int
+#define UINT8  unsigned char
+
+#define VTOY_SIZE_1MB       (1024 * 1024)
+#define VTOY_FILL_BUF_SIZE  (4 * VTOY_SIZE_1MB)
+#define VTOY_FILL_BYTE      0xFF
+
+static int verbose = 0;
+#define debug(fmt, ...) if(verbose) printf(fmt, ##__VA_ARGS__)
+
+static int vtoy_print_help(FILE *fp)
+{
+    fprintf(fp, "Usage: vtoypersist -s size_in_MB [ -v ] file \n"
+            "   create the file with the size, or grow/shrink it if it already exists \n");
+    return 0;
+}
+
+/*
+ * Reserve the space at once, so the file is as contiguous as the filesystem can make it
+ * and we fail before writing gigabytes if there is no enough space.
+ * Not all the filesystems support it (e.g. exfat-fuse), the fill writes allocate the space anyway.
+ */
+static int vtoy_prealloc(int fd, UINT64 offset, UINT64 len)
+{
+    int ret;
+
+    ret = fallocate(fd, 0, (off_t)offset, (off_t)len);
+    if (ret == 0)
+    {
+        debug("fallocate %llu %llu success\n", offset, len);
+        return 0;
+    }
+
+    if (errno == ENOSPC)
+    {
+        fprintf(stderr, "No enough space for %llu MB\n", len / VTOY_SIZE_1MB);
+        return 1;
+    }
+
+    debug("fallocate not supported err:%d\n", errno);
+    return 0;
+}
+
+/*
+ * Fill [offset, end) with 0xFF, so no part of the file looks like a hole (all zero)
+ * to the sparse detection of the copy tools.
+ * Only the range not written before is filled, large aligned writes and one fsync at the end.
+ */
+static int vtoy_fill(int fd, int direct, UINT64 offset, UINT64 end)
+{
+    int flags;
+    int tty;
+    int last = -1;
+    int percent;
+    ssize_t ret;
+    UINT32 len;
+    UINT64 total = end - offset;
+    UINT64 done = 0;
+    UINT8 *buf = MAP_FAILED;
+
+    /* mmap buffer is page aligned, as O_DIRECT needs */
+    buf = mmap(NULL, VTOY_FILL_BUF_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to alloc memory len:%d err:%d\n", VTOY_FILL_BUF_SIZE, errno);
+        return 1;
+    }
+    memset(buf, VTOY_FILL_BYTE, VTOY_FILL_BUF_SIZE);
+
+    tty = isatty(2);
+
+    while (offset < end)
+    {
+        len = (end - offset > VTOY_FILL_BUF_SIZE) ? VTOY_FILL_BUF_SIZE : (UINT32)(end - offset);
+
+        /* the old file end may not be aligned, catch up to the buffer size boundary first */
+        if (offset % VTOY_FILL_BUF_SIZE)
+        {
+            len = VTOY_FILL_BUF_SIZE - (UINT32)(offset % VTOY_FILL_BUF_SIZE);
+            if (len > end - offset)
+            {
+                len = (UINT32)(end - offset);
+            }
+        }
+
+        ret = pwrite(fd, buf, len, (off_t)offset);
+        if (ret < 0 && errno == EINVAL && direct)
+        {
+            debug("O_DIRECT write refused at %llu, try without it\n", offset);
+            flags = fcntl(fd, F_GETFL);
+            if (flags >= 0 && fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0)
+            {
+                direct = 0;
+                continue;
+            }
+        }
+
+        if (ret <= 0)
+        {
+            fprintf(stderr, "Failed to write at %llu err:%d\n", offset, errno);
+            munmap(buf, VTOY_FILL_BUF_SIZE);
+            return 1;
+        }
+
+        offset += ret;
+        done += ret;
+
+        percent = (int)(done * 100 / total);
+        if (tty && percent != last)
+        {
+            fprintf(stderr, "\r%3d%%  %llu/%llu MB", percent, done / VTOY_SIZE_1MB, total / VTOY_SIZE_1MB);
+            last = percent;
+        }
+    }
+
+    if (tty)
+    {
+        fprintf(stderr, "\n");
+    }
+
+    munmap(buf, VTOY_FILL_BUF_SIZE);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ch;
+    int fd;
+    int rc = 1;
+    int direct = 0;
+    UINT64 size = 0;
+    UINT64 oldsize = 0;
+    const char *file = NULL;
+    struct stat st;
+
+    while ((ch = getopt(argc, argv, "s:v::h::")) != -1)
+    {
+        if (ch == 's')
+        {
+            size = strtoull(optarg, NULL, 10) * VTOY_SIZE_1MB;
+        }
+        else if (ch == 'v')
+        {
+            verbose = 1;
+        }
+        else if (ch == 'h')
+        {
+            return vtoy_print_help(stdout);
+        }
+        else
+        {
+            vtoy_print_help(stderr);
+            return 1;
+        }
+    }
+
+    if (size == 0 || optind >= argc)
+    {
+        vtoy_print_help(stderr);
+        return 1;
+    }
+
+    file = argv[optind];
+
+    /* O_DIRECT keeps gigabytes of fill data out of the page cache */
+    fd = open(file, O_RDWR | O_CREAT | O_DIRECT, 0644);
+    if (fd >= 0)
+    {
+        direct = 1;
+    }
+    else
+    {
+        fd = open(file, O_RDWR | O_CREAT, 0644);
+    }
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s err:%d\n", file, errno);
+        return 1;
+    }
+
+    if (fstat(fd, &st) < 0)
+    {
+        fprintf(stderr, "Failed to stat %s err:%d\n", file, errno);
+        goto end;
+    }
+
+    oldsize = (UINT64)st.st_size;
+    debug("%s size %llu ==> %llu direct:%d\n", file, oldsize, size, direct);
+
+    if (size < oldsize)
+    {
+        /* the filesystem in it must have been shrunk before */
+        if (ftruncate(fd, (off_t)size) < 0)
+        {
+            fprintf(stderr, "Failed to truncate %s err:%d\n", file, errno);
+            goto end;
+        }
+    }
+    else if (size > oldsize)
+    {
+        if (vtoy_prealloc(fd, oldsize, size - oldsize))
+        {
+            goto end;
+        }
+
+        if (vtoy_fill(fd, direct, oldsize, size))
+        {
+            goto end;
+        }
+    }
+
+    if (fsync(fd) < 0)
+    {
+        fprintf(stderr, "Failed to sync %s err:%d\n", file, errno);
+        goto end;
+    }
+
+    rc = 0;
+
+end:
+    close(fd);
+    return rc;
+}
+
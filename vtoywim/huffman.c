@@ -24,7 +24,7 @@
  *
  */
 
-#include "wimboot.h"
+#include "vtoywim.h"
 #include "huffman.h"
 
 /**
@@ -185,23 +185,3 @@ int huffman_alphabet ( struct huffman_alphabet *alphabet,
 
 	return 0;
 }
-
-/**
- * Get Huffman symbol set
- *
- * @v alphabet		Huffman alphabet
- * @v huf		Raw input value (normalised to HUFFMAN_BITS bits)
- * @ret sym		Huffman symbol set
- */
-struct huffman_symbols * huffman_sym ( struct huffman_alphabet *alphabet,
-				       unsigned int huf ) {
-	struct huffman_symbols *sym;
-	unsigned int lookup_index;
-
-	/* Find symbol set for this length */
-	lookup_index = ( huf >> HUFFMAN_QL_SHIFT );
-	sym = &alphabet->huf[ alphabet->lookup[ lookup_index ] ];
-	while ( huf < sym->start )
-		sym--;
-	return sym;
-}
@@ -102,7 +102,27 @@ huffman_raw ( struct huffman_symbols *sym, unsigned int huf ) {
 
 extern int huffman_alphabet ( struct huffman_alphabet *alphabet,
 			      uint8_t *lengths, unsigned int count );
-extern struct huffman_symbols *
-huffman_sym ( struct huffman_alphabet *alphabet, unsigned int huf );
+
+/**
+ * Get Huffman symbol set
+ *
+ * @v alphabet		Huffman alphabet
+ * @v huf		Raw input value (normalised to HUFFMAN_BITS bits)
+ * @ret sym		Huffman symbol set
+ *
+ * Inline, as it is called for every decoded symbol.
+ */
+static inline __attribute__ (( always_inline )) struct huffman_symbols *
+huffman_sym ( struct huffman_alphabet *alphabet, unsigned int huf ) {
+	struct huffman_symbols *sym;
+	unsigned int lookup_index;
+
+	/* Find symbol set for this length */
+	lookup_index = ( huf >> HUFFMAN_QL_SHIFT );
+	sym = &alphabet->huf[ alphabet->lookup[ lookup_index ] ];
+	while ( huf < sym->start )
+		sym--;
+	return sym;
+}
 
 #endif /* _HUFFMAN_H */
@@ -31,12 +31,19 @@
  *
  */
 
-#include "wimboot.h"
+#include "vtoywim.h"
 #include "huffman.h"
 #include "lzx.h"
 
-/** Base positions, indexed by position slot */
-static unsigned int lzx_position_base[LZX_POSITION_SLOTS];
+/** Base positions, indexed by position slot
+ *
+ * Constant (rather than filled on the first call) so that several
+ * threads can decompress at the same time.
+ */
+static const unsigned int lzx_position_base[LZX_POSITION_SLOTS] = {
+	0, 1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384,
+	512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384, 24576
+};
 
 /**
  * Attempt to accumulate bits from LZX bitstream
@@ -617,15 +624,6 @@ ssize_t lzx_decompress ( const void *data, size_t len, void *buf ) {
 		return -1;
 	}
 
-	/* Initialise global state, if required */
-	if ( ! lzx_position_base[ LZX_POSITION_SLOTS - 1 ] ) {
-		for ( i = 1 ; i < LZX_POSITION_SLOTS ; i++ ) {
-			lzx_position_base[i] =
-				( lzx_position_base[i-1] +
-				  ( 1 << lzx_footer_bits ( i - 1 ) ) );
-		}
-	}
-
 	/* Initialise decompressor */
 	memset ( &lzx, 0, sizeof ( lzx ) );
 	lzx.input.data = data;
@@ -0,0 +1,313 @@
+/******************************************************************************
+ * vtoywim.c  ---- WIM resource chunk table and decompression
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "vtoywim.h"
+
+#ifndef VTOY_WIM_GRUB
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define VTOY_WIM_MAX_THREAD     32
+#endif
+
+static uint64_t vtoy_wim_get_le(const uint8_t *buf, uint32_t len)
+{
+    uint32_t i;
+    uint64_t value = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        value |= (uint64_t)buf[i] << (i * 8);
+    }
+
+    return value;
+}
+
+/*
+ * Compression type of the resources from the wim header flags,
+ * -1 for the ones that can not be decompressed here (LZMS).
+ */
+int vtoy_wim_comp_type(uint32_t header_flags)
+{
+    if ((header_flags & VTOY_WIM_HDR_COMPRESSION) == 0)
+    {
+        return VTOY_WIM_COMP_NONE;
+    }
+
+    if (header_flags & VTOY_WIM_HDR_XPRESS)
+    {
+        return VTOY_WIM_COMP_XPRESS;
+    }
+
+    if (header_flags & VTOY_WIM_HDR_LZX)
+    {
+        return VTOY_WIM_COMP_LZX;
+    }
+
+    return -1;
+}
+
+uint32_t vtoy_wim_chunk_num(uint64_t raw_size)
+{
+    return (uint32_t)((raw_size + VTOY_WIM_CHUNK_LEN - 1) / VTOY_WIM_CHUNK_LEN);
+}
+
+/*
+ * Fill chunks[vtoy_wim_chunk_num(raw_size)] from the chunk table at the start of the
+ * compressed resource res[size_in_wim].
+ * The table has an entry for every chunk but the first one, which is the offset of the
+ * chunk after the table, 8 bytes for the resources larger than 4GB and 4 bytes otherwise.
+ * Return 0 if the table is sane.
+ */
+int vtoy_wim_parse_chunks(const void *res, uint64_t size_in_wim, uint64_t raw_size, vtoy_wim_chunk *chunks)
+{
+    uint32_t i;
+    uint32_t num;
+    uint32_t entry;
+    uint64_t table;
+    uint64_t start;
+    uint64_t end;
+    const uint8_t *data = (const uint8_t *)res;
+
+    num = vtoy_wim_chunk_num(raw_size);
+    if (num == 0)
+    {
+        return 1;
+    }
+
+    entry = (raw_size > 0xFFFFFFFFULL) ? 8 : 4;
+    table = (uint64_t)(num - 1) * entry;
+    if (table >= size_in_wim)
+    {
+        return 1;
+    }
+
+    start = 0;
+    for (i = 0; i < num; i++)
+    {
+        end = (i + 1 < num) ? vtoy_wim_get_le(data + (uint64_t)i * entry, entry) : size_in_wim - table;
+
+        /* a chunk never grows, it is stored uncompressed if compression does not help */
+        if (end <= start || end > size_in_wim - table || end - start > VTOY_WIM_CHUNK_LEN)
+        {
+            return 1;
+        }
+
+        chunks[i].offset = table + start;
+        chunks[i].size = (uint32_t)(end - start);
+        chunks[i].raw_size = (i + 1 < num) ? VTOY_WIM_CHUNK_LEN : (uint32_t)(raw_size - (uint64_t)i * VTOY_WIM_CHUNK_LEN);
+
+        if (chunks[i].size > chunks[i].raw_size)
+        {
+            return 1;
+        }
+
+        start = end;
+    }
+
+    return 0;
+}
+
+/*
+ * Decompress one chunk of the resource res to out[chunk->raw_size].
+ * Return 0 for success.
+ */
+int vtoy_wim_decompress_chunk(int comp, const void *res, const vtoy_wim_chunk *chunk, void *out)
+{
+    ssize_t len;
+    const uint8_t *data = (const uint8_t *)res + chunk->offset;
+
+    if (chunk->size == chunk->raw_size)
+    {
+        memcpy(out, data, chunk->size);
+        return 0;
+    }
+
+    if (comp == VTOY_WIM_COMP_XPRESS)
+    {
+        len = xca_decompress(data, chunk->size, out);
+    }
+    else if (comp == VTOY_WIM_COMP_LZX)
+    {
+        len = lzx_decompress(data, chunk->size, out);
+    }
+    else
+    {
+        return 1;
+    }
+
+    return (len == (ssize_t)chunk->raw_size) ? 0 : 1;
+}
+
+/*
+ * Decompress the whole resource res[size_in_wim] to out[raw_size] in the calling thread,
+ * chunks is a buffer of vtoy_wim_chunk_num(raw_size) entries.
+ * Return 0 for success.
+ */
+int vtoy_wim_decompress(int comp, const void *res, uint64_t size_in_wim, uint64_t raw_size,
+                        vtoy_wim_chunk *chunks, void *out)
+{
+    uint32_t i;
+    uint32_t num;
+
+    if (size_in_wim == raw_size)
+    {
+        memcpy(out, res, (size_t)raw_size);
+        return 0;
+    }
+
+    if (vtoy_wim_parse_chunks(res, size_in_wim, raw_size, chunks))
+    {
+        DBG("Invalid chunk table size_in_wim:%llu raw_size:%llu\n",
+            (unsigned long long)size_in_wim, (unsigned long long)raw_size);
+        return 1;
+    }
+
+    num = vtoy_wim_chunk_num(raw_size);
+    for (i = 0; i < num; i++)
+    {
+        if (vtoy_wim_decompress_chunk(comp, res, chunks + i, (uint8_t *)out + (uint64_t)i * VTOY_WIM_CHUNK_LEN))
+        {
+            DBG("Failed to decompress chunk %u/%u size:%u\n", i, num, chunks[i].size);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#ifndef VTOY_WIM_GRUB
+
+typedef struct vtoy_wim_ctx
+{
+    int comp;
+    const void *res;
+    uint8_t *out;
+    uint32_t chunknum;
+    vtoy_wim_chunk *chunks;
+
+    volatile long next;
+    volatile long error;
+}vtoy_wim_ctx;
+
+static void * vtoy_wim_worker(void *param)
+{
+    long i;
+    vtoy_wim_ctx *ctx = (vtoy_wim_ctx *)param;
+
+    while (ctx->error == 0)
+    {
+        i = __sync_fetch_and_add(&(ctx->next), 1);
+        if (i >= (long)ctx->chunknum)
+        {
+            break;
+        }
+
+        if (vtoy_wim_decompress_chunk(ctx->comp, ctx->res, ctx->chunks + i, ctx->out + (uint64_t)i * VTOY_WIM_CHUNK_LEN))
+        {
+            __sync_lock_test_and_set(&(ctx->error), 1);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+int vtoy_wim_cpu_num(void)
+{
+    long num = sysconf(_SC_NPROCESSORS_ONLN);
+    return (num > 0) ? (int)num : 1;
+}
+
+/*
+ * Same as vtoy_wim_decompress, but the chunks are shared by threads (0 means one for
+ * each CPU) that decompress them straight into their place in out.
+ * Return 0 for success.
+ */
+int vtoy_wim_decompress_mt(int comp, const void *res, uint64_t size_in_wim, uint64_t raw_size,
+                           void *out, int threads)
+{
+    int i;
+    int num = 0;
+    vtoy_wim_ctx ctx;
+    pthread_t handles[VTOY_WIM_MAX_THREAD];
+
+    if (size_in_wim == raw_size)
+    {
+        memcpy(out, res, (size_t)raw_size);
+        return 0;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.comp = comp;
+    ctx.res = res;
+    ctx.out = (uint8_t *)out;
+    ctx.chunknum = vtoy_wim_chunk_num(raw_size);
+
+    ctx.chunks = (vtoy_wim_chunk *)malloc(ctx.chunknum * sizeof(vtoy_wim_chunk));
+    if (!ctx.chunks)
+    {
+        return 1;
+    }
+
+    if (vtoy_wim_parse_chunks(res, size_in_wim, raw_size, ctx.chunks))
+    {
+        free(ctx.chunks);
+        return 1;
+    }
+
+    if (threads <= 0)
+    {
+        threads = vtoy_wim_cpu_num();
+    }
+
+    if (threads > VTOY_WIM_MAX_THREAD)
+    {
+        threads = VTOY_WIM_MAX_THREAD;
+    }
+
+    if (threads > (int)ctx.chunknum)
+    {
+        threads = (int)ctx.chunknum;
+    }
+
+    /* the calling thread is one of the workers, a failed thread creation only makes it slower */
+    for (i = 0; i < threads - 1; i++)
+    {
+        if (pthread_create(handles + num, NULL, vtoy_wim_worker, &ctx) == 0)
+        {
+            num++;
+        }
+    }
+
+    vtoy_wim_worker(&ctx);
+
+    for (i = 0; i < num; i++)
+    {
+        pthread_join(handles[i], NULL);
+    }
+
+    free(ctx.chunks);
+    return ctx.error ? 1 : 0;
+}
+
+#endif /* VTOY_WIM_GRUB */
+
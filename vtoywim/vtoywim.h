@@ -0,0 +1,82 @@
+/******************************************************************************
+ * vtoywim.h  ---- WIM resource chunk table and decompression
+ *
+ * Copyright (c) 2020, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * A compressed WIM resource is a chunk table followed by the chunks, every chunk is
+ * WIM_CHUNK_LEN bytes uncompressed (except the last one) and is compressed on its own,
+ * so the chunks can be decompressed in any order and in parallel.
+ *
+ * The same code (with lzx.c/xpress.c/huffman.c) is used by the grub ventoy module and by
+ * vtoytool. Define VTOY_WIM_GRUB when building in grub, buildgrub.sh copies these files to
+ * grub-core/ventoy/. The worker pool is only built for linux.
+ */
+
+#ifndef __VTOYWIM_H__
+#define __VTOYWIM_H__
+
+#ifdef VTOY_WIM_GRUB
+#include "wimboot.h"
+#else
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define assert(exp)
+#define DBG(fmt, ...)
+
+const char * huffman_bin ( unsigned long value, unsigned int bits );
+#endif
+
+#define VTOY_WIM_CHUNK_LEN      32768
+
+#define VTOY_WIM_COMP_NONE      0
+#define VTOY_WIM_COMP_XPRESS    1
+#define VTOY_WIM_COMP_LZX       2
+
+/* wim header flags */
+#define VTOY_WIM_HDR_COMPRESSION    0x00000002
+#define VTOY_WIM_HDR_XPRESS         0x00020000
+#define VTOY_WIM_HDR_LZX            0x00040000
+
+typedef struct vtoy_wim_chunk
+{
+    uint64_t offset;    /* from the start of the resource */
+    uint32_t size;      /* size in the wim, equal to raw_size if the chunk is stored uncompressed */
+    uint32_t raw_size;
+}vtoy_wim_chunk;
+
+ssize_t lzx_decompress ( const void *data, size_t len, void *buf );
+ssize_t xca_decompress ( const void *data, size_t len, void *buf );
+
+int vtoy_wim_comp_type(uint32_t header_flags);
+uint32_t vtoy_wim_chunk_num(uint64_t raw_size);
+int vtoy_wim_parse_chunks(const void *res, uint64_t size_in_wim, uint64_t raw_size, vtoy_wim_chunk *chunks);
+int vtoy_wim_decompress_chunk(int comp, const void *res, const vtoy_wim_chunk *chunk, void *out);
+int vtoy_wim_decompress(int comp, const void *res, uint64_t size_in_wim, uint64_t raw_size,
+                        vtoy_wim_chunk *chunks, void *out);
+
+#ifndef VTOY_WIM_GRUB
+int vtoy_wim_cpu_num(void);
+int vtoy_wim_decompress_mt(int comp, const void *res, uint64_t size_in_wim, uint64_t raw_size,
+                           void *out, int threads);
+#endif
+
+#endif /* __VTOYWIM_H__ */
+
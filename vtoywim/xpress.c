@@ -24,7 +24,7 @@
  *
  */
 
-#include "wimboot.h"
+#include "vtoywim.h"
 #include "huffman.h"
 #include "xpress.h"
 